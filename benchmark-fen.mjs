@@ -0,0 +1,66 @@
+// Per-ply FEN export: makeMoveSAN + toFEN after every move, with and without the
+// per-board rank cache (setFENCache), on the native engine.
+// Run: npm run build && node benchmark-fen.mjs [games=20000]
+
+import { createRequire } from 'module';
+
+const require = createRequire(import.meta.url);
+let BitboardChessNative = null;
+try {
+  BitboardChessNative = require('./index-native.cjs').BitboardChessNative;
+} catch (_) {
+  console.log('Native addon not built. Run: npm run build');
+  process.exit(0);
+}
+
+// Kasparov–Topalov, Wijk aan Zee 1999
+const SAN_MOVES = `e4 d6 d4 Nf6 Nc3 g6 Be3 Bg7 Qd2 c6 f3 b5 Nge2 Nbd7 Bh6 Bxh6 Qxh6 Bb7 a3 e5
+  O-O-O Qe7 Kb1 a6 Nc1 O-O-O Nb3 exd4 Rxd4 c5 Rd1 Nb6 g3 Kb8 Na5 Ba8 Bh3 d5 Qf4+ Ka7
+  Rhe1 d4 Nd5 Nbxd5 exd5 Qd6 Rxd4 cxd4 Re7+ Kb6 Qxd4+ Kxa5 b4+ Ka4 Qc3 Qxd5 Ra7 Bb7
+  Rxb7 Qc4 Qxf6 Kxa3 Qxa6+ Kxb4 c3+ Kxc3 Qa1+ Kd2 Qb2+ Kd1 Bf1 Rd2 Rd7 Rxd7 Bxc4 bxc4
+  Qxh8 Rd3 Qa8 c3 Qa4+ Ke1 f4 f5 Kc1 Rd2 Qa7`.split(/\s+/);
+
+const GAMES = Number(process.argv[2] ?? 20_000);
+
+function run(cached) {
+  const board = new BitboardChessNative();
+  if (cached) board.setFENCache();
+  let bytes = 0;
+  const start = performance.now();
+  for (let g = 0; g < GAMES; g++) {
+    board.reset();
+    for (const san of SAN_MOVES) {
+      if (!board.makeMoveSAN(san)) throw new Error(`rejected ${san}`);
+      bytes += board.toFEN().length;
+    }
+  }
+  const ms = performance.now() - start;
+  const plies = GAMES * SAN_MOVES.length;
+  const ranks = board.fenCacheRendered();
+  board.destroy();
+  return { ms, plies, bytes, ranks };
+}
+
+// Same FEN either way, ply by ply.
+const full = new BitboardChessNative();
+const cached = new BitboardChessNative();
+cached.setFENCache();
+for (const san of SAN_MOVES) {
+  full.makeMoveSAN(san);
+  cached.makeMoveSAN(san);
+  if (full.toFEN() !== cached.toFEN()) throw new Error(`FEN mismatch after ${san}`);
+}
+full.destroy();
+cached.destroy();
+
+console.log(`Per-ply toFEN: ${SAN_MOVES.length} plies × ${GAMES.toLocaleString()} games`);
+const results = {};
+for (const mode of ['full', 'cached']) {
+  const r = run(mode === 'cached');
+  results[mode] = r;
+  const perRank = mode === 'cached' ? `  |  ${(r.ranks / r.plies).toFixed(2)} ranks rendered/ply` : '';
+  console.log(`  ${mode.padEnd(7)} ${(r.ms / 1000).toFixed(2)} s  |  ${(r.plies / (r.ms / 1000) / 1e6).toFixed(2)} M (move + toFEN)/s${perRank}`);
+}
+if (results.full.bytes !== results.cached.bytes) throw new Error('output size mismatch');
+const ratio = results.full.ms / results.cached.ms;
+console.log(`Cached vs full: ${ratio.toFixed(2)}×`);
@@ -0,0 +1,52 @@
+// Perft throughput: move-generator speed of the C core across thread counts.
+// Run: npm run build && node benchmark-perft.mjs [depth] [maxThreads]
+
+import { createRequire } from 'module';
+import os from 'os';
+
+const require = createRequire(import.meta.url);
+let BitboardChessNative = null;
+try {
+  BitboardChessNative = require('./index-native.cjs').BitboardChessNative;
+} catch (_) {
+  console.log('Native addon not built. Run: npm run build');
+  process.exit(0);
+}
+
+// Standard perft positions (chessprogramming.org) with expected counts per depth.
+const POSITIONS = [
+  { name: 'start', fen: 'rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1', counts: [20, 400, 8902, 197281, 4865609, 119060324] },
+  { name: 'kiwipete', fen: 'r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1', counts: [48, 2039, 97862, 4085603, 193690690] },
+  { name: 'pos3', fen: '8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1', counts: [14, 191, 2812, 43238, 674624, 11030083] },
+  { name: 'pos4', fen: 'r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1', counts: [6, 264, 9467, 422333, 15833292] },
+  { name: 'pos5', fen: 'rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8', counts: [44, 1486, 62379, 2103487, 89941194] },
+  { name: 'pos6', fen: 'r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10', counts: [46, 2079, 89890, 3894594, 164075551] },
+];
+
+const DEPTH = Number(process.argv[2] ?? 5);
+const MAX_THREADS = Number(process.argv[3] ?? os.availableParallelism?.() ?? os.cpus().length);
+const HASH_MB = 64;
+
+const threadCounts = [];
+for (let t = 1; t <= MAX_THREADS; t *= 2) threadCounts.push(t);
+if (threadCounts[threadCounts.length - 1] !== MAX_THREADS) threadCounts.push(MAX_THREADS);
+
+const board = new BitboardChessNative();
+for (const hashMb of [0, HASH_MB]) {
+  console.log(`Perft depth ≤ ${DEPTH}, hash ${hashMb ? hashMb + ' MB' : 'off'}`);
+  for (const threads of threadCounts) {
+    let nodes = 0;
+    const start = performance.now();
+    for (const { name, fen, counts } of POSITIONS) {
+      const depth = Math.min(DEPTH, counts.length);
+      board.loadFromFEN(fen);
+      const n = board.perft(depth, threads, hashMb);
+      if (n !== counts[depth - 1]) throw new Error(`${name} depth ${depth}: got ${n}, expected ${counts[depth - 1]}`);
+      nodes += n;
+    }
+    const s = (performance.now() - start) / 1000;
+    console.log(`  ${String(threads).padStart(3)} thread(s): ${s.toFixed(2)} s  |  ${(nodes / s / 1e6).toFixed(2)} M nodes/s  (${nodes.toLocaleString()} nodes)`);
+  }
+}
+board.destroy();
+console.log('Done.');
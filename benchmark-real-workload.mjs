@@ -7,8 +7,10 @@ import BitboardChess from './index.mjs';
 
 const require = createRequire(import.meta.url);
 let BitboardChessNative = null;
+let replayPGN = null;
+let replayNDJSON = null;
 try {
-  BitboardChessNative = require('./index-native.cjs').BitboardChessNative;
+  ({ BitboardChessNative, replayPGN, replayNDJSON } = require('./index-native.cjs'));
 } catch (_) {
   // Native addon not built
 }
@@ -71,4 +73,69 @@ if (tNative != null) {
 } else {
   console.log('\n(Run npm run build to include C native engine in benchmark.)');
 }
+// Batch replay of a whole PGN buffer, non-validating vs validating (legal-move checked).
+// Kasparov–Topalov, Wijk aan Zee 1999 (legal throughout, unlike SAN_MOVES above which
+// is only resolvable, not legal).
+const PGN_GAME = `[Event "Hoogovens"]
+[Result "1-0"]
+
+1. e4 d6 2. d4 Nf6 3. Nc3 g6 4. Be3 Bg7 5. Qd2 c6 6. f3 b5 7. Nge2 Nbd7 8. Bh6 Bxh6
+9. Qxh6 Bb7 10. a3 e5 11. O-O-O Qe7 12. Kb1 a6 13. Nc1 O-O-O 14. Nb3 exd4 15. Rxd4 c5
+16. Rd1 Nb6 17. g3 Kb8 18. Na5 Ba8 19. Bh3 d5 20. Qf4+ Ka7 21. Rhe1 d4 22. Nd5 Nbxd5
+23. exd5 Qd6 24. Rxd4 cxd4 25. Re7+ Kb6 26. Qxd4+ Kxa5 27. b4+ Ka4 28. Qc3 Qxd5 29. Ra7 Bb7
+30. Rxb7 Qc4 31. Qxf6 Kxa3 32. Qxa6+ Kxb4 33. c3+ Kxc3 34. Qa1+ Kd2 35. Qb2+ Kd1 36. Bf1 Rd2
+37. Rd7 Rxd7 38. Bxc4 bxc4 39. Qxh8 Rd3 40. Qa8 c3 41. Qa4+ Ke1 42. f4 f5 43. Kc1 Rd2 44. Qa7 1-0
+
+`;
+
+if (replayPGN) {
+  const pgn = Buffer.from(PGN_GAME.repeat(ITERATIONS));
+  console.log('\nBatch replayPGN (one buffer, per-ply keys):');
+  const times = {};
+  for (const validate of [false, true]) {
+    const start = performance.now();
+    const r = replayPGN(pgn, { validate });
+    const ms = performance.now() - start;
+    if (r.status.some(s => s !== 0)) throw new Error('replayPGN rejected a game');
+    times[validate] = ms;
+    console.log(`  ${validate ? 'validating    ' : 'non-validating'}: ${(ms / 1000).toFixed(2)} s  |  ${(r.keys.length / (ms / 1000) / 1e6).toFixed(2)} M plies/s`);
+  }
+  console.log(`  validation overhead: ${(times[true] / times[false]).toFixed(2)}×`);
+  const start = performance.now();
+  const r = replayPGN(pgn, { motifs: true });
+  const ms = performance.now() - start;
+  console.log(`  with motifs   : ${(ms / 1000).toFixed(2)} s  |  ${(r.motifs.length / (ms / 1000) / 1e6).toFixed(2)} M plies/s  (${(ms / times[false]).toFixed(2)}× non-validating)`);
+}
+
+// The same games as NDJSON lines (lichess-export shape): JSON.parse + replay() per line
+// vs native replayNDJSON (structural scan, no JSON parse).
+if (replayNDJSON) {
+  const movetext = PGN_GAME.split('\n\n')[1].replace(/\d+\. /g, '').replace(/\s+1-0\s*$/, '').replace(/\n/g, ' ');
+  const line = JSON.stringify({
+    id: 'abcd1234', rated: true, variant: 'standard', speed: 'blitz', status: 'resign',
+    players: { white: { user: { name: 'Kasparov' }, rating: 2812 }, black: { user: { name: 'Topalov' }, rating: 2700 } },
+    winner: 'white', moves: movetext, clock: { initial: 300, increment: 0 },
+  });
+  const ndjson = Buffer.from((line + '\n').repeat(ITERATIONS));
+  console.log('\nNDJSON ingest (per-ply keys plus the "id" field):');
+  let start = performance.now();
+  const b = new BitboardChessNative();
+  let plies = 0;
+  const text = ndjson.toString();
+  for (let i = 0, j; i < text.length; i = j + 1) {
+    j = text.indexOf('\n', i);
+    const game = JSON.parse(text.slice(i, j));
+    b.reset();
+    plies += b.replay(game.moves).plies;
+  }
+  b.destroy();
+  const jsMs = performance.now() - start;
+  console.log(`  JSON.parse + replay(): ${(jsMs / 1000).toFixed(2)} s  |  ${(plies / (jsMs / 1000) / 1e6).toFixed(2)} M plies/s`);
+  start = performance.now();
+  const r = replayNDJSON(ndjson, { fields: ['id'] });
+  const ms = performance.now() - start;
+  if (r.status.some(s => s !== 0) || r.keys.length !== plies) throw new Error('replayNDJSON disagrees');
+  console.log(`  replayNDJSON        : ${(ms / 1000).toFixed(2)} s  |  ${(r.keys.length / (ms / 1000) / 1e6).toFixed(2)} M plies/s  (${(jsMs / ms).toFixed(2)}× faster)`);
+}
+
 console.log('Done.');
@@ -0,0 +1,49 @@
+// Search throughput: nodes/s of the native alpha-beta search across thread counts (lazy SMP).
+// Run: npm run build && node benchmark-search.mjs [depth] [maxThreads]
+
+import { createRequire } from 'module';
+import os from 'os';
+
+const require = createRequire(import.meta.url);
+let BitboardChessNative = null;
+try {
+  BitboardChessNative = require('./index-native.cjs').BitboardChessNative;
+} catch (_) {
+  console.log('Native addon not built. Run: npm run build');
+  process.exit(0);
+}
+
+const POSITIONS = [
+  { name: 'start', fen: 'rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1' },
+  { name: 'kiwipete', fen: 'r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1' },
+  { name: 'pos3', fen: '8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1' },
+  { name: 'pos4', fen: 'r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1' },
+  { name: 'pos6', fen: 'r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10' },
+];
+
+const DEPTH = Number(process.argv[2] ?? 7);
+const MAX_THREADS = Number(process.argv[3] ?? os.availableParallelism?.() ?? os.cpus().length);
+const HASH_MB = 64;
+
+const threadCounts = [];
+for (let t = 1; t <= MAX_THREADS; t *= 2) threadCounts.push(t);
+if (threadCounts[threadCounts.length - 1] !== MAX_THREADS) threadCounts.push(MAX_THREADS);
+
+const board = new BitboardChessNative();
+console.log(`Search depth ${DEPTH}, hash ${HASH_MB} MB`);
+for (const threads of threadCounts) {
+  let nodes = 0;
+  const start = performance.now();
+  const best = [];
+  for (const { name, fen } of POSITIONS) {
+    board.loadFromFEN(fen);
+    const r = board.search({ depth: DEPTH, threads, hashMb: HASH_MB });
+    nodes += r.nodes;
+    best.push(`${name} ${r.best} (${r.score})`);
+  }
+  const s = (performance.now() - start) / 1000;
+  console.log(`  ${String(threads).padStart(3)} thread(s): ${s.toFixed(2)} s  |  ${(nodes / s / 1e6).toFixed(2)} M nodes/s  (${nodes.toLocaleString()} nodes)`);
+  console.log(`      ${best.join(', ')}`);
+}
+board.destroy();
+console.log('Done.');
@@ -2,12 +2,13 @@
   "targets": [
     {
       "target_name": "bitboard_chess_native",
-      "sources": ["src/bitboard_chess.c", "src/addon.c"],
+      "sources": ["src/bitboard_chess.c", "src/alloc.c", "src/pool.c", "src/perft.c", "src/search.c", "src/mate.c", "src/motif.c", "src/minhash.c", "src/groupby.c", "src/pgn.c", "src/replay.c", "src/ndjson.c", "src/puzzle.c", "src/tablebase.c", "src/fencheck.c", "src/similarity.c", "src/store.c", "src/job.c", "src/pgnstream.c", "src/posdict.c", "src/audit.c", "src/addon.c"],
       "include_dirs": ["src"],
       "cflags!": ["-fno-exceptions"],
       "cflags_cc!": ["-fno-exceptions"],
       "conditions": [
-        ["OS=='win'", { "msvs_settings": { "VCCLCompilerTool": { "ExceptionHandling": 1 } } }]
+        ["OS=='win'", { "msvs_settings": { "VCCLCompilerTool": { "ExceptionHandling": 1 } } }],
+        ["OS!='win'", { "cflags": ["-pthread"], "ldflags": ["-pthread"] }]
       ],
       "defines": ["NAPI_VERSION=8"],
       "xcode_settings": { "GCC_ENABLE_CPP_EXCEPTIONS": "YES" }
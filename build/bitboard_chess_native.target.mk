@@ -0,0 +1,181 @@
+# This file is generated by gyp; do not edit.
+
+TOOLSET := target
+TARGET := bitboard_chess_native
+DEFS_Debug := \
+	'-DNODE_GYP_MODULE_NAME=bitboard_chess_native' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DNAPI_VERSION=8' \
+	'-DBUILDING_NODE_EXTENSION' \
+	'-DDEBUG' \
+	'-D_DEBUG'
+
+# Flags passed to all source files.
+CFLAGS_Debug := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-pthread \
+	-m64 \
+	-g \
+	-O0
+
+# Flags passed to only C files.
+CFLAGS_C_Debug :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Debug := \
+	-fno-rtti \
+	-std=gnu++17
+
+INCS_Debug := \
+	-I/root/.nvm/versions/node/v20.19.5/include/node \
+	-I/root/.nvm/versions/node/v20.19.5/src \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/config \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/openssl/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/uv/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/zlib \
+	-I/root/.nvm/versions/node/v20.19.5/deps/v8/include \
+	-I$(srcdir)/src
+
+DEFS_Release := \
+	'-DNODE_GYP_MODULE_NAME=bitboard_chess_native' \
+	'-DUSING_UV_SHARED=1' \
+	'-DUSING_V8_SHARED=1' \
+	'-DV8_DEPRECATION_WARNINGS=1' \
+	'-D_GLIBCXX_USE_CXX11_ABI=1' \
+	'-D_FILE_OFFSET_BITS=64' \
+	'-D_LARGEFILE_SOURCE' \
+	'-D__STDC_FORMAT_MACROS' \
+	'-DOPENSSL_NO_PINSHARED' \
+	'-DOPENSSL_THREADS' \
+	'-DNAPI_VERSION=8' \
+	'-DBUILDING_NODE_EXTENSION'
+
+# Flags passed to all source files.
+CFLAGS_Release := \
+	-fPIC \
+	-pthread \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-pthread \
+	-m64 \
+	-O3 \
+	-fno-omit-frame-pointer
+
+# Flags passed to only C files.
+CFLAGS_C_Release :=
+
+# Flags passed to only C++ files.
+CFLAGS_CC_Release := \
+	-fno-rtti \
+	-std=gnu++17
+
+INCS_Release := \
+	-I/root/.nvm/versions/node/v20.19.5/include/node \
+	-I/root/.nvm/versions/node/v20.19.5/src \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/config \
+	-I/root/.nvm/versions/node/v20.19.5/deps/openssl/openssl/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/uv/include \
+	-I/root/.nvm/versions/node/v20.19.5/deps/zlib \
+	-I/root/.nvm/versions/node/v20.19.5/deps/v8/include \
+	-I$(srcdir)/src
+
+OBJS := \
+	$(obj).target/$(TARGET)/src/bitboard_chess.o \
+	$(obj).target/$(TARGET)/src/alloc.o \
+	$(obj).target/$(TARGET)/src/pool.o \
+	$(obj).target/$(TARGET)/src/perft.o \
+	$(obj).target/$(TARGET)/src/search.o \
+	$(obj).target/$(TARGET)/src/mate.o \
+	$(obj).target/$(TARGET)/src/motif.o \
+	$(obj).target/$(TARGET)/src/minhash.o \
+	$(obj).target/$(TARGET)/src/groupby.o \
+	$(obj).target/$(TARGET)/src/pgn.o \
+	$(obj).target/$(TARGET)/src/replay.o \
+	$(obj).target/$(TARGET)/src/ndjson.o \
+	$(obj).target/$(TARGET)/src/puzzle.o \
+	$(obj).target/$(TARGET)/src/tablebase.o \
+	$(obj).target/$(TARGET)/src/fencheck.o \
+	$(obj).target/$(TARGET)/src/similarity.o \
+	$(obj).target/$(TARGET)/src/store.o \
+	$(obj).target/$(TARGET)/src/job.o \
+	$(obj).target/$(TARGET)/src/pgnstream.o \
+	$(obj).target/$(TARGET)/src/posdict.o \
+	$(obj).target/$(TARGET)/src/audit.o \
+	$(obj).target/$(TARGET)/src/addon.o
+
+# Add to the list of files we specially track dependencies for.
+all_deps += $(OBJS)
+
+# CFLAGS et al overrides must be target-local.
+# See "Target-specific Variable Values" in the GNU Make manual.
+$(OBJS): TOOLSET := $(TOOLSET)
+$(OBJS): GYP_CFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_C_$(BUILDTYPE))
+$(OBJS): GYP_CXXFLAGS := $(DEFS_$(BUILDTYPE)) $(INCS_$(BUILDTYPE))  $(CFLAGS_$(BUILDTYPE)) $(CFLAGS_CC_$(BUILDTYPE))
+
+# Suffix rules, putting all outputs into $(obj).
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(srcdir)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# Try building from generated source, too.
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj).$(TOOLSET)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+$(obj).$(TOOLSET)/$(TARGET)/%.o: $(obj)/%.c FORCE_DO_CMD
+	@$(call do_cmd,cc,1)
+
+# End of this set of suffix rules
+### Rules for final target.
+LDFLAGS_Debug := \
+	-pthread \
+	-rdynamic \
+	-pthread \
+	-m64
+
+LDFLAGS_Release := \
+	-pthread \
+	-rdynamic \
+	-pthread \
+	-m64
+
+LIBS :=
+
+$(obj).target/bitboard_chess_native.node: GYP_LDFLAGS := $(LDFLAGS_$(BUILDTYPE))
+$(obj).target/bitboard_chess_native.node: LIBS := $(LIBS)
+$(obj).target/bitboard_chess_native.node: TOOLSET := $(TOOLSET)
+$(obj).target/bitboard_chess_native.node: $(OBJS) FORCE_DO_CMD
+	$(call do_cmd,solink_module)
+
+all_deps += $(obj).target/bitboard_chess_native.node
+# Add target alias
+.PHONY: bitboard_chess_native
+bitboard_chess_native: $(builddir)/bitboard_chess_native.node
+
+# Copy this to the executable output path.
+$(builddir)/bitboard_chess_native.node: TOOLSET := $(TOOLSET)
+$(builddir)/bitboard_chess_native.node: $(obj).target/bitboard_chess_native.node FORCE_DO_CMD
+	$(call do_cmd,copy)
+
+all_deps += $(builddir)/bitboard_chess_native.node
+# Short alias for building this executable.
+.PHONY: bitboard_chess_native.node
+bitboard_chess_native.node: $(obj).target/bitboard_chess_native.node $(builddir)/bitboard_chess_native.node
+
+# Add executable to "all" target.
+.PHONY: all
+all: $(builddir)/bitboard_chess_native.node
+
@@ -0,0 +1,401 @@
+/**
+ * Distributed PGN ingest: a coordinator splits PGN inputs into game-aligned byte ranges and
+ * hands them to worker processes over a socket; each worker replays its range with the native
+ * replayPGN and returns its Zobrist keys as a sorted run of (key, count). The coordinator
+ * retries ranges whose worker died or timed out and merges the runs, so the result does not
+ * depend on which worker handled which range.
+ *
+ * Transport: a Unix socket (named pipe on Windows) for local workers, or TCP ({ host, port })
+ * so workers on other hosts can join with `node distributed.cjs --worker host:port`.
+ */
+'use strict';
+
+const fs = require('fs');
+const net = require('net');
+const os = require('os');
+const path = require('path');
+const { spawn } = require('child_process');
+
+const MSG = Object.freeze({ HELLO: 1, RANGE: 2, RESULT: 3, ERROR: 4, SHUTDOWN: 5 });
+const FRAME_HEADER = 9; // u32 length of the rest, u8 type, u32 JSON length
+const SCAN_CHUNK = 64 * 1024;
+
+/** Frame: [u32 len][u8 type][u32 jsonLen][JSON header][binary payload]. */
+function encodeFrame(type, header, payload = Buffer.alloc(0)) {
+  const json = Buffer.from(JSON.stringify(header));
+  const frame = Buffer.allocUnsafe(FRAME_HEADER + json.length + payload.length);
+  frame.writeUInt32LE(5 + json.length + payload.length, 0);
+  frame.writeUInt8(type, 4);
+  frame.writeUInt32LE(json.length, 5);
+  json.copy(frame, FRAME_HEADER);
+  payload.copy(frame, FRAME_HEADER + json.length);
+  return frame;
+}
+
+/** Calls onFrame(type, header, payload) for every complete frame read from socket. */
+function readFrames(socket, onFrame) {
+  let pending = Buffer.alloc(0);
+  socket.on('data', chunk => {
+    pending = pending.length ? Buffer.concat([pending, chunk]) : chunk;
+    while (pending.length >= 4 && pending.length >= 4 + pending.readUInt32LE(0)) {
+      const end = 4 + pending.readUInt32LE(0);
+      const type = pending.readUInt8(4);
+      const jsonLen = pending.readUInt32LE(5);
+      const header = JSON.parse(pending.toString('utf8', FRAME_HEADER, FRAME_HEADER + jsonLen));
+      const payload = pending.subarray(FRAME_HEADER + jsonLen, end);
+      pending = pending.subarray(end);
+      onFrame(type, header, payload);
+    }
+  });
+}
+
+function parseAddress(address) {
+  if (typeof address === 'object') return address;
+  const m = /^([^/\\]+):(\d+)$/.exec(address);
+  return m ? { host: m[1], port: Number(m[2]) } : { path: address };
+}
+
+function formatAddress(address) {
+  return address.path || `${address.host}:${address.port}`;
+}
+
+/** Readers over a Buffer/string or a file, so ranges are read without loading whole files. */
+function openSource(input) {
+  if (typeof input === 'string' && !input.includes('\n') && fs.existsSync(input)) {
+    const fd = fs.openSync(input, 'r');
+    return {
+      size: fs.fstatSync(fd).size,
+      read(start, end) {
+        const buf = Buffer.allocUnsafe(end - start);
+        let off = 0;
+        while (off < buf.length) {
+          const n = fs.readSync(fd, buf, off, buf.length - off, start + off);
+          if (n === 0) break;
+          off += n;
+        }
+        return buf.subarray(0, off);
+      },
+      close() { fs.closeSync(fd); },
+    };
+  }
+  const buf = Buffer.isBuffer(input) ? input : Buffer.from(input);
+  return { size: buf.length, read: (start, end) => buf.subarray(start, end), close() {} };
+}
+
+/** Offset of the first game start ('[' opening a line after a blank line) at or after from, or -1. */
+function findGameStart(source, from) {
+  for (let pos = from; pos < source.size; pos += SCAN_CHUNK) {
+    // Overlap by 3 bytes so a "\n\n[" split across windows is still found.
+    const start = Math.max(0, pos - 3);
+    const window = source.read(start, Math.min(source.size, pos + SCAN_CHUNK));
+    let i = window.indexOf('\n[');
+    while (i >= 0) {
+      const before = start + i;
+      const prev = source.read(Math.max(0, before - 2), before).toString('latin1');
+      if (before + 1 >= from && (prev.endsWith('\n') || prev.endsWith('\n\r'))) return before + 1;
+      i = window.indexOf('\n[', i + 1);
+    }
+  }
+  return -1;
+}
+
+/**
+ * Split a source into game-aligned [start, end) ranges of about rangeBytes each.
+ * Every boundary is the start of a tag section, so each range holds whole games.
+ */
+function splitPGN(input, rangeBytes = 1 << 20) {
+  const source = typeof input === 'object' && input.read ? input : openSource(input);
+  const ranges = [];
+  let start = 0;
+  try {
+    while (start < source.size) {
+      const next = start + rangeBytes < source.size ? findGameStart(source, start + rangeBytes) : -1;
+      const end = next < 0 ? source.size : next;
+      ranges.push({ start, end });
+      start = end;
+    }
+  } finally {
+    if (source !== input) source.close();
+  }
+  return ranges;
+}
+
+/** Sorted unique keys with occurrence counts. */
+function sortedRun(keys) {
+  const sorted = keys.slice().sort();
+  const outKeys = new BigUint64Array(sorted.length);
+  const counts = new Uint32Array(sorted.length);
+  let n = 0;
+  for (let i = 0; i < sorted.length; i++) {
+    if (n > 0 && outKeys[n - 1] === sorted[i]) {
+      counts[n - 1]++;
+    } else {
+      outKeys[n] = sorted[i];
+      counts[n++] = 1;
+    }
+  }
+  return { keys: outKeys.slice(0, n), counts: counts.slice(0, n) };
+}
+
+/** Merge two sorted runs, summing the counts of equal keys. */
+function mergeRuns(a, b) {
+  const keys = new BigUint64Array(a.keys.length + b.keys.length);
+  const counts = new Uint32Array(keys.length);
+  let i = 0, j = 0, n = 0;
+  while (i < a.keys.length || j < b.keys.length) {
+    if (j >= b.keys.length || (i < a.keys.length && a.keys[i] < b.keys[j])) {
+      keys[n] = a.keys[i]; counts[n++] = a.counts[i++];
+    } else if (i >= a.keys.length || b.keys[j] < a.keys[i]) {
+      keys[n] = b.keys[j]; counts[n++] = b.counts[j++];
+    } else {
+      keys[n] = a.keys[i]; counts[n++] = a.counts[i++] + b.counts[j++];
+    }
+  }
+  return { keys: keys.slice(0, n), counts: counts.slice(0, n) };
+}
+
+/** Pairwise merge rounds: O(n log k) for k runs. */
+function mergeAll(runs) {
+  if (runs.length === 0) return { keys: new BigUint64Array(0), counts: new Uint32Array(0) };
+  while (runs.length > 1) {
+    const next = [];
+    for (let i = 0; i < runs.length; i += 2) next.push(i + 1 < runs.length ? mergeRuns(runs[i], runs[i + 1]) : runs[i]);
+    runs = next;
+  }
+  return runs[0];
+}
+
+/**
+ * Worker loop: connect to the coordinator, replay every range it sends, answer with a sorted
+ * run. crashAfter (testing) exits without answering when that many ranges have been received;
+ * 0 exits before connecting.
+ */
+function runWorker(address, { crashAfter = Infinity } = {}) {
+  if (crashAfter <= 0) process.exit(1);
+  const { replayPGN } = require('./index-native.cjs');
+  return new Promise((resolve, reject) => {
+    const socket = net.connect(parseAddress(address));
+    let received = 0;
+    socket.on('connect', () => socket.write(encodeFrame(MSG.HELLO, { pid: process.pid })));
+    socket.on('error', reject);
+    socket.on('close', resolve);
+    readFrames(socket, (type, header, payload) => {
+      if (type === MSG.SHUTDOWN) {
+        socket.end();
+        return;
+      }
+      if (type !== MSG.RANGE) return;
+      if (++received >= crashAfter) process.exit(1);
+      try {
+        const r = replayPGN(payload, { validate: header.validate });
+        const run = sortedRun(r.keys);
+        const rejected = r.status.reduce((n, s) => n + (s !== 0 ? 1 : 0), 0);
+        const body = Buffer.concat([
+          Buffer.from(run.keys.buffer, run.keys.byteOffset, run.keys.byteLength),
+          Buffer.from(run.counts.buffer, run.counts.byteOffset, run.counts.byteLength),
+        ]);
+        socket.write(encodeFrame(MSG.RESULT, {
+          id: header.id, games: r.games, plies: r.keys.length, rejected, unique: run.keys.length,
+        }, body));
+      } catch (err) {
+        socket.write(encodeFrame(MSG.ERROR, { id: header.id, message: String(err && err.message) }));
+      }
+    });
+  });
+}
+
+function defaultAddress() {
+  const name = `bitboard-ingest-${process.pid}-${Date.now().toString(36)}`;
+  return process.platform === 'win32' ? { path: `\\\\.\\pipe\\${name}` } : { path: path.join(os.tmpdir(), `${name}.sock`) };
+}
+
+/**
+ * Ingest PGN inputs (Buffers, strings, or file paths) across worker processes.
+ * Options:
+ *   workers        local worker processes to spawn (0 = only remote workers that connect)
+ *   address        Unix socket path / pipe name, or { host, port } / "host:port" for TCP
+ *   rangeBytes     target size of a game-aligned range (default 1 MB)
+ *   validate       legality-check every move (replayPGN validate)
+ *   maxAttempts    attempts per range before the ingest fails (default 3)
+ *   rangeTimeoutMs per-attempt timeout; the worker is dropped (killed if local) and the range retried
+ *   workerArgs     (index) => extra argv for spawned worker i (e.g. ['--crash-after', '1'])
+ * Resolves { games, plies, rejected, keys: BigUint64Array (sorted, unique), counts: Uint32Array,
+ * ranges, retries }. Everything but `retries` is identical for any number or mix of workers.
+ * Rejects when a range fails maxAttempts times, or when every local worker has exited, the
+ * respawn budget is spent and no worker is connected.
+ */
+function ingestPGN(inputs, options = {}) {
+  const {
+    workers = Math.max(1, os.cpus().length),
+    rangeBytes = 1 << 20,
+    validate = false,
+    maxAttempts = 3,
+    rangeTimeoutMs = 60_000,
+    workerArgs = () => [],
+  } = options;
+  const address = options.address ? parseAddress(options.address) : defaultAddress();
+  const sources = (Array.isArray(inputs) ? inputs : [inputs]).map(openSource);
+  const ranges = [];
+  sources.forEach((source, s) => {
+    for (const r of splitPGN(source, rangeBytes)) ranges.push({ source: s, ...r, attempts: 0, result: null });
+  });
+  const queue = ranges.map((_, i) => i);
+  const children = new Set();
+  let done = 0;
+  let retries = 0;
+  let spawned = 0;
+  let lastExit = null;
+  let finished = false;
+
+  return new Promise((resolve, reject) => {
+    const server = net.createServer();
+    const sockets = new Set();
+
+    function finish(err) {
+      if (finished) return;
+      finished = true;
+      for (const socket of sockets) {
+        if (!err) socket.write(encodeFrame(MSG.SHUTDOWN, {}));
+        socket.end();
+      }
+      server.close();
+      // Connected workers exit on SHUTDOWN; this also stops replacements still starting up.
+      for (const child of children) child.kill();
+      sources.forEach(s => s.close());
+      if (err) return reject(err);
+      const run = mergeAll(ranges.map(r => r.result.run));
+      resolve({
+        games: ranges.reduce((n, r) => n + r.result.games, 0),
+        plies: ranges.reduce((n, r) => n + r.result.plies, 0),
+        rejected: ranges.reduce((n, r) => n + r.result.rejected, 0),
+        keys: run.keys,
+        counts: run.counts,
+        ranges: ranges.map(r => ({ source: r.source, start: r.start, end: r.end, games: r.result.games })),
+        retries,
+      });
+    }
+
+    function retry(index, reason) {
+      const range = ranges[index];
+      if (range.result) return;
+      if (range.attempts >= maxAttempts) {
+        finish(new Error(`range ${index} failed ${range.attempts} times: ${reason}`));
+        return;
+      }
+      retries++;
+      queue.unshift(index);
+      dispatchIdle();
+    }
+
+    const idle = [];
+    function assign(conn) {
+      if (finished) return;
+      const index = queue.shift();
+      if (index === undefined) {
+        idle.push(conn);
+        return;
+      }
+      const range = ranges[index];
+      range.attempts++;
+      conn.current = index;
+      conn.timer = setTimeout(() => {
+        conn.socket.destroy();
+        if (conn.child) conn.child.kill();
+      }, rangeTimeoutMs);
+      const data = sources[range.source].read(range.start, range.end);
+      conn.socket.write(encodeFrame(MSG.RANGE, { id: index, validate }, data));
+    }
+
+    function dispatchIdle() {
+      while (idle.length && queue.length) assign(idle.shift());
+    }
+
+    server.on('connection', socket => {
+      const conn = { socket, current: -1, timer: null, child: null };
+      sockets.add(socket);
+      socket.on('error', () => {});
+      socket.on('close', () => {
+        sockets.delete(socket);
+        clearTimeout(conn.timer);
+        const i = idle.indexOf(conn);
+        if (i >= 0) idle.splice(i, 1);
+        if (conn.current >= 0) retry(conn.current, 'worker disconnected');
+        checkWorkers();
+      });
+      readFrames(socket, (type, header, payload) => {
+        if (type === MSG.HELLO) {
+          for (const child of children) if (child.pid === header.pid) conn.child = child;
+          return assign(conn);
+        }
+        if (type !== MSG.RESULT && type !== MSG.ERROR) return;
+        clearTimeout(conn.timer);
+        conn.current = -1;
+        const range = ranges[header.id];
+        if (type === MSG.ERROR) {
+          retry(header.id, header.message);
+        } else if (!range.result) {
+          const bytes = new Uint8Array(payload); // copy onto an 8-byte-aligned ArrayBuffer
+          range.result = {
+            games: header.games,
+            plies: header.plies,
+            rejected: header.rejected,
+            run: {
+              keys: new BigUint64Array(bytes.buffer, 0, header.unique),
+              counts: new Uint32Array(bytes.buffer, header.unique * 8, header.unique),
+            },
+          };
+          if (++done === ranges.length) return finish();
+        }
+        assign(conn);
+      });
+    });
+
+    // With the respawn budget spent and nothing left to do the work, the ingest can never finish.
+    function checkWorkers() {
+      if (finished || workers === 0 || spawned < workers * (maxAttempts + 1)) return;
+      if (children.size || sockets.size) return;
+      finish(new Error(`all workers exited (last ${lastExit})`));
+    }
+
+    function spawnWorker(i) {
+      spawned++;
+      const child = spawn(process.execPath, [__filename, '--worker', formatAddress(address), ...workerArgs(i)], {
+        stdio: ['ignore', 'ignore', 'inherit'],
+      });
+      children.add(child);
+      child.on('exit', (code, signal) => {
+        children.delete(child);
+        lastExit = signal ? `signal ${signal}` : `exit code ${code}`;
+        // Replace a dead worker while work remains; bounded so a crash loop still ends.
+        if (!finished && done < ranges.length && spawned < workers * (maxAttempts + 1)) {
+          spawnWorker(i + workers);
+        }
+        checkWorkers();
+      });
+    }
+
+    server.on('error', finish);
+    if (address.path && process.platform !== 'win32' && fs.existsSync(address.path)) fs.unlinkSync(address.path);
+    server.listen(address, () => {
+      if (ranges.length === 0) return finish();
+      for (let i = 0; i < workers; i++) spawnWorker(i);
+    });
+  });
+}
+
+module.exports = { ingestPGN, runWorker, splitPGN, sortedRun, mergeRuns, mergeAll };
+
+if (require.main === module) {
+  const argv = process.argv.slice(2);
+  const at = argv.indexOf('--worker');
+  if (at < 0 || !argv[at + 1]) {
+    console.error('usage: node distributed.cjs --worker <socket path | host:port> [--crash-after N]');
+    process.exit(2);
+  }
+  const crash = argv.indexOf('--crash-after');
+  runWorker(argv[at + 1], { crashAfter: crash >= 0 ? Number(argv[crash + 1]) : Infinity })
+    .catch(err => {
+      console.error(err.message);
+      process.exit(1);
+    });
+}
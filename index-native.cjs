@@ -54,10 +54,695 @@ const SQUARES = Object.freeze(
   })()
 );
 
+/** Status codes of replay() / replayPGN() (reason the first rejected move was rejected). */
+const REPLAY_STATUS = Object.freeze({
+  OK: 0,
+  SYNTAX: 1,     // token is not SAN or UCI
+  NO_PIECE: 2,   // no piece of that kind can reach the target square
+  ILLEGAL: 3,    // blocked, bad target, leaves king in check, bad castle/promotion
+  AMBIGUOUS: 4,  // more than one legal piece matches the SAN
+});
+
+/** How the final position of a replayed game ended (replayPGN().end). */
+const GAME_END = Object.freeze({
+  UNFINISHED: 0,
+  CHECKMATE: 1,
+  STALEMATE: 2,
+  INSUFFICIENT_MATERIAL: 3,
+  THREEFOLD: 4,
+  FIFTY_MOVE: 5,
+});
+
+/** Bit flags of replayPGN().mismatch. */
+const RESULT_MISMATCH = Object.freeze({
+  RESULT: 1,       // [Result] contradicts a checkmate, stalemate or dead position
+  TERMINATION: 2,  // [Termination] names a reason the final position does not show
+});
+
+/** solveMate() / solveMates() result status. */
+const MATE_STATUS = Object.freeze({
+  NONE: 0,     // no forced mate within n moves
+  FOUND: 1,    // moves lists every mating first move
+  UNKNOWN: 2,  // node budget exhausted; moves lists the mates found so far
+  INVALID: 3,  // not one king per side, or the side not to move is in check
+});
+
+/** checkFEN() / checkFENs() codes; a FEN gets the first check it fails, in this order. */
+const FEN_STATUS = Object.freeze({
+  OK: 0,
+  SYNTAX: 1,      // unknown character, adjacent digits, missing or extra fields
+  RANKS: 2,       // not 8 ranks of 8 files
+  KINGS: 3,       // not exactly one king per side
+  PAWNS: 4,       // pawn on the first or last rank
+  CASTLING: 5,    // castling right without its king and rook on their home squares
+  EN_PASSANT: 6,  // ep square not just passed by a double push of the side not to move
+  CHECK: 7,       // the side not to move is in check
+  EMPTY: 8,       // blank line
+});
+
+/** Tablebase.probeWDL() results, for the side to move. */
+const WDL = Object.freeze({
+  WIN: 1,
+  DRAW: 0,
+  LOSS: -1,
+  UNKNOWN: -2, // more than 5 pieces, castling rights, or table not generated
+});
+
+/** Bit flags of getMotifs() and replayPGN().motifs: tactics open to the side to move. */
+const MOTIF = Object.freeze({
+  HANGING: 1,            // a capture wins material by static exchange
+  FORK: 2,               // a move to a square that loses nothing attacks two targets
+  PIN: 4,                // a slider pins an enemy piece to the king or a more valuable piece
+  SKEWER: 8,             // a slider move attacks a target with a lesser target behind it
+  DISCOVERED_ATTACK: 16, // a piece between our slider and a target can step off the line
+  DISCOVERED_CHECK: 32,  // the same with the enemy king as the target
+});
+
+/**
+ * Replay every game of a PGN buffer/string natively ([FEN] tags honoured).
+ * Returns { games, keys: BigUint64Array, offsets: Uint32Array(games + 1), status, end, mismatch }
+ * (Uint8Array(games) each); game i's per-ply keys are keys.subarray(offsets[i], offsets[i + 1]).
+ * end[i] is a GAME_END code and mismatch[i] RESULT_MISMATCH flags for games replayed in full.
+ * validate: check every move for legality and stop the game at the first bad one.
+ * tablebase: a Tablebase; adds wdl: Int8Array(games), the WDL of each final position.
+ * evals: adds evals: Int16Array parallel to keys, the tapered score (White's side) after each ply.
+ * store: a PositionStoreWriter that gets every game and the position after each ply.
+ * motifs: adds motifs: Uint8Array parallel to keys, the MOTIF flags after each ply.
+ * minhash: adds minhash: Uint32Array(games * MINHASH_SIZE), each game's MinHash signature
+ * (see MinHashIndex); game i's is minhash.subarray(i * MINHASH_SIZE, (i + 1) * MINHASH_SIZE).
+ * dict: a PositionDictionaryWriter that gets the position after each ply under its key.
+ * audit: a CollisionAudit that gets the key and position after each ply.
+ */
+function replayPGN(input, { validate = false, tablebase = null, evals = false, store = null, motifs = false, minhash = false, dict = null, audit = null } = {}) {
+  return native.replayPGN(input, validate, tablebase ? tablebase._handle : null, evals, writerHandle(store), motifs, minhash,
+    writerHandle(dict), writerHandle(audit));
+}
+
+/**
+ * Start a native async job and return its promise. signal: an AbortSignal (or anything with
+ * aborted and addEventListener('abort')); aborting stops the job at its next game or build step
+ * and it resolves with what it finished and cancelled: true. onProgress(done, total) is called on
+ * the main thread at most every progressInterval ms while the job runs (workers never wait on it)
+ * and with the final counts just before it settles.
+ */
+function runAsync(start, { signal = null, onProgress = null, progressInterval = 100 } = {}) {
+  const [promise, job] = start(onProgress, progressInterval);
+  if (!signal) {
+    native.jobStart(job);
+    return promise;
+  }
+  const abort = () => native.jobCancel(job);
+  if (signal.aborted) abort();
+  else signal.addEventListener('abort', abort, { once: true });
+  native.jobStart(job);
+  return promise.finally(() => signal.removeEventListener('abort', abort));
+}
+
+/** Throw while an async replay adds to writer (a store, dict or audit writer) off the main thread. */
+function checkNotReplaying(writer) {
+  if (writer._replaying) throw new Error(`${writer.constructor.name}: async replay in progress`);
+}
+
+/** The native handle of an optional store, dict or audit writer, once it is free to use. */
+function writerHandle(writer) {
+  if (!writer) return null;
+  checkNotReplaying(writer);
+  return writer._handle;
+}
+
+/** runAsync() for a batch replay; its store, dict and audit writers throw until the job settles. */
+function runReplayAsync(start, options) {
+  const writers = [options.store, options.dict, options.audit].filter((writer) => writer);
+  const promise = runAsync(start, options);
+  for (const writer of writers) writer._replaying = true;
+  return promise.finally(() => {
+    for (const writer of writers) writer._replaying = false;
+  });
+}
+
+/**
+ * replayPGN() on the libuv thread pool: resolves with its result plus cancelled. Takes
+ * replayPGN()'s options and runAsync()'s signal, onProgress (input bytes) and progressInterval.
+ * A Buffer input and tablebase must not be changed or used until it settles; the store, dict and
+ * audit writers throw meanwhile.
+ */
+function replayPGNAsync(input, options = {}) {
+  const { validate = false, tablebase = null, evals = false, store = null, motifs = false, minhash = false, dict = null, audit = null } = options;
+  return runReplayAsync((onProgress, interval) => native.replayPGNAsync(input, validate, tablebase ? tablebase._handle : null,
+    evals, writerHandle(store), motifs, minhash, writerHandle(dict), writerHandle(audit), onProgress, interval), options);
+}
+
+/** Bytes per packed position (record batch positions column). */
+const PACKED_POSITION_SIZE = 32;
+
+/**
+ * Transform from PGN bytes (Buffer chunks cut anywhere) to record batches: Buffers of one
+ * fixed-layout record per replayed ply (see decodeRecordBatch). Games are cut at tag sections
+ * natively and replayed on the libuv thread pool, one chunk at a time, so a slow reader holds
+ * back the writer through the usual stream backpressure. Each batch holds whole games and at
+ * most maxRecords records unless one game has more. validate: stop each game at its first
+ * illegal move; positions: add a packed position per record. destroy() cancels the chunk being
+ * replayed at its next game; aborting signal (an AbortSignal) destroys the stream with an
+ * AbortError.
+ */
+function createReplayStream({ validate = false, positions = false, maxRecords = 65536, highWaterMark = 16, signal = null } = {}) {
+  const { Transform, addAbortSignal } = require('stream');
+  const handle = native.replayStreamCreate(validate, positions);
+  let job = null;
+  const push = (stream, chunk, final, callback) => {
+    const [promise, pushJob] = native.replayStreamPush(handle, chunk, final, maxRecords);
+    job = pushJob;
+    native.jobStart(job);
+    promise.then(({ batches }) => {
+      job = null;
+      for (const batch of batches) stream.push(batch);
+      callback();
+    }, (err) => {
+      job = null;
+      callback(err);
+    });
+  };
+  const stream = new Transform({
+    readableObjectMode: true,
+    readableHighWaterMark: highWaterMark,
+    transform(chunk, encoding, callback) {
+      push(this, chunk, false, callback);
+    },
+    flush(callback) {
+      push(this, Buffer.alloc(0), true, callback);
+    },
+    destroy(err, callback) {
+      if (job) native.jobCancel(job);
+      callback(err);
+    },
+  });
+  if (signal) addAbortSignal(signal, stream);
+  return stream;
+}
+
+/**
+ * Views over a record batch from createReplayStream: { firstGame, games, records, keys:
+ * BigUint64Array, game: Uint32Array (index of the record's game within the batch; its stream
+ * id is firstGame + game[i]), ply: Uint16Array (1 = after the first move), status and end:
+ * Uint8Array per game (REPLAY_STATUS, GAME_END), positions: Uint8Array of
+ * PACKED_POSITION_SIZE bytes per record or null }. An unaligned buffer is copied first.
+ */
+function decodeRecordBatch(buf) {
+  if (buf.length < 32 || buf.toString('latin1', 0, 4) !== 'BCRB') throw new TypeError('decodeRecordBatch: not a record batch');
+  if (buf.byteOffset % 8) buf = Buffer.from(buf);
+  const { buffer, byteOffset } = buf;
+  const align8 = (n) => (n + 7) & ~7;
+  const games = buf.readUInt32LE(8);
+  const records = buf.readUInt32LE(12);
+  const packedSize = buf.readUInt32LE(24);
+  let at = byteOffset + 32;
+  const keys = new BigUint64Array(buffer, at, records);
+  at += records * 8;
+  const game = new Uint32Array(buffer, at, records);
+  at += align8(records * 4);
+  const ply = new Uint16Array(buffer, at, records);
+  at += align8(records * 2);
+  const status = new Uint8Array(buffer, at, games);
+  at += align8(games);
+  const end = new Uint8Array(buffer, at, games);
+  at += align8(games);
+  const positions = buf.readUInt16LE(6) & 1 ? new Uint8Array(buffer, at, records * packedSize) : null;
+  return { firstGame: Number(buf.readBigUInt64LE(16)), games, records, keys, game, ply, status, end, positions };
+}
+
+/**
+ * Replay a Lichess-style puzzle CSV (PuzzleId, FEN, Moves, Rating, ...; header row optional)
+ * natively: each row's FEN is loaded and its UCI line applied, rows split across threads
+ * (0 = one per CPU). Returns { rows, keys, offsets, status, ratings: Int32Array, ids, fens }
+ * where row i's keys are keys.subarray(offsets[i], offsets[i + 1]) and fens[i] is its final FEN.
+ */
+function replayPuzzles(input, { validate = false, threads = 0 } = {}) {
+  return native.replayPuzzles(input, validate, threads);
+}
+
+const GROUP_BUCKETS = { month: 2, year: 3 };
+const GROUP_AGGS = { count: 0, sum: 1, min: 2, max: 3, distinctPositions: 4, topFirstMoves: 5 };
+
+function groupKeyArg(key) {
+  if (typeof key === 'string') return [key, 0, 0];
+  const { tag, bucket = null } = key;
+  if (typeof bucket === 'number') return [tag, 1, bucket];
+  if (bucket === null) return [tag, 0, 0];
+  if (!(bucket in GROUP_BUCKETS)) throw new RangeError(`groupPGN: unknown bucket ${bucket}`);
+  return [tag, GROUP_BUCKETS[bucket], 0];
+}
+
+function groupAggArg(name, spec) {
+  if (spec === 'count' || spec === 'distinctPositions') return [GROUP_AGGS[spec], 0, '', 0];
+  const kind = spec && Object.keys(spec).find((k) => k in GROUP_AGGS);
+  if (!kind) throw new RangeError(`groupPGN: unknown aggregator for ${name}`);
+  if (kind === 'topFirstMoves') return [GROUP_AGGS.topFirstMoves, 0, '', spec.topFirstMoves];
+  const value = spec[kind];
+  return value === 'plies' ? [GROUP_AGGS[kind], 0, '', 0] : [GROUP_AGGS[kind], 1, value, 0];
+}
+
+function groupRows(names, res) {
+  const rows = [];
+  for (let i = 0; i < res.groups; i++) {
+    const row = { key: res.keys[i] };
+    names.forEach((name, a) => {
+      const col = res.values[a];
+      if (Array.isArray(col)) row[name] = col[i].map(([move, count]) => ({ move, count }));
+      else row[name] = Number.isNaN(col[i]) ? null : col[i];
+    });
+    rows.push(row);
+  }
+  return rows;
+}
+
+/**
+ * Replay every game of a PGN buffer/string natively and aggregate it by tags, the games
+ * split across threads (0 = one per CPU) with one hash table of groups each, merged at the end.
+ * by: tag names, or { tag, bucket } where bucket is a width (Elo 2437 by 100 -> '2400'),
+ * 'month' ('2024.03') or 'year'; a missing or unreadable value is '?'.
+ * aggregate: { name: spec } with spec 'count' (games), 'distinctPositions' (HyperLogLog
+ * estimate of the positions reached, about 1.6% error), { sum | min | max: 'plies' or an
+ * integer tag } (games without the tag are left out; min/max null when none had it) or
+ * { topFirstMoves: k } ([{ move, count }], UCI, most played first).
+ * Returns one row per group, sorted by key: { key: [value per by entry], ...aggregates }.
+ */
+function groupPGN(input, { by = [], aggregate = { games: 'count' }, validate = false, threads = 0 } = {}) {
+  const names = Object.keys(aggregate);
+  return groupRows(names, native.groupPGN(input, by.map(groupKeyArg), names.map((n) => groupAggArg(n, aggregate[n])), validate, threads));
+}
+
+/**
+ * groupPGN() on the libuv thread pool: resolves with { rows, cancelled }, the rows covering the
+ * games finished when it was cancelled. Takes groupPGN()'s options and runAsync()'s signal,
+ * onProgress (input bytes) and progressInterval.
+ */
+function groupPGNAsync(input, options = {}) {
+  const { by = [], aggregate = { games: 'count' }, validate = false, threads = 0 } = options;
+  const names = Object.keys(aggregate);
+  const keys = by.map(groupKeyArg);
+  const aggs = names.map((n) => groupAggArg(n, aggregate[n]));
+  return runAsync((onProgress, interval) => native.groupPGNAsync(input, keys, aggs, validate, threads, onProgress, interval), options)
+    .then((res) => ({ rows: groupRows(names, res), cancelled: res.cancelled }));
+}
+
+/** FEN_STATUS code of one FEN string. */
+function checkFEN(fen) {
+  return native.checkFEN(fen);
+}
+
+/**
+ * Check every line of a buffer/string of FENs natively, the lines split across threads
+ * (0 = one per CPU). Returns a Uint8Array with one FEN_STATUS code per line.
+ */
+function checkFENs(input, { threads = 0 } = {}) {
+  return native.checkFENs(input, threads);
+}
+
+function ndjsonArgs({ fields = [], movesField = 'moves', fenField = null, validate = false, evals = false, store = null, motifs = false, minhash = false, dict = null, audit = null } = {}) {
+  return [fields, movesField, fenField, validate, evals, writerHandle(store), motifs, minhash, writerHandle(dict),
+    writerHandle(audit)];
+}
+
+/**
+ * Replay an NDJSON buffer/string natively: one JSON object per line with a movetext field
+ * (space-separated SAN or UCI). Lines are not JSON-parsed; a SIMD structural scan picks out
+ * the fields. Options: fields (extra top-level fields to return), movesField ('moves'),
+ * fenField (start FEN field, e.g. 'initialFen'), validate, evals, store (a PositionStoreWriter), motifs, minhash,
+ * dict (a PositionDictionaryWriter), audit (a CollisionAudit).
+ * Returns replayPGN()'s { games, keys, offsets, status, end, normalized } (no mismatch) plus
+ * fields: { name: [value per game] }. A malformed line is a game with status SYNTAX.
+ */
+function replayNDJSON(input, options) {
+  return native.replayNDJSON(input, ...ndjsonArgs(options));
+}
+
+/** replayNDJSON() over a file, read natively in chunks. */
+function replayNDJSONFile(path, options) {
+  return native.replayNDJSONFile(path, ...ndjsonArgs(options));
+}
+
+/**
+ * replayNDJSONFile() on the libuv thread pool: resolves with its result plus cancelled. Takes
+ * runAsync()'s signal, onProgress (file bytes) and progressInterval besides its options.
+ */
+function replayNDJSONFileAsync(path, options = {}) {
+  return runReplayAsync((onProgress, interval) => native.replayNDJSONFileAsync(path, ...ndjsonArgs(options), onProgress, interval),
+    options);
+}
+
+/**
+ * Incremental NDJSON replay for a stream of Buffers (chunks may split lines anywhere).
+ * push(chunk) and end(chunk?) return replayNDJSON()-shaped results for the lines completed so far.
+ */
+class NDJSONReader {
+  constructor(options) {
+    this._handle = native.ndjsonCreate(...ndjsonArgs(options));
+    this._store = options && options.store; // the reader writes into them
+    this._dict = options && options.dict;
+    this._audit = options && options.audit;
+  }
+
+  push(chunk) {
+    this._checkWriters();
+    return native.ndjsonPush(this._handle, chunk, false);
+  }
+
+  end(chunk = '') {
+    this._checkWriters();
+    return native.ndjsonPush(this._handle, chunk, true);
+  }
+
+  _checkWriters() {
+    for (const writer of [this._store, this._dict, this._audit]) {
+      if (writer) checkNotReplaying(writer);
+    }
+  }
+}
+
+/**
+ * solveMate() over a list of FENs, spread over threads (0 = one per CPU) with one
+ * table each; nodes is the budget per position. Returns one result per FEN.
+ */
+function solveMates(fens, { n = 3, nodes = 0, threads = 0, hashMb = 4 } = {}) {
+  return native.solveMates(fens, n, nodes, threads, hashMb);
+}
+
+/**
+ * The evaluation tables: { mgValue, egValue, phaseWeight } (6 numbers each, indexed
+ * P N B R Q K) and { mgPst, egPst } (6 arrays of 64 bonuses from White's side, a1 = 0,
+ * mirrored for Black). The phase of a position is the sum of phaseWeight over its pieces,
+ * capped at the start position's; scores are (mg * phase + eg * (max - phase)) / max.
+ */
+function getEvalTables() {
+  return native.getEvalTables();
+}
+
+/**
+ * Replace the evaluation tables process-wide, e.g. with tables loaded from a JSON file.
+ * Fields left out keep their current values; null restores the defaults. Boards keep the
+ * scores they have until their position is next loaded or reset.
+ */
+function setEvalTables(tables) {
+  native.setEvalTables(tables ? { ...native.getEvalTables(), ...tables } : null);
+}
+
+/**
+ * Retrograde win/draw/loss tables for endings of up to 5 pieces (2 bits per position).
+ * dir: directory the tables are written to and memory-mapped from; omit to keep them in memory.
+ */
+class Tablebase {
+  constructor(dir = null) {
+    this._handle = native.tbCreate(dir);
+  }
+
+  /** Generate (or load) the table for a signature like 'KRvK' and the tables it leads to. */
+  generate(signature, { threads = 0 } = {}) {
+    if (!native.tbGenerate(this._handle, signature, threads)) {
+      throw new Error(`Tablebase: cannot generate ${signature}`);
+    }
+  }
+
+  /** WDL code of a BitboardChessNative position for the side to move. */
+  probeWDL(board) {
+    return native.tbProbe(this._handle, board._handle);
+  }
+}
+
+/**
+ * Collects the positions of batch replays (the store option of replayPGN, replayNDJSON,
+ * replayNDJSONFile and NDJSONReader) for a PositionStore file. Game ids count the games
+ * replayed into the writer from 0; ply 1 is the position after the first move.
+ */
+class PositionStoreWriter {
+  constructor() {
+    this._handle = native.storeWriterCreate();
+    this._replaying = false;
+  }
+
+  /** { positions, games } added so far. */
+  get counts() {
+    checkNotReplaying(this);
+    return native.storeWriterCounts(this._handle);
+  }
+
+  /** Write the store to path and empty the writer. */
+  finish(path) {
+    checkNotReplaying(this);
+    if (!native.storeWriterFinish(this._handle, String(path))) {
+      throw new Error(`PositionStoreWriter: cannot write ${path}`);
+    }
+  }
+}
+
+/**
+ * A memory-mapped columnar store of positions (12 bitboards, game id, ply, side to move and
+ * castling rights each). query(text) returns the matching { positions, games, plies }; see
+ * the README for the query language, e.g. 'N@e5 p@d6,e6 k@g8 r@f8 #Qq=0 turn=w'.
+ */
+class PositionStore {
+  constructor(path) {
+    this._handle = native.storeOpen(String(path));
+    if (!this._handle) throw new Error(`PositionStore: ${path} is missing or not a position store`);
+  }
+
+  /** { positions, games } in the store. */
+  get counts() {
+    return native.storeCounts(this._handle);
+  }
+
+  /** Position i: { game, ply, turn, castling, sets: BigUint64Array(12) } (P N B R Q K p n b r q k). */
+  get(i) {
+    return native.storeGet(this._handle, i);
+  }
+
+  /** Positions matching every term, ascending, scanned on threads (0 = one per CPU). */
+  query(text, { threads = 0 } = {}) {
+    return native.storeQuery(this._handle, String(text), threads);
+  }
+}
+
+/**
+ * Collects one packed position per distinct Zobrist key from batch replays (the dict option of
+ * replayPGN, replayNDJSON, replayNDJSONFile and NDJSONReader) for a PositionDictionary file.
+ * Entries are only appended: a key seen again with a different position keeps the first and
+ * counts as a collision. With path, starts from the dictionary already there (if any), so
+ * finish(path) extends it.
+ */
+class PositionDictionaryWriter {
+  constructor(path = null) {
+    this._handle = native.dictWriterCreate();
+    this._replaying = false;
+    const existing = path == null ? null : native.dictOpen(String(path));
+    if (existing && !native.dictWriterLoad(this._handle, existing)) {
+      throw new Error(`PositionDictionaryWriter: out of memory loading ${path}`);
+    }
+  }
+
+  /** { positions, collisions } added so far. */
+  get counts() {
+    checkNotReplaying(this);
+    return native.dictWriterCounts(this._handle);
+  }
+
+  /** Write the dictionary to path; the writer keeps its entries for further additions. */
+  finish(path) {
+    checkNotReplaying(this);
+    if (!native.dictWriterFinish(this._handle, String(path))) {
+      throw new Error(`PositionDictionaryWriter: cannot write ${path}`);
+    }
+  }
+}
+
+/**
+ * A memory-mapped position dictionary: the packed position (PACKED_POSITION_SIZE bytes, the
+ * record batch format) of every key added, found through a hash index in the same file.
+ */
+class PositionDictionary {
+  constructor(path) {
+    this._handle = native.dictOpen(String(path));
+    if (!this._handle) throw new Error(`PositionDictionary: ${path} is missing or not a position dictionary`);
+  }
+
+  /** { positions, collisions } in the dictionary. */
+  get counts() {
+    return native.dictCounts(this._handle);
+  }
+
+  /**
+   * The positions of a BigUint64Array of keys: a Uint8Array of PACKED_POSITION_SIZE bytes per
+   * key (all zero for a key not in the dictionary), or with fen an array of FEN strings (null
+   * when missing; halfmove clock 0, move number 1).
+   */
+  lookup(keys, { fen = false } = {}) {
+    return native.dictLookup(this._handle, keys, fen);
+  }
+
+  /** Keys that were added with more than one distinct position (a BigUint64Array). */
+  collisions() {
+    return native.dictCollisions(this._handle);
+  }
+}
+
+/**
+ * Measures real Zobrist collisions: batch replays given audit: this (replayPGN, replayNDJSON,
+ * replayNDJSONFile, NDJSONReader) add each position's key and a 128-bit fingerprint of the
+ * packed position. Memory stays within memoryMb; past it, sorted runs go to files in dir.
+ */
+class CollisionAudit {
+  constructor({ dir = null, memoryMb = 256 } = {}) {
+    const fs = require('fs');
+    const os = require('os');
+    const runDir = dir == null ? os.tmpdir() : String(dir);
+    if (!fs.statSync(runDir).isDirectory()) throw new Error(`CollisionAudit: ${runDir} is not a directory`);
+    this._handle = native.auditCreate(runDir, memoryMb * 1024 * 1024);
+    this._replaying = false;
+  }
+
+  /** { positions, runs } added so far (runs: files written). */
+  get counts() {
+    checkNotReplaying(this);
+    return native.auditCounts(this._handle);
+  }
+
+  /**
+   * Merge everything added and start over empty. Returns { positions, keys, fingerprints,
+   * collisions: BigUint64Array, counts: Uint32Array }: positions added, distinct keys, distinct
+   * (key, fingerprint) pairs, and the keys seen with more than one position with how many each.
+   */
+  finish() {
+    checkNotReplaying(this);
+    return native.auditFinish(this._handle);
+  }
+}
+
+/** Throw while a build() of index is running; its tables are in use off the main thread. */
+function checkNotBuilding(index) {
+  if (index._building) throw new Error(`${index.constructor.name}: build() in progress`);
+}
+
+function buildIndex(index, start, options) {
+  checkNotBuilding(index);
+  const promise = runAsync((onProgress, interval) => start(index._handle, onProgress, interval), options);
+  index._building = true;
+  return promise.finally(() => { index._building = false; });
+}
+
+/**
+ * Nearest positions by piece placement: the distance between two positions is the number
+ * of squares-by-piece bits that differ over their twelve piece bitboards (a quiet move is 2).
+ * Ranks shared exactly with the query give the candidates; when they cannot prove the top k,
+ * the query compares every position (threads: 0 = one per CPU) unless approximate is set.
+ * Ids are insertion order.
+ */
+class SimilarityIndex {
+  constructor() {
+    this._handle = native.simCreate();
+    this._building = false;
+  }
+
+  get size() {
+    return native.simSize(this._handle);
+  }
+
+  /** Add a BitboardChessNative, a FEN or a BigUint64Array of its 12 bitboards; returns its id. */
+  add(position) {
+    checkNotBuilding(this);
+    return native.simAdd(this._handle, positionArg(position));
+  }
+
+  /** Add one FEN per non-blank line of a string/Buffer; returns how many were added. */
+  addFENs(input) {
+    checkNotBuilding(this);
+    return native.simAddFENs(this._handle, input);
+  }
+
+  /** Add a BigUint64Array of 12 bitboards per position (P N B R Q K p n b r q k); returns how many. */
+  addPositions(sets) {
+    checkNotBuilding(this);
+    return native.simAddPositions(this._handle, sets);
+  }
+
+  /**
+   * The k nearest positions to a position (as for add()), closest first (ties by id):
+   * { ids: Uint32Array, distances: Uint16Array, candidates, skipped, scanned, exact }.
+   * maxBucket (0 = 4096) skips ranks shared by more positions than that.
+   */
+  query(position, { k = 10, approximate = false, threads = 0, maxBucket = 0 } = {}) {
+    checkNotBuilding(this);
+    return native.simQuery(this._handle, positionArg(position), k, approximate, threads, maxBucket);
+  }
+
+  /**
+   * Build the rank tables on the libuv thread pool instead of in the next query: resolves with
+   * { cancelled }, or rejects with an AbortError when cancelled before it finished (the next
+   * query redoes the build). Takes runAsync()'s signal, onProgress (positions times ranks) and
+   * progressInterval. The index is unusable until it settles.
+   */
+  build(options = {}) {
+    return buildIndex(this, native.simBuildAsync, options);
+  }
+}
+
+/** Slots per MinHash signature. */
+const MINHASH_SIZE = 64;
+
+/** MinHash signature (Uint32Array(MINHASH_SIZE)) of a set of Zobrist keys, e.g. a game's replay keys. */
+function minhashSign(keys) {
+  return native.minhashSign(keys);
+}
+
+/** Jaccard estimate of two signatures: the fraction of slots where they agree. */
+function minhashJaccard(a, b) {
+  return native.minhashJaccard(a, b);
+}
+
+/**
+ * Banded LSH index of game signatures for finding games that share most of their positions.
+ * Signatures are cut into bands of MINHASH_SIZE / bands slots; games agreeing on a whole band
+ * are candidates, then ranked by their Jaccard estimate. With the default 16 bands of 4,
+ * pairs above about 0.5 similarity are found with high probability.
+ */
+class MinHashIndex {
+  constructor({ bands = 16 } = {}) {
+    this._handle = native.lshCreate(bands);
+    this._building = false;
+  }
+
+  get size() {
+    return native.lshSize(this._handle);
+  }
+
+  /** Add a Uint32Array of MINHASH_SIZE slots per game (replayPGN's minhash); returns how many. */
+  add(signatures) {
+    checkNotBuilding(this);
+    return native.lshAdd(this._handle, signatures);
+  }
+
+  /**
+   * Games most similar to a signature or to an indexed game id, highest estimate first (ties by
+   * id; a game id finds itself): { ids: Uint32Array, jaccard: Float32Array, candidates, skipped }.
+   * minJaccard drops weaker candidates; maxBucket (0 = 4096) skips bands shared by more games.
+   */
+  query(game, { k = 10, minJaccard = 0, maxBucket = 0 } = {}) {
+    checkNotBuilding(this);
+    return native.lshQuery(this._handle, game, k, minJaccard, maxBucket);
+  }
+
+  /** As SimilarityIndex.build(), for the band tables; progress counts games times bands. */
+  build(options = {}) {
+    return buildIndex(this, native.lshBuildAsync, options);
+  }
+}
+
+function positionArg(position) {
+  return position instanceof BitboardChessNative ? position._handle : position;
+}
+
 class BitboardChessNative {
   constructor() {
     this._handle = native.create();
     if (!this._handle) throw new Error('native.create failed');
+    this._fenCache = null;
   }
 
   makeMoveSAN(san) {
@@ -84,7 +769,20 @@ class BitboardChessNative {
   }
 
   toFEN() {
-    return native.toFEN(this._handle);
+    return native.toFEN(this._handle, this._fenCache);
+  }
+
+  /**
+   * Cache rendered ranks for per-ply toFEN(): each call then re-renders only the ranks
+   * whose pieces changed since the previous one. false drops the cache.
+   */
+  setFENCache(enabled = true) {
+    this._fenCache = enabled ? native.fenCacheCreate() : null;
+  }
+
+  /** Ranks rendered through the FEN cache so far (0 without one). */
+  fenCacheRendered() {
+    return this._fenCache ? native.fenCacheRendered(this._fenCache) : 0;
   }
 
   loadFromFEN(fen) {
@@ -96,17 +794,125 @@ class BitboardChessNative {
     native.reset(this._handle);
   }
 
+  /**
+   * Apply a movetext (SAN and/or UCI tokens; move numbers, comments and results skipped).
+   * Returns { keys: BigUint64Array (key after each applied ply), plies, status } where
+   * status is a REPLAY_STATUS code; replay stops at the first rejected move.
+   * validate: check every move for legality (otherwise only resolvability).
+   */
+  replay(moves, { validate = false } = {}) {
+    return native.replay(this._handle, moves, validate);
+  }
+
+  /**
+   * Apply a chess.com TCN move string (two characters per ply) from the current position.
+   * Castling and en passant are inferred from the board. Returns { keys, plies, status } as replay().
+   */
+  replayTCN(tcn, { validate = false } = {}) {
+    return native.replayTCN(this._handle, tcn, validate);
+  }
+
+  /**
+   * Count leaf nodes of the legal move tree from the current position.
+   * threads: worker threads (0 = one per CPU); hashMb: shared perft hash size (0 = off).
+   */
+  perft(depth, threads = 1, hashMb = 16) {
+    return native.perft(this._handle, depth, threads, hashMb);
+  }
+
+  /** Like perft(), but returns { uciMove: nodes } for each legal root move. */
+  perftDivide(depth, threads = 1, hashMb = 16) {
+    return native.perftDivide(this._handle, depth, threads, hashMb);
+  }
+
+  /**
+   * Alpha-beta search of the current position, stopping at the first limit reached
+   * (depth in plies, nodes, ms; depth 6 when none is given). threads > 1 runs lazy SMP
+   * over a shared hashMb transposition table. Returns { best (UCI or null), score
+   * (centipawns for the side to move), mate (moves, negative when mated, or null),
+   * depth, nodes, ms, pv }.
+   */
+  search({ depth = 0, nodes = 0, ms = 0, threads = 1, hashMb = 16 } = {}) {
+    return native.search(this._handle, depth, nodes, ms, threads, hashMb);
+  }
+
+  /**
+   * Forced mates of the side to move within n moves (AND/OR search, checks first).
+   * Returns { status (MATE_STATUS), mateIn (shortest, 0 if none), moves: [{ move, mateIn }]
+   * (every mating first move, shortest first), count, nodes }; nodes: budget (0 = none).
+   */
+  solveMate(n = 3, { nodes = 0, hashMb = 4 } = {}) {
+    return native.solveMate(this._handle, n, nodes, hashMb);
+  }
+
+  /** Tapered material + piece-square score for the side to move, in centipawns. */
+  evaluate() {
+    return native.evaluate(this._handle);
+  }
+
+  /**
+   * The evaluation kept incrementally by every move: { mg, eg, phase, score }, all from
+   * White's side (score blends mg and eg by phase; see getEvalTables()).
+   */
+  getEval() {
+    return native.getEval(this._handle);
+  }
+
+  /**
+   * MOTIF flags for the side to move, from attack maps and static exchange
+   * (pseudo-legal: a piece pinned to its own king still counts).
+   */
+  getMotifs() {
+    return native.getMotifs(this._handle);
+  }
+
   destroy() {
     if (this._handle) {
       native.destroy(this._handle);
       this._handle = null;
     }
+    this._fenCache = null;
   }
 }
 
 module.exports = {
   BitboardChessNative,
   native,
+  REPLAY_STATUS,
+  MOTIF,
+  GAME_END,
+  RESULT_MISMATCH,
+  WDL,
+  MATE_STATUS,
+  FEN_STATUS,
+  replayPGN,
+  replayPGNAsync,
+  createReplayStream,
+  decodeRecordBatch,
+  PACKED_POSITION_SIZE,
+  replayNDJSON,
+  replayNDJSONFile,
+  replayNDJSONFileAsync,
+  replayPuzzles,
+  groupPGN,
+  groupPGNAsync,
+  checkFEN,
+  checkFENs,
+  solveMates,
+  getEvalTables,
+  setEvalTables,
+  NDJSONReader,
+  Tablebase,
+  SimilarityIndex,
+  MinHashIndex,
+  MINHASH_SIZE,
+  minhashSign,
+  minhashJaccard,
+  PositionStore,
+  PositionStoreWriter,
+  PositionDictionary,
+  PositionDictionaryWriter,
+  CollisionAudit,
   SQUARES,
   squareNameToIndex,
   squareToBitboard,
@@ -539,6 +539,8 @@ class BitboardChess {
 
       // Remove castling rights
       this.castling = this.castling.replace(side === WHITE ? /K|Q/g : /k|q/g, "");
+      this.enPassant = -1;
+      this.halfmove++;
       this._finishMove();
       return;
     }
@@ -546,6 +548,9 @@ class BitboardChess {
     // -------------------------
     // 2. Handle en-passant capture
     // -------------------------
+    const captured = !!move.enpassant ||
+      !!((this.pawns[enemy] | this.knights[enemy] | this.bishops[enemy] |
+          this.rooks[enemy] | this.queens[enemy] | this.kings[enemy]) & toBB);
     if (move.enpassant) {
       const capSq = side === WHITE ? move.to - 8 : move.to + 8;
       const capBB = bit(capSq);
@@ -573,6 +578,7 @@ class BitboardChess {
 
     let movedPawn = false;
     const movedRook = !!(this.rooks[side] & fromBB);
+    const movedKing = !!(this.kings[side] & fromBB);
 
     if (movePiece(this.pawns)) movedPawn = true;
     else if (movePiece(this.knights));
@@ -597,6 +603,9 @@ class BitboardChess {
       target[side] |= toBB;
     }
 
+    // Halfmove clock: reset by pawn moves and captures
+    this.halfmove = (movedPawn || captured) ? 0 : this.halfmove + 1;
+
     // -------------------------
     // 6. Update en-passant square
     // -------------------------
@@ -607,9 +616,9 @@ class BitboardChess {
     }
 
     // -------------------------
-    // 7. Remove castling rights if king or rook moved
+    // 7. Remove castling rights if king or rook moved, or a rook was captured at home
     // -------------------------
-    if (fromBB & this.kings[side]) {
+    if (movedKing) {
       this.castling = this.castling.replace(side === WHITE ? /K|Q/g : /k|q/g, "");
     }
     if (movedRook) {
@@ -618,6 +627,10 @@ class BitboardChess {
       if (move.from === 56) this.castling = this.castling.replace("q", "");
       if (move.from === 63) this.castling = this.castling.replace("k", "");
     }
+    if (move.to === 0) this.castling = this.castling.replace("Q", "");
+    if (move.to === 7) this.castling = this.castling.replace("K", "");
+    if (move.to === 56) this.castling = this.castling.replace("q", "");
+    if (move.to === 63) this.castling = this.castling.replace("k", "");
 
     // -------------------------
     // 8. Finish move
@@ -0,0 +1,396 @@
+/* CPython bindings for the C core: Board, batch PGN replay and per-ply
+ * features. Batch outputs are Array objects that own the native buffers and
+ * export them through the buffer protocol, so numpy.asarray() or memoryview()
+ * wraps them without a copy. Replay runs with the GIL released. */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "alloc.h"
+#include "bitboard_chess.h"
+#include "minhash.h"
+#include "motif.h"
+#include "replay.h"
+#include "search.h"
+
+static const char* const STATUS_NAMES[] = {"OK", "SYNTAX", "NO_PIECE", "ILLEGAL", "AMBIGUOUS"};
+
+/* ---- Array ---- */
+
+typedef struct {
+  PyObject_HEAD
+  void* data; /* bc_malloc'd and owned, or NULL when empty */
+  const char* format;
+  Py_ssize_t itemsize;
+  int ndim;
+  Py_ssize_t shape[2];
+  Py_ssize_t strides[2];
+} ArrayObject;
+
+static PyTypeObject ArrayType;
+
+static void Array_dealloc(ArrayObject* self) {
+  bc_free(self->data);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/* Rows are stored C-contiguous and writable, like PyBuffer_FillInfo's
+ * buffers but typed: shape and strides only go to consumers that ask for
+ * them, and only a Fortran-order request for a real 2-D array is refused. */
+static int Array_getbuffer(ArrayObject* self, Py_buffer* view, int flags) {
+  static char empty[8];
+  if ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS && self->ndim == 2 && self->shape[0] > 1 &&
+      self->shape[1] > 1) {
+    PyErr_SetString(PyExc_BufferError, "bitboard_chess.Array is C-contiguous, not Fortran-contiguous");
+    view->obj = NULL;
+    return -1;
+  }
+  view->buf = self->data ? self->data : empty;
+  view->obj = (PyObject*)self;
+  Py_INCREF(self);
+  view->len = self->shape[0] * (self->ndim == 2 ? self->shape[1] : 1) * self->itemsize;
+  view->readonly = 0;
+  view->itemsize = self->itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : NULL;
+  if (flags & PyBUF_ND) {
+    view->ndim = self->ndim;
+    view->shape = self->shape;
+  } else {
+    /* Without a shape the consumer sees len bytes. */
+    view->ndim = 1;
+    view->shape = NULL;
+  }
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+  return 0;
+}
+
+static Py_ssize_t Array_length(ArrayObject* self) {
+  return self->shape[0];
+}
+
+static PyObject* Array_repr(ArrayObject* self) {
+  if (self->ndim == 2)
+    return PyUnicode_FromFormat("Array('%s', shape=(%zd, %zd))", self->format, self->shape[0], self->shape[1]);
+  return PyUnicode_FromFormat("Array('%s', shape=(%zd,))", self->format, self->shape[0]);
+}
+
+static PyBufferProcs Array_as_buffer = {(getbufferproc)Array_getbuffer, NULL};
+
+static PySequenceMethods Array_as_sequence = {(lenfunc)Array_length};
+
+static PyTypeObject ArrayType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "bitboard_chess.Array",
+    .tp_basicsize = sizeof(ArrayObject),
+    .tp_dealloc = (destructor)Array_dealloc,
+    .tp_repr = (reprfunc)Array_repr,
+    .tp_as_sequence = &Array_as_sequence,
+    .tp_as_buffer = &Array_as_buffer,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Native array (buffer protocol): wrap it with numpy.asarray() or memoryview().",
+};
+
+/* Wrap data (taken over; NULL allowed when rows is 0) as rows x cols items. */
+static PyObject* array_take(void* data, const char* format, Py_ssize_t itemsize, Py_ssize_t rows, Py_ssize_t cols) {
+  ArrayObject* a = PyObject_New(ArrayObject, &ArrayType);
+  if (!a) {
+    bc_free(data);
+    return NULL;
+  }
+  a->data = data;
+  a->format = format;
+  a->itemsize = itemsize;
+  a->ndim = cols > 0 ? 2 : 1;
+  a->shape[0] = rows;
+  a->shape[1] = cols;
+  a->strides[0] = itemsize * (cols > 0 ? cols : 1);
+  a->strides[1] = itemsize;
+  return (PyObject*)a;
+}
+
+/* A new zeroed 1-D array, its storage in *data. */
+static PyObject* array_new(const char* format, Py_ssize_t itemsize, Py_ssize_t n, void** data) {
+  *data = n ? bc_calloc((size_t)n, (size_t)itemsize) : NULL;
+  if (n && !*data) return PyErr_NoMemory();
+  return array_take(*data, format, itemsize, n, 0);
+}
+
+/* ---- Board ---- */
+
+typedef struct {
+  PyObject_HEAD
+  Board board;
+} BoardObject;
+
+static PyTypeObject BoardType;
+
+static int Board_init(BoardObject* self, PyObject* args, PyObject* kw) {
+  static char* kwlist[] = {"fen", NULL};
+  const char* fen = NULL;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "|z", kwlist, &fen)) return -1;
+  board_init(&self->board);
+  if (fen) board_load_fen(&self->board, fen);
+  return 0;
+}
+
+static PyObject* Board_reset(BoardObject* self, PyObject* unused) {
+  (void)unused;
+  board_reset(&self->board);
+  Py_RETURN_NONE;
+}
+
+static PyObject* Board_load_fen(BoardObject* self, PyObject* arg) {
+  const char* fen = PyUnicode_AsUTF8(arg);
+  if (!fen) return NULL;
+  board_load_fen(&self->board, fen);
+  Py_RETURN_NONE;
+}
+
+static PyObject* Board_fen(BoardObject* self, PyObject* unused) {
+  char buf[BOARD_FEN_MAX];
+  (void)unused;
+  int n = board_to_fen(&self->board, buf, sizeof(buf));
+  return PyUnicode_FromStringAndSize(buf, n);
+}
+
+static PyObject* Board_push(BoardObject* self, PyObject* args, PyObject* kw) {
+  static char* kwlist[] = {"move", "validate", NULL};
+  const char* tok;
+  Py_ssize_t len;
+  int validate = 0;
+  Move move;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "s#|p", kwlist, &tok, &len, &validate)) return NULL;
+  int status = replay_resolve_token(&self->board, tok, (int)len, validate ? REPLAY_VALIDATE : 0, &move, NULL);
+  if (status != MOVE_OK) {
+    PyErr_Format(PyExc_ValueError, "%s: %s", tok, STATUS_NAMES[status]);
+    return NULL;
+  }
+  board_make_move(&self->board, &move);
+  Py_RETURN_NONE;
+}
+
+static PyObject* Board_legal_moves(BoardObject* self, PyObject* unused) {
+  Move moves[BOARD_MAX_MOVES];
+  char uci[8];
+  (void)unused;
+  int n = board_generate_moves(&self->board, moves);
+  PyObject* list = PyList_New(n);
+  if (!list) return NULL;
+  for (int i = 0; i < n; i++) {
+    PyObject* s = PyUnicode_FromStringAndSize(uci, board_move_to_uci(&moves[i], uci));
+    if (!s) {
+      Py_DECREF(list);
+      return NULL;
+    }
+    PyList_SET_ITEM(list, i, s);
+  }
+  return list;
+}
+
+static PyObject* Board_evaluate(BoardObject* self, PyObject* unused) {
+  (void)unused;
+  return PyLong_FromLong(board_evaluate(&self->board));
+}
+
+static PyObject* Board_motifs(BoardObject* self, PyObject* unused) {
+  (void)unused;
+  return PyLong_FromUnsignedLong(motif_tag(&self->board));
+}
+
+static PyObject* Board_features(BoardObject* self, PyObject* unused) {
+  u64* sets;
+  (void)unused;
+  PyObject* a = array_new("Q", sizeof(u64), 12, (void**)&sets);
+  if (a) board_piece_sets(&self->board, sets);
+  return a;
+}
+
+static PyObject* Board_copy(BoardObject* self, PyObject* unused) {
+  (void)unused;
+  BoardObject* c = PyObject_New(BoardObject, &BoardType);
+  if (c) c->board = self->board;
+  return (PyObject*)c;
+}
+
+static PyObject* Board_get_key(BoardObject* self, void* closure) {
+  (void)closure;
+  return PyLong_FromUnsignedLongLong(board_get_zobrist_key(&self->board));
+}
+
+static PyObject* Board_get_turn(BoardObject* self, void* closure) {
+  (void)closure;
+  return PyUnicode_FromString(self->board.sideToMove == WHITE ? "w" : "b");
+}
+
+static PyMethodDef Board_methods[] = {
+    {"reset", (PyCFunction)Board_reset, METH_NOARGS, "Set up the start position."},
+    {"load_fen", (PyCFunction)Board_load_fen, METH_O, "Load a FEN (unreadable fields are skipped)."},
+    {"fen", (PyCFunction)Board_fen, METH_NOARGS, "The position as FEN."},
+    {"push", (PyCFunction)(void (*)(void))Board_push, METH_VARARGS | METH_KEYWORDS,
+     "push(move, validate=False): apply a SAN or UCI move; ValueError names the rejection."},
+    {"legal_moves", (PyCFunction)Board_legal_moves, METH_NOARGS, "Legal moves in UCI."},
+    {"evaluate", (PyCFunction)Board_evaluate, METH_NOARGS, "Static evaluation for the side to move, in centipawns."},
+    {"motifs", (PyCFunction)Board_motifs, METH_NOARGS, "MOTIF_* bits for the side to move."},
+    {"features", (PyCFunction)Board_features, METH_NOARGS, "The 12 piece bitboards (P N B R Q K p n b r q k) as an Array."},
+    {"copy", (PyCFunction)Board_copy, METH_NOARGS, "An independent copy."},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyGetSetDef Board_getset[] = {
+    {"key", (getter)Board_get_key, NULL, "Zobrist key.", NULL},
+    {"turn", (getter)Board_get_turn, NULL, "Side to move, 'w' or 'b'.", NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject BoardType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "bitboard_chess.Board",
+    .tp_basicsize = sizeof(BoardObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Board(fen=None): a position, the start position by default.",
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Board_init,
+    .tp_methods = Board_methods,
+    .tp_getset = Board_getset,
+};
+
+/* ---- batch replay ---- */
+
+static int set_item(PyObject* dict, const char* name, PyObject* value) {
+  if (!value) return -1;
+  int r = PyDict_SetItemString(dict, name, value);
+  Py_DECREF(value);
+  return r;
+}
+
+static PyObject* replay_pgn_py(PyObject* self, PyObject* args, PyObject* kw) {
+  static char* kwlist[] = {"data", "validate", "evals", "motifs", "features", "minhash", NULL};
+  Py_buffer in;
+  int validate = 0, evals = 0, motifs = 0, features = 0, minhash = 0;
+  (void)self;
+  if (!PyArg_ParseTupleAndKeywords(args, kw, "s*|$ppppp", kwlist, &in, &validate, &evals, &motifs, &features,
+                                   &minhash))
+    return NULL;
+  int flags = (validate ? REPLAY_VALIDATE : 0) | (evals ? REPLAY_EVALS : 0) | (motifs ? REPLAY_MOTIFS : 0) |
+              (features ? REPLAY_SETS : 0) | (minhash ? REPLAY_MINHASH : 0);
+  ReplayBatch batch;
+  bool ok;
+  replay_batch_init(&batch);
+  Py_BEGIN_ALLOW_THREADS
+  ok = replay_pgn((const char*)in.buf, (size_t)in.len, flags, &batch);
+  Py_END_ALLOW_THREADS
+  PyBuffer_Release(&in);
+  if (!ok) {
+    replay_batch_free(&batch);
+    return PyErr_NoMemory();
+  }
+
+  size_t n = batch.game_count, plies = batch.key_count;
+  uint32_t* offsets;
+  uint8_t* status;
+  uint8_t* end;
+  PyObject* result = PyDict_New();
+  if (!result) goto fail;
+  if (set_item(result, "games", PyLong_FromSize_t(n)) < 0) goto fail;
+  if (set_item(result, "offsets", array_new("I", sizeof(uint32_t), (Py_ssize_t)n + 1, (void**)&offsets)) < 0) goto fail;
+  if (set_item(result, "status", array_new("B", 1, (Py_ssize_t)n, (void**)&status)) < 0) goto fail;
+  if (set_item(result, "end", array_new("B", 1, (Py_ssize_t)n, (void**)&end)) < 0) goto fail;
+  for (size_t i = 0; i < n; i++) {
+    offsets[i] = (uint32_t)batch.games[i].first_key;
+    status[i] = (uint8_t)batch.games[i].status;
+    end[i] = (uint8_t)batch.games[i].end;
+  }
+  offsets[n] = (uint32_t)plies;
+  /* The per-ply columns are handed over as they are. */
+  if (set_item(result, "keys", array_take(batch.keys, "Q", sizeof(uint64_t), (Py_ssize_t)plies, 0)) < 0) {
+    batch.keys = NULL;
+    goto fail;
+  }
+  batch.keys = NULL;
+  if (batch.evals) {
+    int r = set_item(result, "evals", array_take(batch.evals, "h", sizeof(int16_t), (Py_ssize_t)plies, 0));
+    batch.evals = NULL;
+    if (r < 0) goto fail;
+  }
+  if (batch.motifs) {
+    int r = set_item(result, "motifs", array_take(batch.motifs, "B", 1, (Py_ssize_t)plies, 0));
+    batch.motifs = NULL;
+    if (r < 0) goto fail;
+  }
+  if (batch.sets) {
+    int r = set_item(result, "features", array_take(batch.sets, "Q", sizeof(u64), (Py_ssize_t)plies, 12));
+    batch.sets = NULL;
+    if (r < 0) goto fail;
+  }
+  if (batch.minhash) {
+    int r = set_item(result, "minhash", array_take(batch.minhash, "I", sizeof(uint32_t), (Py_ssize_t)n, MINHASH_SIZE));
+    batch.minhash = NULL;
+    if (r < 0) goto fail;
+  }
+  replay_batch_free(&batch);
+  return result;
+
+fail:
+  replay_batch_free(&batch);
+  Py_XDECREF(result);
+  return NULL;
+}
+
+static PyMethodDef module_methods[] = {
+    {"replay_pgn", (PyCFunction)(void (*)(void))replay_pgn_py, METH_VARARGS | METH_KEYWORDS,
+     "replay_pgn(data, *, validate=False, evals=False, motifs=False, features=False, minhash=False) -> dict\n\n"
+     "Replay every game of a PGN str or bytes-like object ([FEN] tags honoured) with the GIL\n"
+     "released. Returns games and Arrays keys (uint64 per ply), offsets (uint32, games + 1),\n"
+     "status and end (uint8 per game), plus evals (int16), motifs (uint8), features\n"
+     "(uint64, 12 per ply) and minhash (uint32, 64 per game) when asked for."},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef module_def = {
+    PyModuleDef_HEAD_INIT, "bitboard_chess", "Bitboard chess core: boards and batch replay.", -1, module_methods,
+    NULL, NULL, NULL, NULL,
+};
+
+PyMODINIT_FUNC PyInit_bitboard_chess(void) {
+  static const struct {
+    const char* name;
+    int value;
+  } constants[] = {
+      {"MOVE_OK", MOVE_OK},
+      {"MOVE_ERR_SYNTAX", MOVE_ERR_SYNTAX},
+      {"MOVE_ERR_NO_PIECE", MOVE_ERR_NO_PIECE},
+      {"MOVE_ERR_ILLEGAL", MOVE_ERR_ILLEGAL},
+      {"MOVE_ERR_AMBIGUOUS", MOVE_ERR_AMBIGUOUS},
+      {"GAME_END_UNFINISHED", GAME_END_UNFINISHED},
+      {"GAME_END_CHECKMATE", GAME_END_CHECKMATE},
+      {"GAME_END_STALEMATE", GAME_END_STALEMATE},
+      {"GAME_END_INSUFFICIENT_MATERIAL", GAME_END_INSUFFICIENT_MATERIAL},
+      {"GAME_END_THREEFOLD", GAME_END_THREEFOLD},
+      {"GAME_END_FIFTY_MOVE", GAME_END_FIFTY_MOVE},
+      {"MOTIF_HANGING", MOTIF_HANGING},
+      {"MOTIF_FORK", MOTIF_FORK},
+      {"MOTIF_PIN", MOTIF_PIN},
+      {"MOTIF_SKEWER", MOTIF_SKEWER},
+      {"MOTIF_DISCOVERED_ATTACK", MOTIF_DISCOVERED_ATTACK},
+      {"MOTIF_DISCOVERED_CHECK", MOTIF_DISCOVERED_CHECK},
+  };
+  /* Shared tables are set up here, before threads can race to do it. */
+  board_init_tables();
+  if (PyType_Ready(&ArrayType) < 0 || PyType_Ready(&BoardType) < 0) return NULL;
+  PyObject* m = PyModule_Create(&module_def);
+  if (!m) return NULL;
+  Py_INCREF(&ArrayType);
+  Py_INCREF(&BoardType);
+  if (PyModule_AddObject(m, "Array", (PyObject*)&ArrayType) < 0 ||
+      PyModule_AddObject(m, "Board", (PyObject*)&BoardType) < 0) {
+    Py_DECREF(m);
+    return NULL;
+  }
+  for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+    if (PyModule_AddIntConstant(m, constants[i].name, constants[i].value) < 0) {
+      Py_DECREF(m);
+      return NULL;
+    }
+  }
+  return m;
+}
@@ -0,0 +1,24 @@
+# Build in place with: python3 setup.py build_ext --inplace
+import glob
+import os
+import sys
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+src = os.path.join(here, '..', 'src')
+core = sorted(p for p in glob.glob(os.path.join(src, '*.c')) if os.path.basename(p) != 'addon.c')
+
+setup(
+    name='bitboard_chess',
+    version='1.0.0',
+    ext_modules=[
+        Extension(
+            'bitboard_chess',
+            sources=[os.path.join(here, 'bitboard_chess_py.c')] + [os.path.relpath(p, here) for p in core],
+            include_dirs=[src],
+            extra_compile_args=[] if sys.platform == 'win32' else ['-O2', '-pthread'],
+            extra_link_args=[] if sys.platform == 'win32' else ['-pthread'],
+        )
+    ],
+)
@@ -0,0 +1,101 @@
+import ctypes
+import unittest
+
+import bitboard_chess as bc
+
+PGN = b'''[Event "a"]
+
+1. e4 e5 2. Nf3 Nc6 3. Bc4 Nd4 4. Nxe5 Qg5 5. Nxf7 Qxg2 6. Rf1 Qxe4+ 7. Be2 Nf3# 0-1
+
+[Event "b"]
+[FEN "4k3/8/8/8/8/8/8/4K2R w K - 0 1"]
+
+1. O-O Kd7 2. Rd1+ *
+'''
+
+
+class BoardTest(unittest.TestCase):
+    def test_push_and_keys(self):
+        b = bc.Board()
+        self.assertEqual(b.turn, 'w')
+        self.assertEqual(len(b.legal_moves()), 20)
+        start = b.key
+        b.push('e4')
+        b.push('e7e5')
+        self.assertNotEqual(b.key, start)
+        self.assertEqual(b.fen(), 'rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2')
+        with self.assertRaisesRegex(ValueError, 'ILLEGAL'):
+            b.push('e5', validate=True)
+
+    def test_features(self):
+        f = memoryview(bc.Board().features())
+        self.assertEqual(f.format, 'Q')
+        self.assertEqual(f.tolist()[0], 0xFF00)
+        self.assertEqual(f.tolist()[11], 1 << 60)
+
+
+class ReplayTest(unittest.TestCase):
+    def test_replay_pgn_columns(self):
+        res = bc.replay_pgn(PGN, evals=True, motifs=True, features=True)
+        self.assertEqual(res['games'], 2)
+        offsets = memoryview(res['offsets']).tolist()
+        self.assertEqual(offsets, [0, 14, 17])
+        self.assertEqual(memoryview(res['end']).tolist()[0], bc.GAME_END_CHECKMATE)
+        self.assertEqual(memoryview(res['status']).tolist(), [bc.MOVE_OK, bc.MOVE_OK])
+
+        b = bc.Board()
+        for mv in ['e4', 'e5', 'Nf3']:
+            b.push(mv)
+        self.assertEqual(memoryview(res['keys'])[2], b.key)
+        self.assertEqual(memoryview(res['evals']).format, 'h')
+        self.assertEqual(len(res['motifs']), 17)
+        feats = memoryview(res['features'])
+        self.assertEqual(feats.shape, (17, 12))
+        self.assertEqual(feats.tolist()[2], memoryview(b.features()).tolist())
+
+    def test_accepts_str_and_empty(self):
+        res = bc.replay_pgn('')
+        self.assertEqual(res['games'], 0)
+        self.assertEqual(len(res['keys']), 0)
+        self.assertEqual(memoryview(res['offsets']).tolist(), [0])
+
+
+class Py_buffer(ctypes.Structure):
+    _fields_ = [('buf', ctypes.c_void_p), ('obj', ctypes.py_object), ('len', ctypes.c_ssize_t),
+                ('itemsize', ctypes.c_ssize_t), ('readonly', ctypes.c_int), ('ndim', ctypes.c_int),
+                ('format', ctypes.c_char_p), ('shape', ctypes.POINTER(ctypes.c_ssize_t)),
+                ('strides', ctypes.POINTER(ctypes.c_ssize_t)), ('suboffsets', ctypes.c_void_p),
+                ('internal', ctypes.c_void_p)]
+
+
+PyBUF_SIMPLE, PyBUF_WRITABLE, PyBUF_FORMAT, PyBUF_ND, PyBUF_STRIDES = 0, 0x1, 0x4, 0x8, 0x18
+PyBUF_C_CONTIGUOUS, PyBUF_F_CONTIGUOUS = 0x38, 0x58
+
+
+def get_buffer(obj, flags):
+    view = Py_buffer()
+    ctypes.pythonapi.PyObject_GetBuffer.argtypes = [ctypes.py_object, ctypes.POINTER(Py_buffer), ctypes.c_int]
+    ctypes.pythonapi.PyObject_GetBuffer(obj, ctypes.byref(view), flags)
+    info = (view.ndim, bool(view.shape), bool(view.strides), view.format, view.len)
+    ctypes.pythonapi.PyBuffer_Release.argtypes = [ctypes.POINTER(Py_buffer)]
+    ctypes.pythonapi.PyBuffer_Release(ctypes.byref(view))
+    return info
+
+
+class BufferTest(unittest.TestCase):
+    def test_request_flags(self):
+        feats = bc.replay_pgn(PGN, features=True)['features']
+        size = 17 * 12 * 8
+        self.assertEqual(get_buffer(feats, PyBUF_SIMPLE), (1, False, False, None, size))
+        self.assertEqual(get_buffer(feats, PyBUF_WRITABLE | PyBUF_FORMAT), (1, False, False, b'Q', size))
+        self.assertEqual(get_buffer(feats, PyBUF_ND), (2, True, False, None, size))
+        self.assertEqual(get_buffer(feats, PyBUF_STRIDES | PyBUF_FORMAT), (2, True, True, b'Q', size))
+        self.assertEqual(get_buffer(feats, PyBUF_C_CONTIGUOUS), (2, True, True, None, size))
+        self.assertEqual(get_buffer(bc.Board().features(), PyBUF_F_CONTIGUOUS), (1, True, True, None, 12 * 8))
+        with self.assertRaises(BufferError):
+            get_buffer(feats, PyBUF_F_CONTIGUOUS)
+        self.assertEqual(memoryview(feats).cast('B').nbytes, size)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -1,9 +1,29 @@
 /* Node.js N-API bindings for bitboard_chess */
 
 #include <node_api.h>
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "alloc.h"
+#include "audit.h"
 #include "bitboard_chess.h"
+#include "fencheck.h"
+#include "groupby.h"
+#include "mate.h"
+#include "minhash.h"
+#include "motif.h"
+#include "ndjson.h"
+#include "perft.h"
+#include "pgnstream.h"
+#include "posdict.h"
+#include "puzzle.h"
+#include "replay.h"
+#include "search.h"
+#include "similarity.h"
+#include "store.h"
+#include "tablebase.h"
+#include "threads.h"
 
 #define FEN_MAX 128
 
@@ -42,11 +62,11 @@ static napi_value MakeMoveSAN(napi_env env, napi_callback_info info) {
   napi_get_value_external(env, argv[0], (void**)&b);
   size_t len;
   napi_get_value_string_utf8(env, argv[1], NULL, 0, &len);
-  char* san = (char*)malloc(len + 1);
+  char* san = (char*)bc_malloc(len + 1);
   if (!san) return NULL;
   napi_get_value_string_utf8(env, argv[1], san, len + 1, &len);
   bool ok = board_make_move_san(b, san);
-  free(san);
+  bc_free(san);
   napi_value result;
   napi_get_boolean(env, ok, &result);
   return result;
@@ -68,15 +88,58 @@ static napi_value GetZobristKey(napi_env env, napi_callback_info info) {
   return result;
 }
 
-static napi_value ToFEN(napi_env env, napi_callback_info info) {
+static void fen_cache_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  bc_free(data);
+}
+
+/* fenCacheCreate() -> FenCache handle for toFEN */
+static napi_value FenCacheCreate(napi_env env, napi_callback_info info) {
+  (void)info;
+  FenCache* cache = (FenCache*)bc_malloc(sizeof(FenCache));
+  if (!cache) {
+    napi_throw_error(env, NULL, "fenCacheCreate: out of memory");
+    return NULL;
+  }
+  board_fen_cache_init(cache);
+  napi_value external;
+  napi_create_external(env, cache, fen_cache_finalize, NULL, &external);
+  return external;
+}
+
+/* fenCacheRendered(cache) -> ranks rendered through the cache so far */
+static napi_value FenCacheRendered(napi_env env, napi_callback_info info) {
   size_t argc = 1;
   napi_value argv[1];
   napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
   if (argc < 1) return NULL;
+  FenCache* cache;
+  napi_get_value_external(env, argv[0], (void**)&cache);
+  napi_value result;
+  napi_create_double(env, (double)cache->rendered, &result);
+  return result;
+}
+
+/* toFEN(handle, cache?) */
+static napi_value ToFEN(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_valuetype type = napi_undefined;
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
   Board* b;
   napi_get_value_external(env, argv[0], (void**)&b);
+  if (argc >= 2) napi_typeof(env, argv[1], &type);
   char buf[FEN_MAX];
-  int n = board_to_fen(b, buf, FEN_MAX);
+  int n;
+  if (type == napi_external) {
+    FenCache* cache;
+    napi_get_value_external(env, argv[1], (void**)&cache);
+    n = board_to_fen_cached(b, cache, buf, FEN_MAX);
+  } else {
+    n = board_to_fen(b, buf, FEN_MAX);
+  }
   napi_value result;
   napi_create_string_utf8(env, buf, (size_t)n, &result);
   return result;
@@ -91,11 +154,11 @@ static napi_value LoadFromFEN(napi_env env, napi_callback_info info) {
   napi_get_value_external(env, argv[0], (void**)&b);
   size_t len;
   napi_get_value_string_utf8(env, argv[1], NULL, 0, &len);
-  char* fen = (char*)malloc(len + 1);
+  char* fen = (char*)bc_malloc(len + 1);
   if (!fen) return NULL;
   napi_get_value_string_utf8(env, argv[1], fen, len + 1, &len);
   board_load_fen(b, fen);
-  free(fen);
+  bc_free(fen);
   return NULL;
 }
 
@@ -119,12 +182,12 @@ static napi_value ResolveSAN(napi_env env, napi_callback_info info) {
   napi_get_value_external(env, argv[0], (void**)&b);
   size_t len;
   napi_get_value_string_utf8(env, argv[1], NULL, 0, &len);
-  char* san = (char*)malloc(len + 1);
+  char* san = (char*)bc_malloc(len + 1);
   if (!san) return NULL;
   napi_get_value_string_utf8(env, argv[1], san, len + 1, &len);
   Move move;
   bool ok = board_resolve_san(b, san, &move);
-  free(san);
+  bc_free(san);
   if (!ok) {
     napi_value null_val;
     napi_get_null(env, &null_val);
@@ -260,6 +323,2509 @@ static napi_value GetPosition(napi_env env, napi_callback_info info) {
   return obj;
 }
 
+static bool get_perft_args(napi_env env, napi_callback_info info, Board** b, int32_t* depth, PerftOptions* opts) {
+  size_t argc = 4;
+  napi_value argv[4];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return false;
+  napi_get_value_external(env, argv[0], (void**)b);
+  if (napi_get_value_int32(env, argv[1], depth) != napi_ok) return false;
+  int32_t threads = 1, hash_mb = 0;
+  if (argc >= 3) napi_get_value_int32(env, argv[2], &threads);
+  if (argc >= 4) napi_get_value_int32(env, argv[3], &hash_mb);
+  opts->threads = threads;
+  opts->hash_mb = hash_mb > 0 ? (size_t)hash_mb : 0;
+  return true;
+}
+
+static napi_value Perft(napi_env env, napi_callback_info info) {
+  Board* b;
+  int32_t depth;
+  PerftOptions opts;
+  if (!get_perft_args(env, info, &b, &depth, &opts)) return NULL;
+  uint64_t nodes = board_perft(b, depth, &opts, NULL, NULL);
+  if (nodes == UINT64_MAX) {
+    napi_throw_error(env, NULL, "perft: out of memory");
+    return NULL;
+  }
+  napi_value result;
+  napi_create_double(env, (double)nodes, &result);
+  return result;
+}
+
+static napi_value PerftDivideFn(napi_env env, napi_callback_info info) {
+  Board* b;
+  int32_t depth;
+  PerftOptions opts;
+  if (!get_perft_args(env, info, &b, &depth, &opts)) return NULL;
+  PerftDivide divide[BOARD_MAX_MOVES];
+  int count = 0;
+  uint64_t nodes = board_perft(b, depth, &opts, divide, &count);
+  if (nodes == UINT64_MAX) {
+    napi_throw_error(env, NULL, "perft: out of memory");
+    return NULL;
+  }
+  napi_value obj;
+  napi_create_object(env, &obj);
+  for (int i = 0; i < count; i++) {
+    char uci[6];
+    board_move_to_uci(&divide[i].move, uci);
+    napi_value v;
+    napi_create_double(env, (double)divide[i].nodes, &v);
+    napi_set_named_property(env, obj, uci, v);
+  }
+  return obj;
+}
+
+/* search(handle, depth, nodes, ms, threads, hashMb) ->
+ * { best, score, mate, depth, nodes, ms, pv } (best null without a legal move) */
+static napi_value Search(napi_env env, napi_callback_info info) {
+  size_t argc = 6;
+  napi_value argv[6];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 6) return NULL;
+  Board* b;
+  int32_t depth = 0, threads = 1, hash_mb = 0;
+  double nodes = 0;
+  SearchOptions opts;
+  SearchResult r;
+  napi_get_value_external(env, argv[0], (void**)&b);
+  napi_get_value_int32(env, argv[1], &depth);
+  napi_get_value_double(env, argv[2], &nodes);
+  napi_get_value_double(env, argv[3], &opts.ms);
+  napi_get_value_int32(env, argv[4], &threads);
+  napi_get_value_int32(env, argv[5], &hash_mb);
+  opts.depth = depth;
+  opts.nodes = nodes > 0 ? (uint64_t)nodes : 0;
+  opts.threads = threads;
+  opts.hash_mb = hash_mb > 0 ? (size_t)hash_mb : 0;
+  if (!board_search(b, &opts, &r)) {
+    napi_throw_error(env, NULL, "search: out of memory");
+    return NULL;
+  }
+
+  napi_value obj, v, pv;
+  char uci[8];
+  napi_create_object(env, &obj);
+  if (r.best.from >= 0) {
+    napi_create_string_utf8(env, uci, (size_t)board_move_to_uci(&r.best, uci), &v);
+  } else {
+    napi_get_null(env, &v);
+  }
+  napi_set_named_property(env, obj, "best", v);
+  napi_create_int32(env, r.score, &v);
+  napi_set_named_property(env, obj, "score", v);
+  /* moves to mate, negative when the side to move is mated */
+  int mate_plies = SEARCH_MATE - abs(r.score);
+  if (mate_plies <= SEARCH_MAX_PLY) {
+    napi_create_int32(env, r.score > 0 ? (mate_plies + 1) / 2 : -(mate_plies / 2), &v);
+  } else {
+    napi_get_null(env, &v);
+  }
+  napi_set_named_property(env, obj, "mate", v);
+  napi_create_int32(env, r.depth, &v);
+  napi_set_named_property(env, obj, "depth", v);
+  napi_create_double(env, (double)r.nodes, &v);
+  napi_set_named_property(env, obj, "nodes", v);
+  napi_create_double(env, r.ms, &v);
+  napi_set_named_property(env, obj, "ms", v);
+  napi_create_array_with_length(env, (size_t)r.pv_len, &pv);
+  for (int i = 0; i < r.pv_len; i++) {
+    napi_create_string_utf8(env, uci, (size_t)board_move_to_uci(&r.pv[i], uci), &v);
+    napi_set_element(env, pv, (uint32_t)i, v);
+  }
+  napi_set_named_property(env, obj, "pv", pv);
+  return obj;
+}
+
+static napi_value Evaluate(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  Board* b;
+  napi_get_value_external(env, argv[0], (void**)&b);
+  napi_value result;
+  napi_create_int32(env, board_evaluate(b), &result);
+  return result;
+}
+
+/* { mg, eg, phase, score } of the incrementally kept evaluation (White's side). */
+static napi_value GetEval(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  Board* b;
+  napi_get_value_external(env, argv[0], (void**)&b);
+  napi_value obj, v;
+  napi_create_object(env, &obj);
+  napi_create_int32(env, b->mg, &v);
+  napi_set_named_property(env, obj, "mg", v);
+  napi_create_int32(env, b->eg, &v);
+  napi_set_named_property(env, obj, "eg", v);
+  napi_create_int32(env, b->phase, &v);
+  napi_set_named_property(env, obj, "phase", v);
+  napi_create_int32(env, board_eval(b), &v);
+  napi_set_named_property(env, obj, "score", v);
+  return obj;
+}
+
+/* MOTIF_* bits for the side to move. */
+static napi_value GetMotifs(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  Board* b;
+  napi_get_value_external(env, argv[0], (void**)&b);
+  napi_value result;
+  napi_create_uint32(env, motif_tag(b), &result);
+  return result;
+}
+
+static napi_value int_array(napi_env env, const int* values, size_t n) {
+  napi_value arr, v;
+  napi_create_array_with_length(env, n, &arr);
+  for (size_t i = 0; i < n; i++) {
+    napi_create_int32(env, values[i], &v);
+    napi_set_element(env, arr, (uint32_t)i, v);
+  }
+  return arr;
+}
+
+/* Read exactly n integers from a JS array. */
+static bool read_int_array(napi_env env, napi_value arr, int* out, size_t n) {
+  bool is_array = false;
+  uint32_t len = 0;
+  if (napi_is_array(env, arr, &is_array) != napi_ok || !is_array) return false;
+  napi_get_array_length(env, arr, &len);
+  if (len != n) return false;
+  for (uint32_t i = 0; i < len; i++) {
+    napi_value v;
+    int32_t x;
+    napi_get_element(env, arr, i, &v);
+    if (napi_get_value_int32(env, v, &x) != napi_ok) return false;
+    out[i] = x;
+  }
+  return true;
+}
+
+static napi_value pst_array(napi_env env, const int pst[6][64]) {
+  napi_value arr;
+  napi_create_array_with_length(env, 6, &arr);
+  for (int k = 0; k < 6; k++) napi_set_element(env, arr, (uint32_t)k, int_array(env, pst[k], 64));
+  return arr;
+}
+
+static bool read_pst_array(napi_env env, napi_value arr, int pst[6][64]) {
+  bool is_array = false;
+  uint32_t len = 0;
+  if (napi_is_array(env, arr, &is_array) != napi_ok || !is_array) return false;
+  napi_get_array_length(env, arr, &len);
+  if (len != 6) return false;
+  for (uint32_t k = 0; k < 6; k++) {
+    napi_value v;
+    napi_get_element(env, arr, k, &v);
+    if (!read_int_array(env, v, pst[k], 64)) return false;
+  }
+  return true;
+}
+
+/* getEvalTables() -> { mgValue, egValue, mgPst, egPst, phaseWeight } */
+static napi_value GetEvalTables(napi_env env, napi_callback_info info) {
+  EvalTables t;
+  napi_value obj;
+  (void)info;
+  board_get_eval_tables(&t);
+  napi_create_object(env, &obj);
+  napi_set_named_property(env, obj, "mgValue", int_array(env, t.mg_value, 6));
+  napi_set_named_property(env, obj, "egValue", int_array(env, t.eg_value, 6));
+  napi_set_named_property(env, obj, "mgPst", pst_array(env, t.mg_pst));
+  napi_set_named_property(env, obj, "egPst", pst_array(env, t.eg_pst));
+  napi_set_named_property(env, obj, "phaseWeight", int_array(env, t.phase_weight, 6));
+  return obj;
+}
+
+/* setEvalTables(tables | null): tables has every field of getEvalTables(). */
+static napi_value SetEvalTables(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_valuetype type = napi_undefined;
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc >= 1) napi_typeof(env, argv[0], &type);
+  if (type != napi_object) {
+    board_set_eval_tables(NULL);
+    return NULL;
+  }
+  EvalTables t;
+  napi_value v[5];
+  napi_get_named_property(env, argv[0], "mgValue", &v[0]);
+  napi_get_named_property(env, argv[0], "egValue", &v[1]);
+  napi_get_named_property(env, argv[0], "mgPst", &v[2]);
+  napi_get_named_property(env, argv[0], "egPst", &v[3]);
+  napi_get_named_property(env, argv[0], "phaseWeight", &v[4]);
+  if (!read_int_array(env, v[0], t.mg_value, 6) || !read_int_array(env, v[1], t.eg_value, 6) ||
+      !read_pst_array(env, v[2], t.mg_pst) || !read_pst_array(env, v[3], t.eg_pst) ||
+      !read_int_array(env, v[4], t.phase_weight, 6)) {
+    napi_throw_type_error(env, NULL, "setEvalTables: values and phase weights must be 6 integers, tables 6 x 64");
+    return NULL;
+  }
+  board_set_eval_tables(&t);
+  return NULL;
+}
+
+/* { status, mateIn, moves: [{ move, mateIn }], count, nodes } */
+static napi_value mate_result_to_object(napi_env env, const MateResult* r) {
+  napi_value obj, v, moves;
+  napi_create_object(env, &obj);
+  napi_create_int32(env, r->status, &v);
+  napi_set_named_property(env, obj, "status", v);
+  napi_create_int32(env, r->mate_in, &v);
+  napi_set_named_property(env, obj, "mateIn", v);
+  napi_create_int32(env, r->count, &v);
+  napi_set_named_property(env, obj, "count", v);
+  napi_create_double(env, (double)r->nodes, &v);
+  napi_set_named_property(env, obj, "nodes", v);
+  int stored = r->count < MATE_MAX_SOLUTIONS ? r->count : MATE_MAX_SOLUTIONS;
+  napi_create_array_with_length(env, (size_t)stored, &moves);
+  for (int i = 0; i < stored; i++) {
+    Move m;
+    char uci[8];
+    napi_value entry;
+    memset(&m, 0, sizeof(m));
+    m.from = r->moves[i].from;
+    m.to = r->moves[i].to;
+    m.promotion = r->moves[i].promotion;
+    napi_create_object(env, &entry);
+    napi_create_string_utf8(env, uci, (size_t)board_move_to_uci(&m, uci), &v);
+    napi_set_named_property(env, entry, "move", v);
+    napi_create_int32(env, r->moves[i].mate_in, &v);
+    napi_set_named_property(env, entry, "mateIn", v);
+    napi_set_element(env, moves, (uint32_t)i, entry);
+  }
+  napi_set_named_property(env, obj, "moves", moves);
+  return obj;
+}
+
+/* solveMate(handle, n, nodes, hashMb) */
+static napi_value SolveMate(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value argv[4];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 4) return NULL;
+  Board* b;
+  int32_t n = 1, hash_mb = 0;
+  double nodes = 0;
+  MateOptions opts;
+  MateResult r;
+  napi_get_value_external(env, argv[0], (void**)&b);
+  napi_get_value_int32(env, argv[1], &n);
+  napi_get_value_double(env, argv[2], &nodes);
+  napi_get_value_int32(env, argv[3], &hash_mb);
+  memset(&opts, 0, sizeof(opts));
+  opts.n = n;
+  opts.node_budget = nodes > 0 ? (uint64_t)nodes : 0;
+  opts.hash_mb = hash_mb > 0 ? (size_t)hash_mb : 0;
+  if (!mate_solve(b, &opts, &r)) {
+    napi_throw_error(env, NULL, "solveMate: out of memory");
+    return NULL;
+  }
+  return mate_result_to_object(env, &r);
+}
+
+/* solveMates(fens, n, nodes, threads, hashMb) -> [result per FEN] */
+static napi_value SolveMates(napi_env env, napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 5) return NULL;
+  uint32_t count = 0;
+  int32_t n = 1, threads = 0, hash_mb = 0;
+  double nodes = 0;
+  MateOptions opts;
+  if (napi_get_array_length(env, argv[0], &count) != napi_ok) {
+    napi_throw_type_error(env, NULL, "solveMates: fens must be an array of strings");
+    return NULL;
+  }
+  napi_get_value_int32(env, argv[1], &n);
+  napi_get_value_double(env, argv[2], &nodes);
+  napi_get_value_int32(env, argv[3], &threads);
+  napi_get_value_int32(env, argv[4], &hash_mb);
+  memset(&opts, 0, sizeof(opts));
+  opts.n = n;
+  opts.node_budget = nodes > 0 ? (uint64_t)nodes : 0;
+  opts.threads = threads;
+  opts.hash_mb = hash_mb > 0 ? (size_t)hash_mb : 0;
+
+  char (*fens)[FEN_MAX] = (char (*)[FEN_MAX])bc_calloc(count ? count : 1, FEN_MAX);
+  const char** ptrs = (const char**)bc_calloc(count ? count : 1, sizeof(char*));
+  MateResult* results = (MateResult*)bc_calloc(count ? count : 1, sizeof(MateResult));
+  bool ok = fens && ptrs && results;
+  for (uint32_t i = 0; ok && i < count; i++) {
+    napi_value v;
+    size_t len;
+    napi_get_element(env, argv[0], i, &v);
+    napi_get_value_string_utf8(env, v, fens[i], FEN_MAX, &len);
+    ptrs[i] = fens[i];
+  }
+  ok = ok && mate_solve_batch(ptrs, count, &opts, results);
+  napi_value arr = NULL;
+  if (ok) {
+    napi_create_array_with_length(env, count, &arr);
+    for (uint32_t i = 0; i < count; i++) napi_set_element(env, arr, i, mate_result_to_object(env, &results[i]));
+  } else {
+    napi_throw_error(env, NULL, "solveMates: out of memory");
+  }
+  bc_free(fens);
+  bc_free(ptrs);
+  bc_free(results);
+  return arr;
+}
+
+/* Borrow the bytes of a Buffer/TypedArray, or copy a string into *owned (caller frees). */
+static bool get_bytes(napi_env env, napi_value v, const char** data, size_t* len, char** owned) {
+  bool is_buffer = false, is_typed = false;
+  *owned = NULL;
+  napi_is_buffer(env, v, &is_buffer);
+  if (is_buffer) {
+    void* p;
+    if (napi_get_buffer_info(env, v, &p, len) != napi_ok) return false;
+    *data = (const char*)p;
+    return true;
+  }
+  napi_is_typedarray(env, v, &is_typed);
+  if (is_typed) {
+    napi_typedarray_type type;
+    size_t length, offset;
+    napi_value ab;
+    void* p;
+    if (napi_get_typedarray_info(env, v, &type, &length, &p, &ab, &offset) != napi_ok) return false;
+    if (type != napi_uint8_array && type != napi_int8_array && type != napi_uint8_clamped_array) return false;
+    *data = (const char*)p;
+    *len = length;
+    return true;
+  }
+  size_t n;
+  if (napi_get_value_string_utf8(env, v, NULL, 0, &n) != napi_ok) return false;
+  *owned = (char*)bc_malloc(n + 1);
+  if (!*owned) return false;
+  napi_get_value_string_utf8(env, v, *owned, n + 1, &n);
+  *data = *owned;
+  *len = n;
+  return true;
+}
+
+static napi_value keys_to_bigint64_array(napi_env env, const uint64_t* keys, size_t count) {
+  napi_value ab, arr;
+  void* data;
+  napi_create_arraybuffer(env, count * sizeof(uint64_t), &data, &ab);
+  if (count) memcpy(data, keys, count * sizeof(uint64_t));
+  napi_create_typedarray(env, napi_biguint64_array, count, ab, 0, &arr);
+  return arr;
+}
+
+static napi_value create_typed(napi_env env, napi_typedarray_type type, size_t elem_size, size_t count, void** data) {
+  napi_value ab, arr;
+  napi_create_arraybuffer(env, count * elem_size, data, &ab);
+  napi_create_typedarray(env, type, count, ab, 0, &arr);
+  return arr;
+}
+
+typedef struct {
+  uint64_t* keys;
+  size_t count;
+  size_t cap;
+  bool oom;
+} KeyList;
+
+static void key_list_push(void* ctx, const Board* b, const Move* move, uint64_t key) {
+  KeyList* l = (KeyList*)ctx;
+  (void)b;
+  (void)move;
+  if (l->count == l->cap) {
+    size_t cap = l->cap ? l->cap * 2 : 128;
+    uint64_t* keys = (uint64_t*)bc_realloc(l->keys, cap * sizeof(uint64_t));
+    if (!keys) { l->oom = true; return; }
+    l->keys = keys;
+    l->cap = cap;
+  }
+  l->keys[l->count++] = key;
+}
+
+/* { glyph, epSuffix, ... }: moves accepted per lenient SAN form */
+static napi_value norm_stats_to_object(napi_env env, const SanNormStats* stats) {
+  static const char* names[SAN_NORM_KINDS] = {
+    "glyph", "epSuffix", "promotionWithoutEquals", "timesSign", "figurine", "nullMove"
+  };
+  napi_value obj;
+  napi_create_object(env, &obj);
+  for (int i = 0; i < SAN_NORM_KINDS; i++) {
+    napi_value v;
+    napi_create_double(env, (double)stats->counts[i], &v);
+    napi_set_named_property(env, obj, names[i], v);
+  }
+  return obj;
+}
+
+/* replay(handle, moves, validate) and replayTCN(handle, tcn, validate) */
+static napi_value run_replay(napi_env env, napi_callback_info info, bool tcn) {
+  const char* name = tcn ? "replayTCN" : "replay";
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  Board* b;
+  napi_get_value_external(env, argv[0], (void**)&b);
+  bool validate = false;
+  if (argc >= 3) napi_get_value_bool(env, argv[2], &validate);
+  const char* text;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[1], &text, &len, &owned)) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s: moves must be a string or Buffer", name);
+    napi_throw_type_error(env, NULL, msg);
+    return NULL;
+  }
+  KeyList keys = { NULL, 0, 0, false };
+  SanNormStats norm;
+  memset(&norm, 0, sizeof(norm));
+  ReplayOptions opts;
+  opts.flags = validate ? REPLAY_VALIDATE : 0;
+  opts.on_ply = key_list_push;
+  opts.ctx = &keys;
+  opts.norm = &norm;
+  ReplayResult r = tcn ? replay_tcn(b, text, len, &opts) : replay_movetext(b, text, len, &opts);
+  bc_free(owned);
+  if (keys.oom) {
+    bc_free(keys.keys);
+    napi_throw_error(env, NULL, "out of memory");
+    return NULL;
+  }
+  napi_value obj, v_status, v_plies;
+  napi_create_object(env, &obj);
+  napi_set_named_property(env, obj, "keys", keys_to_bigint64_array(env, keys.keys, keys.count));
+  napi_create_int32(env, r.status, &v_status);
+  napi_create_int32(env, r.plies, &v_plies);
+  napi_set_named_property(env, obj, "status", v_status);
+  napi_set_named_property(env, obj, "plies", v_plies);
+  if (!tcn) napi_set_named_property(env, obj, "normalized", norm_stats_to_object(env, &norm));
+  bc_free(keys.keys);
+  return obj;
+}
+
+static napi_value Replay(napi_env env, napi_callback_info info) {
+  return run_replay(env, info, false);
+}
+
+static napi_value ReplayTCN(napi_env env, napi_callback_info info) {
+  return run_replay(env, info, true);
+}
+
+/* games, keys, offsets (n + 1), status, end and normalized of a batch */
+static void set_batch_arrays(napi_env env, napi_value obj, const ReplayBatch* batch) {
+  size_t n = batch->game_count;
+  uint32_t* offsets;
+  uint8_t* status;
+  uint8_t* end;
+  napi_value v_games;
+  napi_create_uint32(env, (uint32_t)n, &v_games);
+  napi_set_named_property(env, obj, "games", v_games);
+  napi_set_named_property(env, obj, "keys", keys_to_bigint64_array(env, batch->keys, batch->key_count));
+  napi_set_named_property(env, obj, "offsets", create_typed(env, napi_uint32_array, 4, n + 1, (void**)&offsets));
+  napi_set_named_property(env, obj, "status", create_typed(env, napi_uint8_array, 1, n, (void**)&status));
+  napi_set_named_property(env, obj, "end", create_typed(env, napi_uint8_array, 1, n, (void**)&end));
+  for (size_t i = 0; i < n; i++) {
+    offsets[i] = (uint32_t)batch->games[i].first_key;
+    status[i] = (uint8_t)batch->games[i].status;
+    end[i] = (uint8_t)batch->games[i].end;
+  }
+  offsets[n] = (uint32_t)batch->key_count;
+  if (batch->evals) {
+    int16_t* evals;
+    napi_set_named_property(env, obj, "evals", create_typed(env, napi_int16_array, 2, batch->key_count, (void**)&evals));
+    if (batch->key_count) memcpy(evals, batch->evals, batch->key_count * sizeof(int16_t));
+  }
+  if (batch->motifs) {
+    uint8_t* motifs;
+    napi_set_named_property(env, obj, "motifs", create_typed(env, napi_uint8_array, 1, batch->key_count, (void**)&motifs));
+    if (batch->key_count) memcpy(motifs, batch->motifs, batch->key_count);
+  }
+  if (batch->minhash) {
+    uint32_t* sigs;
+    size_t count = n * MINHASH_SIZE;
+    napi_set_named_property(env, obj, "minhash", create_typed(env, napi_uint32_array, 4, count, (void**)&sigs));
+    if (count) memcpy(sigs, batch->minhash, count * sizeof(uint32_t));
+  }
+  napi_set_named_property(env, obj, "normalized", norm_stats_to_object(env, &batch->norm));
+}
+
+/* ---- async jobs ---- */
+
+/* A batch call run on the libuv thread pool. run does the work off the main
+ * thread (no N-API calls); result builds the resolved value on the main
+ * thread, or returns NULL with error set to reject. A call with nothing to
+ * resolve with once cancelled sets aborted instead of ok to reject with an
+ * AbortError. The AsyncJob is shared
+ * by the work, the cancel handle given to JS and the progress function, and
+ * freed when the last of them lets go (all on the main thread). */
+typedef struct AsyncJob AsyncJob;
+
+struct AsyncJob {
+  Job job;
+  int refs;
+  napi_async_work work;
+  napi_deferred deferred;
+  napi_threadsafe_function progress; /* NULL without a callback */
+  napi_ref on_progress;              /* the callback, for the final report */
+  bool queued;
+  bool settled;                      /* reports still queued are dropped */
+  uint64_t reported;                 /* done + 1 of the last report, 0 before the first */
+  napi_ref held[6];                  /* JS values the worker reads: input Buffer, handles */
+  int held_count;
+  bool ok;
+  bool aborted;
+  const char* error;
+  void (*run)(AsyncJob* a);
+  napi_value (*result)(napi_env env, AsyncJob* a);
+  void (*cleanup)(AsyncJob* a); /* frees what run and result left */
+};
+
+static void async_job_unref(AsyncJob* a) {
+  if (--a->refs == 0) bc_free(a);
+}
+
+static void async_job_handle_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  async_job_unref((AsyncJob*)data);
+}
+
+static void async_progress_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  async_job_unref((AsyncJob*)data);
+}
+
+/* Reads the counters when the call runs, so a report that waited in the
+ * queue is never stale; one that would repeat the last is skipped. */
+static void async_progress_call(napi_env env, napi_value fn, void* context, void* data) {
+  (void)data;
+  AsyncJob* a = (AsyncJob*)context;
+  if (!env || a->settled) return;
+  uint64_t done = bc_atomic_load_u64(&a->job.done);
+  if (a->reported == done + 1) return;
+  a->reported = done + 1;
+  napi_value undefined, argv[2];
+  napi_get_undefined(env, &undefined);
+  napi_create_double(env, (double)done, &argv[0]);
+  napi_create_double(env, (double)bc_atomic_load_u64(&a->job.total), &argv[1]);
+  napi_call_function(env, undefined, fn, 2, argv, NULL);
+}
+
+/* Worker side: queue a report unless one is already waiting. */
+static void async_progress_post(void* ctx, uint64_t done, uint64_t total) {
+  (void)done;
+  (void)total;
+  AsyncJob* a = (AsyncJob*)ctx;
+  napi_call_threadsafe_function(a->progress, NULL, napi_tsfn_nonblocking);
+}
+
+static void async_execute(napi_env env, void* data) {
+  (void)env;
+  AsyncJob* a = (AsyncJob*)data;
+  a->run(a);
+}
+
+static void async_complete(napi_env env, napi_status status, void* data) {
+  AsyncJob* a = (AsyncJob*)data;
+  napi_value result = NULL;
+  if (a->on_progress) {
+    /* Final report, ahead of the settlement; an exception in it is uncaught like in any other. */
+    napi_value fn;
+    napi_get_reference_value(env, a->on_progress, &fn);
+    async_progress_call(env, fn, a, NULL);
+    a->settled = true;
+    bool pending = false;
+    napi_is_exception_pending(env, &pending);
+    if (pending) {
+      napi_value err;
+      napi_get_and_clear_last_exception(env, &err);
+      napi_fatal_exception(env, err);
+    }
+    napi_delete_reference(env, a->on_progress);
+  }
+  if (status == napi_ok && a->ok) result = a->result(env, a);
+  if (result) {
+    napi_value cancelled;
+    napi_get_boolean(env, job_cancelled(&a->job), &cancelled);
+    napi_set_named_property(env, result, "cancelled", cancelled);
+    napi_resolve_deferred(env, a->deferred, result);
+  } else if (a->aborted) {
+    napi_value msg, code, name, err;
+    napi_create_string_utf8(env, "The operation was aborted", NAPI_AUTO_LENGTH, &msg);
+    napi_create_string_utf8(env, "ABORT_ERR", NAPI_AUTO_LENGTH, &code);
+    napi_create_string_utf8(env, "AbortError", NAPI_AUTO_LENGTH, &name);
+    napi_create_error(env, code, msg, &err);
+    napi_set_named_property(env, err, "name", name);
+    napi_reject_deferred(env, a->deferred, err);
+  } else {
+    napi_value msg, err;
+    napi_create_string_utf8(env, a->error ? a->error : "out of memory", NAPI_AUTO_LENGTH, &msg);
+    napi_create_error(env, NULL, msg, &err);
+    napi_reject_deferred(env, a->deferred, err);
+  }
+  if (a->progress) napi_release_threadsafe_function(a->progress, napi_tsfn_release);
+  for (int i = 0; i < a->held_count; i++) napi_delete_reference(env, a->held[i]);
+  napi_delete_async_work(env, a->work);
+  a->cleanup(a);
+  async_job_unref(a);
+}
+
+/* Zeroed job of size bytes (a struct starting with AsyncJob); NULL after throwing. */
+static AsyncJob* async_job_new(napi_env env, size_t size, const char* name) {
+  AsyncJob* a = (AsyncJob*)bc_calloc(1, size);
+  if (!a) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s: out of memory", name);
+    napi_throw_error(env, NULL, msg);
+    return NULL;
+  }
+  job_init(&a->job);
+  return a;
+}
+
+/* Keep v (when an object or handle) alive until the job completes. */
+static void async_job_hold(napi_env env, AsyncJob* a, napi_value v) {
+  napi_valuetype type;
+  if (napi_typeof(env, v, &type) != napi_ok || (type != napi_object && type != napi_external)) return;
+  if (napi_create_reference(env, v, 1, &a->held[a->held_count]) == napi_ok) a->held_count++;
+}
+
+/* Set a up and return [promise, job handle]; jobStart queues it. on_progress (a function or
+ * anything else for none) gets (done, total) at most every interval ms. On
+ * failure a is cleaned up and freed and NULL returned after throwing. */
+static napi_value async_job_start(napi_env env, AsyncJob* a, const char* name, napi_value on_progress,
+                                  napi_value interval) {
+  napi_value promise, handle, resource_name, pair;
+  napi_valuetype type;
+  a->refs = 1;
+  napi_get_value_int32(env, interval, (int32_t*)&a->job.interval_ms);
+  napi_create_string_utf8(env, name, NAPI_AUTO_LENGTH, &resource_name);
+  if (napi_create_async_work(env, NULL, resource_name, async_execute, async_complete, a, &a->work) != napi_ok) {
+    for (int i = 0; i < a->held_count; i++) napi_delete_reference(env, a->held[i]);
+    a->cleanup(a);
+    bc_free(a);
+    napi_throw_error(env, NULL, "cannot create async work");
+    return NULL;
+  }
+  napi_create_promise(env, &a->deferred, &promise);
+  if (napi_typeof(env, on_progress, &type) == napi_ok && type == napi_function &&
+      napi_create_threadsafe_function(env, on_progress, NULL, resource_name, 1, 1, a, async_progress_finalize, a,
+                                      async_progress_call, &a->progress) == napi_ok) {
+    a->refs++;
+    napi_create_reference(env, on_progress, 1, &a->on_progress);
+    a->job.on_progress = async_progress_post;
+    a->job.ctx = a;
+  }
+  a->refs++;
+  napi_create_external(env, a, async_job_handle_finalize, NULL, &handle);
+  napi_create_array_with_length(env, 2, &pair);
+  napi_set_element(env, pair, 0, promise);
+  napi_set_element(env, pair, 1, handle);
+  return pair;
+}
+
+/* jobStart(handle): queue the job on the libuv thread pool (once). */
+static napi_value JobStart(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  AsyncJob* a;
+  if (napi_get_value_external(env, argv[0], (void**)&a) != napi_ok || a->queued) return NULL;
+  a->queued = true;
+  napi_queue_async_work(env, a->work);
+  return NULL;
+}
+
+/* jobCancel(handle): stop the job at its next checkpoint (or before it starts); it resolves with
+ * what it finished. */
+static napi_value JobCancel(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  AsyncJob* a;
+  if (napi_get_value_external(env, argv[0], (void**)&a) == napi_ok) job_cancel(&a->job);
+  return NULL;
+}
+
+/* validate, tablebase?, evals?, store?, motifs?, minhash?, dict?, audit? of replayPGN into flags and batch. */
+static int replay_pgn_args(napi_env env, size_t argc, napi_value* argv, ReplayBatch* batch) {
+  bool validate = false;
+  bool evals = false;
+  bool motifs = false;
+  bool minhash = false;
+  napi_valuetype type;
+  if (argc >= 2) napi_get_value_bool(env, argv[1], &validate);
+  if (argc >= 4) napi_get_value_bool(env, argv[3], &evals);
+  if (argc >= 6) napi_get_value_bool(env, argv[5], &motifs);
+  if (argc >= 7) napi_get_value_bool(env, argv[6], &minhash);
+  if (argc >= 3 && napi_typeof(env, argv[2], &type) == napi_ok && type == napi_external) {
+    napi_get_value_external(env, argv[2], (void**)&batch->tablebase);
+  }
+  if (argc >= 5 && napi_typeof(env, argv[4], &type) == napi_ok && type == napi_external) {
+    napi_get_value_external(env, argv[4], (void**)&batch->store);
+  }
+  if (argc >= 8 && napi_typeof(env, argv[7], &type) == napi_ok && type == napi_external) {
+    napi_get_value_external(env, argv[7], (void**)&batch->dict);
+  }
+  if (argc >= 9 && napi_typeof(env, argv[8], &type) == napi_ok && type == napi_external) {
+    napi_get_value_external(env, argv[8], (void**)&batch->audit);
+  }
+  return (validate ? REPLAY_VALIDATE : 0) | (evals ? REPLAY_EVALS : 0) | (motifs ? REPLAY_MOTIFS : 0) |
+         (minhash ? REPLAY_MINHASH : 0);
+}
+
+static napi_value replay_pgn_result(napi_env env, const ReplayBatch* batch) {
+  napi_value obj;
+  uint8_t* mismatch;
+  napi_create_object(env, &obj);
+  set_batch_arrays(env, obj, batch);
+  napi_set_named_property(env, obj, "mismatch", create_typed(env, napi_uint8_array, 1, batch->game_count, (void**)&mismatch));
+  for (size_t i = 0; i < batch->game_count; i++) mismatch[i] = (uint8_t)batch->games[i].mismatch;
+  if (batch->tablebase) {
+    int8_t* wdl;
+    napi_set_named_property(env, obj, "wdl", create_typed(env, napi_int8_array, 1, batch->game_count, (void**)&wdl));
+    for (size_t i = 0; i < batch->game_count; i++) wdl[i] = (int8_t)batch->games[i].wdl;
+  }
+  return obj;
+}
+
+/* replayPGN(input, validate, tablebase?, evals?, store?, motifs?, minhash?, dict?, audit?) */
+static napi_value ReplayPGN(napi_env env, napi_callback_info info) {
+  size_t argc = 9;
+  napi_value argv[9];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  const char* text;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[0], &text, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "replayPGN: input must be a string or Buffer");
+    return NULL;
+  }
+  ReplayBatch batch;
+  replay_batch_init(&batch);
+  int flags = replay_pgn_args(env, argc, argv, &batch);
+  bool ok = replay_pgn(text, len, flags, &batch);
+  bc_free(owned);
+  if (!ok) {
+    replay_batch_free(&batch);
+    napi_throw_error(env, NULL, "replayPGN: out of memory");
+    return NULL;
+  }
+  napi_value obj = replay_pgn_result(env, &batch);
+  replay_batch_free(&batch);
+  return obj;
+}
+
+typedef struct {
+  AsyncJob base;
+  const char* text;
+  size_t len;
+  char* owned;
+  int flags;
+  ReplayBatch batch;
+} ReplayPGNJob;
+
+static void replay_pgn_run(AsyncJob* a) {
+  ReplayPGNJob* j = (ReplayPGNJob*)a;
+  a->ok = replay_pgn(j->text, j->len, j->flags, &j->batch);
+}
+
+static napi_value replay_pgn_async_result(napi_env env, AsyncJob* a) {
+  return replay_pgn_result(env, &((ReplayPGNJob*)a)->batch);
+}
+
+static void replay_pgn_cleanup(AsyncJob* a) {
+  ReplayPGNJob* j = (ReplayPGNJob*)a;
+  replay_batch_free(&j->batch);
+  bc_free(j->owned);
+}
+
+/* replayPGNAsync(input, validate, tablebase?, evals?, store?, motifs?, minhash?, dict?, audit?,
+ * onProgress, interval) -> [promise, job]; progress counts input bytes */
+static napi_value ReplayPGNAsync(napi_env env, napi_callback_info info) {
+  size_t argc = 11;
+  napi_value argv[11];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 11) return NULL;
+  ReplayPGNJob* j = (ReplayPGNJob*)async_job_new(env, sizeof(ReplayPGNJob), "replayPGN");
+  if (!j) return NULL;
+  if (!get_bytes(env, argv[0], &j->text, &j->len, &j->owned)) {
+    bc_free(j);
+    napi_throw_type_error(env, NULL, "replayPGN: input must be a string or Buffer");
+    return NULL;
+  }
+  replay_batch_init(&j->batch);
+  j->flags = replay_pgn_args(env, argc, argv, &j->batch);
+  j->batch.job = &j->base.job;
+  async_job_hold(env, &j->base, argv[0]);
+  async_job_hold(env, &j->base, argv[2]);
+  async_job_hold(env, &j->base, argv[4]);
+  async_job_hold(env, &j->base, argv[7]);
+  async_job_hold(env, &j->base, argv[8]);
+  j->base.run = replay_pgn_run;
+  j->base.result = replay_pgn_async_result;
+  j->base.cleanup = replay_pgn_cleanup;
+  return async_job_start(env, &j->base, "replayPGN", argv[9], argv[10]);
+}
+
+static void pgn_stream_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  pgn_stream_free((PgnStream*)data);
+  bc_free(data);
+}
+
+/* replayStreamCreate(validate, positions) -> stream handle */
+static napi_value ReplayStreamCreate(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  bool validate = false, positions = false;
+  napi_get_value_bool(env, argv[0], &validate);
+  napi_get_value_bool(env, argv[1], &positions);
+  PgnStream* s = (PgnStream*)bc_malloc(sizeof(PgnStream));
+  if (!s) {
+    napi_throw_error(env, NULL, "createReplayStream: out of memory");
+    return NULL;
+  }
+  pgn_stream_init(s, (validate ? REPLAY_VALIDATE : 0) | (positions ? REPLAY_PACKED : 0));
+  napi_value external;
+  napi_create_external(env, s, pgn_stream_finalize, NULL, &external);
+  return external;
+}
+
+typedef struct {
+  AsyncJob base;
+  PgnStream* stream;
+  const char* text;
+  size_t len;
+  char* owned;
+  bool final;
+  size_t max_records;
+  uint8_t** batches; /* record batches written by run */
+  size_t* sizes;
+  size_t count;
+} StreamPushJob;
+
+/* Replay the games the chunk completes and write them out as record batches. */
+static void stream_push_run(AsyncJob* a) {
+  StreamPushJob* j = (StreamPushJob*)a;
+  PgnStream* s = j->stream;
+  s->batch.job = &a->job;
+  a->ok = pgn_stream_push(s, j->text, j->len, j->final);
+  s->batch.job = NULL;
+  /* A cancelled push leaves the stream part-way through the chunk: only destroy() cancels. */
+  if (job_cancelled(&a->job)) {
+    a->ok = false;
+    a->aborted = true;
+    return;
+  }
+  size_t games = s->batch.game_count;
+  if (!a->ok || !games) return;
+  j->batches = (uint8_t**)bc_calloc(games, sizeof(uint8_t*));
+  j->sizes = (size_t*)bc_calloc(games, sizeof(size_t));
+  a->ok = j->batches && j->sizes;
+  for (size_t g = 0; a->ok && g < games; j->count++) {
+    size_t to = pgn_stream_batch_end(s, g, j->max_records);
+    j->sizes[j->count] = pgn_stream_batch_size(s, g, to);
+    j->batches[j->count] = (uint8_t*)bc_malloc(j->sizes[j->count]);
+    if (!j->batches[j->count]) {
+      a->ok = false;
+      break;
+    }
+    pgn_stream_write_batch(s, g, to, j->batches[j->count]);
+    g = to;
+  }
+  pgn_stream_take(s);
+}
+
+static void free_batch_buffer(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  bc_free(data);
+}
+
+static napi_value stream_push_result(napi_env env, AsyncJob* a) {
+  StreamPushJob* j = (StreamPushJob*)a;
+  napi_value arr, obj;
+  napi_create_array_with_length(env, j->count, &arr);
+  for (size_t i = 0; i < j->count; i++) {
+    napi_value buf;
+    if (napi_create_external_buffer(env, j->sizes[i], j->batches[i], free_batch_buffer, NULL, &buf) == napi_ok) {
+      j->batches[i] = NULL;
+    } else {
+      napi_create_buffer_copy(env, j->sizes[i], j->batches[i], NULL, &buf);
+    }
+    napi_set_element(env, arr, (uint32_t)i, buf);
+  }
+  napi_create_object(env, &obj);
+  napi_set_named_property(env, obj, "batches", arr);
+  return obj;
+}
+
+static void stream_push_cleanup(AsyncJob* a) {
+  StreamPushJob* j = (StreamPushJob*)a;
+  for (size_t i = 0; j->batches && i < j->count; i++) bc_free(j->batches[i]);
+  bc_free(j->batches);
+  bc_free(j->sizes);
+  bc_free(j->owned);
+}
+
+/* replayStreamPush(handle, chunk, final, maxRecords) -> [promise, job] resolving { batches: [Buffer] };
+ * one push at a time per stream */
+static napi_value ReplayStreamPush(napi_env env, napi_callback_info info) {
+  size_t argc = 4;
+  napi_value argv[4];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 4) return NULL;
+  StreamPushJob* j = (StreamPushJob*)async_job_new(env, sizeof(StreamPushJob), "replayStream");
+  if (!j) return NULL;
+  double max_records = 0;
+  napi_get_value_external(env, argv[0], (void**)&j->stream);
+  napi_get_value_bool(env, argv[2], &j->final);
+  napi_get_value_double(env, argv[3], &max_records);
+  j->max_records = max_records >= 1 ? (size_t)max_records : 1;
+  if (!get_bytes(env, argv[1], &j->text, &j->len, &j->owned)) {
+    bc_free(j);
+    napi_throw_type_error(env, NULL, "replayStream: chunk must be a string or Buffer");
+    return NULL;
+  }
+  async_job_hold(env, &j->base, argv[0]);
+  async_job_hold(env, &j->base, argv[1]);
+  j->base.run = stream_push_run;
+  j->base.result = stream_push_result;
+  j->base.cleanup = stream_push_cleanup;
+  napi_value none;
+  napi_get_undefined(env, &none);
+  return async_job_start(env, &j->base, "replayStream", none, none);
+}
+
+/* NDJSON reader plus the option strings it points into. */
+typedef struct {
+  NdjsonReader reader;
+  char* names[NDJSON_MAX_FIELDS + 2];
+  int name_count;
+} NdjsonHandle;
+
+static void ndjson_handle_free(NdjsonHandle* h) {
+  ndjson_reader_free(&h->reader);
+  for (int i = 0; i < h->name_count; i++) bc_free(h->names[i]);
+  bc_free(h);
+}
+
+static void ndjson_handle_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  ndjson_handle_free((NdjsonHandle*)data);
+}
+
+static char* dup_js_string(napi_env env, napi_value v) {
+  size_t n;
+  if (napi_get_value_string_utf8(env, v, NULL, 0, &n) != napi_ok) return NULL;
+  char* s = (char*)bc_malloc(n + 1);
+  if (s) napi_get_value_string_utf8(env, v, s, n + 1, &n);
+  return s;
+}
+
+/* argv: fields (array of names), movesField, fenField (or null), validate, evals, store writer (or null), motifs,
+ * minhash, dictionary writer (or null), collision audit (or null) */
+static NdjsonHandle* ndjson_handle_create(napi_env env, napi_value* argv) {
+  NdjsonHandle* h = (NdjsonHandle*)bc_calloc(1, sizeof(NdjsonHandle));
+  const char* fields[NDJSON_MAX_FIELDS];
+  NdjsonOptions opts;
+  uint32_t count = 0;
+  bool validate = false;
+  bool evals = false;
+  bool motifs = false;
+  bool minhash = false;
+  napi_valuetype type;
+  if (!h) return NULL;
+  memset(&opts, 0, sizeof(opts));
+  napi_get_array_length(env, argv[0], &count);
+  if (count > NDJSON_MAX_FIELDS) count = NDJSON_MAX_FIELDS;
+  for (uint32_t i = 0; i < count; i++) {
+    napi_value v;
+    napi_get_element(env, argv[0], i, &v);
+    char* name = dup_js_string(env, v);
+    if (!name) break;
+    h->names[h->name_count++] = name;
+    fields[opts.field_count++] = name;
+  }
+  opts.fields = fields;
+  napi_typeof(env, argv[1], &type);
+  if (type == napi_string && (opts.moves_field = dup_js_string(env, argv[1])) != NULL) {
+    h->names[h->name_count++] = (char*)opts.moves_field;
+  }
+  napi_typeof(env, argv[2], &type);
+  if (type == napi_string && (opts.fen_field = dup_js_string(env, argv[2])) != NULL) {
+    h->names[h->name_count++] = (char*)opts.fen_field;
+  }
+  napi_get_value_bool(env, argv[3], &validate);
+  napi_get_value_bool(env, argv[4], &evals);
+  napi_get_value_bool(env, argv[6], &motifs);
+  napi_get_value_bool(env, argv[7], &minhash);
+  opts.flags = (validate ? REPLAY_VALIDATE : 0) | (evals ? REPLAY_EVALS : 0) | (motifs ? REPLAY_MOTIFS : 0) |
+               (minhash ? REPLAY_MINHASH : 0);
+  ndjson_reader_init(&h->reader, &opts);
+  napi_typeof(env, argv[5], &type);
+  if (type == napi_external) napi_get_value_external(env, argv[5], (void**)&h->reader.batch.store);
+  napi_typeof(env, argv[8], &type);
+  if (type == napi_external) napi_get_value_external(env, argv[8], (void**)&h->reader.batch.dict);
+  napi_typeof(env, argv[9], &type);
+  if (type == napi_external) napi_get_value_external(env, argv[9], (void**)&h->reader.batch.audit);
+  /* The reader keeps the pointer to fields; point it at the owned copies. */
+  h->reader.opts.fields = (const char* const*)h->names;
+  return h;
+}
+
+/* Batch arrays plus fields: { name: [value per game] } for the games read so far. */
+static napi_value ndjson_take_result(napi_env env, NdjsonReader* r) {
+  napi_value obj, fields;
+  int nf = r->opts.field_count;
+  size_t n = r->batch.game_count;
+  napi_create_object(env, &obj);
+  set_batch_arrays(env, obj, &r->batch);
+  napi_create_object(env, &fields);
+  for (int f = 0; f < nf; f++) {
+    napi_value arr;
+    napi_create_array_with_length(env, n, &arr);
+    for (size_t g = 0; g < n; g++) {
+      const NdjsonValue* v = &r->values[g * (size_t)nf + (size_t)f];
+      const char* text = r->strings + v->offset;
+      napi_value jv;
+      switch (v->type) {
+        case JSON_STRING:
+        case JSON_RAW: napi_create_string_utf8(env, text, v->len, &jv); break;
+        case JSON_NUMBER: napi_create_double(env, strtod(text, NULL), &jv); break;
+        case JSON_TRUE: napi_get_boolean(env, true, &jv); break;
+        case JSON_FALSE: napi_get_boolean(env, false, &jv); break;
+        case JSON_NULL: napi_get_null(env, &jv); break;
+        default: napi_get_undefined(env, &jv); break;
+      }
+      napi_set_element(env, arr, (uint32_t)g, jv);
+    }
+    napi_set_named_property(env, fields, r->opts.fields[f], arr);
+  }
+  napi_set_named_property(env, obj, "fields", fields);
+  ndjson_reader_take(r);
+  return obj;
+}
+
+/* ndjsonCreate(fields, movesField, fenField, validate, evals, store, motifs, minhash, dict, audit) -> reader handle */
+static napi_value NdjsonCreate(napi_env env, napi_callback_info info) {
+  size_t argc = 10;
+  napi_value argv[10];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 10) return NULL;
+  NdjsonHandle* h = ndjson_handle_create(env, argv);
+  if (!h) {
+    napi_throw_error(env, NULL, "ndjsonCreate: out of memory");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, h, ndjson_handle_finalize, NULL, &external);
+  return external;
+}
+
+/* ndjsonPush(handle, chunk, final) -> result for the lines completed by chunk */
+static napi_value NdjsonPush(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 3) return NULL;
+  NdjsonHandle* h;
+  napi_get_value_external(env, argv[0], (void**)&h);
+  bool final = false;
+  napi_get_value_bool(env, argv[2], &final);
+  const char* data;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[1], &data, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "NDJSON reader: chunk must be a string or Buffer");
+    return NULL;
+  }
+  bool ok = ndjson_reader_push(&h->reader, data, len, final);
+  bc_free(owned);
+  if (!ok) {
+    napi_throw_error(env, NULL, "NDJSON reader: out of memory");
+    return NULL;
+  }
+  return ndjson_take_result(env, &h->reader);
+}
+
+/* replayNDJSON(input, fields, movesField, fenField, validate, evals, store, motifs, minhash, dict, audit) */
+static napi_value ReplayNDJSON(napi_env env, napi_callback_info info) {
+  size_t argc = 11;
+  napi_value argv[11];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 11) return NULL;
+  const char* data;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[0], &data, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "replayNDJSON: input must be a string or Buffer");
+    return NULL;
+  }
+  NdjsonHandle* h = ndjson_handle_create(env, argv + 1);
+  bool ok = h && ndjson_reader_push(&h->reader, data, len, true);
+  bc_free(owned);
+  if (!ok) {
+    if (h) ndjson_handle_free(h);
+    napi_throw_error(env, NULL, "replayNDJSON: out of memory");
+    return NULL;
+  }
+  napi_value result = ndjson_take_result(env, &h->reader);
+  ndjson_handle_free(h);
+  return result;
+}
+
+/* replayNDJSONFile(path, fields, movesField, fenField, validate, evals, store, motifs, minhash, dict, audit) */
+static napi_value ReplayNDJSONFile(napi_env env, napi_callback_info info) {
+  size_t argc = 11;
+  napi_value argv[11];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 11) return NULL;
+  char* path = dup_js_string(env, argv[0]);
+  if (!path) {
+    napi_throw_type_error(env, NULL, "replayNDJSONFile: path must be a string");
+    return NULL;
+  }
+  NdjsonHandle* h = ndjson_handle_create(env, argv + 1);
+  bool ok = h && ndjson_replay_file(&h->reader, path);
+  if (!ok) {
+    char msg[512];
+    snprintf(msg, sizeof(msg), "replayNDJSONFile: cannot read %s", path);
+    bc_free(path);
+    if (h) ndjson_handle_free(h);
+    napi_throw_error(env, NULL, msg);
+    return NULL;
+  }
+  bc_free(path);
+  napi_value result = ndjson_take_result(env, &h->reader);
+  ndjson_handle_free(h);
+  return result;
+}
+
+typedef struct {
+  AsyncJob base;
+  char* path;
+  NdjsonHandle* h;
+  char msg[512];
+} NdjsonFileJob;
+
+static void ndjson_file_run(AsyncJob* a) {
+  NdjsonFileJob* j = (NdjsonFileJob*)a;
+  a->ok = ndjson_replay_file(&j->h->reader, j->path);
+  if (!a->ok) {
+    snprintf(j->msg, sizeof(j->msg), "replayNDJSONFile: cannot read %s", j->path);
+    a->error = j->msg;
+  }
+}
+
+static napi_value ndjson_file_result(napi_env env, AsyncJob* a) {
+  return ndjson_take_result(env, &((NdjsonFileJob*)a)->h->reader);
+}
+
+static void ndjson_file_cleanup(AsyncJob* a) {
+  NdjsonFileJob* j = (NdjsonFileJob*)a;
+  ndjson_handle_free(j->h);
+  bc_free(j->path);
+}
+
+/* replayNDJSONFileAsync(path, fields, movesField, fenField, validate, evals, store, motifs, minhash,
+ * dict, audit, onProgress, interval) -> [promise, job]; progress counts file bytes */
+static napi_value ReplayNDJSONFileAsync(napi_env env, napi_callback_info info) {
+  size_t argc = 13;
+  napi_value argv[13];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 13) return NULL;
+  NdjsonFileJob* j = (NdjsonFileJob*)async_job_new(env, sizeof(NdjsonFileJob), "replayNDJSONFile");
+  if (!j) return NULL;
+  j->path = dup_js_string(env, argv[0]);
+  if (!j->path) {
+    bc_free(j);
+    napi_throw_type_error(env, NULL, "replayNDJSONFile: path must be a string");
+    return NULL;
+  }
+  j->h = ndjson_handle_create(env, argv + 1);
+  if (!j->h) {
+    bc_free(j->path);
+    bc_free(j);
+    napi_throw_error(env, NULL, "replayNDJSONFile: out of memory");
+    return NULL;
+  }
+  j->h->reader.batch.job = &j->base.job;
+  async_job_hold(env, &j->base, argv[6]);
+  async_job_hold(env, &j->base, argv[9]);
+  async_job_hold(env, &j->base, argv[10]);
+  j->base.run = ndjson_file_run;
+  j->base.result = ndjson_file_result;
+  j->base.cleanup = ndjson_file_cleanup;
+  return async_job_start(env, &j->base, "replayNDJSONFile", argv[11], argv[12]);
+}
+
+/* replayPuzzles(input, validate, threads) */
+static napi_value ReplayPuzzles(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 3) return NULL;
+  bool validate = false;
+  int32_t threads = 0;
+  napi_get_value_bool(env, argv[1], &validate);
+  napi_get_value_int32(env, argv[2], &threads);
+  const char* text;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[0], &text, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "replayPuzzles: input must be a string or Buffer");
+    return NULL;
+  }
+  PuzzleBatch batch;
+  if (!puzzle_replay_csv(text, len, validate ? REPLAY_VALIDATE : 0, threads, &batch)) {
+    bc_free(owned);
+    napi_throw_error(env, NULL, "replayPuzzles: out of memory");
+    return NULL;
+  }
+  size_t n = batch.row_count;
+  uint32_t* offsets;
+  uint8_t* status;
+  int32_t* ratings;
+  napi_value obj, v_rows, ids, fens;
+  napi_create_object(env, &obj);
+  napi_create_uint32(env, (uint32_t)n, &v_rows);
+  napi_set_named_property(env, obj, "rows", v_rows);
+  napi_set_named_property(env, obj, "keys", keys_to_bigint64_array(env, batch.keys, batch.key_count));
+  napi_set_named_property(env, obj, "offsets", create_typed(env, napi_uint32_array, 4, n + 1, (void**)&offsets));
+  napi_set_named_property(env, obj, "status", create_typed(env, napi_uint8_array, 1, n, (void**)&status));
+  napi_set_named_property(env, obj, "ratings", create_typed(env, napi_int32_array, 4, n, (void**)&ratings));
+  napi_create_array_with_length(env, n, &ids);
+  napi_create_array_with_length(env, n, &fens);
+  for (size_t i = 0; i < n; i++) {
+    const PuzzleRow* row = &batch.rows[i];
+    napi_value v;
+    offsets[i] = (uint32_t)row->first_key;
+    status[i] = (uint8_t)row->status;
+    ratings[i] = row->rating;
+    napi_create_string_utf8(env, text + row->id_offset, row->id_len, &v);
+    napi_set_element(env, ids, (uint32_t)i, v);
+    napi_create_string_utf8(env, batch.fens + row->fen_offset, row->fen_len, &v);
+    napi_set_element(env, fens, (uint32_t)i, v);
+  }
+  offsets[n] = (uint32_t)batch.key_count;
+  napi_set_named_property(env, obj, "ids", ids);
+  napi_set_named_property(env, obj, "fens", fens);
+  puzzle_batch_free(&batch);
+  bc_free(owned);
+  return obj;
+}
+
+/* Element i of a JS array as an int (0 when missing). */
+static int32_t element_int(napi_env env, napi_value arr, uint32_t i) {
+  napi_value v;
+  int32_t x = 0;
+  if (napi_get_element(env, arr, i, &v) == napi_ok) napi_get_value_int32(env, v, &x);
+  return x;
+}
+
+/* Element i of a JS array as a string into out[size] ("" when missing). */
+static void element_string(napi_env env, napi_value arr, uint32_t i, char* out, size_t size) {
+  napi_value v;
+  size_t n;
+  out[0] = '\0';
+  if (napi_get_element(env, arr, i, &v) == napi_ok) napi_get_value_string_utf8(env, v, out, size, &n);
+}
+
+/* keys, aggs, validate and threads of groupPGN (argv[1..4]) into spec; false after throwing. */
+static bool group_spec_args(napi_env env, napi_value* argv, GroupSpec* spec) {
+  uint32_t nkeys = 0, naggs = 0;
+  bool validate = false;
+  memset(spec, 0, sizeof(*spec));
+  if (napi_get_array_length(env, argv[1], &nkeys) != napi_ok || napi_get_array_length(env, argv[2], &naggs) != napi_ok ||
+      nkeys > GROUP_MAX_KEYS || naggs > GROUP_MAX_AGGS) {
+    napi_throw_range_error(env, NULL, "groupPGN: at most 8 keys and 16 aggregators");
+    return false;
+  }
+  for (uint32_t i = 0; i < nkeys; i++) {
+    napi_value k;
+    napi_get_element(env, argv[1], i, &k);
+    element_string(env, k, 0, spec->keys[i].tag, GROUP_TAG_MAX);
+    spec->keys[i].bucket = element_int(env, k, 1);
+    spec->keys[i].width = element_int(env, k, 2);
+  }
+  for (uint32_t i = 0; i < naggs; i++) {
+    napi_value a;
+    napi_get_element(env, argv[2], i, &a);
+    spec->aggs[i].kind = element_int(env, a, 0);
+    spec->aggs[i].value = element_int(env, a, 1);
+    element_string(env, a, 2, spec->aggs[i].tag, GROUP_TAG_MAX);
+    spec->aggs[i].k = element_int(env, a, 3);
+  }
+  spec->key_count = (int)nkeys;
+  spec->agg_count = (int)naggs;
+  napi_get_value_bool(env, argv[3], &validate);
+  napi_get_value_int32(env, argv[4], &spec->threads);
+  spec->flags = validate ? REPLAY_VALIDATE : 0;
+  return true;
+}
+
+static napi_value group_result(napi_env env, const GroupTable* t, const GroupSpec* spec) {
+  uint32_t nkeys = (uint32_t)spec->key_count, naggs = (uint32_t)spec->agg_count;
+  size_t n = group_count(t);
+  napi_value obj, v, keys, values;
+  napi_create_object(env, &obj);
+  napi_create_uint32(env, (uint32_t)n, &v);
+  napi_set_named_property(env, obj, "groups", v);
+  napi_create_array_with_length(env, n, &keys);
+  for (size_t i = 0; i < n; i++) {
+    napi_value row;
+    napi_create_array_with_length(env, nkeys, &row);
+    for (uint32_t j = 0; j < nkeys; j++) {
+      size_t klen;
+      const char* k = group_key(t, i, (int)j, &klen);
+      napi_create_string_utf8(env, k, klen, &v);
+      napi_set_element(env, row, j, v);
+    }
+    napi_set_element(env, keys, (uint32_t)i, row);
+  }
+  napi_set_named_property(env, obj, "keys", keys);
+  napi_create_array_with_length(env, naggs, &values);
+  for (uint32_t a = 0; a < naggs; a++) {
+    napi_value col;
+    if (spec->aggs[a].kind == GROUP_AGG_TOP_FIRST) {
+      napi_create_array_with_length(env, n, &col);
+      for (size_t i = 0; i < n; i++) {
+        const GroupMoveCount* moves;
+        int m = group_top_moves(t, i, (int)a, &moves);
+        napi_value list;
+        napi_create_array_with_length(env, (size_t)m, &list);
+        for (int j = 0; j < m; j++) {
+          napi_value pair, mv, count;
+          napi_create_array_with_length(env, 2, &pair);
+          napi_create_string_utf8(env, moves[j].move, NAPI_AUTO_LENGTH, &mv);
+          napi_create_double(env, (double)moves[j].count, &count);
+          napi_set_element(env, pair, 0, mv);
+          napi_set_element(env, pair, 1, count);
+          napi_set_element(env, list, (uint32_t)j, pair);
+        }
+        napi_set_element(env, col, (uint32_t)i, list);
+      }
+    } else {
+      double* out;
+      col = create_typed(env, napi_float64_array, sizeof(double), n, (void**)&out);
+      for (size_t i = 0; i < n; i++) {
+        if (!group_value(t, i, (int)a, &out[i])) out[i] = NAN;
+      }
+    }
+    napi_set_element(env, values, a, col);
+  }
+  napi_set_named_property(env, obj, "values", values);
+  return obj;
+}
+
+/* groupPGN(input, keys: [[tag, bucket, width]], aggs: [[kind, value, tag, k]], validate, threads)
+ * -> { groups, keys: [[value per key] per group], values: [Float64Array | [[move, count]] per agg] } */
+static napi_value GroupPGN(napi_env env, napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 5) return NULL;
+  GroupSpec spec;
+  if (!group_spec_args(env, argv, &spec)) return NULL;
+  const char* text;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[0], &text, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "groupPGN: input must be a string or Buffer");
+    return NULL;
+  }
+  GroupTable* t = group_pgn(text, len, &spec);
+  bc_free(owned);
+  if (!t) {
+    napi_throw_error(env, NULL, "groupPGN: out of memory");
+    return NULL;
+  }
+  napi_value obj = group_result(env, t, &spec);
+  group_table_free(t);
+  return obj;
+}
+
+typedef struct {
+  AsyncJob base;
+  const char* text;
+  size_t len;
+  char* owned;
+  GroupSpec spec;
+  GroupTable* table;
+} GroupPGNJob;
+
+static void group_pgn_run(AsyncJob* a) {
+  GroupPGNJob* j = (GroupPGNJob*)a;
+  j->table = group_pgn(j->text, j->len, &j->spec);
+  a->ok = j->table != NULL;
+}
+
+static napi_value group_pgn_async_result(napi_env env, AsyncJob* a) {
+  GroupPGNJob* j = (GroupPGNJob*)a;
+  return group_result(env, j->table, &j->spec);
+}
+
+static void group_pgn_cleanup(AsyncJob* a) {
+  GroupPGNJob* j = (GroupPGNJob*)a;
+  if (j->table) group_table_free(j->table);
+  bc_free(j->owned);
+}
+
+/* groupPGNAsync(input, keys, aggs, validate, threads, onProgress, interval) -> [promise, job];
+ * progress counts input bytes */
+static napi_value GroupPGNAsync(napi_env env, napi_callback_info info) {
+  size_t argc = 7;
+  napi_value argv[7];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 7) return NULL;
+  GroupPGNJob* j = (GroupPGNJob*)async_job_new(env, sizeof(GroupPGNJob), "groupPGN");
+  if (!j) return NULL;
+  if (!group_spec_args(env, argv, &j->spec)) {
+    bc_free(j);
+    return NULL;
+  }
+  if (!get_bytes(env, argv[0], &j->text, &j->len, &j->owned)) {
+    bc_free(j);
+    napi_throw_type_error(env, NULL, "groupPGN: input must be a string or Buffer");
+    return NULL;
+  }
+  j->spec.job = &j->base.job;
+  async_job_hold(env, &j->base, argv[0]);
+  j->base.run = group_pgn_run;
+  j->base.result = group_pgn_async_result;
+  j->base.cleanup = group_pgn_cleanup;
+  return async_job_start(env, &j->base, "groupPGN", argv[5], argv[6]);
+}
+
+/* checkFENs(input, threads) -> Uint8Array of FEN_* codes, one per line */
+static napi_value CheckFENs(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  int32_t threads = 0;
+  napi_get_value_int32(env, argv[1], &threads);
+  const char* text;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[0], &text, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "checkFENs: input must be a string or Buffer");
+    return NULL;
+  }
+  uint8_t* status;
+  napi_value result = create_typed(env, napi_uint8_array, 1, fen_line_count(text, len), (void**)&status);
+  bool ok = fen_check_lines(text, len, threads, status);
+  bc_free(owned);
+  if (!ok) {
+    napi_throw_error(env, NULL, "checkFENs: out of memory");
+    return NULL;
+  }
+  return result;
+}
+
+/* checkFEN(fen) -> FEN_* code */
+static napi_value CheckFEN(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  const char* text;
+  size_t len;
+  char* owned;
+  if (!get_bytes(env, argv[0], &text, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "checkFEN: fen must be a string or Buffer");
+    return NULL;
+  }
+  board_init_tables();
+  napi_value result;
+  napi_create_int32(env, fen_check(text, len), &result);
+  bc_free(owned);
+  return result;
+}
+
+static void sim_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  sim_destroy((SimIndex*)data);
+}
+
+/* simCreate() -> similarity index handle */
+static napi_value SimCreate(napi_env env, napi_callback_info info) {
+  (void)info;
+  SimIndex* idx = sim_create();
+  if (!idx) {
+    napi_throw_error(env, NULL, "simCreate: out of memory");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, idx, sim_finalize, NULL, &external);
+  return external;
+}
+
+/* The twelve bitboards of a board handle, a FEN string or a BigUint64Array(12). */
+static bool sim_position_arg(napi_env env, napi_value v, u64 sets[12]) {
+  napi_valuetype type = napi_undefined;
+  bool is_typed = false;
+  napi_typeof(env, v, &type);
+  napi_is_typedarray(env, v, &is_typed);
+  if (is_typed) {
+    napi_typedarray_type kind;
+    size_t length, offset;
+    napi_value ab;
+    void* data;
+    napi_get_typedarray_info(env, v, &kind, &length, &data, &ab, &offset);
+    if ((kind != napi_biguint64_array && kind != napi_bigint64_array) || length != 12) return false;
+    memcpy(sets, data, 12 * sizeof(u64));
+    return true;
+  }
+  if (type == napi_external) {
+    Board* b;
+    napi_get_value_external(env, v, (void**)&b);
+    board_piece_sets(b, sets);
+    return true;
+  }
+  if (type != napi_string) return false;
+  char fen[FEN_MAX];
+  size_t n;
+  Board b;
+  napi_get_value_string_utf8(env, v, fen, sizeof(fen), &n);
+  board_reset(&b);
+  board_load_fen(&b, fen);
+  board_piece_sets(&b, sets);
+  return true;
+}
+
+/* simAdd(handle, position) -> id */
+static napi_value SimAdd(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  SimIndex* idx;
+  u64 sets[12];
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  if (!sim_position_arg(env, argv[1], sets)) {
+    napi_throw_type_error(env, NULL, "simAdd: position must be a board, a FEN string or a BigUint64Array(12)");
+    return NULL;
+  }
+  size_t id = sim_size(idx);
+  if (!sim_add(idx, sets, 1)) {
+    napi_throw_error(env, NULL, "simAdd: out of memory");
+    return NULL;
+  }
+  napi_value result;
+  napi_create_double(env, (double)id, &result);
+  return result;
+}
+
+/* simAddFENs(handle, input) -> positions added, one per non-blank line */
+static napi_value SimAddFENs(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  SimIndex* idx;
+  const char* text;
+  size_t len;
+  char* owned;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  if (!get_bytes(env, argv[1], &text, &len, &owned)) {
+    napi_throw_type_error(env, NULL, "simAddFENs: input must be a string or Buffer");
+    return NULL;
+  }
+  size_t lines = fen_line_count(text, len), count = 0;
+  u64* sets = (u64*)bc_malloc((lines ? lines : 1) * 12 * sizeof(u64));
+  bool ok = sets != NULL;
+  Board b;
+  char fen[FEN_MAX];
+  for (const char* p = text; ok && p < text + len;) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(text + len - p));
+    const char* end = nl ? nl : text + len;
+    size_t n = (size_t)(end - p);
+    while (n && (p[n - 1] == '\r' || p[n - 1] == ' ' || p[n - 1] == '\t')) n--;
+    if (n) {
+      if (n >= FEN_MAX) n = FEN_MAX - 1;
+      memcpy(fen, p, n);
+      fen[n] = '\0';
+      board_reset(&b);
+      board_load_fen(&b, fen);
+      board_piece_sets(&b, sets + 12 * count++);
+    }
+    p = end + 1;
+  }
+  ok = ok && sim_add(idx, sets, count);
+  bc_free(sets);
+  bc_free(owned);
+  if (!ok) {
+    napi_throw_error(env, NULL, "simAddFENs: out of memory");
+    return NULL;
+  }
+  napi_value result;
+  napi_create_double(env, (double)count, &result);
+  return result;
+}
+
+/* simAddPositions(handle, BigUint64Array of 12 bitboards per position) -> positions added */
+static napi_value SimAddPositions(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  SimIndex* idx;
+  napi_typedarray_type type;
+  size_t length, offset;
+  napi_value ab;
+  void* data;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  if (napi_get_typedarray_info(env, argv[1], &type, &length, &data, &ab, &offset) != napi_ok ||
+      (type != napi_biguint64_array && type != napi_bigint64_array) || length % 12) {
+    napi_throw_type_error(env, NULL, "simAddPositions: expected a BigUint64Array of 12 bitboards per position");
+    return NULL;
+  }
+  if (!sim_add(idx, (const u64*)data, length / 12)) {
+    napi_throw_error(env, NULL, "simAddPositions: out of memory");
+    return NULL;
+  }
+  napi_value result;
+  napi_create_double(env, (double)(length / 12), &result);
+  return result;
+}
+
+/* simSize(handle) -> positions in the index */
+static napi_value SimSize(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  SimIndex* idx;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  napi_value result;
+  napi_create_double(env, (double)sim_size(idx), &result);
+  return result;
+}
+
+/* simQuery(handle, position, k, approximate, threads, maxBucket)
+ *   -> { ids, distances, candidates, skipped, scanned, exact } */
+static napi_value SimQuery(napi_env env, napi_callback_info info) {
+  size_t argc = 6;
+  napi_value argv[6];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 6) return NULL;
+  SimIndex* idx;
+  u64 query[12];
+  int32_t k = 10, threads = 0;
+  double max_bucket = 0;
+  bool approximate = false;
+  SimOptions opts;
+  SimStats stats;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  if (!sim_position_arg(env, argv[1], query)) {
+    napi_throw_type_error(env, NULL, "simQuery: position must be a board, a FEN string or a BigUint64Array(12)");
+    return NULL;
+  }
+  napi_get_value_int32(env, argv[2], &k);
+  napi_get_value_bool(env, argv[3], &approximate);
+  napi_get_value_int32(env, argv[4], &threads);
+  napi_get_value_double(env, argv[5], &max_bucket);
+  memset(&opts, 0, sizeof(opts));
+  opts.k = k > 0 ? k : 0;
+  opts.approximate = approximate;
+  opts.threads = threads;
+  opts.max_bucket = max_bucket > 0 ? (size_t)max_bucket : 0;
+
+  size_t cap = (size_t)opts.k < sim_size(idx) ? (size_t)opts.k : sim_size(idx);
+  uint32_t* ids = (uint32_t*)bc_malloc((cap ? cap : 1) * sizeof(uint32_t));
+  uint16_t* dist = (uint16_t*)bc_malloc((cap ? cap : 1) * sizeof(uint16_t));
+  int count = ids && dist ? sim_query(idx, query, &opts, ids, dist, &stats) : -1;
+  if (count < 0) {
+    bc_free(ids);
+    bc_free(dist);
+    napi_throw_error(env, NULL, "simQuery: out of memory");
+    return NULL;
+  }
+  napi_value obj, v;
+  void* data;
+  napi_create_object(env, &obj);
+  v = create_typed(env, napi_uint32_array, sizeof(uint32_t), (size_t)count, &data);
+  if (count) memcpy(data, ids, (size_t)count * sizeof(uint32_t));
+  napi_set_named_property(env, obj, "ids", v);
+  v = create_typed(env, napi_uint16_array, sizeof(uint16_t), (size_t)count, &data);
+  if (count) memcpy(data, dist, (size_t)count * sizeof(uint16_t));
+  napi_set_named_property(env, obj, "distances", v);
+  napi_create_double(env, (double)stats.candidates, &v);
+  napi_set_named_property(env, obj, "candidates", v);
+  napi_create_int32(env, stats.skipped, &v);
+  napi_set_named_property(env, obj, "skipped", v);
+  napi_get_boolean(env, stats.scanned, &v);
+  napi_set_named_property(env, obj, "scanned", v);
+  napi_get_boolean(env, stats.exact, &v);
+  napi_set_named_property(env, obj, "exact", v);
+  bc_free(ids);
+  bc_free(dist);
+  return obj;
+}
+
+static void lsh_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  lsh_destroy((LshIndex*)data);
+}
+
+/* Borrow a Uint32Array whose length is a multiple of MINHASH_SIZE. */
+static bool signatures_arg(napi_env env, napi_value v, const uint32_t** sigs, size_t* count) {
+  napi_typedarray_type type;
+  size_t length, offset;
+  napi_value ab;
+  void* data;
+  if (napi_get_typedarray_info(env, v, &type, &length, &data, &ab, &offset) != napi_ok || type != napi_uint32_array ||
+      length % MINHASH_SIZE) {
+    return false;
+  }
+  *sigs = (const uint32_t*)data;
+  *count = length / MINHASH_SIZE;
+  return true;
+}
+
+/* minhashSign(keys: BigUint64Array) -> Uint32Array(MINHASH_SIZE) */
+static napi_value MinhashSign(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  napi_typedarray_type type;
+  size_t length, offset;
+  napi_value ab;
+  void* data;
+  if (napi_get_typedarray_info(env, argv[0], &type, &length, &data, &ab, &offset) != napi_ok ||
+      (type != napi_biguint64_array && type != napi_bigint64_array)) {
+    napi_throw_type_error(env, NULL, "minhashSign: keys must be a BigUint64Array");
+    return NULL;
+  }
+  uint32_t* sig;
+  napi_value result = create_typed(env, napi_uint32_array, 4, MINHASH_SIZE, (void**)&sig);
+  minhash_sign((const uint64_t*)data, length, sig);
+  return result;
+}
+
+/* minhashJaccard(a, b) -> estimate from two signatures */
+static napi_value MinhashJaccard(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  const uint32_t *a, *b;
+  size_t na, nb;
+  if (!signatures_arg(env, argv[0], &a, &na) || !signatures_arg(env, argv[1], &b, &nb) || na != 1 || nb != 1) {
+    napi_throw_type_error(env, NULL, "minhashJaccard: expected two Uint32Array signatures");
+    return NULL;
+  }
+  napi_value result;
+  napi_create_double(env, minhash_jaccard(a, b), &result);
+  return result;
+}
+
+/* lshCreate(bands) -> LSH index handle */
+static napi_value LshCreate(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  int32_t bands = 0;
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc >= 1) napi_get_value_int32(env, argv[0], &bands);
+  if (bands > MINHASH_SIZE || (bands > 0 && MINHASH_SIZE % bands)) {
+    napi_throw_range_error(env, NULL, "lshCreate: bands must divide 64");
+    return NULL;
+  }
+  LshIndex* idx = lsh_create(bands);
+  if (!idx) {
+    napi_throw_error(env, NULL, "lshCreate: out of memory");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, idx, lsh_finalize, NULL, &external);
+  return external;
+}
+
+/* lshAdd(handle, signatures: Uint32Array) -> games added */
+static napi_value LshAdd(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  LshIndex* idx;
+  const uint32_t* sigs;
+  size_t count;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  if (!signatures_arg(env, argv[1], &sigs, &count)) {
+    napi_throw_type_error(env, NULL, "lshAdd: expected a Uint32Array of 64 slots per game");
+    return NULL;
+  }
+  if (!lsh_add(idx, sigs, count)) {
+    napi_throw_error(env, NULL, "lshAdd: out of memory");
+    return NULL;
+  }
+  napi_value result;
+  napi_create_double(env, (double)count, &result);
+  return result;
+}
+
+/* lshSize(handle) -> games in the index */
+static napi_value LshSize(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  LshIndex* idx;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  napi_value result;
+  napi_create_double(env, (double)lsh_size(idx), &result);
+  return result;
+}
+
+/* lshQuery(handle, signature or game id, k, minJaccard, maxBucket) -> { ids, jaccard, candidates, skipped } */
+static napi_value LshQuery(napi_env env, napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 5) return NULL;
+  LshIndex* idx;
+  const uint32_t* sig;
+  size_t n;
+  int32_t k = 10;
+  double min_jaccard = 0, max_bucket = 0, id = -1;
+  LshOptions opts;
+  LshStats stats;
+  napi_get_value_external(env, argv[0], (void**)&idx);
+  if (napi_get_value_double(env, argv[1], &id) == napi_ok) {
+    if (id < 0 || id >= (double)lsh_size(idx)) {
+      napi_throw_range_error(env, NULL, "lshQuery: no such game");
+      return NULL;
+    }
+    sig = lsh_signature(idx, (uint32_t)id);
+  } else if (!signatures_arg(env, argv[1], &sig, &n) || n != 1) {
+    napi_throw_type_error(env, NULL, "lshQuery: expected a game id or a Uint32Array signature");
+    return NULL;
+  }
+  napi_get_value_int32(env, argv[2], &k);
+  napi_get_value_double(env, argv[3], &min_jaccard);
+  napi_get_value_double(env, argv[4], &max_bucket);
+  memset(&opts, 0, sizeof(opts));
+  opts.k = k > 0 ? k : 0;
+  opts.min_jaccard = min_jaccard;
+  opts.max_bucket = max_bucket > 0 ? (size_t)max_bucket : 0;
+
+  uint32_t* ids = (uint32_t*)bc_malloc((opts.k ? (size_t)opts.k : 1) * sizeof(uint32_t));
+  float* jaccard = (float*)bc_malloc((opts.k ? (size_t)opts.k : 1) * sizeof(float));
+  int count = ids && jaccard ? lsh_query(idx, sig, &opts, ids, jaccard, &stats) : -1;
+  if (count < 0) {
+    bc_free(ids);
+    bc_free(jaccard);
+    napi_throw_error(env, NULL, "lshQuery: out of memory");
+    return NULL;
+  }
+  napi_value obj, v;
+  void* data;
+  napi_create_object(env, &obj);
+  v = create_typed(env, napi_uint32_array, sizeof(uint32_t), (size_t)count, &data);
+  if (count) memcpy(data, ids, (size_t)count * sizeof(uint32_t));
+  napi_set_named_property(env, obj, "ids", v);
+  v = create_typed(env, napi_float32_array, sizeof(float), (size_t)count, &data);
+  if (count) memcpy(data, jaccard, (size_t)count * sizeof(float));
+  napi_set_named_property(env, obj, "jaccard", v);
+  napi_create_double(env, (double)stats.candidates, &v);
+  napi_set_named_property(env, obj, "candidates", v);
+  napi_create_int32(env, stats.skipped, &v);
+  napi_set_named_property(env, obj, "skipped", v);
+  bc_free(ids);
+  bc_free(jaccard);
+  return obj;
+}
+
+/* Index build run off the main thread: sim_build or lsh_build. */
+typedef struct {
+  AsyncJob base;
+  void* index;
+  bool (*build)(void* index, Job* job);
+} IndexBuildJob;
+
+static bool sim_build_thunk(void* index, Job* job) {
+  return sim_build((SimIndex*)index, job);
+}
+
+static bool lsh_build_thunk(void* index, Job* job) {
+  return lsh_build((LshIndex*)index, job);
+}
+
+static void index_build_run(AsyncJob* a) {
+  IndexBuildJob* j = (IndexBuildJob*)a;
+  a->ok = j->build(j->index, &a->job);
+  a->aborted = !a->ok && job_cancelled(&a->job);
+}
+
+static napi_value index_build_result(napi_env env, AsyncJob* a) {
+  (void)a;
+  napi_value obj;
+  napi_create_object(env, &obj);
+  return obj;
+}
+
+static void index_build_cleanup(AsyncJob* a) {
+  (void)a;
+}
+
+static napi_value start_index_build(napi_env env, napi_callback_info info, const char* name,
+                                    bool (*build)(void*, Job*)) {
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 3) return NULL;
+  IndexBuildJob* j = (IndexBuildJob*)async_job_new(env, sizeof(IndexBuildJob), name);
+  if (!j) return NULL;
+  napi_get_value_external(env, argv[0], &j->index);
+  j->build = build;
+  async_job_hold(env, &j->base, argv[0]);
+  j->base.run = index_build_run;
+  j->base.result = index_build_result;
+  j->base.cleanup = index_build_cleanup;
+  return async_job_start(env, &j->base, name, argv[1], argv[2]);
+}
+
+/* simBuildAsync(handle, onProgress, interval) -> [promise, job]; progress counts positions times ranks */
+static napi_value SimBuildAsync(napi_env env, napi_callback_info info) {
+  return start_index_build(env, info, "SimilarityIndex.build", sim_build_thunk);
+}
+
+/* lshBuildAsync(handle, onProgress, interval) -> [promise, job]; progress counts games times bands */
+static napi_value LshBuildAsync(napi_env env, napi_callback_info info) {
+  return start_index_build(env, info, "MinHashIndex.build", lsh_build_thunk);
+}
+
+static void store_writer_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  store_writer_destroy((StoreWriter*)data);
+}
+
+/* storeWriterCreate() -> writer handle for replayPGN / replayNDJSON */
+static napi_value StoreWriterCreate(napi_env env, napi_callback_info info) {
+  (void)info;
+  StoreWriter* w = store_writer_create();
+  if (!w) {
+    napi_throw_error(env, NULL, "storeWriterCreate: out of memory");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, w, store_writer_finalize, NULL, &external);
+  return external;
+}
+
+static napi_value store_counts(napi_env env, double positions, double games) {
+  napi_value obj, v;
+  napi_create_object(env, &obj);
+  napi_create_double(env, positions, &v);
+  napi_set_named_property(env, obj, "positions", v);
+  napi_create_double(env, games, &v);
+  napi_set_named_property(env, obj, "games", v);
+  return obj;
+}
+
+/* storeWriterCounts(writer) -> { positions, games } added so far */
+static napi_value StoreWriterCounts(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  StoreWriter* w;
+  napi_get_value_external(env, argv[0], (void**)&w);
+  return store_counts(env, (double)store_writer_positions(w), (double)store_writer_games(w));
+}
+
+/* storeWriterFinish(writer, path) -> bool */
+static napi_value StoreWriterFinish(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  StoreWriter* w;
+  napi_get_value_external(env, argv[0], (void**)&w);
+  char* path = dup_js_string(env, argv[1]);
+  if (!path) {
+    napi_throw_type_error(env, NULL, "storeWriterFinish: path must be a string");
+    return NULL;
+  }
+  napi_value result;
+  napi_get_boolean(env, store_writer_finish(w, path), &result);
+  bc_free(path);
+  return result;
+}
+
+static void store_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  store_close((PositionStore*)data);
+}
+
+/* storeOpen(path) -> store handle, or null when missing or not a store */
+static napi_value StoreOpen(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  char* path = dup_js_string(env, argv[0]);
+  if (!path) {
+    napi_throw_type_error(env, NULL, "storeOpen: path must be a string");
+    return NULL;
+  }
+  PositionStore* s = store_open(path);
+  bc_free(path);
+  napi_value result;
+  if (!s) {
+    napi_get_null(env, &result);
+    return result;
+  }
+  napi_create_external(env, s, store_finalize, NULL, &result);
+  return result;
+}
+
+/* storeCounts(store) -> { positions, games } */
+static napi_value StoreCounts(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  PositionStore* s;
+  napi_get_value_external(env, argv[0], (void**)&s);
+  return store_counts(env, (double)store_size(s), (double)store_games(s));
+}
+
+/* storeGet(store, index) -> { game, ply, turn, castling, sets: BigUint64Array(12) } */
+static napi_value StoreGet(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  PositionStore* s;
+  double index = -1;
+  napi_get_value_external(env, argv[0], (void**)&s);
+  napi_get_value_double(env, argv[1], &index);
+  if (!(index >= 0 && index < (double)store_size(s))) {
+    napi_throw_range_error(env, NULL, "storeGet: index out of range");
+    return NULL;
+  }
+  u64 sets[12];
+  uint32_t game, ply;
+  uint8_t flags;
+  char castling[5];
+  int n = 0;
+  store_get(s, (size_t)index, sets, &game, &ply, &flags);
+  if (flags & STORE_FLAG_CASTLE_K) castling[n++] = 'K';
+  if (flags & STORE_FLAG_CASTLE_Q) castling[n++] = 'Q';
+  if (flags & STORE_FLAG_CASTLE_k) castling[n++] = 'k';
+  if (flags & STORE_FLAG_CASTLE_q) castling[n++] = 'q';
+  if (!n) castling[n++] = '-';
+  napi_value obj, v;
+  napi_create_object(env, &obj);
+  napi_create_uint32(env, game, &v);
+  napi_set_named_property(env, obj, "game", v);
+  napi_create_uint32(env, ply, &v);
+  napi_set_named_property(env, obj, "ply", v);
+  napi_create_string_utf8(env, flags & STORE_FLAG_BLACK ? "b" : "w", 1, &v);
+  napi_set_named_property(env, obj, "turn", v);
+  napi_create_string_utf8(env, castling, (size_t)n, &v);
+  napi_set_named_property(env, obj, "castling", v);
+  napi_set_named_property(env, obj, "sets", keys_to_bigint64_array(env, sets, 12));
+  return obj;
+}
+
+/* storeQuery(store, query, threads) -> { positions: Uint32Array, games: Uint32Array, plies: Uint16Array } */
+static napi_value StoreQueryFn(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 3) return NULL;
+  PositionStore* s;
+  int32_t threads = 0;
+  napi_get_value_external(env, argv[0], (void**)&s);
+  napi_get_value_int32(env, argv[2], &threads);
+  char* text = dup_js_string(env, argv[1]);
+  if (!text) {
+    napi_throw_type_error(env, NULL, "storeQuery: query must be a string");
+    return NULL;
+  }
+  StoreQuery q;
+  size_t err_at = 0;
+  if (!store_compile(text, strlen(text), &q, &err_at)) {
+    char msg[256];
+    size_t n = strcspn(text + err_at, " \t\r\n");
+    snprintf(msg, sizeof(msg), "storeQuery: bad term at offset %zu: %.*s", err_at, (int)(n > 64 ? 64 : n), text + err_at);
+    bc_free(text);
+    napi_throw_error(env, "ERR_QUERY_SYNTAX", msg);
+    return NULL;
+  }
+  bc_free(text);
+  uint32_t* hits;
+  size_t count;
+  if (!store_query(s, &q, threads, &hits, &count)) {
+    napi_throw_error(env, NULL, "storeQuery: out of memory");
+    return NULL;
+  }
+  uint32_t* positions;
+  uint32_t* games;
+  uint16_t* plies;
+  napi_value obj;
+  napi_create_object(env, &obj);
+  napi_set_named_property(env, obj, "positions", create_typed(env, napi_uint32_array, 4, count, (void**)&positions));
+  napi_set_named_property(env, obj, "games", create_typed(env, napi_uint32_array, 4, count, (void**)&games));
+  napi_set_named_property(env, obj, "plies", create_typed(env, napi_uint16_array, 2, count, (void**)&plies));
+  for (size_t i = 0; i < count; i++) {
+    uint32_t ply;
+    positions[i] = hits[i];
+    store_get(s, hits[i], NULL, &games[i], &ply, NULL);
+    plies[i] = (uint16_t)ply;
+  }
+  store_hits_free(hits);
+  return obj;
+}
+
+static void posdict_writer_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  posdict_writer_destroy((PosDictWriter*)data);
+}
+
+/* dictWriterCreate() -> writer handle for replayPGN / replayNDJSON */
+static napi_value DictWriterCreate(napi_env env, napi_callback_info info) {
+  (void)info;
+  PosDictWriter* w = posdict_writer_create();
+  if (!w) {
+    napi_throw_error(env, NULL, "dictWriterCreate: out of memory");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, w, posdict_writer_finalize, NULL, &external);
+  return external;
+}
+
+static napi_value dict_counts(napi_env env, double positions, double collisions) {
+  napi_value obj, v;
+  napi_create_object(env, &obj);
+  napi_create_double(env, positions, &v);
+  napi_set_named_property(env, obj, "positions", v);
+  napi_create_double(env, collisions, &v);
+  napi_set_named_property(env, obj, "collisions", v);
+  return obj;
+}
+
+/* dictWriterCounts(writer) -> { positions, collisions } added so far */
+static napi_value DictWriterCounts(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  PosDictWriter* w;
+  napi_get_value_external(env, argv[0], (void**)&w);
+  return dict_counts(env, (double)posdict_writer_size(w), (double)posdict_writer_collisions(w));
+}
+
+/* dictWriterLoad(writer, dict) -> bool; false on allocation failure */
+static napi_value DictWriterLoad(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  PosDictWriter* w;
+  PositionDict* d;
+  napi_get_value_external(env, argv[0], (void**)&w);
+  napi_get_value_external(env, argv[1], (void**)&d);
+  napi_value result;
+  napi_get_boolean(env, posdict_writer_load(w, d), &result);
+  return result;
+}
+
+/* dictWriterFinish(writer, path) -> bool */
+static napi_value DictWriterFinish(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  PosDictWriter* w;
+  napi_get_value_external(env, argv[0], (void**)&w);
+  char* path = dup_js_string(env, argv[1]);
+  if (!path) {
+    napi_throw_type_error(env, NULL, "dictWriterFinish: path must be a string");
+    return NULL;
+  }
+  napi_value result;
+  napi_get_boolean(env, posdict_writer_finish(w, path), &result);
+  bc_free(path);
+  return result;
+}
+
+static void posdict_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  posdict_close((PositionDict*)data);
+}
+
+/* dictOpen(path) -> dictionary handle, or null when missing or not a dictionary */
+static napi_value DictOpen(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  char* path = dup_js_string(env, argv[0]);
+  if (!path) {
+    napi_throw_type_error(env, NULL, "dictOpen: path must be a string");
+    return NULL;
+  }
+  PositionDict* d = posdict_open(path);
+  bc_free(path);
+  napi_value result;
+  if (!d) {
+    napi_get_null(env, &result);
+    return result;
+  }
+  napi_create_external(env, d, posdict_finalize, NULL, &result);
+  return result;
+}
+
+/* dictCounts(dict) -> { positions, collisions } */
+static napi_value DictCounts(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  PositionDict* d;
+  napi_get_value_external(env, argv[0], (void**)&d);
+  return dict_counts(env, (double)posdict_size(d), (double)posdict_collisions(d));
+}
+
+/* dictLookup(dict, keys, fen) -> Uint8Array of BOARD_PACKED_SIZE bytes per key (all zero when
+ * absent), or with fen an array of FEN strings (null when absent or unpacked) */
+static napi_value DictLookup(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 3) return NULL;
+  PositionDict* d;
+  bool fen = false;
+  napi_get_value_external(env, argv[0], (void**)&d);
+  napi_get_value_bool(env, argv[2], &fen);
+  napi_typedarray_type type;
+  size_t length, offset;
+  napi_value ab;
+  void* data;
+  if (napi_get_typedarray_info(env, argv[1], &type, &length, &data, &ab, &offset) != napi_ok ||
+      (type != napi_biguint64_array && type != napi_bigint64_array)) {
+    napi_throw_type_error(env, NULL, "PositionDictionary.lookup: keys must be a BigUint64Array");
+    return NULL;
+  }
+  const uint64_t* keys = (const uint64_t*)data;
+  napi_value result;
+  if (!fen) {
+    uint8_t* out;
+    result = create_typed(env, napi_uint8_array, 1, length * BOARD_PACKED_SIZE, (void**)&out);
+    for (size_t i = 0; i < length; i++) {
+      const uint8_t* packed = posdict_find(d, keys[i], NULL);
+      if (packed) memcpy(out + i * BOARD_PACKED_SIZE, packed, BOARD_PACKED_SIZE);
+      else memset(out + i * BOARD_PACKED_SIZE, 0, BOARD_PACKED_SIZE);
+    }
+    return result;
+  }
+  napi_create_array_with_length(env, length, &result);
+  for (size_t i = 0; i < length; i++) {
+    uint8_t flags = 0;
+    const uint8_t* packed = posdict_find(d, keys[i], &flags);
+    Board b;
+    char text[BOARD_FEN_MAX];
+    napi_value v;
+    if (packed && !(flags & POSDICT_UNPACKED) && board_unpack(&b, packed)) {
+      board_to_fen(&b, text, (int)sizeof(text));
+      napi_create_string_utf8(env, text, NAPI_AUTO_LENGTH, &v);
+    } else {
+      napi_get_null(env, &v);
+    }
+    napi_set_element(env, result, (uint32_t)i, v);
+  }
+  return result;
+}
+
+/* dictCollisions(dict) -> BigUint64Array of the keys added with more than one position */
+static napi_value DictCollisions(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  PositionDict* d;
+  napi_get_value_external(env, argv[0], (void**)&d);
+  uint64_t* keys;
+  napi_value result = create_typed(env, napi_biguint64_array, 8, posdict_collisions(d), (void**)&keys);
+  size_t n = 0, count = posdict_size(d);
+  for (size_t i = 0; i < count && n < posdict_collisions(d); i++) {
+    uint64_t key;
+    uint8_t flags;
+    posdict_get(d, i, &key, NULL, &flags);
+    if (flags & POSDICT_COLLIDED) keys[n++] = key;
+  }
+  return result;
+}
+
+static void audit_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  audit_destroy((CollisionAudit*)data);
+}
+
+/* auditCreate(dir, budgetBytes) -> audit handle for replayPGN / replayNDJSON */
+static napi_value AuditCreate(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  double budget = 0;
+  napi_get_value_double(env, argv[1], &budget);
+  char* dir = dup_js_string(env, argv[0]);
+  if (!dir) {
+    napi_throw_type_error(env, NULL, "auditCreate: dir must be a string");
+    return NULL;
+  }
+  CollisionAudit* a = audit_create(dir, budget > 0 ? (size_t)budget : 0);
+  bc_free(dir);
+  if (!a) {
+    napi_throw_error(env, NULL, "auditCreate: out of memory or directory path too long");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, a, audit_finalize, NULL, &external);
+  return external;
+}
+
+/* auditCounts(audit) -> { positions, runs } added so far */
+static napi_value AuditCounts(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  CollisionAudit* a;
+  napi_get_value_external(env, argv[0], (void**)&a);
+  napi_value obj, v;
+  napi_create_object(env, &obj);
+  napi_create_double(env, (double)audit_positions(a), &v);
+  napi_set_named_property(env, obj, "positions", v);
+  napi_create_double(env, (double)audit_runs(a), &v);
+  napi_set_named_property(env, obj, "runs", v);
+  return obj;
+}
+
+/* auditFinish(audit) -> { positions, keys, fingerprints, collisions: BigUint64Array, counts: Uint32Array } */
+static napi_value AuditFinish(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 1) return NULL;
+  CollisionAudit* a;
+  napi_get_value_external(env, argv[0], (void**)&a);
+  AuditReport r;
+  if (!audit_finish(a, &r)) {
+    napi_throw_error(env, NULL, "CollisionAudit.finish: out of memory or cannot read a run file");
+    return NULL;
+  }
+  napi_value obj, v;
+  uint32_t* counts;
+  napi_create_object(env, &obj);
+  napi_create_double(env, (double)r.positions, &v);
+  napi_set_named_property(env, obj, "positions", v);
+  napi_create_double(env, (double)r.keys, &v);
+  napi_set_named_property(env, obj, "keys", v);
+  napi_create_double(env, (double)r.fingerprints, &v);
+  napi_set_named_property(env, obj, "fingerprints", v);
+  napi_set_named_property(env, obj, "collisions", keys_to_bigint64_array(env, r.collided, r.collided_count));
+  napi_set_named_property(env, obj, "counts", create_typed(env, napi_uint32_array, 4, r.collided_count, (void**)&counts));
+  if (r.collided_count) memcpy(counts, r.counts, r.collided_count * sizeof(uint32_t));
+  audit_report_free(&r);
+  return obj;
+}
+
+static void tablebase_finalize(napi_env env, void* data, void* hint) {
+  (void)env;
+  (void)hint;
+  tb_destroy((Tablebase*)data);
+}
+
+/* tbCreate(dir | null) -> tablebase handle */
+static napi_value TbCreate(napi_env env, napi_callback_info info) {
+  size_t argc = 1;
+  napi_value argv[1];
+  napi_valuetype type = napi_undefined;
+  char* dir = NULL;
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc >= 1) napi_typeof(env, argv[0], &type);
+  if (type == napi_string) dir = dup_js_string(env, argv[0]);
+  Tablebase* tb = tb_create(dir);
+  bc_free(dir);
+  if (!tb) {
+    napi_throw_error(env, NULL, "tbCreate: out of memory");
+    return NULL;
+  }
+  napi_value external;
+  napi_create_external(env, tb, tablebase_finalize, NULL, &external);
+  return external;
+}
+
+/* tbGenerate(handle, signature, threads) -> bool */
+static napi_value TbGenerate(napi_env env, napi_callback_info info) {
+  size_t argc = 3;
+  napi_value argv[3];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 3) return NULL;
+  Tablebase* tb;
+  char sig[32];
+  size_t n;
+  int32_t threads = 0;
+  napi_get_value_external(env, argv[0], (void**)&tb);
+  napi_get_value_string_utf8(env, argv[1], sig, sizeof(sig), &n);
+  napi_get_value_int32(env, argv[2], &threads);
+  napi_value result;
+  napi_get_boolean(env, tb_generate(tb, sig, threads), &result);
+  return result;
+}
+
+/* tbProbe(handle, board) -> TB_* for the side to move */
+static napi_value TbProbe(napi_env env, napi_callback_info info) {
+  size_t argc = 2;
+  napi_value argv[2];
+  napi_get_cb_info(env, info, &argc, argv, NULL, NULL);
+  if (argc < 2) return NULL;
+  Tablebase* tb;
+  Board* b;
+  napi_get_value_external(env, argv[0], (void**)&tb);
+  napi_get_value_external(env, argv[1], (void**)&b);
+  napi_value result;
+  napi_create_int32(env, tb_probe_wdl(tb, b), &result);
+  return result;
+}
+
 #define DECLARE_NAPI_METHOD(name, func) { name, 0, func, 0, 0, 0, napi_default, 0 }
 
 static napi_value Init(napi_env env, napi_value exports) {
@@ -272,8 +2838,73 @@ static napi_value Init(napi_env env, napi_value exports) {
     DECLARE_NAPI_METHOD("getZobristKey", GetZobristKey),
     DECLARE_NAPI_METHOD("getPosition", GetPosition),
     DECLARE_NAPI_METHOD("toFEN", ToFEN),
+    DECLARE_NAPI_METHOD("fenCacheCreate", FenCacheCreate),
+    DECLARE_NAPI_METHOD("fenCacheRendered", FenCacheRendered),
     DECLARE_NAPI_METHOD("loadFromFEN", LoadFromFEN),
     DECLARE_NAPI_METHOD("reset", Reset),
+    DECLARE_NAPI_METHOD("perft", Perft),
+    DECLARE_NAPI_METHOD("perftDivide", PerftDivideFn),
+    DECLARE_NAPI_METHOD("search", Search),
+    DECLARE_NAPI_METHOD("evaluate", Evaluate),
+    DECLARE_NAPI_METHOD("getEval", GetEval),
+    DECLARE_NAPI_METHOD("getMotifs", GetMotifs),
+    DECLARE_NAPI_METHOD("getEvalTables", GetEvalTables),
+    DECLARE_NAPI_METHOD("setEvalTables", SetEvalTables),
+    DECLARE_NAPI_METHOD("solveMate", SolveMate),
+    DECLARE_NAPI_METHOD("solveMates", SolveMates),
+    DECLARE_NAPI_METHOD("replay", Replay),
+    DECLARE_NAPI_METHOD("replayTCN", ReplayTCN),
+    DECLARE_NAPI_METHOD("replayPGN", ReplayPGN),
+    DECLARE_NAPI_METHOD("replayPGNAsync", ReplayPGNAsync),
+    DECLARE_NAPI_METHOD("replayStreamCreate", ReplayStreamCreate),
+    DECLARE_NAPI_METHOD("replayStreamPush", ReplayStreamPush),
+    DECLARE_NAPI_METHOD("jobStart", JobStart),
+    DECLARE_NAPI_METHOD("jobCancel", JobCancel),
+    DECLARE_NAPI_METHOD("replayNDJSON", ReplayNDJSON),
+    DECLARE_NAPI_METHOD("replayNDJSONFile", ReplayNDJSONFile),
+    DECLARE_NAPI_METHOD("replayNDJSONFileAsync", ReplayNDJSONFileAsync),
+    DECLARE_NAPI_METHOD("replayPuzzles", ReplayPuzzles),
+    DECLARE_NAPI_METHOD("groupPGN", GroupPGN),
+    DECLARE_NAPI_METHOD("groupPGNAsync", GroupPGNAsync),
+    DECLARE_NAPI_METHOD("checkFENs", CheckFENs),
+    DECLARE_NAPI_METHOD("checkFEN", CheckFEN),
+    DECLARE_NAPI_METHOD("ndjsonCreate", NdjsonCreate),
+    DECLARE_NAPI_METHOD("ndjsonPush", NdjsonPush),
+    DECLARE_NAPI_METHOD("simCreate", SimCreate),
+    DECLARE_NAPI_METHOD("simAdd", SimAdd),
+    DECLARE_NAPI_METHOD("simAddFENs", SimAddFENs),
+    DECLARE_NAPI_METHOD("simAddPositions", SimAddPositions),
+    DECLARE_NAPI_METHOD("simSize", SimSize),
+    DECLARE_NAPI_METHOD("simQuery", SimQuery),
+    DECLARE_NAPI_METHOD("simBuildAsync", SimBuildAsync),
+    DECLARE_NAPI_METHOD("minhashSign", MinhashSign),
+    DECLARE_NAPI_METHOD("minhashJaccard", MinhashJaccard),
+    DECLARE_NAPI_METHOD("lshCreate", LshCreate),
+    DECLARE_NAPI_METHOD("lshAdd", LshAdd),
+    DECLARE_NAPI_METHOD("lshSize", LshSize),
+    DECLARE_NAPI_METHOD("lshQuery", LshQuery),
+    DECLARE_NAPI_METHOD("lshBuildAsync", LshBuildAsync),
+    DECLARE_NAPI_METHOD("storeWriterCreate", StoreWriterCreate),
+    DECLARE_NAPI_METHOD("storeWriterCounts", StoreWriterCounts),
+    DECLARE_NAPI_METHOD("storeWriterFinish", StoreWriterFinish),
+    DECLARE_NAPI_METHOD("storeOpen", StoreOpen),
+    DECLARE_NAPI_METHOD("storeCounts", StoreCounts),
+    DECLARE_NAPI_METHOD("storeGet", StoreGet),
+    DECLARE_NAPI_METHOD("storeQuery", StoreQueryFn),
+    DECLARE_NAPI_METHOD("dictWriterCreate", DictWriterCreate),
+    DECLARE_NAPI_METHOD("dictWriterCounts", DictWriterCounts),
+    DECLARE_NAPI_METHOD("dictWriterLoad", DictWriterLoad),
+    DECLARE_NAPI_METHOD("dictWriterFinish", DictWriterFinish),
+    DECLARE_NAPI_METHOD("dictOpen", DictOpen),
+    DECLARE_NAPI_METHOD("dictCounts", DictCounts),
+    DECLARE_NAPI_METHOD("dictLookup", DictLookup),
+    DECLARE_NAPI_METHOD("dictCollisions", DictCollisions),
+    DECLARE_NAPI_METHOD("auditCreate", AuditCreate),
+    DECLARE_NAPI_METHOD("auditCounts", AuditCounts),
+    DECLARE_NAPI_METHOD("auditFinish", AuditFinish),
+    DECLARE_NAPI_METHOD("tbCreate", TbCreate),
+    DECLARE_NAPI_METHOD("tbGenerate", TbGenerate),
+    DECLARE_NAPI_METHOD("tbProbe", TbProbe),
   };
   napi_define_properties(env, exports, sizeof(desc) / sizeof(desc[0]), desc);
   return exports;
@@ -0,0 +1,106 @@
+/* Allocator hooks. Without an aligned pair, aligned blocks are carved out of
+ * an over-sized malloc with the raw pointer stored just before the block. */
+
+#include "alloc.h"
+#include "bitboard_chess.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void* libc_malloc(size_t size, void* ctx) {
+  (void)ctx;
+  return malloc(size);
+}
+
+static void* libc_realloc(void* p, size_t size, void* ctx) {
+  (void)ctx;
+  return realloc(p, size);
+}
+
+static void libc_free(void* p, void* ctx) {
+  (void)ctx;
+  free(p);
+}
+
+static void* libc_aligned_alloc(size_t alignment, size_t size, void* ctx) {
+  (void)ctx;
+#ifdef _WIN32
+  return _aligned_malloc(size, alignment);
+#else
+  void* p = NULL;
+  return posix_memalign(&p, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) == 0 ? p : NULL;
+#endif
+}
+
+static void libc_aligned_free(void* p, void* ctx) {
+  (void)ctx;
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+#define LIBC_ALLOCATOR { libc_malloc, libc_realloc, libc_free, libc_aligned_alloc, libc_aligned_free, NULL }
+
+static const BoardAllocator libc_allocator = LIBC_ALLOCATOR;
+static BoardAllocator hooks = LIBC_ALLOCATOR;
+
+bool board_set_allocator(const BoardAllocator* a) {
+  if (!a) {
+    hooks = libc_allocator;
+    return true;
+  }
+  if (!a->malloc_fn || !a->realloc_fn || !a->free_fn) return false;
+  if (!a->aligned_alloc_fn != !a->aligned_free_fn) return false;
+  hooks = *a;
+  return true;
+}
+
+void board_get_allocator(BoardAllocator* out) {
+  *out = hooks;
+}
+
+void* bc_malloc(size_t size) {
+  return hooks.malloc_fn(size ? size : 1, hooks.ctx);
+}
+
+void* bc_calloc(size_t count, size_t size) {
+  if (size && count > SIZE_MAX / size) return NULL;
+  void* p = bc_malloc(count * size);
+  if (p) memset(p, 0, count * size);
+  return p;
+}
+
+void* bc_realloc(void* p, size_t size) {
+  return hooks.realloc_fn(p, size ? size : 1, hooks.ctx);
+}
+
+void bc_free(void* p) {
+  if (p) hooks.free_fn(p, hooks.ctx);
+}
+
+void* bc_aligned_calloc(size_t alignment, size_t count, size_t size) {
+  if (size && count > SIZE_MAX / size) return NULL;
+  size_t bytes = count * size;
+  if (!bytes) bytes = 1;
+  void* p;
+  if (hooks.aligned_alloc_fn) {
+    p = hooks.aligned_alloc_fn(alignment, bytes, hooks.ctx);
+  } else {
+    if (bytes > SIZE_MAX - alignment - sizeof(void*)) return NULL;
+    char* raw = (char*)bc_malloc(bytes + alignment + sizeof(void*));
+    if (!raw) return NULL;
+    uintptr_t at = ((uintptr_t)(raw + sizeof(void*)) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    p = (void*)at;
+    ((void**)p)[-1] = raw;
+  }
+  if (p) memset(p, 0, bytes);
+  return p;
+}
+
+void bc_aligned_free(void* p) {
+  if (!p) return;
+  if (hooks.aligned_free_fn) hooks.aligned_free_fn(p, hooks.ctx);
+  else bc_free(((void**)p)[-1]);
+}
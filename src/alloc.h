@@ -0,0 +1,21 @@
+/* Allocation through the hooks of board_set_allocator (see bitboard_chess.h).
+ * Every native structure allocates through these, never libc directly. */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+#define BC_CACHE_LINE 64 /* alignment of hash tables and other large arrays */
+
+void* bc_malloc(size_t size);
+void* bc_calloc(size_t count, size_t size); /* zeroed; NULL on overflow */
+void* bc_realloc(void* p, size_t size);
+void bc_free(void* p);
+
+/* Zeroed count * size bytes aligned to alignment (a power of two); release
+ * with bc_aligned_free. */
+void* bc_aligned_calloc(size_t alignment, size_t count, size_t size);
+void bc_aligned_free(void* p);
+
+#endif
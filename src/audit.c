@@ -0,0 +1,363 @@
+/* Zobrist collision audit (see audit.h). Records are (key, fingerprint)
+ * triples of u64 sorted by key, then fingerprint, so a key's fingerprints
+ * are adjacent in every run and in the merge of runs; duplicates collapse
+ * as soon as they meet, in the buffer or in the merge. The merge is a
+ * binary heap over one read buffer per run, every buffer an equal share of
+ * the budget. */
+
+#include "audit.h"
+#include "alloc.h"
+#include "threads.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define AUDIT_PATH_MAX 1024
+#define AUDIT_READ_MIN 4096 /* records per run read buffer at the least */
+
+typedef struct {
+  uint64_t key;
+  uint64_t hi;
+  uint64_t lo;
+} AuditRecord;
+
+struct CollisionAudit {
+  char dir[AUDIT_PATH_MAX];
+  uint64_t tag; /* in run file names, to keep audits sharing a directory apart */
+  size_t budget;
+  AuditRecord* buf; /* budget / sizeof(AuditRecord) records, allocated on the first add */
+  size_t count;
+  uint64_t positions;
+  uint32_t* runs; /* run file numbers, oldest first */
+  size_t run_count;
+  size_t run_cap;
+  uint32_t next_run;
+};
+
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= UINT64_C(0xBF58476D1CE4E5B9);
+  x ^= x >> 27;
+  x *= UINT64_C(0x94D049BB133111EB);
+  return x ^ (x >> 31);
+}
+
+void audit_fingerprint(const uint8_t packed[BOARD_PACKED_SIZE], uint64_t fp[2]) {
+  /* Two differently seeded mix64 chains over the four words; each step is a
+   * bijection of the running state, so both halves depend on every bit. */
+  uint64_t hi = UINT64_C(0x243F6A8885A308D3), lo = UINT64_C(0x13198A2E03707344);
+  for (int i = 0; i < BOARD_PACKED_SIZE / 8; i++) {
+    uint64_t w;
+    memcpy(&w, packed + i * 8, 8);
+    hi = mix64(hi ^ w) + UINT64_C(0x9E3779B97F4A7C15);
+    lo = mix64(lo + (w << 17 | w >> 47)) ^ UINT64_C(0xA4093822299F31D0);
+  }
+  fp[0] = mix64(hi ^ lo);
+  fp[1] = mix64(lo + hi);
+}
+
+static int compare_records(const void* pa, const void* pb) {
+  const AuditRecord* a = (const AuditRecord*)pa;
+  const AuditRecord* b = (const AuditRecord*)pb;
+  if (a->key != b->key) return a->key < b->key ? -1 : 1;
+  if (a->hi != b->hi) return a->hi < b->hi ? -1 : 1;
+  if (a->lo != b->lo) return a->lo < b->lo ? -1 : 1;
+  return 0;
+}
+
+static bool same_record(const AuditRecord* a, const AuditRecord* b) {
+  return a->key == b->key && a->hi == b->hi && a->lo == b->lo;
+}
+
+static void run_path(const CollisionAudit* a, uint32_t run, char* out, size_t size) {
+  snprintf(out, size, "%s/bcaudit-%016llx-%u.run", a->dir, (unsigned long long)a->tag, run);
+}
+
+static void remove_run(const CollisionAudit* a, uint32_t run) {
+  char path[AUDIT_PATH_MAX + 48];
+  run_path(a, run, path, sizeof(path));
+  remove(path);
+}
+
+CollisionAudit* audit_create(const char* dir, size_t budget) {
+  size_t n = strlen(dir);
+  while (n > 1 && (dir[n - 1] == '/' || dir[n - 1] == '\\')) n--;
+  if (n >= AUDIT_PATH_MAX) return NULL;
+  CollisionAudit* a = (CollisionAudit*)bc_calloc(1, sizeof(CollisionAudit));
+  if (!a) return NULL;
+  memcpy(a->dir, dir, n);
+  a->dir[n] = '\0';
+  a->budget = budget < AUDIT_MIN_BUDGET ? AUDIT_MIN_BUDGET : budget;
+  a->tag = mix64((uint64_t)(uintptr_t)a ^ (uint64_t)(bc_now_ms() * 1000.0));
+  return a;
+}
+
+static void drop_runs(CollisionAudit* a) {
+  for (size_t i = 0; i < a->run_count; i++) remove_run(a, a->runs[i]);
+  a->run_count = 0;
+}
+
+void audit_destroy(CollisionAudit* a) {
+  if (!a) return;
+  drop_runs(a);
+  bc_free(a->runs);
+  bc_free(a->buf);
+  bc_free(a);
+}
+
+uint64_t audit_positions(const CollisionAudit* a) {
+  return a->positions;
+}
+
+size_t audit_runs(const CollisionAudit* a) {
+  return a->run_count;
+}
+
+/* Sort and deduplicate recs in place; returns how many remain. */
+static size_t sort_unique(AuditRecord* recs, size_t n) {
+  qsort(recs, n, sizeof(AuditRecord), compare_records);
+  size_t unique = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!unique || !same_record(&recs[i], &recs[unique - 1])) recs[unique++] = recs[i];
+  }
+  return unique;
+}
+
+/* Open a new run file for writing, numbered into *run. */
+static FILE* create_run(CollisionAudit* a, uint32_t* run) {
+  char path[AUDIT_PATH_MAX + 48];
+  if (a->run_count == a->run_cap) {
+    size_t cap = a->run_cap ? a->run_cap * 2 : 64;
+    uint32_t* runs = (uint32_t*)bc_realloc(a->runs, cap * sizeof(uint32_t));
+    if (!runs) return NULL;
+    a->runs = runs;
+    a->run_cap = cap;
+  }
+  *run = a->next_run++;
+  run_path(a, *run, path, sizeof(path));
+  return fopen(path, "wb");
+}
+
+/* Close a run written by create_run and list it; on failure remove it instead. */
+static bool close_run(CollisionAudit* a, FILE* f, uint32_t run, bool ok) {
+  ok = (fclose(f) == 0) && ok;
+  if (ok) a->runs[a->run_count++] = run;
+  else remove_run(a, run);
+  return ok;
+}
+
+static bool spill(CollisionAudit* a) {
+  uint32_t run;
+  size_t n = sort_unique(a->buf, a->count);
+  FILE* f = create_run(a, &run);
+  if (!f) return false;
+  bool ok = fwrite(a->buf, sizeof(AuditRecord), n, f) == n;
+  a->count = 0;
+  return close_run(a, f, run, ok);
+}
+
+bool audit_add(CollisionAudit* a, uint64_t key, const Board* b) {
+  uint8_t packed[BOARD_PACKED_SIZE];
+  uint64_t fp[2];
+  size_t cap = a->budget / sizeof(AuditRecord);
+  if (!a->buf && !(a->buf = (AuditRecord*)bc_malloc(cap * sizeof(AuditRecord)))) return false;
+  if (a->count == cap && !spill(a)) return false;
+  board_pack(b, packed);
+  audit_fingerprint(packed, fp);
+  AuditRecord* r = &a->buf[a->count++];
+  r->key = key;
+  r->hi = fp[1];
+  r->lo = fp[0];
+  a->positions++;
+  return true;
+}
+
+/* ---- merge ---- */
+
+typedef struct {
+  FILE* f;
+  AuditRecord* buf;
+  size_t len;
+  size_t at;
+} RunReader;
+
+/* Make r->buf[r->at] the reader's next record; false at the end or on a read error (*ok cleared). */
+static bool reader_fill(RunReader* r, size_t cap, bool* ok) {
+  if (r->at < r->len) return true;
+  r->len = fread(r->buf, sizeof(AuditRecord), cap, r->f);
+  r->at = 0;
+  if (r->len < cap && ferror(r->f)) *ok = false;
+  return r->len > 0;
+}
+
+typedef struct {
+  FILE* out; /* intermediate pass: write the merged run here */
+  AuditRecord* obuf;
+  size_t olen;
+  size_t ocap;
+  AuditReport* report; /* final pass: count into this instead */
+  size_t collided_cap;
+  AuditRecord last;
+  bool have_last;
+  uint32_t key_fps; /* fingerprints of last.key so far */
+  bool ok;
+} MergeSink;
+
+static void close_key(MergeSink* s) {
+  AuditReport* r = s->report;
+  if (!s->have_last || s->key_fps < 2) return;
+  if (r->collided_count == s->collided_cap) {
+    size_t cap = s->collided_cap ? s->collided_cap * 2 : 64;
+    uint64_t* collided = (uint64_t*)bc_realloc(r->collided, cap * sizeof(uint64_t));
+    if (!collided) {
+      s->ok = false;
+      return;
+    }
+    r->collided = collided;
+    uint32_t* counts = (uint32_t*)bc_realloc(r->counts, cap * sizeof(uint32_t));
+    if (!counts) {
+      s->ok = false;
+      return;
+    }
+    r->counts = counts;
+    s->collided_cap = cap;
+  }
+  r->collided[r->collided_count] = s->last.key;
+  r->counts[r->collided_count++] = s->key_fps;
+}
+
+static void emit(MergeSink* s, const AuditRecord* rec) {
+  if (s->have_last && same_record(rec, &s->last)) return;
+  if (s->out) {
+    if (s->olen == s->ocap) {
+      if (fwrite(s->obuf, sizeof(AuditRecord), s->olen, s->out) != s->olen) s->ok = false;
+      s->olen = 0;
+    }
+    s->obuf[s->olen++] = *rec;
+  } else {
+    if (!s->have_last || rec->key != s->last.key) {
+      close_key(s);
+      s->report->keys++;
+      s->key_fps = 0;
+    }
+    s->report->fingerprints++;
+    s->key_fps++;
+  }
+  s->last = *rec;
+  s->have_last = true;
+}
+
+static void flush_sink(MergeSink* s) {
+  if (s->out) {
+    if (s->olen && fwrite(s->obuf, sizeof(AuditRecord), s->olen, s->out) != s->olen) s->ok = false;
+    s->olen = 0;
+  } else {
+    close_key(s);
+  }
+}
+
+/* Heap of reader indices ordered by their current record. */
+static bool reader_less(const RunReader* r, uint32_t x, uint32_t y) {
+  return compare_records(&r[x].buf[r[x].at], &r[y].buf[r[y].at]) < 0;
+}
+
+static void sift_down(const RunReader* r, uint32_t* heap, size_t n, size_t i) {
+  for (;;) {
+    size_t m = i, c = 2 * i + 1;
+    if (c < n && reader_less(r, heap[c], heap[m])) m = c;
+    if (c + 1 < n && reader_less(r, heap[c + 1], heap[m])) m = c + 1;
+    if (m == i) return;
+    uint32_t t = heap[i];
+    heap[i] = heap[m];
+    heap[m] = t;
+    i = m;
+  }
+}
+
+/* Merge runs [0, n) of a into s, removing their files. */
+static bool merge_runs(CollisionAudit* a, size_t n, MergeSink* s) {
+  size_t share = a->budget / sizeof(AuditRecord) / (n + 1);
+  RunReader* readers = (RunReader*)bc_calloc(n, sizeof(RunReader));
+  uint32_t* heap = (uint32_t*)bc_malloc(n * sizeof(uint32_t));
+  AuditRecord* bufs = (AuditRecord*)bc_malloc(share * (n + 1) * sizeof(AuditRecord));
+  size_t live = 0;
+  bool ok = readers && heap && bufs;
+  for (size_t i = 0; ok && i < n; i++) {
+    char path[AUDIT_PATH_MAX + 48];
+    run_path(a, a->runs[i], path, sizeof(path));
+    readers[i].f = fopen(path, "rb");
+    readers[i].buf = bufs + i * share;
+    if (!readers[i].f) ok = false;
+    else if (reader_fill(&readers[i], share, &ok)) heap[live++] = (uint32_t)i;
+  }
+  if (ok) {
+    s->obuf = bufs + n * share;
+    s->ocap = share;
+    for (size_t i = live; i-- > 0;) sift_down(readers, heap, live, i);
+    while (live && s->ok) {
+      RunReader* r = &readers[heap[0]];
+      emit(s, &r->buf[r->at++]);
+      if (!reader_fill(r, share, &ok)) heap[0] = heap[--live];
+      sift_down(readers, heap, live, 0);
+    }
+    flush_sink(s);
+  }
+  for (size_t i = 0; readers && i < n; i++) {
+    if (readers[i].f) fclose(readers[i].f);
+  }
+  for (size_t i = 0; i < n; i++) remove_run(a, a->runs[i]);
+  a->run_count -= n;
+  memmove(a->runs, a->runs + n, a->run_count * sizeof(uint32_t));
+  bc_free(bufs);
+  bc_free(heap);
+  bc_free(readers);
+  return ok && s->ok;
+}
+
+bool audit_finish(CollisionAudit* a, AuditReport* out) {
+  MergeSink s;
+  memset(out, 0, sizeof(*out));
+  memset(&s, 0, sizeof(s));
+  out->positions = a->positions;
+  s.report = out;
+  s.ok = true;
+  bool ok = true;
+  if (!a->run_count) {
+    /* Everything fits the buffer: count it in place. */
+    size_t n = a->buf ? sort_unique(a->buf, a->count) : 0;
+    for (size_t i = 0; i < n; i++) emit(&s, &a->buf[i]);
+    flush_sink(&s);
+    ok = s.ok;
+  } else {
+    if (a->count) ok = spill(a);
+    bc_free(a->buf);
+    a->buf = NULL;
+    size_t fanin = a->budget / sizeof(AuditRecord) / AUDIT_READ_MIN - 1;
+    if (fanin < 2) fanin = 2;
+    while (ok && a->run_count > fanin) {
+      MergeSink pass;
+      uint32_t run;
+      memset(&pass, 0, sizeof(pass));
+      pass.ok = true;
+      pass.out = create_run(a, &run);
+      if (!pass.out) {
+        ok = false;
+        break;
+      }
+      ok = merge_runs(a, fanin, &pass);
+      ok = close_run(a, pass.out, run, ok);
+    }
+    if (ok) ok = merge_runs(a, a->run_count, &s);
+  }
+  drop_runs(a);
+  a->count = 0;
+  a->positions = 0;
+  if (!ok) audit_report_free(out);
+  return ok;
+}
+
+void audit_report_free(AuditReport* r) {
+  bc_free(r->collided);
+  bc_free(r->counts);
+  memset(r, 0, sizeof(*r));
+}
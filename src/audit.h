@@ -0,0 +1,56 @@
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Zobrist collision audit. Every position added is reduced to its key and a
+ * 128-bit fingerprint of its packed form (board_pack); two positions under
+ * one key with different fingerprints are a collision of the 64-bit key.
+ *
+ * The (key, fingerprint) pairs are collected in a buffer of the memory
+ * budget; a full buffer is sorted, deduplicated and written to a run file
+ * in the audit's directory. Finishing merges the runs (in several passes
+ * when there are more than the budget can read at once) and counts the
+ * distinct fingerprints of each key, so memory stays within the budget
+ * however many positions are added; disk use is at most 24 bytes per
+ * position added, less the duplicates removed within each run. */
+
+#define AUDIT_MIN_BUDGET (1u << 20)
+
+typedef struct CollisionAudit CollisionAudit;
+
+typedef struct {
+  uint64_t positions;    /* added */
+  uint64_t keys;         /* distinct keys */
+  uint64_t fingerprints; /* distinct (key, fingerprint) pairs: distinct positions, up to fingerprint collisions */
+  uint64_t* collided;    /* keys with more than one fingerprint, ascending */
+  uint32_t* counts;      /* fingerprints of each collided key */
+  size_t collided_count;
+} AuditReport;
+
+/* budget: bytes for the buffer and the merge (at least AUDIT_MIN_BUDGET);
+ * dir: where run files go (no trailing separator needed). NULL on
+ * allocation failure or a directory path that is too long. */
+CollisionAudit* audit_create(const char* dir, size_t budget);
+/* Also removes the audit's run files. */
+void audit_destroy(CollisionAudit* a);
+
+uint64_t audit_positions(const CollisionAudit* a);
+size_t audit_runs(const CollisionAudit* a);
+
+/* 128-bit fingerprint of a packed position into fp[2]. */
+void audit_fingerprint(const uint8_t packed[BOARD_PACKED_SIZE], uint64_t fp[2]);
+
+/* Add b under key. Returns false when a run cannot be written. */
+bool audit_add(CollisionAudit* a, uint64_t key, const Board* b);
+
+/* Merge everything added into *out (release with audit_report_free) and
+ * empty the audit for reuse. Returns false on allocation or I/O failure,
+ * leaving the audit empty. */
+bool audit_finish(CollisionAudit* a, AuditReport* out);
+void audit_report_free(AuditReport* r);
+
+#endif
@@ -1,8 +1,10 @@
 /* Bitboard Chess Engine — C implementation with uint64_t. Same logic as index.mjs. */
 
 #include "bitboard_chess.h"
+#include "bitops.h"
+#include "alloc.h"
+#include <stddef.h>
 #include <stdlib.h>
-#include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 
@@ -17,6 +19,8 @@ static u64 zobrist_castle[4];
 static u64 zobrist_ep[8];
 static u64 file_masks[8];
 static u64 rank_masks[8];
+static u64 between_masks[64][64];
+static u64 line_masks[64][64];
 
 static int in_board(int f, int r) {
   return f >= 0 && f < 8 && r >= 0 && r < 8;
@@ -38,6 +42,123 @@ static u64 random64(void) {
   return ((u64)hi << 32) | (u64)lo;
 }
 
+/* ---- Evaluation tables ---- */
+
+/* Defaults: the "simplified evaluation function" piece values and tables
+ * (a8..h1 as printed, converted to a1 = 0 on load), with its endgame king. */
+static const int DEFAULT_VALUE[6] = { 100, 320, 330, 500, 900, 0 };
+static const int DEFAULT_PHASE_WEIGHT[6] = { 0, 1, 1, 2, 4, 0 };
+static const int8_t DEFAULT_PST[7][64] = {
+  { 0,  0,  0,  0,  0,  0,  0,  0,
+   50, 50, 50, 50, 50, 50, 50, 50,
+   10, 10, 20, 30, 30, 20, 10, 10,
+    5,  5, 10, 25, 25, 10,  5,  5,
+    0,  0,  0, 20, 20,  0,  0,  0,
+    5, -5,-10,  0,  0,-10, -5,  5,
+    5, 10, 10,-20,-20, 10, 10,  5,
+    0,  0,  0,  0,  0,  0,  0,  0 },
+  {-50,-40,-30,-30,-30,-30,-40,-50,
+   -40,-20,  0,  0,  0,  0,-20,-40,
+   -30,  0, 10, 15, 15, 10,  0,-30,
+   -30,  5, 15, 20, 20, 15,  5,-30,
+   -30,  0, 15, 20, 20, 15,  0,-30,
+   -30,  5, 10, 15, 15, 10,  5,-30,
+   -40,-20,  0,  5,  5,  0,-20,-40,
+   -50,-40,-30,-30,-30,-30,-40,-50 },
+  {-20,-10,-10,-10,-10,-10,-10,-20,
+   -10,  0,  0,  0,  0,  0,  0,-10,
+   -10,  0,  5, 10, 10,  5,  0,-10,
+   -10,  5,  5, 10, 10,  5,  5,-10,
+   -10,  0, 10, 10, 10, 10,  0,-10,
+   -10, 10, 10, 10, 10, 10, 10,-10,
+   -10,  5,  0,  0,  0,  0,  5,-10,
+   -20,-10,-10,-10,-10,-10,-10,-20 },
+  {  0,  0,  0,  0,  0,  0,  0,  0,
+     5, 10, 10, 10, 10, 10, 10,  5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+     0,  0,  0,  5,  5,  0,  0,  0 },
+  {-20,-10,-10, -5, -5,-10,-10,-20,
+   -10,  0,  0,  0,  0,  0,  0,-10,
+   -10,  0,  5,  5,  5,  5,  0,-10,
+    -5,  0,  5,  5,  5,  5,  0, -5,
+     0,  0,  5,  5,  5,  5,  0, -5,
+   -10,  5,  5,  5,  5,  5,  0,-10,
+   -10,  0,  5,  0,  0,  0,  0,-10,
+   -20,-10,-10, -5, -5,-10,-10,-20 },
+  {-30,-40,-40,-50,-50,-40,-40,-30,
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -30,-40,-40,-50,-50,-40,-40,-30,
+   -20,-30,-30,-40,-40,-30,-30,-20,
+   -10,-20,-20,-20,-20,-20,-20,-10,
+    20, 20,  0,  0,  0,  0, 20, 20,
+    20, 30, 10,  0,  0, 10, 30, 20 },
+  {-50,-40,-30,-20,-20,-30,-40,-50, /* king, endgame */
+   -30,-20,-10,  0,  0,-10,-20,-30,
+   -30,-10, 20, 30, 30, 20,-10,-30,
+   -30,-10, 30, 40, 40, 30,-10,-30,
+   -30,-10, 30, 40, 40, 30,-10,-30,
+   -30,-10, 20, 30, 30, 20,-10,-30,
+   -30,-30,  0,  0,  0,  0,-30,-30,
+   -50,-30,-30,-30,-30,-30,-30,-50 },
+};
+
+static EvalTables eval_tables;
+/* Folded per piece (kind + 6 * color, as zobrist_pieces) and square: value
+ * plus table entry, negated for Black. */
+static int eval_mg[12][64];
+static int eval_eg[12][64];
+static int eval_phase[12];
+static int eval_phase_max;
+
+static void eval_build(const EvalTables* t) {
+  static const int start_counts[6] = { 16, 4, 4, 4, 2, 2 };
+  eval_tables = *t;
+  eval_phase_max = 0;
+  for (int k = 0; k < 6; k++) {
+    eval_phase_max += start_counts[k] * t->phase_weight[k];
+    eval_phase[k] = eval_phase[k + 6] = t->phase_weight[k];
+    for (int sq = 0; sq < 64; sq++) {
+      eval_mg[k][sq] = t->mg_value[k] + t->mg_pst[k][sq];
+      eval_eg[k][sq] = t->eg_value[k] + t->eg_pst[k][sq];
+      eval_mg[k + 6][sq] = -(t->mg_value[k] + t->mg_pst[k][sq ^ 56]);
+      eval_eg[k + 6][sq] = -(t->eg_value[k] + t->eg_pst[k][sq ^ 56]);
+    }
+  }
+}
+
+static void eval_defaults(EvalTables* t) {
+  for (int k = 0; k < 6; k++) {
+    t->mg_value[k] = t->eg_value[k] = DEFAULT_VALUE[k];
+    t->phase_weight[k] = DEFAULT_PHASE_WEIGHT[k];
+    for (int sq = 0; sq < 64; sq++) {
+      t->mg_pst[k][sq] = DEFAULT_PST[k][sq ^ 56];
+      t->eg_pst[k][sq] = DEFAULT_PST[k == 5 ? 6 : k][sq ^ 56];
+    }
+  }
+}
+
+static void eval_add(Board* b, int piece, int sq) {
+  b->mg += eval_mg[piece][sq];
+  b->eg += eval_eg[piece][sq];
+  b->phase += eval_phase[piece];
+}
+
+static void eval_remove(Board* b, int piece, int sq) {
+  b->mg -= eval_mg[piece][sq];
+  b->eg -= eval_eg[piece][sq];
+  b->phase -= eval_phase[piece];
+}
+
+static void eval_move(Board* b, int piece, int from, int to) {
+  b->mg += eval_mg[piece][to] - eval_mg[piece][from];
+  b->eg += eval_eg[piece][to] - eval_eg[piece][from];
+}
+
 static void init_tables(void) {
   static int done = 0;
   if (done) return;
@@ -81,6 +202,24 @@ static void init_tables(void) {
   for (int r = 0; r < 8; r++)
     rank_masks[r] = (UINT64_C(0xff) << (r * 8));
 
+  /* Walk each of the 8 directions from a: squares passed before b are between
+   * them; the line is the whole rank, file or diagonal through both. */
+  static const int dirs[8][2] = {{1,0},{-1,0},{0,1},{0,-1},{1,1},{-1,-1},{1,-1},{-1,1}};
+  for (int a = 0; a < 64; a++) {
+    for (int d = 0; d < 8; d++) {
+      int df = dirs[d][0], dr = dirs[d][1];
+      u64 full = BIT(a), passed = 0;
+      for (int f = a % 8 + df, r = a / 8 + dr; in_board(f, r); f += df, r += dr) full |= BIT(r * 8 + f);
+      for (int f = a % 8 - df, r = a / 8 - dr; in_board(f, r); f -= df, r -= dr) full |= BIT(r * 8 + f);
+      for (int f = a % 8 + df, r = a / 8 + dr; in_board(f, r); f += df, r += dr) {
+        int b = r * 8 + f;
+        between_masks[a][b] = passed;
+        line_masks[a][b] = full;
+        passed |= BIT(b);
+      }
+    }
+  }
+
   mulberry32_state = 0x5eedU;
   for (int sq = 0; sq < 64; sq++)
     for (int pt = 0; pt < 12; pt++)
@@ -88,6 +227,10 @@ static void init_tables(void) {
   zobrist_side = random64();
   for (int i = 0; i < 4; i++) zobrist_castle[i] = random64();
   for (int f = 0; f < 8; f++) zobrist_ep[f] = random64();
+
+  EvalTables defaults;
+  eval_defaults(&defaults);
+  eval_build(&defaults);
 }
 
 static int square_to_index(const char* sq) {
@@ -179,64 +322,112 @@ static int filter_disamb(u64 candidates, int disamb_file, int disamb_rank) {
   return found;
 }
 
-/* Parse SAN; returns true on success. */
-static bool parse_san(const char* san, ParseSANResult* out) {
-  while (*san == ' ') san++;
-  if (strncmp(san, "O-O-O", 5) == 0) {
-    out->piece = 0;
-    out->targetIndex = -1;
-    out->disambFile = -1;
-    out->disambRank = -1;
-    out->promotion = 0;
+/* Figurine piece (U+2654..U+265F, UTF-8 E2 99 94..9F) at p, or 0. Pawns map to 'P'. */
+static int figurine_piece(const unsigned char* p, size_t n) {
+  if (n >= 3 && p[0] == 0xe2 && p[1] == 0x99 && p[2] >= 0x94 && p[2] <= 0x9f)
+    return "KQRBNPKQRBNP"[p[2] - 0x94];
+  return 0;
+}
+
+static bool is_promo_piece(int c) {
+  return c == 'N' || c == 'B' || c == 'R' || c == 'Q';
+}
+
+/* Parse SAN of len bytes (no NUL needed); returns true on success.
+ * Lenient: annotation glyphs, "e.p.", promotions without '=', '×' or ':' for
+ * captures, figurine pieces, 0-0 castling and "--" null moves are accepted in
+ * place and reported in out->normalized (SAN_NORM_* bits). */
+static bool parse_san(const char* text, size_t len, ParseSANResult* out) {
+  const unsigned char* san = (const unsigned char*)text;
+  out->piece = 0;
+  out->targetIndex = -1;
+  out->disambFile = -1;
+  out->disambRank = -1;
+  out->promotion = 0;
+  out->castle = 0;
+  out->nullMove = 0;
+  out->normalized = 0;
+  while (len > 0 && san[0] == ' ') { san++; len--; }
+  /* Strip check/mate marks, annotation glyphs and "e.p." so the tail is the square */
+  for (;;) {
+    if (len > 0 && (san[len - 1] == '+' || san[len - 1] == '#' || san[len - 1] == ' ')) {
+      len--;
+    } else if (len > 0 && (san[len - 1] == '!' || san[len - 1] == '?')) {
+      len--;
+      out->normalized |= SAN_NORM_GLYPH;
+    } else if (len >= 4 && memcmp(san + len - 4, "e.p.", 4) == 0) {
+      len -= 4;
+      out->normalized |= SAN_NORM_EP_SUFFIX;
+    } else {
+      break;
+    }
+  }
+  if (len == 2 && san[0] == '-' && san[1] == '-') {
+    out->nullMove = 1;
+    out->normalized |= SAN_NORM_NULL_MOVE;
+    return true;
+  }
+  if ((len == 5 && memcmp(san, "O-O-O", 5) == 0) || (len == 5 && memcmp(san, "0-0-0", 5) == 0)) {
     out->castle = 'Q';
     return true;
   }
-  if (strncmp(san, "O-O", 3) == 0) {
-    out->piece = 0;
-    out->targetIndex = -1;
-    out->disambFile = -1;
-    out->disambRank = -1;
-    out->promotion = 0;
+  if ((len == 3 && memcmp(san, "O-O", 3) == 0) || (len == 3 && memcmp(san, "0-0", 3) == 0)) {
     out->castle = 'K';
     return true;
   }
-  size_t len = strlen(san);
-  if (len < 2) return false;
-  /* Strip check (+) or checkmate (#) suffix so the last two chars are the square */
-  while (len > 0 && (san[len - 1] == '+' || san[len - 1] == '#')) len--;
-  if (len < 2) return false;
-  const char* p;
-  if (len >= 4 && san[len - 2] == '=' && (san[len - 1] == 'N' || san[len - 1] == 'B' || san[len - 1] == 'R' || san[len - 1] == 'Q')) {
-    out->promotion = (int)(unsigned char)tolower((unsigned char)san[len - 1]);
-    p = san + len - 4;  /* square is two chars before "=P" */
-  } else {
-    out->promotion = 0;
-    p = san + len - 2;
+  int fig = figurine_piece(san, len);
+  if (fig) {
+    san += 3;
+    len -= 3;
+    out->normalized |= SAN_NORM_FIGURINE;
+    if (fig != 'P') out->piece = fig;
+  }
+  /* Promotion: "=Q", "e8Q", "=♕" */
+  fig = len >= 3 ? figurine_piece(san + len - 3, 3) : 0;
+  if (fig && is_promo_piece(fig)) {
+    out->promotion = tolower(fig);
+    len -= 3;
+    out->normalized |= SAN_NORM_FIGURINE;
+  } else if (len >= 3 && is_promo_piece(san[len - 1])) {
+    out->promotion = tolower(san[len - 1]);
+    len--;
+  } else if (len >= 4 && san[len - 2] == '=' && is_promo_piece(toupper(san[len - 1]))) {
+    out->promotion = tolower(san[len - 1]);
+    len--;
   }
+  if (out->promotion) {
+    if (len > 0 && (san[len - 1] == '=' || san[len - 1] == '/')) len--;
+    else out->normalized |= SAN_NORM_PROMO_NO_EQUALS;
+  }
+  if (len < 2) return false;
+  const unsigned char* p = san + len - 2;
   if (p[0] < 'a' || p[0] > 'h' || p[1] < '1' || p[1] > '8') return false;
-  out->targetIndex = square_to_index(p);
-  out->castle = 0;
-  out->disambFile = -1;
-  out->disambRank = -1;
-  out->piece = 0;
+  out->targetIndex = square_to_index((const char*)p);
   size_t rest_len = len - 2;
-  if (out->promotion) rest_len -= 2;
-  while (rest_len > 0 && san[rest_len - 1] == 'x') rest_len--;
-  if (rest_len > 0) {
-    char c = san[0];
-    if (c == 'N' || c == 'B' || c == 'R' || c == 'Q' || c == 'K') {
-      out->piece = (int)(unsigned char)c;
-      if (rest_len >= 2 && san[1] >= 'a' && san[1] <= 'h') out->disambFile = (unsigned char)san[1] - 97;
-      if (rest_len >= 1 && san[rest_len - 1] >= '1' && san[rest_len - 1] <= '8') out->disambRank = (unsigned char)san[rest_len - 1] - '1';
+  for (;;) {
+    if (rest_len > 0 && (san[rest_len - 1] == 'x' || san[rest_len - 1] == ':')) {
+      rest_len--;
+    } else if (rest_len >= 2 && san[rest_len - 2] == 0xc3 && san[rest_len - 1] == 0x97) {
+      rest_len -= 2;
+      out->normalized |= SAN_NORM_TIMES_SIGN;
     } else {
-      if (rest_len >= 1 && san[0] >= 'a' && san[0] <= 'h') out->disambFile = (unsigned char)san[0] - 97;
-      if (rest_len >= 1 && san[rest_len - 1] >= '1' && san[rest_len - 1] <= '8') out->disambRank = (unsigned char)san[rest_len - 1] - '1';
+      break;
     }
-    if (rest_len == 2 && san[0] >= 'a' && san[0] <= 'h' && san[1] >= '1' && san[1] <= '8') {
-      out->disambFile = (unsigned char)san[0] - 97;
-      out->disambRank = (unsigned char)san[1] - '1';
+  }
+  const unsigned char* rest = san;
+  if (rest_len > 0 && !out->piece) {
+    int c = rest[0];
+    if (c == 'N' || c == 'B' || c == 'R' || c == 'Q' || c == 'K') {
+      out->piece = c;
+      rest++;
+      rest_len--;
     }
   }
+  if (rest_len > 0) {
+    if (rest[0] >= 'a' && rest[0] <= 'h') out->disambFile = rest[0] - 'a';
+    if (rest[rest_len - 1] >= '1' && rest[rest_len - 1] <= '8') out->disambRank = rest[rest_len - 1] - '1';
+  }
+  if (out->promotion && out->piece) return false;
   return true;
 }
 
@@ -249,13 +440,24 @@ static u64 all_occ(const Board* b) {
   return occupancy(b, WHITE) | occupancy(b, BLACK);
 }
 
-static bool resolve_san(const Board* b, const char* san, Move* move) {
-  ParseSANResult p;
-  if (!parse_san(san, &p)) return false;
+static void set_null_move(Move* move) {
+  move->from = -1;
+  move->to = -1;
+  move->promotion = 0;
+  move->castle = 0;
+  move->enpassant = false;
+}
+
+static bool resolve_san(const Board* b, const ParseSANResult* parsed, Move* move) {
+  ParseSANResult p = *parsed;
   int side = b->sideToMove;
   u64 occ = all_occ(b);
   int to_sq = p.targetIndex;
 
+  if (p.nullMove) {
+    set_null_move(move);
+    return true;
+  }
   if (p.castle) {
     move->from = side == WHITE ? 4 : 60;
     move->to = (p.castle == 'K') ? (side == WHITE ? 6 : 62) : (side == WHITE ? 2 : 58);
@@ -309,21 +511,41 @@ static bool resolve_san(const Board* b, const char* san, Move* move) {
   return true;
 }
 
+/* Kind (0 pawn .. 5 king) of color's piece on bb, or -1. */
+static int piece_kind(const Board* b, int color, u64 bb) {
+  if (b->pawns[color] & bb) return 0;
+  if (b->knights[color] & bb) return 1;
+  if (b->bishops[color] & bb) return 2;
+  if (b->rooks[color] & bb) return 3;
+  if (b->queens[color] & bb) return 4;
+  if (b->kings[color] & bb) return 5;
+  return -1;
+}
+
 static void make_move(Board* b, const Move* move) {
   int side = b->sideToMove;
   int enemy = side ^ 1;
+
+  if (move->from < 0) {
+    /* Null move ("--"): pass the turn. */
+    b->enPassant = -1;
+    b->halfmove++;
+    b->sideToMove = enemy;
+    if (b->sideToMove == WHITE) b->fullmove++;
+    return;
+  }
+
   u64 from_bb = BIT(move->from);
   u64 to_bb = BIT(move->to);
 
   if (move->castle) {
+    int base = side == WHITE ? 0 : 56;
+    int rook_from = base + (move->castle == 'K' ? 7 : 0);
+    int rook_to = base + (move->castle == 'K' ? 5 : 3);
     b->kings[side] ^= from_bb | to_bb;
-    if (move->castle == 'K') {
-      if (side == WHITE) b->rooks[WHITE] ^= BIT(7) | BIT(5);
-      else b->rooks[BLACK] ^= BIT(63) | BIT(61);
-    } else {
-      if (side == WHITE) b->rooks[WHITE] ^= BIT(0) | BIT(3);
-      else b->rooks[BLACK] ^= BIT(56) | BIT(59);
-    }
+    b->rooks[side] ^= BIT(rook_from) | BIT(rook_to);
+    eval_move(b, 5 + 6 * side, move->from, move->to);
+    eval_move(b, 3 + 6 * side, rook_from, rook_to);
     char tmp[5]; int j = 0;
     for (const char* c = b->castling; *c; c++) {
       if (side == WHITE && (*c == 'K' || *c == 'Q')) continue;
@@ -332,15 +554,24 @@ static void make_move(Board* b, const Move* move) {
     }
     tmp[j] = '\0';
     memcpy(b->castling, tmp, (size_t)(j + 1));
+    b->enPassant = -1;
+    b->halfmove++;
     b->sideToMove = enemy;
     if (b->sideToMove == WHITE) b->fullmove++;
     return;
   }
 
+  int captured = move->enpassant || (occupancy(b, enemy) & to_bb) != 0;
   if (move->enpassant) {
     int cap_sq = side == WHITE ? move->to - 8 : move->to + 8;
     b->pawns[enemy] &= ~BIT(cap_sq);
+    eval_remove(b, 6 * enemy, cap_sq);
+  } else if (captured) {
+    int victim = piece_kind(b, enemy, to_bb);
+    if (victim >= 0) eval_remove(b, victim + 6 * enemy, move->to);
   }
+  int mover = piece_kind(b, side, from_bb);
+  if (mover >= 0) eval_move(b, mover + 6 * side, move->from, move->to);
 
   b->pawns[enemy] &= ~to_bb;
   b->knights[enemy] &= ~to_bb;
@@ -351,6 +582,7 @@ static void make_move(Board* b, const Move* move) {
 
   int moved_pawn = 0;
   int moved_rook = (b->rooks[side] & from_bb) ? 1 : 0;
+  int moved_king = (b->kings[side] & from_bb) ? 1 : 0;
 
   if (b->pawns[side] & from_bb) {
     b->pawns[side] ^= from_bb;
@@ -374,19 +606,24 @@ static void make_move(Board* b, const Move* move) {
   }
 
   if (move->promotion) {
+    int kind = move->promotion == 'q' ? 4 : move->promotion == 'r' ? 3 : move->promotion == 'b' ? 2 : 1;
     b->pawns[side] &= ~to_bb;
     if (move->promotion == 'q') b->queens[side] |= to_bb;
     else if (move->promotion == 'r') b->rooks[side] |= to_bb;
     else if (move->promotion == 'b') b->bishops[side] |= to_bb;
     else b->knights[side] |= to_bb;
+    eval_remove(b, 6 * side, move->to);
+    eval_add(b, kind + 6 * side, move->to);
   }
 
+  b->halfmove = (moved_pawn || captured) ? 0 : b->halfmove + 1;
+
   if (moved_pawn && (move->to - move->from == 16 || move->from - move->to == 16))
     b->enPassant = (move->from + move->to) / 2;
   else
     b->enPassant = -1;
 
-  if (b->kings[side] & from_bb) {
+  if (moved_king) {
     char tmp[5]; int j = 0;
     for (const char* c = b->castling; *c; c++) {
       if (side == WHITE && (*c == 'K' || *c == 'Q')) continue;
@@ -396,13 +633,14 @@ static void make_move(Board* b, const Move* move) {
     tmp[j] = '\0';
     memcpy(b->castling, tmp, (size_t)(j + 1));
   }
-  if (moved_rook) {
+  /* A rook leaving its home square, or captured on it, loses its right. */
+  if (moved_rook || captured) {
     char tmp[5]; int j = 0;
     for (const char* c = b->castling; *c; c++) {
-      if (move->from == 0 && *c == 'Q') continue;
-      if (move->from == 7 && *c == 'K') continue;
-      if (move->from == 56 && *c == 'q') continue;
-      if (move->from == 63 && *c == 'k') continue;
+      if ((move->from == 0 || move->to == 0) && *c == 'Q') continue;
+      if ((move->from == 7 || move->to == 7) && *c == 'K') continue;
+      if ((move->from == 56 || move->to == 56) && *c == 'q') continue;
+      if ((move->from == 63 || move->to == 63) && *c == 'k') continue;
       tmp[j++] = *c;
     }
     tmp[j] = '\0';
@@ -413,19 +651,18 @@ static void make_move(Board* b, const Move* move) {
   if (b->sideToMove == WHITE) b->fullmove++;
 }
 
-/* Zobrist key (same order as JS). */
-static void get_zobrist_key(const Board* b, uint64_t* out_lo, uint64_t* out_hi) {
+/* Zobrist key (same order as JS). Walks set bits only; a square holds at most one piece. */
+static u64 zobrist_key(const Board* b) {
   u64 key = 0;
-  static const int piece_pts[6][2] = {{0,6},{1,7},{2,8},{3,9},{4,10},{5,11}};
-  u64* arrs[] = {(u64*)b->pawns,(u64*)b->knights,(u64*)b->bishops,(u64*)b->rooks,(u64*)b->queens,(u64*)b->kings};
-  for (int sq = 0; sq < 64; sq++) {
-    for (int i = 0; i < 6; i++) {
-      if (arrs[i][WHITE] & BIT(sq)) { key ^= zobrist_pieces[sq][piece_pts[i][0]]; break; }
-      if (arrs[i][BLACK] & BIT(sq)) { key ^= zobrist_pieces[sq][piece_pts[i][1]]; break; }
+  const u64* arrs[] = {b->pawns, b->knights, b->bishops, b->rooks, b->queens, b->kings};
+  for (int i = 0; i < 6; i++) {
+    for (int color = WHITE; color <= BLACK; color++) {
+      u64 bb = arrs[i][color];
+      int pt = color == WHITE ? i : i + 6;
+      while (bb) key ^= zobrist_pieces[bb_pop_lsb(&bb)][pt];
     }
   }
   if (b->sideToMove == BLACK) key ^= zobrist_side;
-  const int castle_idx[] = {0,1,2,3};
   for (const char* c = b->castling; *c; c++) {
     if (*c == 'K') key ^= zobrist_castle[0];
     else if (*c == 'Q') key ^= zobrist_castle[1];
@@ -433,20 +670,151 @@ static void get_zobrist_key(const Board* b, uint64_t* out_lo, uint64_t* out_hi)
     else if (*c == 'q') key ^= zobrist_castle[3];
   }
   if (b->enPassant >= 0) key ^= zobrist_ep[b->enPassant % 8];
+  return key;
+}
+
+static void get_zobrist_key(const Board* b, uint64_t* out_lo, uint64_t* out_hi) {
+  u64 key = zobrist_key(b);
   *out_lo = (uint64_t)(key & UINT64_C(0xffffffff));
   *out_hi = (uint64_t)(key >> 32);
 }
 
-Board* board_create(void) {
-  init_tables();
-  Board* b = (Board*)calloc(1, sizeof(Board));
+/* ---- Legal move generation (pseudo-legal + copy-make king safety) ---- */
+
+static bool square_attacked(const Board* b, int sq, int by, u64 occ) {
+  if (pawn_attacks[by ^ 1][sq] & b->pawns[by]) return true;
+  if (knight_attacks[sq] & b->knights[by]) return true;
+  if (king_attacks[sq] & b->kings[by]) return true;
+  u64 diag = b->bishops[by] | b->queens[by];
+  if (diag && (get_bishop_attacks(sq, occ) & diag)) return true;
+  u64 orth = b->rooks[by] | b->queens[by];
+  if (orth && (get_rook_attacks(sq, occ) & orth)) return true;
+  return false;
+}
+
+static bool king_attacked(const Board* b, int color) {
+  u64 k = b->kings[color];
+  if (!k) return false;
+  return square_attacked(b, bb_lsb(k), color ^ 1, all_occ(b));
+}
+
+static int push_move(Move* out, int n, int from, int to, int promotion, int castle, bool ep) {
+  out[n].from = from;
+  out[n].to = to;
+  out[n].promotion = promotion;
+  out[n].castle = castle;
+  out[n].enpassant = ep;
+  return n + 1;
+}
+
+static int push_targets(Move* out, int n, int from, u64 targets) {
+  while (targets) n = push_move(out, n, from, bb_pop_lsb(&targets), 0, 0, false);
+  return n;
+}
+
+static int push_pawn_move(Move* out, int n, int from, int to) {
+  if (to >= 56 || to < 8) {
+    n = push_move(out, n, from, to, 'q', 0, false);
+    n = push_move(out, n, from, to, 'r', 0, false);
+    n = push_move(out, n, from, to, 'b', 0, false);
+    return push_move(out, n, from, to, 'n', 0, false);
+  }
+  return push_move(out, n, from, to, 0, 0, false);
+}
+
+static bool has_castle_right(const Board* b, char right) {
+  return strchr(b->castling, right) != NULL;
+}
+
+static int gen_castles(const Board* b, Move* out, int n, u64 occ) {
+  int side = b->sideToMove;
+  int enemy = side ^ 1;
+  int base = side == WHITE ? 0 : 56;
+  if (!(b->kings[side] & BIT(base + 4))) return n;
+  char kr = side == WHITE ? 'K' : 'k';
+  char qr = side == WHITE ? 'Q' : 'q';
+  if (has_castle_right(b, kr) && (b->rooks[side] & BIT(base + 7)) &&
+      !(occ & (BIT(base + 5) | BIT(base + 6))) &&
+      !square_attacked(b, base + 4, enemy, occ) && !square_attacked(b, base + 5, enemy, occ) &&
+      !square_attacked(b, base + 6, enemy, occ))
+    n = push_move(out, n, base + 4, base + 6, 0, 'K', false);
+  if (has_castle_right(b, qr) && (b->rooks[side] & BIT(base)) &&
+      !(occ & (BIT(base + 1) | BIT(base + 2) | BIT(base + 3))) &&
+      !square_attacked(b, base + 4, enemy, occ) && !square_attacked(b, base + 3, enemy, occ) &&
+      !square_attacked(b, base + 2, enemy, occ))
+    n = push_move(out, n, base + 4, base + 2, 0, 'Q', false);
+  return n;
+}
+
+static int gen_pseudo(const Board* b, Move* out) {
+  int side = b->sideToMove;
+  int enemy = side ^ 1;
+  u64 own = occupancy(b, side);
+  u64 theirs = occupancy(b, enemy);
+  u64 occ = own | theirs;
+  int n = 0;
+  u64 bb;
+
+  bb = b->pawns[side];
+  while (bb) {
+    int from = bb_pop_lsb(&bb);
+    int fwd = side == WHITE ? from + 8 : from - 8;
+    if (fwd >= 0 && fwd < 64 && !(occ & BIT(fwd))) {
+      n = push_pawn_move(out, n, from, fwd);
+      int start_rank = side == WHITE ? 1 : 6;
+      int dbl = side == WHITE ? from + 16 : from - 16;
+      if (from / 8 == start_rank && !(occ & BIT(dbl))) n = push_move(out, n, from, dbl, 0, 0, false);
+    }
+    u64 caps = pawn_attacks[side][from] & theirs;
+    while (caps) n = push_pawn_move(out, n, from, bb_pop_lsb(&caps));
+    if (b->enPassant >= 0 && (pawn_attacks[side][from] & BIT(b->enPassant)) && !(occ & BIT(b->enPassant)))
+      n = push_move(out, n, from, b->enPassant, 0, 0, true);
+  }
+  bb = b->knights[side];
+  while (bb) {
+    int from = bb_pop_lsb(&bb);
+    n = push_targets(out, n, from, knight_attacks[from] & ~own);
+  }
+  bb = b->bishops[side] | b->queens[side];
+  while (bb) {
+    int from = bb_pop_lsb(&bb);
+    n = push_targets(out, n, from, get_bishop_attacks(from, occ) & ~own);
+  }
+  bb = b->rooks[side] | b->queens[side];
+  while (bb) {
+    int from = bb_pop_lsb(&bb);
+    n = push_targets(out, n, from, get_rook_attacks(from, occ) & ~own);
+  }
+  bb = b->kings[side];
+  while (bb) {
+    int from = bb_pop_lsb(&bb);
+    n = push_targets(out, n, from, king_attacks[from] & ~own);
+  }
+  return gen_castles(b, out, n, occ);
+}
+
+size_t board_sizeof(void) {
+  return sizeof(Board);
+}
+
+size_t board_alignof(void) {
+  struct probe { char c; Board b; };
+  return offsetof(struct probe, b);
+}
+
+Board* board_init(void* mem) {
+  Board* b = (Board*)mem;
   if (!b) return NULL;
   board_reset(b);
   return b;
 }
 
+Board* board_create(void) {
+  return board_init(bc_malloc(sizeof(Board)));
+}
+
 void board_destroy(Board* b) {
-  free(b);
+  bc_free(b);
 }
 
 void board_reset(Board* b) {
@@ -468,6 +836,7 @@ void board_reset(Board* b) {
   b->enPassant = -1;
   b->halfmove = 0;
   b->fullmove = 1;
+  board_refresh_eval(b);
 }
 
 void board_load_fen(Board* b, const char* fen) {
@@ -526,30 +895,41 @@ void board_load_fen(Board* b, const char* fen) {
   }
   b->castling[cidx] = '\0';
   while (*placement == ' ') placement++;
-  if (*placement && *placement != '-') {
+  if (*placement == '-') {
+    placement++;
+  } else if (*placement) {
     int file = (unsigned char)*placement - 97;
     placement++;
     int rank = (unsigned char)*placement - '1';
     if (file >= 0 && file < 8 && rank >= 0 && rank < 8) b->enPassant = rank * 8 + file;
-    placement++;
+    if (*placement) placement++;
   }
-  while (*placement == ' ' || (*placement >= '0' && *placement <= '9')) placement++;
+  while (*placement == ' ') placement++;
   if (*placement >= '0' && *placement <= '9') b->halfmove = (int)strtol(placement, (char**)&placement, 10);
   while (*placement == ' ') placement++;
   if (*placement >= '0' && *placement <= '9') b->fullmove = (int)strtol(placement, NULL, 10);
+
+  board_refresh_eval(b);
 }
 
 bool board_make_move_san(Board* b, const char* san) {
   Move move;
-  if (!resolve_san(b, san, &move)) return false;
+  if (!board_resolve_san(b, san, &move)) return false;
   make_move(b, &move);
   return true;
 }
 
 bool board_resolve_san(const Board* b, const char* san, Move* out_move) {
-  return resolve_san(b, san, out_move);
+  ParseSANResult p;
+  if (!parse_san(san, strlen(san), &p)) return false;
+  return resolve_san(b, &p, out_move);
 }
 
+bool board_parse_san(const char* san, int len, ParseSANResult* out) {
+  return parse_san(san, (size_t)len, out);
+}
+
+
 void board_make_move(Board* b, const Move* move) {
   make_move(b, move);
 }
@@ -566,42 +946,490 @@ uint64_t board_get_zobrist_key_hi(const Board* b) {
   return hi;
 }
 
+/* Full legality check of one move, used by validating replay. */
+static int check_move(const Board* b, const Move* m) {
+  if (m->from < 0 && m->to < 0) return king_attacked(b, b->sideToMove) ? MOVE_ERR_ILLEGAL : MOVE_OK;
+  if (m->from < 0 || m->from > 63 || m->to < 0 || m->to > 63) return MOVE_ERR_SYNTAX;
+  int side = b->sideToMove;
+  u64 own = occupancy(b, side);
+  u64 theirs = occupancy(b, side ^ 1);
+  u64 occ = own | theirs;
+  u64 from_bb = BIT(m->from);
+  u64 to_bb = BIT(m->to);
+  if (!(own & from_bb)) return MOVE_ERR_NO_PIECE;
+  if (m->castle) {
+    Move castles[2];
+    int n = gen_castles(b, castles, 0, occ);
+    for (int i = 0; i < n; i++)
+      if (castles[i].castle == m->castle && castles[i].from == m->from && castles[i].to == m->to) return MOVE_OK;
+    return MOVE_ERR_ILLEGAL;
+  }
+  if (own & to_bb) return MOVE_ERR_ILLEGAL;
+  if (b->pawns[side] & from_bb) {
+    int last_rank = side == WHITE ? 7 : 0;
+    if ((m->to / 8 == last_rank) != (m->promotion != 0)) return MOVE_ERR_ILLEGAL;
+    int fwd = side == WHITE ? 8 : -8;
+    bool is_ep = b->enPassant >= 0 && m->to == b->enPassant && !(occ & to_bb) &&
+                 (pawn_attacks[side][m->from] & to_bb);
+    if (m->enpassant != is_ep) return MOVE_ERR_ILLEGAL;
+    if (pawn_attacks[side][m->from] & to_bb) {
+      if (!(theirs & to_bb) && !is_ep) return MOVE_ERR_ILLEGAL;
+    } else if (m->to == m->from + fwd) {
+      if (occ & to_bb) return MOVE_ERR_ILLEGAL;
+    } else if (m->to == m->from + 2 * fwd) {
+      if (m->from / 8 != (side == WHITE ? 1 : 6) || (occ & (to_bb | BIT(m->from + fwd)))) return MOVE_ERR_ILLEGAL;
+    } else {
+      return MOVE_ERR_ILLEGAL;
+    }
+  } else {
+    u64 reach;
+    if (m->promotion || m->enpassant) return MOVE_ERR_ILLEGAL;
+    if (b->knights[side] & from_bb) reach = knight_attacks[m->from];
+    else if (b->bishops[side] & from_bb) reach = get_bishop_attacks(m->from, occ);
+    else if (b->rooks[side] & from_bb) reach = get_rook_attacks(m->from, occ);
+    else if (b->queens[side] & from_bb) reach = get_bishop_attacks(m->from, occ) | get_rook_attacks(m->from, occ);
+    else reach = king_attacks[m->from];
+    if (!(reach & to_bb)) return MOVE_ERR_ILLEGAL;
+  }
+  Board copy = *b;
+  make_move(&copy, m);
+  return king_attacked(&copy, side) ? MOVE_ERR_ILLEGAL : MOVE_OK;
+}
+
+/* Like resolve_san, but every candidate is legality-checked, so a pinned
+ * piece does not make the move ambiguous and illegal moves are reported. */
+static int resolve_san_checked(const Board* b, const ParseSANResult* parsed, Move* move) {
+  ParseSANResult p = *parsed;
+  int side = b->sideToMove;
+  if (p.nullMove) {
+    set_null_move(move);
+    return check_move(b, move);
+  }
+  if (p.castle) {
+    move->from = side == WHITE ? 4 : 60;
+    move->to = (p.castle == 'K') ? (side == WHITE ? 6 : 62) : (side == WHITE ? 2 : 58);
+    move->castle = p.castle;
+    move->promotion = 0;
+    move->enpassant = false;
+    return check_move(b, move);
+  }
+  u64 occ = all_occ(b);
+  int to_sq = p.targetIndex;
+  u64 candidates = 0;
+  if (p.piece == 'K') candidates = king_attacks[to_sq] & b->kings[side];
+  else if (p.piece == 'N') candidates = knight_attacks[to_sq] & b->knights[side];
+  else if (p.piece == 'R') candidates = get_rook_attacks(to_sq, occ) & b->rooks[side];
+  else if (p.piece == 'B') candidates = get_bishop_attacks(to_sq, occ) & b->bishops[side];
+  else if (p.piece == 'Q') candidates = (get_rook_attacks(to_sq, occ) | get_bishop_attacks(to_sq, occ)) & b->queens[side];
+  else if (p.disambFile >= 0) candidates = pawn_capture_sources(to_sq, side) & b->pawns[side];
+  else {
+    int one_back = side == WHITE ? to_sq - 8 : to_sq + 8;
+    int two_back = side == WHITE ? to_sq - 16 : to_sq + 16;
+    if (one_back >= 0 && one_back < 64 && (b->pawns[side] & BIT(one_back))) candidates = BIT(one_back);
+    else if (two_back >= 0 && two_back < 64 && (b->pawns[side] & BIT(two_back))) candidates = BIT(two_back);
+  }
+  if (p.disambFile >= 0) candidates &= file_masks[p.disambFile];
+  if (p.disambRank >= 0) candidates &= rank_masks[p.disambRank];
+  if (!candidates) return MOVE_ERR_NO_PIECE;
+
+  int legal = 0;
+  while (candidates) {
+    Move m;
+    m.from = bb_pop_lsb(&candidates);
+    m.to = to_sq;
+    m.promotion = p.promotion;
+    m.castle = 0;
+    m.enpassant = p.piece == 0 && to_sq == b->enPassant && (pawn_attacks[side][m.from] & BIT(to_sq)) && !(occ & BIT(to_sq));
+    if (check_move(b, &m) != MOVE_OK) continue;
+    if (++legal > 1) return MOVE_ERR_AMBIGUOUS;
+    *move = m;
+  }
+  return legal ? MOVE_OK : MOVE_ERR_ILLEGAL;
+}
+
+static int piece_char_to_promo(char c) {
+  if (c == 'q' || c == 'Q') return 'q';
+  if (c == 'r' || c == 'R') return 'r';
+  if (c == 'b' || c == 'B') return 'b';
+  if (c == 'n' || c == 'N') return 'n';
+  return 0;
+}
+
+/* Fill move for from->to, inferring castling (king two files, or onto its own
+ * rook) and en passant from the position. */
+static void move_from_squares(const Board* b, int from, int to, int promotion, Move* move) {
+  int side = b->sideToMove;
+  u64 from_bb = BIT(from);
+  move->from = from;
+  move->to = to;
+  move->promotion = promotion;
+  move->castle = 0;
+  move->enpassant = false;
+  if ((b->kings[side] & from_bb) && (from == 4 || from == 60)) {
+    if (to == from + 2 || (to == from + 3 && (b->rooks[side] & BIT(to)))) {
+      move->castle = 'K';
+      move->to = from + 2;
+    } else if (to == from - 2 || (to == from - 4 && (b->rooks[side] & BIT(to)))) {
+      move->castle = 'Q';
+      move->to = from - 2;
+    }
+  } else if ((b->pawns[side] & from_bb) && to == b->enPassant &&
+             (to - from) % 8 != 0 && !(all_occ(b) & BIT(to))) {
+    move->enpassant = true;
+  }
+}
+
+static bool parse_uci(const Board* b, const char* uci, int len, Move* move) {
+  if (len == 4 && memcmp(uci, "0000", 4) == 0) {
+    set_null_move(move);
+    return true;
+  }
+  if (len < 4 || len > 5) return false;
+  if (uci[0] < 'a' || uci[0] > 'h' || uci[1] < '1' || uci[1] > '8' ||
+      uci[2] < 'a' || uci[2] > 'h' || uci[3] < '1' || uci[3] > '8') return false;
+  int promotion = 0;
+  if (len == 5) {
+    promotion = piece_char_to_promo(uci[4]);
+    if (!promotion) return false;
+  }
+  move_from_squares(b, square_to_index(uci), square_to_index(uci + 2), promotion, move);
+  return true;
+}
+
+void board_move_from_squares(const Board* b, int from, int to, int promotion, Move* out_move) {
+  move_from_squares(b, from, to, promotion, out_move);
+}
+
+uint64_t board_get_zobrist_key(const Board* b) {
+  return zobrist_key(b);
+}
+
+int board_generate_moves(const Board* b, Move* out) {
+  Move pseudo[BOARD_MAX_MOVES];
+  int count = gen_pseudo(b, pseudo);
+  int side = b->sideToMove;
+  int n = 0;
+  for (int i = 0; i < count; i++) {
+    if (pseudo[i].castle) {
+      out[n++] = pseudo[i];
+      continue;
+    }
+    Board copy = *b;
+    make_move(&copy, &pseudo[i]);
+    if (!king_attacked(&copy, side)) out[n++] = pseudo[i];
+  }
+  return n;
+}
+
+int board_check_move(const Board* b, const Move* move) {
+  return check_move(b, move);
+}
+
+int board_resolve_san_checked(const Board* b, const char* san, Move* out_move) {
+  ParseSANResult p;
+  if (!parse_san(san, strlen(san), &p)) return MOVE_ERR_SYNTAX;
+  return resolve_san_checked(b, &p, out_move);
+}
+
+int board_resolve_parsed_san(const Board* b, const ParseSANResult* parsed, bool checked, Move* out_move) {
+  if (checked) return resolve_san_checked(b, parsed, out_move);
+  return resolve_san(b, parsed, out_move) ? MOVE_OK : MOVE_ERR_NO_PIECE;
+}
+
+bool board_parse_uci(const Board* b, const char* uci, int len, Move* out_move) {
+  return parse_uci(b, uci, len, out_move);
+}
+
+bool board_square_attacked(const Board* b, int sq, int by_color) {
+  return square_attacked(b, sq, by_color, all_occ(b));
+}
+
+bool board_in_check(const Board* b) {
+  return king_attacked(b, b->sideToMove);
+}
+
+bool board_insufficient_material(const Board* b) {
+  if (b->pawns[WHITE] | b->pawns[BLACK] | b->rooks[WHITE] | b->rooks[BLACK] | b->queens[WHITE] | b->queens[BLACK])
+    return false;
+  u64 knights = b->knights[WHITE] | b->knights[BLACK];
+  u64 bishops = b->bishops[WHITE] | b->bishops[BLACK];
+  if (bb_popcount(knights | bishops) <= 1) return true;
+  if (knights) return false;
+  /* Only bishops left: dead if they all stand on one square colour. */
+  const u64 light = UINT64_C(0x55aa55aa55aa55aa);
+  return (bishops & light) == 0 || (bishops & ~light) == 0;
+}
+
+int board_game_end(const Board* b) {
+  Move moves[BOARD_MAX_MOVES];
+  if (board_generate_moves(b, moves) == 0)
+    return board_in_check(b) ? GAME_END_CHECKMATE : GAME_END_STALEMATE;
+  if (board_insufficient_material(b)) return GAME_END_INSUFFICIENT_MATERIAL;
+  return GAME_END_UNFINISHED;
+}
+
+int board_move_to_uci(const Move* move, char* out) {
+  int n = 0;
+  if (move->from < 0) {
+    memcpy(out, "0000", 5);
+    return 4;
+  }
+  out[n++] = (char)('a' + move->from % 8);
+  out[n++] = (char)('1' + move->from / 8);
+  out[n++] = (char)('a' + move->to % 8);
+  out[n++] = (char)('1' + move->to / 8);
+  if (move->promotion) out[n++] = (char)move->promotion;
+  out[n] = '\0';
+  return n;
+}
+
+void board_init_tables(void) {
+  init_tables();
+}
+
+void board_get_eval_tables(EvalTables* out) {
+  init_tables();
+  *out = eval_tables;
+}
+
+void board_set_eval_tables(const EvalTables* tables) {
+  init_tables();
+  if (tables) {
+    eval_build(tables);
+  } else {
+    EvalTables defaults;
+    eval_defaults(&defaults);
+    eval_build(&defaults);
+  }
+}
+
+void board_refresh_eval(Board* b) {
+  const u64* arrs[] = {b->pawns, b->knights, b->bishops, b->rooks, b->queens, b->kings};
+  init_tables();
+  b->mg = b->eg = b->phase = 0;
+  for (int i = 0; i < 6; i++) {
+    for (int color = WHITE; color <= BLACK; color++) {
+      u64 bb = arrs[i][color];
+      while (bb) eval_add(b, i + 6 * color, bb_pop_lsb(&bb));
+    }
+  }
+}
+
+int board_eval(const Board* b) {
+  int p = b->phase < eval_phase_max ? b->phase : eval_phase_max;
+  if (eval_phase_max <= 0) return b->mg;
+  return (b->mg * p + b->eg * (eval_phase_max - p)) / eval_phase_max;
+}
+
+int board_eval_phase_max(void) {
+  init_tables();
+  return eval_phase_max;
+}
+
+u64 board_between(int a, int b) {
+  return between_masks[a][b];
+}
+
+u64 board_line(int a, int b) {
+  return line_masks[a][b];
+}
+
+u64 board_knight_attacks(int sq) {
+  return knight_attacks[sq];
+}
+
+u64 board_king_attacks(int sq) {
+  return king_attacks[sq];
+}
+
+u64 board_pawn_attacks(int color, int sq) {
+  return pawn_attacks[color][sq];
+}
+
+u64 board_rook_attacks(int sq, u64 occ) {
+  return get_rook_attacks(sq, occ);
+}
+
+u64 board_bishop_attacks(int sq, u64 occ) {
+  return get_bishop_attacks(sq, occ);
+}
+
+/* FEN letters in the order of board_piece_sets(). */
+static const char FEN_PIECES[12] = { 'P', 'N', 'B', 'R', 'Q', 'K', 'p', 'n', 'b', 'r', 'q', 'k' };
+
+void board_piece_sets(const Board* b, u64 sets[12]) {
+  for (int color = WHITE; color <= BLACK; color++) {
+    u64* s = sets + 6 * color;
+    s[0] = b->pawns[color];
+    s[1] = b->knights[color];
+    s[2] = b->bishops[color];
+    s[3] = b->rooks[color];
+    s[4] = b->queens[color];
+    s[5] = b->kings[color];
+  }
+}
+
+bool board_pack(const Board* b, uint8_t out[BOARD_PACKED_SIZE]) {
+  u64 sets[12];
+  uint8_t code[64];
+  u64 occ = 0;
+  memset(out, 0, BOARD_PACKED_SIZE);
+  board_piece_sets(b, sets);
+  for (int i = 0; i < 12; i++) {
+    u64 bits = sets[i] & ~occ;
+    occ |= sets[i];
+    while (bits) code[bb_pop_lsb(&bits)] = (uint8_t)i;
+  }
+  if (bb_popcount(occ) > 32) return false;
+  memcpy(out, &occ, 8);
+  int n = 0;
+  for (u64 bits = occ; bits; n++) out[8 + n / 2] |= (uint8_t)(code[bb_pop_lsb(&bits)] << (4 * (n & 1)));
+  uint8_t flags = b->sideToMove == BLACK ? BOARD_PACKED_BLACK : 0;
+  for (const char* c = b->castling; *c; c++) {
+    if (*c == 'K') flags |= BOARD_PACKED_CASTLE_K;
+    else if (*c == 'Q') flags |= BOARD_PACKED_CASTLE_Q;
+    else if (*c == 'k') flags |= BOARD_PACKED_CASTLE_k;
+    else if (*c == 'q') flags |= BOARD_PACKED_CASTLE_q;
+  }
+  out[24] = flags;
+  out[25] = b->enPassant >= 0 && b->enPassant < 64 ? (uint8_t)b->enPassant : BOARD_PACKED_NO_EP;
+  return true;
+}
+
+bool board_unpack(Board* b, const uint8_t in[BOARD_PACKED_SIZE]) {
+  u64 occ;
+  memcpy(&occ, in, 8);
+  if (bb_popcount(occ) > 32 || (in[25] >= 64 && in[25] != BOARD_PACKED_NO_EP)) return false;
+  u64* sets[12] = { &b->pawns[0], &b->knights[0], &b->bishops[0], &b->rooks[0], &b->queens[0], &b->kings[0],
+                    &b->pawns[1], &b->knights[1], &b->bishops[1], &b->rooks[1], &b->queens[1], &b->kings[1] };
+  u64 found[12] = { 0 };
+  int n = 0;
+  for (u64 bits = occ; bits; n++) {
+    int sq = bb_pop_lsb(&bits);
+    int code = (in[8 + n / 2] >> (4 * (n & 1))) & 15;
+    if (code >= 12) return false;
+    found[code] |= (u64)1 << sq;
+  }
+  for (int i = 0; i < 12; i++) *sets[i] = found[i];
+  uint8_t flags = in[24];
+  int c = 0;
+  b->sideToMove = flags & BOARD_PACKED_BLACK ? BLACK : WHITE;
+  if (flags & BOARD_PACKED_CASTLE_K) b->castling[c++] = 'K';
+  if (flags & BOARD_PACKED_CASTLE_Q) b->castling[c++] = 'Q';
+  if (flags & BOARD_PACKED_CASTLE_k) b->castling[c++] = 'k';
+  if (flags & BOARD_PACKED_CASTLE_q) b->castling[c++] = 'q';
+  b->castling[c] = '\0';
+  b->enPassant = in[25] == BOARD_PACKED_NO_EP ? -1 : in[25];
+  b->halfmove = 0;
+  b->fullmove = 1;
+  board_refresh_eval(b);
+  return true;
+}
+
+/* Placement of rank r (0 = rank 1) into out (at most 8 bytes); returns its length. */
+static int render_rank(const u64 sets[12], int r, char* out) {
+  char squares[8] = { 0 };
+  for (int i = 0; i < 12; i++) {
+    u64 bits = (sets[i] >> (8 * r)) & 0xFF;
+    while (bits) squares[bb_pop_lsb(&bits)] = FEN_PIECES[i];
+  }
+  int n = 0, empty = 0;
+  for (int f = 0; f < 8; f++) {
+    if (!squares[f]) {
+      empty++;
+      continue;
+    }
+    if (empty) out[n++] = (char)('0' + empty);
+    empty = 0;
+    out[n++] = squares[f];
+  }
+  if (empty) out[n++] = (char)('0' + empty);
+  return n;
+}
+
+static int render_int(int v, char* out) {
+  char digits[12];
+  int n = 0, len = 0;
+  unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;
+  if (v < 0) out[len++] = '-';
+  do {
+    digits[n++] = (char)('0' + u % 10);
+    u /= 10;
+  } while (u);
+  while (n) out[len++] = digits[--n];
+  return len;
+}
+
+/* " w KQkq e3 0 1" */
+static int render_trailer(const Board* b, char* out) {
+  int n = 0;
+  out[n++] = ' ';
+  out[n++] = b->sideToMove == WHITE ? 'w' : 'b';
+  out[n++] = ' ';
+  if (!b->castling[0]) out[n++] = '-';
+  for (const char* c = b->castling; *c; c++) out[n++] = *c;
+  out[n++] = ' ';
+  if (b->enPassant >= 0) {
+    out[n++] = (char)('a' + b->enPassant % 8);
+    out[n++] = (char)('1' + b->enPassant / 8);
+  } else {
+    out[n++] = '-';
+  }
+  out[n++] = ' ';
+  n += render_int(b->halfmove, out + n);
+  out[n++] = ' ';
+  n += render_int(b->fullmove, out + n);
+  return n;
+}
+
+/* Copy the n rendered bytes of fen into out the way board_to_fen always has:
+ * truncated to maxlen - 1 bytes plus a NUL, returning the full length. */
+static int copy_fen(const char* fen, int n, char* out, int maxlen) {
+  if (maxlen <= 0) return n;
+  int copy = n < maxlen ? n : maxlen - 1;
+  memcpy(out, fen, (size_t)copy);
+  out[copy] = '\0';
+  return n;
+}
+
 int board_to_fen(const Board* b, char* out, int maxlen) {
+  char fen[BOARD_FEN_MAX];
+  u64 sets[12];
   int n = 0;
+  board_piece_sets(b, sets);
   for (int r = 7; r >= 0; r--) {
-    int empty = 0;
-    for (int f = 0; f < 8; f++) {
-      int sq = r * 8 + f;
-      u64 bb = BIT(sq);
-      char piece = 0;
-      if (b->pawns[WHITE] & bb) piece = 'P';
-      else if (b->knights[WHITE] & bb) piece = 'N';
-      else if (b->bishops[WHITE] & bb) piece = 'B';
-      else if (b->rooks[WHITE] & bb) piece = 'R';
-      else if (b->queens[WHITE] & bb) piece = 'Q';
-      else if (b->kings[WHITE] & bb) piece = 'K';
-      else if (b->pawns[BLACK] & bb) piece = 'p';
-      else if (b->knights[BLACK] & bb) piece = 'n';
-      else if (b->bishops[BLACK] & bb) piece = 'b';
-      else if (b->rooks[BLACK] & bb) piece = 'r';
-      else if (b->queens[BLACK] & bb) piece = 'q';
-      else if (b->kings[BLACK] & bb) piece = 'k';
-      if (!piece) empty++;
-      else {
-        if (empty) { n += snprintf(out + n, (size_t)(maxlen - n), "%d", empty); empty = 0; }
-        if (n < maxlen) out[n] = piece;
-        n++;
-      }
+    n += render_rank(sets, r, fen + n);
+    if (r > 0) fen[n++] = '/';
+  }
+  n += render_trailer(b, fen + n);
+  return copy_fen(fen, n, out, maxlen);
+}
+
+void board_fen_cache_init(FenCache* cache) {
+  memset(cache, 0, sizeof(*cache));
+}
+
+int board_to_fen_cached(const Board* b, FenCache* cache, char* out, int maxlen) {
+  char fen[BOARD_FEN_MAX];
+  u64 sets[12];
+  u64 changed = ~UINT64_C(0);
+  int n = 0;
+  board_piece_sets(b, sets);
+  if (cache->valid) {
+    changed = 0;
+    for (int i = 0; i < 12; i++) changed |= sets[i] ^ cache->sets[i];
+  }
+  for (int r = 7; r >= 0; r--) {
+    if ((changed >> (8 * r)) & 0xFF) {
+      cache->lens[r] = (uint8_t)render_rank(sets, r, cache->ranks[r]);
+      cache->rendered++;
     }
-    if (empty) n += snprintf(out + n, (size_t)(maxlen - n), "%d", empty);
-    if (r > 0) { if (n < maxlen) out[n] = '/'; n++; }
+    memcpy(fen + n, cache->ranks[r], cache->lens[r]);
+    n += cache->lens[r];
+    if (r > 0) fen[n++] = '/';
   }
-  n += snprintf(out + n, (size_t)(maxlen - n), " %s %s ", b->sideToMove == WHITE ? "w" : "b", b->castling[0] ? b->castling : "-");
-  if (b->enPassant >= 0)
-    n += snprintf(out + n, (size_t)(maxlen - n), "%c%d", 'a' + (b->enPassant % 8), b->enPassant / 8 + 1);
-  else
-    n += snprintf(out + n, (size_t)(maxlen - n), "-");
-  n += snprintf(out + n, (size_t)(maxlen - n), " %d %d", b->halfmove, b->fullmove);
-  if (n < maxlen) out[n] = '\0';
-  return n;
+  memcpy(cache->sets, sets, sizeof(sets));
+  cache->valid = true;
+  n += render_trailer(b, fen + n);
+  return copy_fen(fen, n, out, maxlen);
 }
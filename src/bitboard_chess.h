@@ -1,12 +1,15 @@
 #ifndef BITBOARD_CHESS_H
 #define BITBOARD_CHESS_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #define WHITE 0
 #define BLACK 1
 
+#define BOARD_MAX_MOVES 256
+
 typedef uint64_t u64;
 
 typedef struct {
@@ -21,8 +24,22 @@ typedef struct {
   int enPassant;
   int halfmove;
   int fullmove;
+  /* Material + piece-square scores from White's side and the game phase,
+   * kept by make_move, board_load_fen and board_reset (see EvalTables). */
+  int mg;
+  int eg;
+  int phase;
 } Board;
 
+/* Non-standard SAN forms accepted by the parser (ParseSANResult.normalized) */
+#define SAN_NORM_GLYPH 1            /* annotation glyphs: ! ? !! ?? !? ?! */
+#define SAN_NORM_EP_SUFFIX 2        /* "exd6e.p." */
+#define SAN_NORM_PROMO_NO_EQUALS 4  /* "e8Q" */
+#define SAN_NORM_TIMES_SIGN 8       /* "N×d4" (U+00D7) or ":" for the capture */
+#define SAN_NORM_FIGURINE 16        /* "♘f3", "e8=♕" */
+#define SAN_NORM_NULL_MOVE 32       /* "--" */
+#define SAN_NORM_KINDS 6
+
 typedef struct {
   int piece;       /* 'N'=78, 'B'=66, 'R'=82, 'Q'=81, 'K'=75, 0=pawn */
   int targetIndex;
@@ -30,8 +47,11 @@ typedef struct {
   int disambRank;  /* 0-7 or -1 */
   int promotion;   /* 'n','b','r','q' or 0 */
   int castle;      /* 'K' or 'Q' or 0 */
+  int nullMove;    /* 1 for "--" */
+  int normalized;  /* SAN_NORM_* forms seen */
 } ParseSANResult;
 
+/* from = to = -1 is a null move (pass). */
 typedef struct {
   int from;
   int to;
@@ -40,6 +60,48 @@ typedef struct {
   bool enpassant;
 } Move;
 
+/* Status codes for checked move resolution (board_check_move & co). */
+#define MOVE_OK 0
+#define MOVE_ERR_SYNTAX 1    /* not a SAN/UCI move */
+#define MOVE_ERR_NO_PIECE 2  /* no piece of that kind can reach the target */
+#define MOVE_ERR_ILLEGAL 3   /* blocked, wrong target, leaves king in check, bad castle/promotion */
+#define MOVE_ERR_AMBIGUOUS 4 /* more than one legal piece matches */
+
+/* Game end classification (board_game_end, replay) */
+#define GAME_END_UNFINISHED 0
+#define GAME_END_CHECKMATE 1
+#define GAME_END_STALEMATE 2
+#define GAME_END_INSUFFICIENT_MATERIAL 3
+#define GAME_END_THREEFOLD 4  /* needs move history: see replay_classify_end */
+#define GAME_END_FIFTY_MOVE 5
+
+/* Allocator hooks for every native structure (boards from board_create,
+ * replay batches, hash tables, tablebases, thread pools). malloc_fn,
+ * realloc_fn and free_fn are required; aligned_alloc_fn/aligned_free_fn
+ * (cache-line aligned hash tables and other large arrays) are set or
+ * left NULL together, NULL carving aligned blocks out of malloc_fn. All are
+ * called from worker threads too and get ctx as their last argument. */
+typedef struct {
+  void* (*malloc_fn)(size_t size, void* ctx);
+  void* (*realloc_fn)(void* p, size_t size, void* ctx);
+  void (*free_fn)(void* p, void* ctx);
+  void* (*aligned_alloc_fn)(size_t alignment, size_t size, void* ctx);
+  void (*aligned_free_fn)(void* p, void* ctx);
+  void* ctx;
+} BoardAllocator;
+
+/* Install hooks (NULL: libc). Call it while nothing allocated under the
+ * previous hooks is alive. Returns false, changing nothing, on an invalid set. */
+bool board_set_allocator(const BoardAllocator* allocator);
+void board_get_allocator(BoardAllocator* out);
+
+/* Caller-owned boards: mem must hold board_sizeof() bytes aligned to
+ * board_alignof(); board_init sets up the start position there and returns
+ * it as a Board. Such boards need no board_destroy. */
+size_t board_sizeof(void);
+size_t board_alignof(void);
+Board* board_init(void* mem);
+
 Board* board_create(void);
 void board_destroy(Board* b);
 void board_reset(Board* b);
@@ -51,7 +113,112 @@ void board_make_move(Board* b, const Move* move);
 uint64_t board_get_zobrist_key_lo(const Board* b);
 uint64_t board_get_zobrist_key_hi(const Board* b);
 
+uint64_t board_get_zobrist_key(const Board* b);
+
+/* Parse len bytes of SAN (no NUL needed) and resolve it, checked or not
+ * (MOVE_OK / MOVE_ERR_*); lets batch callers see ParseSANResult.normalized. */
+bool board_parse_san(const char* san, int len, ParseSANResult* out);
+int board_resolve_parsed_san(const Board* b, const ParseSANResult* parsed, bool checked, Move* out_move);
+
+/* Checked counterparts of resolve/make: verify the move is legal in b. */
+int board_check_move(const Board* b, const Move* move);
+int board_resolve_san_checked(const Board* b, const char* san, Move* out_move);
+/* Parse a UCI move ("e2e4", "e7e8q"), inferring castle and en passant from b.
+ * len is the token length (no NUL needed). Returns false on bad syntax. */
+bool board_parse_uci(const Board* b, const char* uci, int len, Move* out_move);
+/* Build a move from squares (0-63) and promotion ('q','r','b','n' or 0),
+ * inferring castling (king two files or onto its rook) and en passant. */
+void board_move_from_squares(const Board* b, int from, int to, int promotion, Move* out_move);
+
+/* Legal move generation. out must hold BOARD_MAX_MOVES; returns the count. */
+int board_generate_moves(const Board* b, Move* out);
+bool board_square_attacked(const Board* b, int sq, int by_color);
+bool board_in_check(const Board* b);
+bool board_insufficient_material(const Board* b);
+/* Checkmate, stalemate or insufficient material from the position alone. */
+int board_game_end(const Board* b);
+/* Writes the UCI form (e.g. "e7e8q") into out (>= 6 bytes). Returns length. */
+int board_move_to_uci(const Move* move, char* out);
+
+/* Attack tables, valid once any board has been created (or board_init_tables). */
+void board_init_tables(void);
+u64 board_knight_attacks(int sq);
+u64 board_king_attacks(int sq);
+u64 board_pawn_attacks(int color, int sq);
+u64 board_rook_attacks(int sq, u64 occ);
+u64 board_bishop_attacks(int sq, u64 occ);
+/* Squares strictly between a and b, and the whole rank, file or diagonal
+ * through both (a and b included); 0 when they are not aligned. */
+u64 board_between(int a, int b);
+u64 board_line(int a, int b);
+
+/* The twelve piece bitboards in the order P N B R Q K p n b r q k. */
+void board_piece_sets(const Board* b, u64 sets[12]);
+
+/* Packed position: what the Zobrist key covers, in BOARD_PACKED_SIZE bytes.
+ * Bytes 0-7 are the occupancy (little-endian), 8-23 a 4-bit piece code
+ * (board_piece_sets order, low nibble first) per occupied square in square
+ * order, 24 the flags below and 25 the en passant square or
+ * BOARD_PACKED_NO_EP; the rest is zero. Positions with the same placement,
+ * side, castling rights and en passant square pack to the same bytes. */
+#define BOARD_PACKED_SIZE 32
+#define BOARD_PACKED_CASTLE_K 1
+#define BOARD_PACKED_CASTLE_Q 2
+#define BOARD_PACKED_CASTLE_k 4
+#define BOARD_PACKED_CASTLE_q 8
+#define BOARD_PACKED_BLACK 16
+#define BOARD_PACKED_NO_EP 255
+
+/* Returns false, leaving out zeroed, for more than 32 pieces. */
+bool board_pack(const Board* b, uint8_t out[BOARD_PACKED_SIZE]);
+/* Load a packed position into b (halfmove 0, fullmove 1). Returns false,
+ * leaving b partly set, on a malformed one. */
+bool board_unpack(Board* b, const uint8_t in[BOARD_PACKED_SIZE]);
+
+/* Evaluation tables, indexed by piece kind P N B R Q K. Piece-square tables
+ * are for White with a1 = 0 and are mirrored vertically for Black. The phase
+ * is the sum of phase_weight over the pieces on the board; the tapered score
+ * blends mg and eg by it, capped at the start position's total (full
+ * midgame). */
+typedef struct {
+  int mg_value[6];
+  int eg_value[6];
+  int mg_pst[6][64];
+  int eg_pst[6][64];
+  int phase_weight[6];
+} EvalTables;
+
+void board_get_eval_tables(EvalTables* out);
+/* Replace the tables (NULL restores the defaults). Not thread-safe: call it
+ * while no board is being updated. Existing boards keep their scores until
+ * reloaded or passed to board_refresh_eval. */
+void board_set_eval_tables(const EvalTables* tables);
+/* Recompute b's mg, eg and phase from scratch. */
+void board_refresh_eval(Board* b);
+/* Tapered score from White's side, in centipawns. */
+int board_eval(const Board* b);
+/* Phase value of the start position (a full midgame). */
+int board_eval_phase_max(void);
+
+#define BOARD_FEN_MAX 128 /* longer than any FEN board_to_fen renders, NUL included */
+
 /* toFEN writes into out, max len 128. Returns length written (excluding null). */
 int board_to_fen(const Board* b, char* out, int maxlen);
 
+/* Per-board cache of rendered ranks for per-ply FEN export: each call
+ * re-renders only the ranks whose pieces changed since the last call (found
+ * by diffing the bitboards, so any way of changing the board is seen) and
+ * reuses the rest. Keep one cache per board for the reuse to pay off. */
+typedef struct {
+  u64 sets[12];       /* bitboards at the last render */
+  char ranks[8][8];   /* placement bytes per rank, rank 1 first */
+  uint8_t lens[8];
+  bool valid;
+  uint64_t rendered;  /* ranks rendered so far */
+} FenCache;
+
+void board_fen_cache_init(FenCache* cache);
+/* Same output as board_to_fen. */
+int board_to_fen_cached(const Board* b, FenCache* cache, char* out, int maxlen);
+
 #endif
@@ -0,0 +1,42 @@
+/* Bit-scan and popcount helpers shared by the C modules. */
+
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static __inline int bb_lsb(uint64_t bb) {
+  unsigned long i;
+  _BitScanForward64(&i, bb);
+  return (int)i;
+}
+static __inline int bb_msb(uint64_t bb) {
+  unsigned long i;
+  _BitScanReverse64(&i, bb);
+  return (int)i;
+}
+static __inline int bb_popcount(uint64_t bb) {
+  return (int)__popcnt64(bb);
+}
+#else
+static inline int bb_lsb(uint64_t bb) {
+  return __builtin_ctzll(bb);
+}
+static inline int bb_msb(uint64_t bb) {
+  return 63 - __builtin_clzll(bb);
+}
+static inline int bb_popcount(uint64_t bb) {
+  return __builtin_popcountll(bb);
+}
+#endif
+
+/* Return the lowest set square and clear it from *bb. bb must be non-zero. */
+static inline int bb_pop_lsb(uint64_t* bb) {
+  int sq = bb_lsb(*bb);
+  *bb &= *bb - 1;
+  return sq;
+}
+
+#endif
@@ -0,0 +1,232 @@
+/* Bulk FEN validation (see fencheck.h). The placement is parsed through a
+ * lookup table straight into bitboards, so the position checks are a few
+ * whole-board masks plus one attack test; lines are found with memchr. */
+
+#include "fencheck.h"
+#include "alloc.h"
+#include "bitboard_chess.h"
+#include "bitops.h"
+#include "pool.h"
+#include "threads.h"
+#include <string.h>
+
+#define CHUNKS_PER_THREAD 4
+#define MIN_CHUNK_BYTES (64 * 1024)
+
+#define RANK_1 UINT64_C(0x00000000000000FF)
+#define RANK_8 UINT64_C(0xFF00000000000000)
+
+static bool is_blank(char c) {
+  return c == ' ' || c == '\t';
+}
+
+/* 1 + piece index (P N B R Q K p n b r q k) of a placement character, 0 otherwise. */
+static const uint8_t PIECE_INDEX[256] = {
+  ['P'] = 1, ['N'] = 2, ['B'] = 3, ['R'] = 4, ['Q'] = 5, ['K'] = 6,
+  ['p'] = 7, ['n'] = 8, ['b'] = 9, ['r'] = 10, ['q'] = 11, ['k'] = 12,
+};
+
+/* Placement field into b's bitboards; returns FEN_OK, FEN_ERR_SYNTAX or FEN_ERR_RANKS. */
+static int parse_placement(Board* b, const char* p, const char* end) {
+  u64 sets[12] = { 0 };
+  int rank = 7, file = 0;
+  bool digit = false;
+  for (; p < end; p++) {
+    unsigned char c = (unsigned char)*p;
+    int piece = PIECE_INDEX[c];
+    if (piece) {
+      if (file >= 8) return FEN_ERR_RANKS;
+      sets[piece - 1] |= UINT64_C(1) << (rank * 8 + file++);
+      digit = false;
+    } else if (c >= '1' && c <= '8') {
+      if (digit) return FEN_ERR_SYNTAX;
+      digit = true;
+      file += c - '0';
+      if (file > 8) return FEN_ERR_RANKS;
+    } else if (c == '/') {
+      if (file != 8 || rank == 0) return FEN_ERR_RANKS;
+      rank--;
+      file = 0;
+      digit = false;
+    } else {
+      return FEN_ERR_SYNTAX;
+    }
+  }
+  for (int color = WHITE; color <= BLACK; color++) {
+    const u64* s = sets + 6 * color;
+    b->pawns[color] = s[0];
+    b->knights[color] = s[1];
+    b->bishops[color] = s[2];
+    b->rooks[color] = s[3];
+    b->queens[color] = s[4];
+    b->kings[color] = s[5];
+  }
+  return rank == 0 && file == 8 ? FEN_OK : FEN_ERR_RANKS;
+}
+
+/* Next space-separated field of [*p, end) into [*start, *stop); false when none is left. */
+static bool next_field(const char** p, const char* end, const char** start, const char** stop) {
+  while (*p < end && is_blank(**p)) (*p)++;
+  if (*p == end) return false;
+  *start = *p;
+  while (*p < end && !is_blank(**p)) (*p)++;
+  *stop = *p;
+  return true;
+}
+
+static bool all_digits(const char* p, const char* end) {
+  if (p == end) return false;
+  for (; p < end; p++) {
+    if (*p < '0' || *p > '9') return false;
+  }
+  return true;
+}
+
+static u64 occupied(const Board* b) {
+  u64 occ = 0;
+  for (int c = WHITE; c <= BLACK; c++) {
+    occ |= b->pawns[c] | b->knights[c] | b->bishops[c] | b->rooks[c] | b->queens[c] | b->kings[c];
+  }
+  return occ;
+}
+
+static bool castling_ok(const Board* b) {
+  for (const char* c = b->castling; *c; c++) {
+    int color = (*c == 'K' || *c == 'Q') ? WHITE : BLACK;
+    int home = color == WHITE ? 0 : 56;
+    int rook = home + ((*c == 'K' || *c == 'k') ? 7 : 0);
+    if (!(b->kings[color] & (UINT64_C(1) << (home + 4)))) return false;
+    if (!(b->rooks[color] & (UINT64_C(1) << rook))) return false;
+  }
+  return true;
+}
+
+/* The square was just passed by a double push of the side not to move: the
+ * pawn stands in front of it, and it and the square it came from are empty. */
+static bool en_passant_ok(const Board* b) {
+  int ep = b->enPassant;
+  int mover = b->sideToMove ^ 1;
+  int ahead = mover == WHITE ? 8 : -8;
+  if (ep / 8 != (mover == WHITE ? 2 : 5)) return false;
+  if (!(b->pawns[mover] & (UINT64_C(1) << (ep + ahead)))) return false;
+  return !(occupied(b) & ((UINT64_C(1) << ep) | (UINT64_C(1) << (ep - ahead))));
+}
+
+int fen_check(const char* fen, size_t len) {
+  const char* p = fen;
+  const char* end = fen + len;
+  const char* start;
+  const char* stop;
+  Board b;
+  memset(&b, 0, sizeof(b));
+  b.enPassant = -1;
+  while (end > p && (is_blank(end[-1]) || end[-1] == '\r')) end--;
+
+  if (!next_field(&p, end, &start, &stop)) return FEN_ERR_EMPTY;
+  int status = parse_placement(&b, start, stop);
+  if (status != FEN_OK) return status;
+
+  if (!next_field(&p, end, &start, &stop) || stop - start != 1 || (*start != 'w' && *start != 'b')) return FEN_ERR_SYNTAX;
+  b.sideToMove = *start == 'w' ? WHITE : BLACK;
+
+  if (!next_field(&p, end, &start, &stop) || stop - start > 4) return FEN_ERR_SYNTAX;
+  if (!(stop - start == 1 && *start == '-')) {
+    int n = 0;
+    for (const char* c = start; c < stop; c++) {
+      if (!strchr("KQkq", *c) || memchr(b.castling, *c, (size_t)n)) return FEN_ERR_SYNTAX;
+      b.castling[n++] = *c;
+    }
+    b.castling[n] = '\0';
+  }
+
+  if (!next_field(&p, end, &start, &stop)) return FEN_ERR_SYNTAX;
+  if (!(stop - start == 1 && *start == '-')) {
+    if (stop - start != 2 || start[0] < 'a' || start[0] > 'h' || start[1] < '1' || start[1] > '8') return FEN_ERR_SYNTAX;
+    b.enPassant = (start[1] - '1') * 8 + (start[0] - 'a');
+  }
+
+  /* Move counters are optional, but both or neither. */
+  if (next_field(&p, end, &start, &stop)) {
+    if (!all_digits(start, stop)) return FEN_ERR_SYNTAX;
+    if (!next_field(&p, end, &start, &stop) || !all_digits(start, stop)) return FEN_ERR_SYNTAX;
+    if (next_field(&p, end, &start, &stop)) return FEN_ERR_SYNTAX;
+  }
+
+  if (bb_popcount(b.kings[WHITE]) != 1 || bb_popcount(b.kings[BLACK]) != 1) return FEN_ERR_KINGS;
+  if ((b.pawns[WHITE] | b.pawns[BLACK]) & (RANK_1 | RANK_8)) return FEN_ERR_PAWNS;
+  if (!castling_ok(&b)) return FEN_ERR_CASTLING;
+  if (b.enPassant >= 0 && !en_passant_ok(&b)) return FEN_ERR_EN_PASSANT;
+  if (board_square_attacked(&b, bb_lsb(b.kings[b.sideToMove ^ 1]), b.sideToMove)) return FEN_ERR_CHECK;
+  return FEN_OK;
+}
+
+size_t fen_line_count(const char* buf, size_t len) {
+  size_t lines = 0;
+  const char* p = buf;
+  const char* end = buf + len;
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    lines++;
+    if (!nl) break;
+    p = nl + 1;
+  }
+  return lines;
+}
+
+typedef struct {
+  const char* start;
+  const char* end;
+  uint8_t* out; /* status of the chunk's first line */
+} FenChunk;
+
+static void check_chunk(void* arg, int worker) {
+  FenChunk* c = (FenChunk*)arg;
+  const char* p = c->start;
+  uint8_t* out = c->out;
+  (void)worker;
+  while (p < c->end) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(c->end - p));
+    const char* stop = nl ? nl : c->end;
+    *out++ = (uint8_t)fen_check(p, (size_t)(stop - p));
+    p = stop + 1;
+  }
+}
+
+bool fen_check_lines(const char* buf, size_t len, int threads, uint8_t* out) {
+  const char* p = buf;
+  const char* end = buf + len;
+  board_init_tables();
+  if (threads <= 0) threads = bc_cpu_count();
+  size_t nchunks = (size_t)threads * CHUNKS_PER_THREAD;
+  if (nchunks > len / MIN_CHUNK_BYTES + 1) nchunks = len / MIN_CHUNK_BYTES + 1;
+  if (threads == 1) nchunks = 1;
+
+  FenChunk* chunks = (FenChunk*)bc_calloc(nchunks, sizeof(FenChunk));
+  if (!chunks) return false;
+  size_t count = 0;
+  while (p < end && count < nchunks) {
+    const char* stop = count + 1 == nchunks ? end : p + len / nchunks;
+    if (stop < end) {
+      const char* brk = (const char*)memchr(stop, '\n', (size_t)(end - stop));
+      stop = brk ? brk + 1 : end;
+    }
+    FenChunk* c = &chunks[count++];
+    c->start = p;
+    c->end = stop;
+    c->out = out;
+    out += fen_line_count(p, (size_t)(stop - p));
+    p = stop;
+  }
+
+  Pool* pool = (threads != 1 && count > 1) ? pool_create(threads) : NULL;
+  for (size_t i = 0; i < count; i++) {
+    if (pool && pool_submit(pool, -1, check_chunk, &chunks[i])) continue;
+    check_chunk(&chunks[i], -1);
+  }
+  if (pool) {
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+  bc_free(chunks);
+  return true;
+}
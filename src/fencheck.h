@@ -0,0 +1,33 @@
+#ifndef FENCHECK_H
+#define FENCHECK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* FEN sanity checks for scraped datasets. board_load_fen accepts anything and
+ * skips what it cannot read; these reject what it would misread and
+ * positions that cannot arise in a game. A non-blank line gets the first
+ * check it fails, in the order of the codes. */
+
+#define FEN_OK 0
+#define FEN_ERR_SYNTAX 1     /* unknown character, adjacent digits, missing or extra fields */
+#define FEN_ERR_RANKS 2      /* not 8 ranks of 8 files */
+#define FEN_ERR_KINGS 3      /* not exactly one king per side */
+#define FEN_ERR_PAWNS 4      /* pawn on the first or last rank */
+#define FEN_ERR_CASTLING 5   /* castling right without its king and rook at home */
+#define FEN_ERR_EN_PASSANT 6 /* ep square not just passed by a pawn of the side not to move */
+#define FEN_ERR_CHECK 7      /* the side not to move is in check */
+#define FEN_ERR_EMPTY 8      /* blank line */
+
+/* Check one FEN of len bytes (surrounding spaces and a trailing '\r' are ignored). */
+int fen_check(const char* fen, size_t len);
+
+/* Lines of buf ('\n'-separated; a final '\n' ends the last line). */
+size_t fen_line_count(const char* buf, size_t len);
+
+/* Check every line of buf into out[fen_line_count(buf, len)], splitting the
+ * lines across threads (<= 0: one per CPU). Returns false on allocation failure. */
+bool fen_check_lines(const char* buf, size_t len, int threads, uint8_t* out);
+
+#endif
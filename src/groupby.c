@@ -0,0 +1,608 @@
+/* Tag-keyed group-by over batch PGN replay (see groupby.h). A table keeps its
+ * groups' keys in one byte arena and their aggregator states in fixed-size
+ * records (state_size bytes each, an offset per aggregator), found through
+ * an open-addressing index of group numbers. A DISTINCT state keeps its
+ * HyperLogLog registers as sorted register/rank pairs until they would take
+ * more room than the HLL_REGS dense registers, so small groups stay small. */
+
+#include "groupby.h"
+#include "alloc.h"
+#include "bitops.h"
+#include "pgn.h"
+#include "pool.h"
+#include "replay.h"
+#include "threads.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNKS_PER_THREAD 4
+#define MIN_CHUNK_BYTES (256 * 1024)
+#define HLL_BITS 12
+#define HLL_REGS (1 << HLL_BITS)
+#define HLL_SPARSE_MAX (HLL_REGS / 4) /* pairs of 4 bytes before switching to dense registers */
+#define EMPTY_SLOT UINT32_MAX
+
+typedef struct {
+  int64_t value;
+  uint64_t n;
+} ValueState;
+
+typedef struct {
+  GroupMoveCount* items;
+  uint32_t count;
+  uint32_t cap;
+} MovesState;
+
+typedef struct {
+  uint32_t* pairs; /* sparse: register << 8 | rank, ascending, the registers set so far */
+  uint8_t* regs;   /* dense: HLL_REGS registers, or NULL while sparse */
+  uint32_t count;
+  uint32_t cap;
+} HllState;
+
+typedef struct {
+  uint64_t hash;
+  size_t key_off;
+  uint32_t key_len;
+  uint32_t top_count[GROUP_MAX_AGGS]; /* after group_finish: moves kept per TOP_FIRST */
+} GroupEntry;
+
+typedef struct {
+  const char* key;
+  uint32_t key_len;
+  size_t group;
+} SortKey;
+
+struct GroupTable {
+  GroupSpec spec;
+  size_t agg_off[GROUP_MAX_AGGS];
+  size_t state_size;
+  GroupEntry* entries;
+  uint8_t* states;
+  size_t count;
+  size_t cap;
+  uint32_t* slots;
+  size_t slot_mask;
+  char* keys;
+  size_t keys_len;
+  size_t keys_cap;
+  bool oom;
+};
+
+static uint64_t hash_bytes(const char* p, size_t n) {
+  uint64_t h = 1469598103934665603ULL; /* FNV-1a */
+  for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)p[i]) * 1099511628211ULL;
+  return h;
+}
+
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static GroupTable* table_create(const GroupSpec* spec) {
+  GroupTable* t = (GroupTable*)bc_calloc(1, sizeof(GroupTable));
+  if (!t) return NULL;
+  t->spec = *spec;
+  size_t off = 0;
+  for (int a = 0; a < spec->agg_count; a++) {
+    t->agg_off[a] = off;
+    switch (spec->aggs[a].kind) {
+      case GROUP_AGG_COUNT: off += sizeof(uint64_t); break;
+      case GROUP_AGG_DISTINCT: off += sizeof(HllState); break;
+      case GROUP_AGG_TOP_FIRST: off += sizeof(MovesState); break;
+      default: off += sizeof(ValueState); break;
+    }
+  }
+  t->state_size = (off + 7) & ~(size_t)7;
+  t->slot_mask = 63;
+  t->slots = (uint32_t*)bc_malloc((t->slot_mask + 1) * sizeof(uint32_t));
+  if (!t->slots) {
+    bc_free(t);
+    return NULL;
+  }
+  memset(t->slots, 0xff, (t->slot_mask + 1) * sizeof(uint32_t));
+  return t;
+}
+
+static uint8_t* group_record(const GroupTable* t, size_t g) {
+  return t->states + g * t->state_size;
+}
+
+static uint8_t* group_state(const GroupTable* t, size_t g, int a) {
+  return group_record(t, g) + t->agg_off[a];
+}
+
+void group_table_free(GroupTable* t) {
+  if (!t) return;
+  for (size_t i = 0; i < t->count; i++) {
+    for (int a = 0; a < t->spec.agg_count; a++) {
+      uint8_t* s = group_state(t, i, a);
+      if (t->spec.aggs[a].kind == GROUP_AGG_TOP_FIRST) {
+        bc_free(((MovesState*)s)->items);
+      } else if (t->spec.aggs[a].kind == GROUP_AGG_DISTINCT) {
+        bc_free(((HllState*)s)->pairs);
+        bc_free(((HllState*)s)->regs);
+      }
+    }
+  }
+  bc_free(t->entries);
+  bc_free(t->states);
+  bc_free(t->slots);
+  bc_free(t->keys);
+  bc_free(t);
+}
+
+static bool grow_slots(GroupTable* t) {
+  size_t n = (t->slot_mask + 1) * 2;
+  uint32_t* slots = (uint32_t*)bc_malloc(n * sizeof(uint32_t));
+  if (!slots) return false;
+  memset(slots, 0xff, n * sizeof(uint32_t));
+  for (size_t g = 0; g < t->count; g++) {
+    size_t s = t->entries[g].hash & (n - 1);
+    while (slots[s] != EMPTY_SLOT) s = (s + 1) & (n - 1);
+    slots[s] = (uint32_t)g;
+  }
+  bc_free(t->slots);
+  t->slots = slots;
+  t->slot_mask = n - 1;
+  return true;
+}
+
+/* The group of key[0..len), added with fresh states when new; -1 on OOM. */
+static long find_group(GroupTable* t, const char* key, size_t len) {
+  uint64_t h = hash_bytes(key, len);
+  size_t s = h & t->slot_mask;
+  for (; t->slots[s] != EMPTY_SLOT; s = (s + 1) & t->slot_mask) {
+    const GroupEntry* e = &t->entries[t->slots[s]];
+    if (e->hash == h && e->key_len == len && memcmp(t->keys + e->key_off, key, len) == 0) return (long)t->slots[s];
+  }
+  if (t->count == t->cap) {
+    size_t cap = t->cap ? t->cap * 2 : 64;
+    GroupEntry* entries = (GroupEntry*)bc_realloc(t->entries, cap * sizeof(GroupEntry));
+    if (!entries) return -1;
+    t->entries = entries;
+    uint8_t* states = (uint8_t*)bc_realloc(t->states, cap * t->state_size);
+    if (!states) return -1;
+    t->states = states;
+    t->cap = cap;
+  }
+  if (t->keys_len + len > t->keys_cap) {
+    size_t cap = t->keys_cap ? t->keys_cap : 4096;
+    while (cap < t->keys_len + len) cap *= 2;
+    char* keys = (char*)bc_realloc(t->keys, cap);
+    if (!keys) return -1;
+    t->keys = keys;
+    t->keys_cap = cap;
+  }
+  size_t g = t->count++;
+  GroupEntry* e = &t->entries[g];
+  memset(e, 0, sizeof(*e));
+  e->hash = h;
+  e->key_off = t->keys_len;
+  e->key_len = (uint32_t)len;
+  memcpy(t->keys + t->keys_len, key, len);
+  t->keys_len += len;
+  memset(t->states + g * t->state_size, 0, t->state_size);
+  t->slots[s] = (uint32_t)g;
+  if (t->count * 2 > t->slot_mask + 1 && !grow_slots(t)) return -1;
+  return (long)g;
+}
+
+/* ---- keys ---- */
+
+static bool parse_int(const char* v, size_t n, int64_t* out) {
+  size_t i = 0;
+  bool neg = false;
+  int64_t x = 0;
+  if (i < n && (v[i] == '-' || v[i] == '+')) neg = v[i++] == '-';
+  if (i == n) return false;
+  for (; i < n; i++) {
+    if (v[i] < '0' || v[i] > '9' || x > (INT64_MAX - 9) / 10) return false;
+    x = x * 10 + (v[i] - '0');
+  }
+  *out = neg ? -x : x;
+  return true;
+}
+
+static bool all_digits(const char* v, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    if (v[i] < '0' || v[i] > '9') return false;
+  }
+  return true;
+}
+
+/* Append the bucketed value of k for game to key at *len (NUL-terminated). */
+static void append_key(const GroupKey* k, const PgnGame* game, char* key, size_t* len) {
+  const char* v;
+  size_t n;
+  char* out = key + *len;
+  size_t w = 0;
+  bool found = pgn_get_tag(game, k->tag, &v, &n);
+  if (found) {
+    if (k->bucket == GROUP_BUCKET_VALUE) {
+      w = n < GROUP_VALUE_MAX ? n : GROUP_VALUE_MAX;
+      memcpy(out, v, w);
+    } else if (k->bucket == GROUP_BUCKET_NUMBER) {
+      int64_t x;
+      int64_t width = k->width > 0 ? k->width : 1;
+      if (parse_int(v, n, &x)) {
+        x -= ((x % width) + width) % width;
+        w = (size_t)snprintf(out, 24, "%lld", (long long)x);
+      }
+    } else if (n >= 4 && all_digits(v, 4)) {
+      if (k->bucket == GROUP_BUCKET_YEAR) {
+        memcpy(out, v, 4);
+        w = 4;
+      } else if (n >= 7 && (v[4] == '.' || v[4] == '-') && all_digits(v + 5, 2)) {
+        memcpy(out, v, 7);
+        out[4] = '.';
+        w = 7;
+      }
+    }
+  }
+  if (w == 0 && !(found && k->bucket == GROUP_BUCKET_VALUE)) out[w++] = '?';
+  out[w++] = '\0';
+  *len += w;
+}
+
+/* ---- aggregation ---- */
+
+typedef struct {
+  GroupTable* t;
+  size_t group;
+  int plies;
+  char first[6];
+} GameCtx;
+
+static bool hll_densify(HllState* s) {
+  uint8_t* regs = (uint8_t*)bc_calloc(HLL_REGS, 1);
+  if (!regs) return false;
+  for (uint32_t i = 0; i < s->count; i++) regs[s->pairs[i] >> 8] = (uint8_t)(s->pairs[i] & 0xFF);
+  bc_free(s->pairs);
+  s->pairs = NULL;
+  s->count = s->cap = 0;
+  s->regs = regs;
+  return true;
+}
+
+/* Raise register reg to rank; false on OOM. */
+static bool hll_set(HllState* s, uint32_t reg, uint8_t rank) {
+  if (s->regs) {
+    if (rank > s->regs[reg]) s->regs[reg] = rank;
+    return true;
+  }
+  uint32_t lo = 0, hi = s->count;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (s->pairs[mid] >> 8 < reg) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < s->count && s->pairs[lo] >> 8 == reg) {
+    if (rank > (s->pairs[lo] & 0xFF)) s->pairs[lo] = reg << 8 | rank;
+    return true;
+  }
+  if (s->count == HLL_SPARSE_MAX) return hll_densify(s) && hll_set(s, reg, rank);
+  if (s->count == s->cap) {
+    uint32_t cap = s->cap ? s->cap * 2 : 16;
+    uint32_t* pairs = (uint32_t*)bc_realloc(s->pairs, cap * sizeof(uint32_t));
+    if (!pairs) return false;
+    s->pairs = pairs;
+    s->cap = cap;
+  }
+  memmove(s->pairs + lo + 1, s->pairs + lo, (s->count - lo) * sizeof(uint32_t));
+  s->pairs[lo] = reg << 8 | rank;
+  s->count++;
+  return true;
+}
+
+static bool hll_add(HllState* s, uint64_t key) {
+  uint64_t h = mix64(key);
+  uint64_t rest = (h << HLL_BITS) | ((uint64_t)1 << (HLL_BITS - 1));
+  return hll_set(s, (uint32_t)(h >> (64 - HLL_BITS)), (uint8_t)(64 - bb_msb(rest)));
+}
+
+static bool hll_merge(HllState* d, const HllState* s) {
+  if (s->regs) {
+    if (!d->regs && !hll_densify(d)) return false;
+    for (int r = 0; r < HLL_REGS; r++) d->regs[r] = d->regs[r] > s->regs[r] ? d->regs[r] : s->regs[r];
+    return true;
+  }
+  for (uint32_t i = 0; i < s->count; i++) {
+    if (!hll_set(d, s->pairs[i] >> 8, (uint8_t)(s->pairs[i] & 0xFF))) return false;
+  }
+  return true;
+}
+
+/* Both forms sum the set registers in register order, then the zeros, so a
+ * group gives the same estimate whichever form it ended in. */
+static double hll_estimate(const HllState* s) {
+  double sum = 0;
+  int zeros = HLL_REGS;
+  if (s->regs) {
+    for (int i = 0; i < HLL_REGS; i++) {
+      if (!s->regs[i]) continue;
+      sum += ldexp(1.0, -s->regs[i]);
+      zeros--;
+    }
+  } else {
+    for (uint32_t i = 0; i < s->count; i++) sum += ldexp(1.0, -(int)(s->pairs[i] & 0xFF));
+    zeros -= (int)s->count;
+  }
+  sum += zeros;
+  double m = HLL_REGS;
+  double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  if (e <= 2.5 * m && zeros) e = m * log(m / zeros);
+  return floor(e + 0.5);
+}
+
+static void on_ply(void* ctx, const Board* b, const Move* move, uint64_t key) {
+  GameCtx* c = (GameCtx*)ctx;
+  GroupTable* t = c->t;
+  (void)b;
+  if (c->plies++ == 0) board_move_to_uci(move, c->first);
+  for (int a = 0; a < t->spec.agg_count; a++) {
+    if (t->spec.aggs[a].kind == GROUP_AGG_DISTINCT && !hll_add((HllState*)group_state(t, c->group, a), key))
+      t->oom = true;
+  }
+}
+
+/* Fold n values (their sum, min or max v) into s. */
+static void fold_value(ValueState* s, int kind, int64_t v, uint64_t n) {
+  if (s->n == 0) s->value = v;
+  else if (kind == GROUP_AGG_SUM) s->value += v;
+  else if (kind == GROUP_AGG_MIN ? v < s->value : v > s->value) s->value = v;
+  s->n += n;
+}
+
+static bool add_moves(MovesState* s, const char* move, uint64_t count) {
+  for (uint32_t i = 0; i < s->count; i++) {
+    if (strcmp(s->items[i].move, move) == 0) {
+      s->items[i].count += count;
+      return true;
+    }
+  }
+  if (s->count == s->cap) {
+    uint32_t cap = s->cap ? s->cap * 2 : 8;
+    GroupMoveCount* items = (GroupMoveCount*)bc_realloc(s->items, cap * sizeof(GroupMoveCount));
+    if (!items) return false;
+    s->items = items;
+    s->cap = cap;
+  }
+  memcpy(s->items[s->count].move, move, sizeof(s->items[0].move));
+  s->items[s->count++].count = count;
+  return true;
+}
+
+static void group_game(GroupTable* t, Board* b, const PgnGame* game) {
+  char key[GROUP_MAX_KEYS * (GROUP_VALUE_MAX + 1)];
+  size_t len = 0;
+  for (int j = 0; j < t->spec.key_count; j++) append_key(&t->spec.keys[j], game, key, &len);
+  long g = find_group(t, key, len);
+  if (g < 0) {
+    t->oom = true;
+    return;
+  }
+  GameCtx c = { t, (size_t)g, 0, "" };
+  ReplayOptions opts = { t->spec.flags, on_ply, &c, NULL };
+  if (replay_game_start(b, game)) replay_movetext(b, game->moves, game->moves_len, &opts);
+  for (int a = 0; a < t->spec.agg_count; a++) {
+    const GroupAgg* agg = &t->spec.aggs[a];
+    uint8_t* s = group_state(t, c.group, a);
+    int64_t v = c.plies;
+    switch (agg->kind) {
+      case GROUP_AGG_COUNT: (*(uint64_t*)s)++; break;
+      case GROUP_AGG_DISTINCT: break;
+      case GROUP_AGG_TOP_FIRST:
+        if (c.plies && !add_moves((MovesState*)s, c.first, 1)) t->oom = true;
+        break;
+      default: {
+        const char* tv;
+        size_t n;
+        if (agg->value == GROUP_VALUE_TAG && !(pgn_get_tag(game, agg->tag, &tv, &n) && parse_int(tv, n, &v))) break;
+        fold_value((ValueState*)s, agg->kind, v, 1);
+      }
+    }
+  }
+}
+
+/* Fold every group of src into dst. A group new to dst takes src's states
+ * as they are, leaving src's record empty. */
+static bool merge_table(GroupTable* dst, GroupTable* src) {
+  for (size_t i = 0; i < src->count; i++) {
+    const GroupEntry* e = &src->entries[i];
+    size_t before = dst->count;
+    long g = find_group(dst, src->keys + e->key_off, e->key_len);
+    if (g < 0) return false;
+    if ((size_t)g == before) {
+      memcpy(group_record(dst, (size_t)g), group_record(src, i), src->state_size);
+      memset(group_record(src, i), 0, src->state_size);
+      continue;
+    }
+    for (int a = 0; a < dst->spec.agg_count; a++) {
+      int kind = dst->spec.aggs[a].kind;
+      uint8_t* d = group_state(dst, (size_t)g, a);
+      const uint8_t* s = group_state(src, i, a);
+      if (kind == GROUP_AGG_COUNT) {
+        *(uint64_t*)d += *(const uint64_t*)s;
+      } else if (kind == GROUP_AGG_DISTINCT) {
+        if (!hll_merge((HllState*)d, (const HllState*)s)) return false;
+      } else if (kind == GROUP_AGG_TOP_FIRST) {
+        const MovesState* m = (const MovesState*)s;
+        for (uint32_t k = 0; k < m->count; k++) {
+          if (!add_moves((MovesState*)d, m->items[k].move, m->items[k].count)) return false;
+        }
+      } else if (((const ValueState*)s)->n) {
+        fold_value((ValueState*)d, kind, ((const ValueState*)s)->value, ((const ValueState*)s)->n);
+      }
+    }
+  }
+  return true;
+}
+
+static int cmp_keys(const void* a, const void* b) {
+  const SortKey* x = (const SortKey*)a;
+  const SortKey* y = (const SortKey*)b;
+  int c = memcmp(x->key, y->key, x->key_len < y->key_len ? x->key_len : y->key_len);
+  return c ? c : (x->key_len > y->key_len) - (x->key_len < y->key_len);
+}
+
+static int cmp_moves(const void* a, const void* b) {
+  const GroupMoveCount* x = (const GroupMoveCount*)a;
+  const GroupMoveCount* y = (const GroupMoveCount*)b;
+  if (x->count != y->count) return x->count < y->count ? 1 : -1;
+  return strcmp(x->move, y->move);
+}
+
+/* Reorder the groups by key, in place, and sort each TOP_FIRST list. The slot
+ * index is stale afterwards; no group is looked up again. */
+static bool group_finish(GroupTable* t) {
+  size_t n = t->count;
+  SortKey* order = (SortKey*)bc_malloc((n ? n : 1) * sizeof(SortKey));
+  uint8_t* held = (uint8_t*)bc_malloc(t->state_size ? t->state_size : 1);
+  if (!order || !held) {
+    bc_free(order);
+    bc_free(held);
+    return false;
+  }
+  for (size_t g = 0; g < n; g++) {
+    SortKey k = { t->keys + t->entries[g].key_off, t->entries[g].key_len, g };
+    order[g] = k;
+  }
+  qsort(order, n, sizeof(SortKey), cmp_keys);
+  /* Group order[i].group moves to i: follow each cycle of the permutation,
+   * holding its first group aside and marking slots done as they fill. */
+  for (size_t i = 0; i < n; i++) {
+    if (order[i].group == i) continue;
+    GroupEntry entry = t->entries[i];
+    memcpy(held, group_record(t, i), t->state_size);
+    size_t j = i;
+    for (;;) {
+      size_t from = order[j].group;
+      order[j].group = j;
+      if (from == i) break;
+      t->entries[j] = t->entries[from];
+      memcpy(group_record(t, j), group_record(t, from), t->state_size);
+      j = from;
+    }
+    t->entries[j] = entry;
+    memcpy(group_record(t, j), held, t->state_size);
+  }
+  bc_free(order);
+  bc_free(held);
+  for (size_t g = 0; g < n; g++) {
+    for (int a = 0; a < t->spec.agg_count; a++) {
+      if (t->spec.aggs[a].kind != GROUP_AGG_TOP_FIRST) continue;
+      MovesState* m = (MovesState*)group_state(t, g, a);
+      int k = t->spec.aggs[a].k;
+      qsort(m->items, m->count, sizeof(GroupMoveCount), cmp_moves);
+      t->entries[g].top_count[a] = k > 0 && (uint32_t)k < m->count ? (uint32_t)k : m->count;
+    }
+  }
+  return true;
+}
+
+/* ---- driver ---- */
+
+typedef struct {
+  const char* start;
+  const char* end;
+  GroupTable** tables; /* one per worker, index worker + 1 */
+} GroupChunk;
+
+static void group_chunk(void* arg, int worker) {
+  GroupChunk* c = (GroupChunk*)arg;
+  GroupTable* t = c->tables[worker + 1];
+  Board b;
+  PgnGame game;
+  size_t pos = 0, counted = 0;
+  size_t len = (size_t)(c->end - c->start);
+  Job* job = t->spec.job;
+  while (!t->oom && !job_cancelled(job) && pgn_next_game(c->start, len, &pos, &game)) {
+    group_game(t, &b, &game);
+    job_advance(job, pos - counted);
+    counted = pos;
+  }
+  if (!t->oom && !job_cancelled(job)) job_advance(job, len - counted);
+}
+
+GroupTable* group_pgn(const char* buf, size_t len, const GroupSpec* spec) {
+  const char* p = buf;
+  const char* end = buf + len;
+  int threads = spec->threads > 0 ? spec->threads : bc_cpu_count();
+  board_init_tables();
+  job_set_total(spec->job, len);
+  size_t nchunks = (size_t)threads * CHUNKS_PER_THREAD;
+  if (nchunks > len / MIN_CHUNK_BYTES + 1) nchunks = len / MIN_CHUNK_BYTES + 1;
+  if (threads == 1) nchunks = 1;
+
+  GroupChunk* chunks = (GroupChunk*)bc_calloc(nchunks, sizeof(GroupChunk));
+  if (!chunks) return NULL;
+  size_t count = 0;
+  while (p < end && count < nchunks) {
+    const char* stop = count + 1 == nchunks ? end : pgn_find_game_start(p + len / nchunks, end);
+    chunks[count].start = p;
+    chunks[count++].end = stop;
+    p = stop;
+  }
+
+  Pool* pool = (threads != 1 && count > 1) ? pool_create(threads) : NULL;
+  int ntables = pool ? pool_size(pool) + 1 : 1;
+  GroupTable** tables = (GroupTable**)bc_calloc((size_t)ntables, sizeof(GroupTable*));
+  bool ok = tables != NULL;
+  for (int i = 0; ok && i < ntables; i++) ok = (tables[i] = table_create(spec)) != NULL;
+  for (size_t i = 0; ok && i < count; i++) {
+    chunks[i].tables = tables;
+    if (pool && pool_submit(pool, -1, group_chunk, &chunks[i])) continue;
+    group_chunk(&chunks[i], -1);
+  }
+  if (pool) {
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+
+  for (int i = 0; ok && i < ntables; i++) ok = !tables[i]->oom && (i == 0 || merge_table(tables[0], tables[i]));
+  if (ok) ok = group_finish(tables[0]);
+  GroupTable* out = ok ? tables[0] : NULL;
+  for (int i = ok ? 1 : 0; tables && i < ntables; i++) group_table_free(tables[i]);
+  bc_free(tables);
+  bc_free(chunks);
+  return out;
+}
+
+/* ---- results ---- */
+
+size_t group_count(const GroupTable* t) {
+  return t->count;
+}
+
+const char* group_key(const GroupTable* t, size_t i, int j, size_t* len) {
+  const char* k = t->keys + t->entries[i].key_off;
+  for (; j > 0; j--) k += strlen(k) + 1;
+  *len = strlen(k);
+  return k;
+}
+
+bool group_value(const GroupTable* t, size_t i, int a, double* out) {
+  const uint8_t* s = group_state(t, i, a);
+  switch (t->spec.aggs[a].kind) {
+    case GROUP_AGG_COUNT: *out = (double)*(const uint64_t*)s; return true;
+    case GROUP_AGG_DISTINCT: *out = hll_estimate((const HllState*)s); return true;
+    case GROUP_AGG_TOP_FIRST: return false;
+    case GROUP_AGG_SUM: *out = (double)((const ValueState*)s)->value; return true;
+    default:
+      *out = (double)((const ValueState*)s)->value;
+      return ((const ValueState*)s)->n > 0;
+  }
+}
+
+int group_top_moves(const GroupTable* t, size_t i, int a, const GroupMoveCount** out) {
+  if (t->spec.aggs[a].kind != GROUP_AGG_TOP_FIRST) return 0;
+  *out = ((const MovesState*)group_state(t, i, a))->items;
+  return (int)t->entries[i].top_count[a];
+}
@@ -0,0 +1,89 @@
+#ifndef GROUPBY_H
+#define GROUPBY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "job.h"
+
+/* Group-by aggregation over batch PGN replay. Every game is replayed and
+ * folded into the group named by a few of its tags, each optionally
+ * bucketed. The input is cut into game-aligned chunks run as pool tasks;
+ * each worker aggregates into its own hash table of groups, and the tables
+ * are merged at the end. */
+
+#define GROUP_MAX_KEYS 8
+#define GROUP_MAX_AGGS 16
+#define GROUP_TAG_MAX 32
+#define GROUP_VALUE_MAX 256 /* longer tag values are cut to this many bytes */
+
+/* How a tag value becomes part of the group key. A missing tag, or a value
+ * the bucket cannot read, gives "?". */
+#define GROUP_BUCKET_VALUE 0  /* as is */
+#define GROUP_BUCKET_NUMBER 1 /* integer rounded down to a multiple of width: 2437 by 100 is "2400" */
+#define GROUP_BUCKET_MONTH 2  /* "YYYY.MM" of a PGN date ("2024.03.15" or "2024-03-15") */
+#define GROUP_BUCKET_YEAR 3   /* "YYYY" */
+
+typedef struct {
+  char tag[GROUP_TAG_MAX];
+  int bucket;
+  int width; /* GROUP_BUCKET_NUMBER; < 1 counts as 1 */
+} GroupKey;
+
+/* Aggregators */
+#define GROUP_AGG_COUNT 0     /* games */
+#define GROUP_AGG_SUM 1       /* sum of a value over the games that have it */
+#define GROUP_AGG_MIN 2
+#define GROUP_AGG_MAX 3
+#define GROUP_AGG_DISTINCT 4  /* HyperLogLog estimate of the distinct positions reached (about 1.6% error) */
+#define GROUP_AGG_TOP_FIRST 5 /* the k most played first moves */
+
+/* Values of SUM, MIN and MAX */
+#define GROUP_VALUE_PLIES 0 /* plies replayed */
+#define GROUP_VALUE_TAG 1   /* an integer tag; games without one are left out */
+
+typedef struct {
+  int kind;
+  int value;
+  char tag[GROUP_TAG_MAX]; /* GROUP_VALUE_TAG */
+  int k;                   /* GROUP_AGG_TOP_FIRST */
+} GroupAgg;
+
+typedef struct {
+  GroupKey keys[GROUP_MAX_KEYS];
+  int key_count;
+  GroupAgg aggs[GROUP_MAX_AGGS];
+  int agg_count;
+  int flags;   /* REPLAY_* flags */
+  int threads; /* <= 0: one per CPU */
+  Job* job;    /* optional: counts input bytes; once cancelled, the groups cover the games done so far */
+} GroupSpec;
+
+typedef struct {
+  char move[6]; /* UCI, "0000" for a null move */
+  uint64_t count;
+} GroupMoveCount;
+
+typedef struct GroupTable GroupTable;
+
+/* Replay and group every game of a PGN buffer ([FEN] tags honoured). Games
+ * rejected part way still count, with the plies applied before the error.
+ * Returns NULL on allocation failure. */
+GroupTable* group_pgn(const char* buf, size_t len, const GroupSpec* spec);
+void group_table_free(GroupTable* t);
+
+/* Groups, in ascending order of their key bytes. */
+size_t group_count(const GroupTable* t);
+
+/* Key value j of group i (not NUL-terminated). */
+const char* group_key(const GroupTable* t, size_t i, int j, size_t* len);
+
+/* Aggregator a of group i: the count, sum, min, max or distinct estimate.
+ * Returns false for a MIN or MAX that saw no value, or a TOP_FIRST. */
+bool group_value(const GroupTable* t, size_t i, int a, double* out);
+
+/* The first moves of TOP_FIRST aggregator a for group i, most played first
+ * (ties by move), at most its k. Sets *out to them and returns the count. */
+int group_top_moves(const GroupTable* t, size_t i, int a, const GroupMoveCount** out);
+
+#endif
@@ -0,0 +1,34 @@
+/* Batch job progress and cancellation (see job.h). The report time is a
+ * relaxed atomic rather than a lock: two workers crossing the interval
+ * together may both report, which costs a redundant callback, never a wait. */
+
+#include "job.h"
+#include "threads.h"
+#include <string.h>
+
+void job_init(Job* job) {
+  memset(job, 0, sizeof(*job));
+}
+
+void job_cancel(Job* job) {
+  if (job) bc_atomic_store_int(&job->cancelled, 1);
+}
+
+bool job_cancelled(Job* job) {
+  return job && bc_atomic_load_int(&job->cancelled);
+}
+
+void job_set_total(Job* job, uint64_t total) {
+  if (job) bc_atomic_store_u64(&job->total, total);
+}
+
+void job_advance(Job* job, uint64_t units) {
+  if (!job) return;
+  uint64_t done = bc_atomic_add_u64(&job->done, units) + units;
+  if (!job->on_progress) return;
+  uint64_t now = (uint64_t)bc_now_ms();
+  if (now < bc_atomic_load_u64(&job->next_ms)) return;
+  int interval = job->interval_ms > 0 ? job->interval_ms : JOB_DEFAULT_INTERVAL_MS;
+  bc_atomic_store_u64(&job->next_ms, now + (uint64_t)interval);
+  job->on_progress(job->ctx, done, bc_atomic_load_u64(&job->total));
+}
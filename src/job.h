@@ -0,0 +1,38 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Progress and cancellation of a long batch call. The caller owns the Job and
+ * may cancel it from any thread; the call stops at its next checkpoint (a
+ * game, a build step) and returns what it finished. Workers add finished
+ * units to done; whichever one first passes the report interval calls
+ * on_progress, so it runs on a worker thread and must not block. */
+
+#define JOB_DEFAULT_INTERVAL_MS 100
+
+typedef void (*JobProgressFn)(void* ctx, uint64_t done, uint64_t total);
+
+typedef struct {
+  int cancelled;
+  uint64_t done;             /* units finished: input bytes, or build steps */
+  uint64_t total;            /* units in the whole call, set by the call */
+  JobProgressFn on_progress; /* optional */
+  void* ctx;
+  int interval_ms;  /* between progress reports; <= 0: JOB_DEFAULT_INTERVAL_MS */
+  uint64_t next_ms; /* time of the next report */
+} Job;
+
+void job_init(Job* job);
+
+/* Both accept a NULL job: never cancelled, nothing counted. */
+void job_cancel(Job* job);
+bool job_cancelled(Job* job);
+
+void job_set_total(Job* job, uint64_t total);
+
+/* Count units as finished and report progress if the interval has passed. */
+void job_advance(Job* job, uint64_t units);
+
+#endif
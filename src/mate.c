@@ -0,0 +1,216 @@
+/* Mate-in-N solver. attacker_mates(b, n): the side to move mates in at most
+ * n moves; defender_lost(b, k): every reply of the side to move leaves the
+ * attacker a mate in at most k. Attacker nodes are cached as the smallest
+ * depth proven to mate and the largest proven not to; a node budget aborts
+ * the search without caching anything unproven. */
+
+#include "mate.h"
+#include "alloc.h"
+#include "bitops.h"
+#include "pool.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MATE_DEFAULT_HASH_MB 4
+
+typedef struct {
+  uint64_t key;
+  uint8_t win;  /* mates within win moves (0: not proven) */
+  uint8_t fail; /* no mate within fail moves */
+} MateEntry;
+
+typedef struct {
+  MateEntry* table;
+  uint64_t mask;
+  uint64_t nodes;
+  uint64_t budget;
+  bool aborted;
+} MateSolver;
+
+static bool solver_init(MateSolver* s, size_t hash_mb) {
+  size_t count = 1;
+  size_t want = (hash_mb ? hash_mb : MATE_DEFAULT_HASH_MB) * 1024 * 1024 / sizeof(MateEntry);
+  while (count * 2 <= want) count *= 2;
+  memset(s, 0, sizeof(*s));
+  s->table = (MateEntry*)bc_aligned_calloc(BC_CACHE_LINE, count, sizeof(MateEntry));
+  s->mask = (uint64_t)count - 1;
+  return s->table != NULL;
+}
+
+static bool count_node(MateSolver* s) {
+  if (++s->nodes > s->budget && s->budget) s->aborted = true;
+  return s->aborted;
+}
+
+static bool defender_lost(MateSolver* s, const Board* b, int k);
+
+/* Checking moves to the front; returns how many there are. */
+static int order_checks(const Board* b, Move* moves, int n) {
+  int checks = 0;
+  for (int i = 0; i < n; i++) {
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    if (board_in_check(&child)) {
+      Move m = moves[checks];
+      moves[checks++] = moves[i];
+      moves[i] = m;
+    }
+  }
+  return checks;
+}
+
+static bool attacker_mates(MateSolver* s, const Board* b, int n) {
+  if (count_node(s)) return false;
+  uint64_t key = board_get_zobrist_key(b);
+  MateEntry* e = &s->table[key & s->mask];
+  if (e->key == key) {
+    if (e->win && e->win <= n) return true;
+    if (e->fail >= n) return false;
+  }
+  Move moves[BOARD_MAX_MOVES];
+  int count = board_generate_moves(b, moves);
+  int checks = order_checks(b, moves, count);
+  /* Only a check can mate on the last move. */
+  if (n == 1) count = checks;
+  bool mates = false;
+  for (int i = 0; i < count && !mates; i++) {
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    mates = defender_lost(s, &child, n - 1);
+    if (s->aborted) return false;
+  }
+  if (e->key != key) {
+    e->key = key;
+    e->win = 0;
+    e->fail = 0;
+  }
+  if (mates && (!e->win || n < e->win)) e->win = (uint8_t)n;
+  if (!mates && n > e->fail) e->fail = (uint8_t)n;
+  return mates;
+}
+
+static bool defender_lost(MateSolver* s, const Board* b, int k) {
+  if (count_node(s)) return false;
+  Move moves[BOARD_MAX_MOVES];
+  int count = board_generate_moves(b, moves);
+  if (count == 0) return board_in_check(b);
+  if (k == 0) return false;
+  for (int i = 0; i < count; i++) {
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    if (!attacker_mates(s, &child, k) || s->aborted) return false;
+  }
+  return true;
+}
+
+static bool position_valid(const Board* b) {
+  if (bb_popcount(b->kings[0]) != 1 || bb_popcount(b->kings[1]) != 1) return false;
+  return !board_square_attacked(b, bb_lsb(b->kings[b->sideToMove ^ 1]), b->sideToMove);
+}
+
+static void solve(MateSolver* s, const Board* b, const MateOptions* opts, MateResult* out) {
+  int n = opts->n < 1 ? 1 : opts->n > MATE_MAX_N ? MATE_MAX_N : opts->n;
+  MateMove found[BOARD_MAX_MOVES];
+  memset(out, 0, sizeof(*out));
+  if (!position_valid(b)) {
+    out->status = MATE_INVALID;
+    return;
+  }
+  s->nodes = 0;
+  s->budget = opts->node_budget;
+  s->aborted = false;
+
+  Move moves[BOARD_MAX_MOVES];
+  int count = board_generate_moves(b, moves);
+  order_checks(b, moves, count);
+  /* Each root move is deepened on its own, so its shortest mate is the one found. */
+  for (int i = 0; i < count && !s->aborted; i++) {
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    for (int k = 0; k < n; k++) {
+      if (defender_lost(s, &child, k)) {
+        MateMove* m = &found[out->count++];
+        m->from = (uint8_t)moves[i].from;
+        m->to = (uint8_t)moves[i].to;
+        m->promotion = (char)moves[i].promotion;
+        m->mate_in = (uint8_t)(k + 1);
+        break;
+      }
+      if (s->aborted) break;
+    }
+  }
+
+  /* Stable order by mate length. */
+  int stored = 0;
+  for (int len = 1; len <= n; len++) {
+    for (int i = 0; i < out->count; i++) {
+      if (found[i].mate_in != len) continue;
+      if (!out->mate_in) out->mate_in = len;
+      if (stored < MATE_MAX_SOLUTIONS) out->moves[stored++] = found[i];
+    }
+  }
+  out->nodes = s->nodes;
+  out->status = s->aborted ? MATE_UNKNOWN : out->count ? MATE_FOUND : MATE_NONE;
+}
+
+bool mate_solve(const Board* b, const MateOptions* opts, MateResult* out) {
+  MateSolver s;
+  board_init_tables();
+  if (!solver_init(&s, opts->hash_mb)) return false;
+  solve(&s, b, opts, out);
+  bc_aligned_free(s.table);
+  return true;
+}
+
+typedef struct {
+  const char* const* fens;
+  size_t count;
+  const MateOptions* opts;
+  MateResult* out;
+  uint64_t next; /* next position to take */
+  int oom;
+} MateBatch;
+
+/* One per thread: takes positions off the shared counter until none are left. */
+static void batch_task(void* arg, int worker) {
+  MateBatch* batch = (MateBatch*)arg;
+  MateSolver s;
+  Board b;
+  (void)worker;
+  if (!solver_init(&s, batch->opts->hash_mb)) {
+    bc_atomic_store_int(&batch->oom, 1);
+    return;
+  }
+  for (;;) {
+    uint64_t i = bc_atomic_add_u64(&batch->next, 1);
+    if (i >= batch->count) break;
+    board_reset(&b);
+    board_load_fen(&b, batch->fens[i]);
+    solve(&s, &b, batch->opts, &batch->out[i]);
+  }
+  bc_aligned_free(s.table);
+}
+
+bool mate_solve_batch(const char* const* fens, size_t count, const MateOptions* opts, MateResult* out) {
+  MateBatch batch;
+  int threads = opts->threads > 0 ? opts->threads : bc_cpu_count();
+  board_init_tables();
+  memset(&batch, 0, sizeof(batch));
+  batch.fens = fens;
+  batch.count = count;
+  batch.opts = opts;
+  batch.out = out;
+  if ((size_t)threads > count) threads = count ? (int)count : 1;
+  Pool* pool = threads > 1 ? pool_create(threads) : NULL;
+  int submitted = 0;
+  for (int i = 0; pool && i < threads; i++) {
+    if (pool_submit(pool, -1, batch_task, &batch)) submitted++;
+  }
+  if (!submitted) batch_task(&batch, -1);
+  if (pool) {
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+  return !batch.oom;
+}
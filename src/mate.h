@@ -0,0 +1,52 @@
+#ifndef MATE_H
+#define MATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Forced-mate solver: depth-limited AND/OR search for the side to move
+ * (checking moves first, only checks on the last move) with a table of proven
+ * and refuted (position, depth) pairs. Every root move is searched, so all
+ * mating first moves are found, each with its shortest forced mate. */
+
+#define MATE_MAX_N 16
+#define MATE_MAX_SOLUTIONS 64
+
+/* MateResult.status */
+#define MATE_NONE 0    /* no forced mate within n moves */
+#define MATE_FOUND 1   /* moves[] holds every mating first move */
+#define MATE_UNKNOWN 2 /* node budget exhausted; moves[] holds those found so far */
+#define MATE_INVALID 3 /* not one king per side, or the side not to move is in check */
+
+typedef struct {
+  uint8_t from;
+  uint8_t to;
+  char promotion; /* 'q','r','b','n' or 0 */
+  uint8_t mate_in; /* moves of the mating side, this one included */
+} MateMove;
+
+typedef struct {
+  int n;                /* longest mate looked for, in moves (1..MATE_MAX_N) */
+  uint64_t node_budget; /* per position; 0 = none */
+  size_t hash_mb;       /* table per thread; 0 = 4 MB */
+  int threads;          /* batch only; <= 0: one per CPU */
+} MateOptions;
+
+typedef struct {
+  int status;
+  int mate_in;   /* shortest mate found, 0 if none */
+  int count;     /* mating first moves (moves[] keeps the first MATE_MAX_SOLUTIONS) */
+  uint64_t nodes;
+  MateMove moves[MATE_MAX_SOLUTIONS]; /* shortest mates first */
+} MateResult;
+
+/* Solve one position. Returns false on allocation failure. */
+bool mate_solve(const Board* b, const MateOptions* opts, MateResult* out);
+
+/* Solve count FENs across threads (one table per worker) into out[count].
+ * Returns false on allocation failure. */
+bool mate_solve_batch(const char* const* fens, size_t count, const MateOptions* opts, MateResult* out);
+
+#endif
@@ -0,0 +1,337 @@
+/* MinHash signatures and banded LSH (see minhash.h). Signatures use
+ * one-permutation hashing: each key is hashed once, its top bits pick a slot
+ * and the slot keeps the least low word seen, so signing costs one hash per
+ * key rather than one per slot. A slot no key reached borrows from the next
+ * filled slot to its right (circularly), offset by the distance, which keeps
+ * agreeing slots an unbiased Jaccard estimate for short games. Each band has
+ * a table of game ids grouped by a hash of that band's slots, built like the
+ * rank tables of similarity.c by a counting sort over power-of-two buckets,
+ * with a 32-bit fingerprint per entry to drop most bucket collisions. Games
+ * added after a build are chained per band into an overflow table on the same
+ * buckets; once they outnumber the games in the sorted tables, everything is
+ * rebuilt, so each game costs amortized O(bands) however adds and queries
+ * interleave. */
+
+#include "minhash.h"
+#include "alloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LSH_GAMES_PER_BUCKET 4
+#define SLOT_SHIFT 58 /* 64 - log2(MINHASH_SIZE) */
+#define BORROW_STEP 0x9E3779B9U
+
+typedef struct {
+  uint32_t id;
+  uint32_t fp;
+  uint32_t next; /* 1 + the previous entry of the bucket, or 0 */
+} LshEntry;
+
+struct LshIndex {
+  uint32_t* sigs; /* MINHASH_SIZE per game */
+  size_t count;
+  size_t cap;
+  int bands;
+  int rows;
+  size_t built; /* games covered by the sorted band tables */
+  uint64_t mask;
+  uint32_t** starts; /* per band: mask + 2 offsets into ids/fps */
+  uint32_t** ids;
+  uint32_t** fps;
+  /* Per band, games from built on: ov_head[b][bucket] is 1 + the newest entry
+   * of the bucket's chain (0 when empty), ov[b][0..ov_len[b]) the entries. */
+  uint32_t** ov_head;
+  LshEntry** ov;
+  size_t* ov_len;
+  size_t* ov_cap;
+};
+
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= UINT64_C(0xBF58476D1CE4E5B9);
+  x ^= x >> 27;
+  x *= UINT64_C(0x94D049BB133111EB);
+  return x ^ (x >> 31);
+}
+
+void minhash_sign(const uint64_t* keys, size_t count, uint32_t* sig) {
+  uint32_t min[MINHASH_SIZE];
+  bool filled[MINHASH_SIZE] = { false };
+  int slots = 0;
+  for (int i = 0; i < MINHASH_SIZE; i++) min[i] = MINHASH_EMPTY;
+  for (size_t k = 0; k < count; k++) {
+    uint64_t h = mix64(keys[k]);
+    int slot = (int)(h >> SLOT_SHIFT);
+    uint32_t v = (uint32_t)h;
+    if (v < min[slot]) min[slot] = v;
+    if (!filled[slot]) {
+      filled[slot] = true;
+      slots++;
+    }
+  }
+  for (int i = 0; i < MINHASH_SIZE; i++) {
+    int d = 1;
+    sig[i] = min[i];
+    if (filled[i] || !slots) continue;
+    while (!filled[(i + d) % MINHASH_SIZE]) d++;
+    sig[i] = min[(i + d) % MINHASH_SIZE] + (uint32_t)d * BORROW_STEP;
+  }
+}
+
+static int matches(const uint32_t* a, const uint32_t* b) {
+  int n = 0;
+  for (int i = 0; i < MINHASH_SIZE; i++) n += a[i] == b[i];
+  return n;
+}
+
+double minhash_jaccard(const uint32_t* a, const uint32_t* b) {
+  return (double)matches(a, b) / MINHASH_SIZE;
+}
+
+/* ---- index ---- */
+
+static uint64_t band_hash(const uint32_t* sig, int band, int rows) {
+  uint64_t h = (uint64_t)(band + 1) * UINT64_C(0x9E3779B97F4A7C15);
+  for (int r = 0; r < rows; r++) h = mix64(h ^ sig[band * rows + r]);
+  return h;
+}
+
+static void free_tables(LshIndex* idx) {
+  for (int b = 0; b < idx->bands; b++) {
+    bc_free(idx->starts[b]);
+    bc_free(idx->ids[b]);
+    bc_free(idx->fps[b]);
+    bc_free(idx->ov_head[b]);
+    bc_free(idx->ov[b]);
+    idx->starts[b] = idx->ids[b] = idx->fps[b] = idx->ov_head[b] = NULL;
+    idx->ov[b] = NULL;
+    idx->ov_len[b] = idx->ov_cap[b] = 0;
+  }
+  idx->built = 0;
+}
+
+LshIndex* lsh_create(int bands) {
+  if (bands <= 0) bands = LSH_DEFAULT_BANDS;
+  if (bands > MINHASH_SIZE || MINHASH_SIZE % bands) return NULL;
+  LshIndex* idx = (LshIndex*)bc_calloc(1, sizeof(LshIndex));
+  if (!idx) return NULL;
+  idx->bands = bands;
+  idx->rows = MINHASH_SIZE / bands;
+  idx->starts = (uint32_t**)bc_calloc((size_t)bands, sizeof(uint32_t*));
+  idx->ids = (uint32_t**)bc_calloc((size_t)bands, sizeof(uint32_t*));
+  idx->fps = (uint32_t**)bc_calloc((size_t)bands, sizeof(uint32_t*));
+  idx->ov_head = (uint32_t**)bc_calloc((size_t)bands, sizeof(uint32_t*));
+  idx->ov = (LshEntry**)bc_calloc((size_t)bands, sizeof(LshEntry*));
+  idx->ov_len = (size_t*)bc_calloc((size_t)bands, sizeof(size_t));
+  idx->ov_cap = (size_t*)bc_calloc((size_t)bands, sizeof(size_t));
+  if (!idx->starts || !idx->ids || !idx->fps || !idx->ov_head || !idx->ov || !idx->ov_len || !idx->ov_cap) {
+    lsh_destroy(idx);
+    return NULL;
+  }
+  return idx;
+}
+
+void lsh_destroy(LshIndex* idx) {
+  if (!idx) return;
+  if (idx->starts && idx->ids && idx->fps && idx->ov_head && idx->ov && idx->ov_len && idx->ov_cap) free_tables(idx);
+  bc_free(idx->starts);
+  bc_free(idx->ids);
+  bc_free(idx->fps);
+  bc_free(idx->ov_head);
+  bc_free(idx->ov);
+  bc_free(idx->ov_len);
+  bc_free(idx->ov_cap);
+  bc_free(idx->sigs);
+  bc_free(idx);
+}
+
+size_t lsh_size(const LshIndex* idx) {
+  return idx->count;
+}
+
+int lsh_bands(const LshIndex* idx) {
+  return idx->bands;
+}
+
+const uint32_t* lsh_signature(const LshIndex* idx, uint32_t id) {
+  return idx->sigs + (size_t)id * MINHASH_SIZE;
+}
+
+bool lsh_add(LshIndex* idx, const uint32_t* sigs, size_t count) {
+  if (count > UINT32_MAX - idx->count) return false;
+  if (idx->count + count > idx->cap) {
+    size_t cap = idx->cap ? idx->cap : 1024;
+    while (cap < idx->count + count) cap *= 2;
+    uint32_t* grown = (uint32_t*)bc_realloc(idx->sigs, cap * MINHASH_SIZE * sizeof(uint32_t));
+    if (!grown) return false;
+    idx->sigs = grown;
+    idx->cap = cap;
+  }
+  memcpy(idx->sigs + idx->count * MINHASH_SIZE, sigs, count * MINHASH_SIZE * sizeof(uint32_t));
+  idx->count += count;
+  return true;
+}
+
+/* Chain games built + ov_len[b] .. count into each band's overflow table.
+ * Bands are independent, so a cancelled append resumes where it stopped. */
+static bool append_overflow(LshIndex* idx, Job* job) {
+  size_t buckets = (size_t)idx->mask + 1;
+  uint64_t pending = 0;
+  for (int b = 0; b < idx->bands; b++) pending += idx->count - idx->built - idx->ov_len[b];
+  job_set_total(job, pending);
+  for (int b = 0; b < idx->bands; b++) {
+    size_t from = idx->built + idx->ov_len[b];
+    if (from == idx->count) continue;
+    if (job_cancelled(job)) return false;
+    if (!idx->ov_head[b]) {
+      idx->ov_head[b] = (uint32_t*)bc_calloc(buckets, sizeof(uint32_t));
+      if (!idx->ov_head[b]) return false;
+    }
+    size_t need = idx->count - idx->built;
+    if (need > idx->ov_cap[b]) {
+      size_t cap = idx->ov_cap[b] ? idx->ov_cap[b] : 64;
+      while (cap < need) cap *= 2;
+      LshEntry* grown = (LshEntry*)bc_realloc(idx->ov[b], cap * sizeof(LshEntry));
+      if (!grown) return false;
+      idx->ov[b] = grown;
+      idx->ov_cap[b] = cap;
+    }
+    uint32_t* head = idx->ov_head[b];
+    for (size_t i = from; i < idx->count; i++) {
+      uint64_t h = band_hash(idx->sigs + i * MINHASH_SIZE, b, idx->rows);
+      LshEntry* e = &idx->ov[b][idx->ov_len[b]++];
+      e->id = (uint32_t)i;
+      e->fp = (uint32_t)(h >> 32);
+      e->next = head[h & idx->mask];
+      head[h & idx->mask] = (uint32_t)idx->ov_len[b];
+    }
+    job_advance(job, idx->count - from);
+  }
+  return true;
+}
+
+bool lsh_build(LshIndex* idx, Job* job) {
+  if (idx->starts[0]) {
+    bool current = true;
+    for (int b = 0; b < idx->bands; b++) current = current && idx->built + idx->ov_len[b] == idx->count;
+    if (current) return true;
+    if (idx->count - idx->built <= idx->built) return append_overflow(idx, job);
+  }
+  free_tables(idx);
+  size_t n = idx->count, buckets = 1;
+  while (buckets * LSH_GAMES_PER_BUCKET < n) buckets *= 2;
+  uint64_t* hashes = (uint64_t*)bc_malloc(n * sizeof(uint64_t));
+  if (!hashes) return false;
+  job_set_total(job, (uint64_t)n * (uint64_t)idx->bands);
+  for (int b = 0; b < idx->bands; b++) {
+    if (job_cancelled(job)) {
+      bc_free(hashes);
+      free_tables(idx);
+      return false;
+    }
+    uint32_t* starts = (uint32_t*)bc_calloc(buckets + 1, sizeof(uint32_t));
+    uint32_t* ids = (uint32_t*)bc_malloc(n * sizeof(uint32_t));
+    uint32_t* fps = (uint32_t*)bc_malloc(n * sizeof(uint32_t));
+    idx->starts[b] = starts;
+    idx->ids[b] = ids;
+    idx->fps[b] = fps;
+    if (!starts || !ids || !fps) {
+      bc_free(hashes);
+      free_tables(idx);
+      return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+      hashes[i] = band_hash(idx->sigs + i * MINHASH_SIZE, b, idx->rows);
+      starts[(hashes[i] & (buckets - 1)) + 1]++;
+    }
+    for (size_t k = 0; k < buckets; k++) starts[k + 1] += starts[k];
+    /* Place by bucket, advancing each start to its end, then shift back. */
+    for (size_t i = 0; i < n; i++) {
+      uint32_t at = starts[hashes[i] & (buckets - 1)]++;
+      ids[at] = (uint32_t)i;
+      fps[at] = (uint32_t)(hashes[i] >> 32);
+    }
+    memmove(starts + 1, starts, buckets * sizeof(uint32_t));
+    starts[0] = 0;
+    job_advance(job, n);
+  }
+  bc_free(hashes);
+  idx->mask = buckets - 1;
+  idx->built = n;
+  return true;
+}
+
+static int compare_u32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int compare_u64(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+int lsh_query(LshIndex* idx, const uint32_t* sig, const LshOptions* opts, uint32_t* ids, float* jaccard,
+              LshStats* stats) {
+  LshStats local;
+  if (!stats) stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  if (opts->k <= 0 || !idx->count) return 0;
+  if (!lsh_build(idx, NULL)) return -1;
+  size_t max_bucket = opts->max_bucket ? opts->max_bucket : LSH_DEFAULT_MAX_BUCKET;
+
+  /* Ids sharing a band with sig, then made ascending and distinct. */
+  size_t total = 0;
+  for (int b = 0; b < idx->bands; b++) {
+    uint64_t h = band_hash(sig, b, idx->rows);
+    size_t span = idx->starts[b][(h & idx->mask) + 1] - idx->starts[b][h & idx->mask];
+    for (uint32_t e = idx->ov_head[b] ? idx->ov_head[b][h & idx->mask] : 0; e; e = idx->ov[b][e - 1].next) span++;
+    if (span > max_bucket) stats->skipped++;
+    else total += span;
+  }
+  uint32_t* cand = (uint32_t*)bc_malloc((total ? total : 1) * sizeof(uint32_t));
+  if (!cand) return -1;
+  size_t n = 0;
+  for (int b = 0; b < idx->bands; b++) {
+    uint64_t h = band_hash(sig, b, idx->rows);
+    uint32_t begin = idx->starts[b][h & idx->mask], end = idx->starts[b][(h & idx->mask) + 1];
+    uint32_t chain = idx->ov_head[b] ? idx->ov_head[b][h & idx->mask] : 0;
+    size_t span = end - begin;
+    for (uint32_t e = chain; e; e = idx->ov[b][e - 1].next) span++;
+    if (span > max_bucket) continue;
+    for (uint32_t j = begin; j < end; j++) {
+      if (idx->fps[b][j] == (uint32_t)(h >> 32)) cand[n++] = idx->ids[b][j];
+    }
+    for (uint32_t e = chain; e; e = idx->ov[b][e - 1].next) {
+      if (idx->ov[b][e - 1].fp == (uint32_t)(h >> 32)) cand[n++] = idx->ov[b][e - 1].id;
+    }
+  }
+  qsort(cand, n, sizeof(uint32_t), compare_u32);
+  size_t unique = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!unique || cand[i] != cand[unique - 1]) cand[unique++] = cand[i];
+  }
+  stats->candidates = unique;
+
+  /* Rank by agreeing slots (most first), then id. */
+  uint64_t* keys = (uint64_t*)bc_malloc((unique ? unique : 1) * sizeof(uint64_t));
+  if (!keys) {
+    bc_free(cand);
+    return -1;
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < unique; i++) {
+    int m = matches(sig, lsh_signature(idx, cand[i]));
+    if ((double)m / MINHASH_SIZE < opts->min_jaccard) continue;
+    keys[kept++] = (uint64_t)(MINHASH_SIZE - m) << 32 | cand[i];
+  }
+  qsort(keys, kept, sizeof(uint64_t), compare_u64);
+  int written = kept < (size_t)opts->k ? (int)kept : opts->k;
+  for (int i = 0; i < written; i++) {
+    ids[i] = (uint32_t)keys[i];
+    jaccard[i] = (float)(MINHASH_SIZE - (int)(keys[i] >> 32)) / MINHASH_SIZE;
+  }
+  bc_free(keys);
+  bc_free(cand);
+  return written;
+}
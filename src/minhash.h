@@ -0,0 +1,71 @@
+#ifndef MINHASH_H
+#define MINHASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "job.h"
+
+/* MinHash signatures of games and a banded LSH index over them. A game's
+ * signature summarises the set of its per-ply Zobrist keys: each slot holds
+ * a minimum hash over part of the set, and two signatures agree in a slot
+ * with probability equal to the Jaccard similarity of the two sets.
+ * The index cuts signatures into bands of rows slots; games that agree on a
+ * whole band are candidates, which finds pairs above about
+ * (1 / bands)^(1 / rows) similarity with high probability. */
+
+#define MINHASH_SIZE 64
+#define MINHASH_EMPTY UINT32_MAX /* every slot of the signature of an empty set */
+#define LSH_DEFAULT_BANDS 16
+#define LSH_DEFAULT_MAX_BUCKET 4096
+
+/* Signature of keys[0..count) (duplicates allowed) into sig[MINHASH_SIZE]. */
+void minhash_sign(const uint64_t* keys, size_t count, uint32_t* sig);
+
+/* Fraction of slots where a and b agree: the Jaccard estimate. */
+double minhash_jaccard(const uint32_t* a, const uint32_t* b);
+
+typedef struct LshIndex LshIndex;
+
+typedef struct {
+  int k;             /* results wanted */
+  double min_jaccard; /* candidates estimated below this are dropped */
+  size_t max_bucket; /* bands shared by more games are not looked up; 0 = LSH_DEFAULT_MAX_BUCKET */
+} LshOptions;
+
+typedef struct {
+  uint64_t candidates; /* distinct games whose signatures were compared */
+  int skipped;         /* bands whose bucket exceeded max_bucket */
+} LshStats;
+
+/* bands must divide MINHASH_SIZE (<= 0: LSH_DEFAULT_BANDS); NULL otherwise
+ * or on allocation failure. */
+LshIndex* lsh_create(int bands);
+void lsh_destroy(LshIndex* idx);
+size_t lsh_size(const LshIndex* idx);
+int lsh_bands(const LshIndex* idx);
+
+/* Append count signatures of MINHASH_SIZE slots; their ids follow on from
+ * lsh_size(). Band tables take them in at the next query or lsh_build: new
+ * games are chained into per-band overflow tables at O(bands) each, and once
+ * they outnumber the games already in the sorted tables all n games are
+ * rebuilt at O(n * bands). Adding a few games between queries therefore costs
+ * amortized O(bands) per game. Returns false on allocation failure or past
+ * UINT32_MAX games. */
+bool lsh_add(LshIndex* idx, const uint32_t* sigs, size_t count);
+
+/* Build the band tables now rather than at the next query, counting the
+ * games times bands it takes in into job (optional). Returns false on allocation failure or
+ * when job is cancelled, which leaves the build to the next query. */
+bool lsh_build(LshIndex* idx, Job* job);
+
+/* Signature of game id. */
+const uint32_t* lsh_signature(const LshIndex* idx, uint32_t id);
+
+/* Games most similar to sig, highest estimate first and ties by id, into
+ * ids[k] and jaccard[k]. Returns how many were written (at most k), or -1
+ * on allocation failure. Queries on one index must not overlap. */
+int lsh_query(LshIndex* idx, const uint32_t* sig, const LshOptions* opts, uint32_t* ids, float* jaccard,
+              LshStats* stats);
+
+#endif
@@ -0,0 +1,406 @@
+/* Tactical motif tagger (see motif.h). Sliders use per-direction ray masks
+ * cut at the first blocker, which is several times faster than walking the
+ * board as the core does. Both sides' attack maps, and the attacks of every
+ * piece, are built once per position; moves, exchanges and lines read them
+ * back instead of recomputing attackers. */
+
+#include "motif.h"
+#include "bitops.h"
+
+#define BIT(sq) (UINT64_C(1) << (sq))
+#define NOT_A (~UINT64_C(0x0101010101010101))
+#define NOT_H (~UINT64_C(0x8080808080808080))
+
+#define PAWN 0
+#define KNIGHT 1
+#define BISHOP 2
+#define ROOK 3
+#define QUEEN 4
+#define KING 5
+
+static const int VALUE[6] = {100, 300, 300, 500, 900, 20000};
+
+/* Directions 0-3 step up the board (N, NE, E, NW), 4-7 down (S, SW, W, SE);
+ * d and (d + 4) & 7 are opposite, odd directions are diagonal. */
+static u64 rays[8][64];
+static u64 diag_lines[64]; /* empty-board bishop and rook attacks */
+static u64 orth_lines[64];
+static u64 knight_attacks[64];
+static u64 king_attacks[64];
+static u64 pawn_attacks[2][64];
+static u64 between[64][64];
+
+typedef struct {
+  u64 sets[12];
+  u64 side[2];
+  u64 attacks[2][6]; /* squares attacked by each side's pieces of each kind */
+  u64 attacked[2];   /* all squares each side attacks */
+  u64 piece_att[64]; /* attacks of the piece (not pawn) on each occupied square */
+  u64 occ;
+  int us;
+  int them;
+} Position;
+
+static void init_rays(void) {
+  static int done = 0;
+  static const int steps[8][2] = {{0, 1}, {1, 1}, {1, 0}, {-1, 1}, {0, -1}, {-1, -1}, {-1, 0}, {1, -1}};
+  if (done) return;
+  board_init_tables();
+  for (int d = 0; d < 8; d++) {
+    for (int sq = 0; sq < 64; sq++) {
+      u64 bb = 0;
+      for (int f = sq % 8 + steps[d][0], r = sq / 8 + steps[d][1]; f >= 0 && f < 8 && r >= 0 && r < 8;
+           f += steps[d][0], r += steps[d][1])
+        bb |= BIT(r * 8 + f);
+      rays[d][sq] = bb;
+      if (d & 1)
+        diag_lines[sq] |= bb;
+      else
+        orth_lines[sq] |= bb;
+    }
+  }
+  /* Local copies of the leaper and between tables keep the hot loops free
+   * of calls. */
+  for (int sq = 0; sq < 64; sq++) {
+    knight_attacks[sq] = board_knight_attacks(sq);
+    king_attacks[sq] = board_king_attacks(sq);
+    pawn_attacks[WHITE][sq] = board_pawn_attacks(WHITE, sq);
+    pawn_attacks[BLACK][sq] = board_pawn_attacks(BLACK, sq);
+    for (int to = 0; to < 64; to++) between[sq][to] = board_between(sq, to);
+  }
+  done = 1;
+}
+
+/* h8 (a1) ends every upward (downward) ray, so it stands in for "no blocker"
+ * and keeps these free of branches. */
+static inline u64 ray_up(int d, int sq, u64 occ) {
+  u64 ray = rays[d][sq];
+  return ray ^ rays[d][bb_lsb((ray & occ) | BIT(63))];
+}
+
+static inline u64 ray_down(int d, int sq, u64 occ) {
+  u64 ray = rays[d][sq];
+  return ray ^ rays[d][bb_msb((ray & occ) | 1)];
+}
+
+static inline u64 rook_attacks(int sq, u64 occ) {
+  return ray_up(0, sq, occ) | ray_up(2, sq, occ) | ray_down(4, sq, occ) | ray_down(6, sq, occ);
+}
+
+static inline u64 bishop_attacks(int sq, u64 occ) {
+  return ray_up(1, sq, occ) | ray_up(3, sq, occ) | ray_down(5, sq, occ) | ray_down(7, sq, occ);
+}
+
+static inline u64 piece_attacks(int kind, int color, int sq, u64 occ) {
+  switch (kind) {
+    case PAWN: return pawn_attacks[color][sq];
+    case KNIGHT: return knight_attacks[sq];
+    case BISHOP: return bishop_attacks(sq, occ);
+    case ROOK: return rook_attacks(sq, occ);
+    case QUEEN: return bishop_attacks(sq, occ) | rook_attacks(sq, occ);
+    default: return king_attacks[sq];
+  }
+}
+
+static inline u64 empty_lines(int kind, int sq) {
+  return kind == BISHOP ? diag_lines[sq] : kind == ROOK ? orth_lines[sq] : diag_lines[sq] | orth_lines[sq];
+}
+
+/* The squares of cand, on lines from sq, with nothing of occ in between. */
+static inline u64 in_sight(int sq, u64 cand, u64 occ) {
+  u64 seen = 0;
+  while (cand) {
+    int t = bb_pop_lsb(&cand);
+    if (!(between[sq][t] & occ)) seen |= BIT(t);
+  }
+  return seen;
+}
+
+/* Pieces of either side within occ attacking sq. */
+static u64 attackers_to(const u64* sets, int sq, u64 occ) {
+  u64 diag = sets[BISHOP] | sets[QUEEN] | sets[6 + BISHOP] | sets[6 + QUEEN];
+  u64 orth = sets[ROOK] | sets[QUEEN] | sets[6 + ROOK] | sets[6 + QUEEN];
+  u64 att = (pawn_attacks[BLACK][sq] & sets[PAWN]) | (pawn_attacks[WHITE][sq] & sets[6 + PAWN]) |
+            (knight_attacks[sq] & (sets[KNIGHT] | sets[6 + KNIGHT])) | (king_attacks[sq] & (sets[KING] | sets[6 + KING])) |
+            (bishop_attacks(sq, occ) & diag) | (rook_attacks(sq, occ) & orth);
+  return att & occ;
+}
+
+static u64 least_valuable(const u64* sets, u64 attackers, int side, int* kind) {
+  for (int k = PAWN; k <= KING; k++) {
+    u64 bb = attackers & sets[side * 6 + k];
+    if (bb) {
+      *kind = k;
+      return bb & (~bb + 1);
+    }
+  }
+  return 0;
+}
+
+static int see(const u64* sets, u64 occ, int sq, int side, int target_value) {
+  u64 diag = sets[BISHOP] | sets[QUEEN] | sets[6 + BISHOP] | sets[6 + QUEEN];
+  u64 orth = sets[ROOK] | sets[QUEEN] | sets[6 + ROOK] | sets[6 + QUEEN];
+  u64 attackers = attackers_to(sets, sq, occ);
+  int gain[40];
+  int d = 0;
+  int kind;
+  u64 from = least_valuable(sets, attackers, side, &kind);
+  if (!from) return 0;
+  gain[0] = target_value;
+  for (;;) {
+    /* Lifting the capturer exposes any slider behind it, only along the
+     * line it stood on: knights stand on none. */
+    occ ^= from;
+    side ^= 1;
+    if (kind != KNIGHT && kind != ROOK) attackers |= bishop_attacks(sq, occ) & diag;
+    if (kind >= ROOK) attackers |= rook_attacks(sq, occ) & orth;
+    attackers &= occ;
+    int next_kind;
+    u64 next = least_valuable(sets, attackers, side, &next_kind);
+    if (!next) break;
+    d++;
+    gain[d] = VALUE[kind] - gain[d - 1];
+    /* Neither side can come out ahead by going on. */
+    if ((-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]) < 0) break;
+    from = next;
+    kind = next_kind;
+  }
+  for (; d > 0; d--) gain[d - 1] = -(-gain[d - 1] > gain[d] ? -gain[d - 1] : gain[d]);
+  return gain[0];
+}
+
+int motif_see(const u64* sets, u64 occ, int sq, int side, int target_value) {
+  init_rays();
+  return see(sets, occ, sq, side, target_value);
+}
+
+static int kind_at(const Position* p, int color, int sq) {
+  for (int k = PAWN; k < KING; k++)
+    if (p->sets[color * 6 + k] & BIT(sq)) return k;
+  return KING;
+}
+
+/* Sliders of color on a line through sq that could attack it along the line. */
+static inline u64 line_sliders(const Position* p, int color, int sq) {
+  const u64* s = p->sets + color * 6;
+  return (diag_lines[sq] & (s[BISHOP] | s[QUEEN])) | (orth_lines[sq] & (s[ROOK] | s[QUEEN]));
+}
+
+static u64 pawn_moves(const Position* p, int sq) {
+  u64 moves = pawn_attacks[p->us][sq] & p->side[p->them];
+  int step = p->us == WHITE ? 8 : -8;
+  int one = sq + step;
+  if (one >= 0 && one < 64 && !(p->occ & BIT(one))) {
+    moves |= BIT(one);
+    if (sq / 8 == (p->us == WHITE ? 1 : 6) && !(p->occ & BIT(one + step))) moves |= BIT(one + step);
+  }
+  return moves;
+}
+
+static u64 piece_moves(const Position* p, int kind, int sq) {
+  if (kind == PAWN) return pawn_moves(p, sq);
+  u64 moves = p->piece_att[sq] & ~p->side[p->us];
+  return kind == KING ? moves & ~p->attacked[p->them] : moves;
+}
+
+/* A piece of ours moved from from to to (occ: after the move) keeps its
+ * material there. */
+static bool safe_square(const Position* p, int kind, int from, int to, u64 occ) {
+  /* Vacating from only opens the line through from and to, so a square
+   * they do not attack now stays unattacked unless one of their sliders
+   * stands on that line. */
+  if (!(p->attacked[p->them] & BIT(to)) && !(board_line(from, to) & line_sliders(p, p->them, to))) return true;
+  if (kind == KING) return !(attackers_to(p->sets, to, occ) & p->side[p->them]);
+  /* Vacating from only opens lines, so a cheaper attacker still attacks. */
+  for (int k = PAWN; VALUE[k] < VALUE[kind]; k++)
+    if (p->attacks[p->them][k] & BIT(to)) return false;
+  return see(p->sets, occ, to, p->them, VALUE[kind]) <= 0;
+}
+
+static bool find_hanging(const Position* p) {
+  u64 cand = p->side[p->them] & ~p->sets[p->them * 6 + KING] & p->attacked[p->us];
+  while (cand) {
+    int sq = bb_pop_lsb(&cand);
+    int value = VALUE[kind_at(p, p->them, sq)];
+    /* Taking with something cheaper wins whatever follows. */
+    for (int k = PAWN; VALUE[k] < value; k++)
+      if (p->attacks[p->us][k] & BIT(sq)) return true;
+    /* Undefended, and no slider of theirs to recapture through the square
+     * our capturer leaves. */
+    if (!(p->attacked[p->them] & BIT(sq)) && !line_sliders(p, p->them, sq)) return true;
+    if (see(p->sets, p->occ, sq, p->us, value) > 0) return true;
+  }
+  return false;
+}
+
+/* Forks and skewers: both need a move to a safe square. Destinations are
+ * screened setwise first; the exchange is only worked out for a move that
+ * would fork or skewer. */
+static uint32_t find_moves(const Position* p) {
+  const uint32_t all = MOTIF_FORK | MOTIF_SKEWER;
+  uint32_t found = 0;
+  const u64* theirs = p->sets + p->them * 6;
+  /* A target is the king, a piece worth more than the attacker or a loose one. */
+  u64 loose = p->side[p->them] & ~theirs[KING] & ~p->attacked[p->them];
+  for (int k = PAWN; k <= KING; k++) {
+    if (!p->sets[p->us * 6 + k]) continue;
+    u64 front = theirs[KING];
+    for (int f = PAWN; f < KING; f++)
+      if (VALUE[f] > VALUE[k]) front |= theirs[f];
+    u64 tgt = front | loose;
+    bool fork = (tgt & (tgt - 1)) != 0;
+    bool skewer = k >= BISHOP && k <= QUEEN && front;
+    if (!fork && !skewer) continue;
+    if (k == PAWN || k == KNIGHT || k == KING) {
+      /* Attacks that ignore occupancy: the fork squares are those reached
+       * from two targets by the reverse attack. */
+      if (found & MOTIF_FORK) continue;
+      u64 seen = 0, twice = 0, t = k == PAWN ? 0 : tgt;
+      if (k == PAWN) {
+        /* A pawn attacks just two squares: both must be targets. */
+        twice = p->us == WHITE ? ((tgt & NOT_H) >> 7) & ((tgt & NOT_A) >> 9)
+                               : ((tgt & NOT_H) << 9) & ((tgt & NOT_A) << 7);
+      }
+      while (t) {
+        u64 a = piece_attacks(k, p->them, bb_pop_lsb(&t), 0);
+        twice |= seen & a;
+        seen |= a;
+      }
+      u64 pieces = twice ? p->sets[p->us * 6 + k] : 0;
+      while (pieces && !(found & MOTIF_FORK)) {
+        int from = bb_pop_lsb(&pieces);
+        u64 dests = piece_moves(p, k, from) & twice;
+        while (dests) {
+          int to = bb_pop_lsb(&dests);
+          if (safe_square(p, k, from, to, (p->occ & ~BIT(from)) | BIT(to))) {
+            found |= MOTIF_FORK;
+            break;
+          }
+        }
+      }
+      if (found == all) return found;
+      continue;
+    }
+    /* Screen destinations by empty-board lines: a fork square lies on lines
+     * to two targets, a skewer square on a line through a front piece on the
+     * far side from another enemy piece. The exact attacks follow. */
+    int d0 = k == BISHOP ? 1 : 0, dstep = k == QUEEN ? 1 : 2;
+    u64 seen = 0, twice = 0, zone = 0, t = fork ? tgt : 0, f = skewer ? front : 0;
+    while (t) {
+      int sq = bb_pop_lsb(&t);
+      u64 a = empty_lines(k, sq);
+      twice |= seen & a;
+      seen |= a;
+    }
+    while (f) {
+      int sq = bb_pop_lsb(&f);
+      for (int d = d0; d < 8; d += dstep)
+        if (rays[d][sq] & p->side[p->them] & ~theirs[KING]) zone |= rays[(d + 4) & 7][sq];
+    }
+    u64 want = twice | zone;
+    u64 pieces = want ? p->sets[p->us * 6 + k] : 0;
+    while (pieces) {
+      int from = bb_pop_lsb(&pieces);
+      u64 dests = piece_moves(p, k, from) & want;
+      while (dests) {
+        int to = bb_pop_lsb(&dests);
+        u64 occ = (p->occ & ~BIT(from)) | BIT(to);
+        /* The few targets on our lines are checked for blockers one by one;
+         * the full attack set is only needed behind a front piece. */
+        u64 lines = empty_lines(k, to);
+        u64 hits = fork && !(found & MOTIF_FORK) ? in_sight(to, tgt & lines, occ) : 0;
+        u64 fronts = skewer && !(found & MOTIF_SKEWER) ? in_sight(to, front & lines, occ) : 0;
+        bool try_fork = (hits & (hits - 1)) != 0;
+        if (!try_fork && !fronts) continue;
+        uint32_t hit = 0;
+        if (try_fork) hit |= MOTIF_FORK;
+        if (fronts) {
+          u64 att = piece_attacks(k, p->us, to, occ);
+          while (fronts && !(hit & MOTIF_SKEWER)) {
+            int f = bb_pop_lsb(&fronts);
+            /* Lifting the front piece extends only its own ray. */
+            u64 behind = piece_attacks(k, p->us, to, occ & ~BIT(f)) & ~att & p->side[p->them] & ~theirs[KING];
+            if (!behind) continue;
+            int b = bb_lsb(behind);
+            int fk = kind_at(p, p->them, f), bk = kind_at(p, p->them, b);
+            if ((fk == KING || VALUE[bk] < VALUE[fk]) && (VALUE[bk] > VALUE[k] || !(p->attacked[p->them] & BIT(b))))
+              hit |= MOTIF_SKEWER;
+          }
+        }
+        if (hit && safe_square(p, k, from, to, occ)) {
+          found |= hit;
+          if (found == all) return found;
+        }
+      }
+    }
+  }
+  return found;
+}
+
+/* Can our piece on sq move off line? */
+static bool can_leave(const Position* p, int sq, u64 line) {
+  return (piece_moves(p, kind_at(p, p->us, sq), sq) & ~line) != 0;
+}
+
+/* Pins and discoveries: one piece between one of our sliders and an enemy piece. */
+static uint32_t find_lines(const Position* p) {
+  uint32_t found = 0;
+  for (int k = BISHOP; k <= QUEEN; k++) {
+    u64 sliders = p->sets[p->us * 6 + k];
+    while (sliders) {
+      int s = bb_pop_lsb(&sliders);
+      u64 aligned = empty_lines(k, s) & p->side[p->them];
+      while (aligned) {
+        int t = bb_pop_lsb(&aligned);
+        u64 inside = between[s][t] & p->occ;
+        if (!inside || (inside & (inside - 1))) continue;
+        int m = bb_lsb(inside);
+        int tk = kind_at(p, p->them, t);
+        if (inside & p->side[p->them]) {
+          int mk = kind_at(p, p->them, m);
+          if (mk != KING && (tk == KING || VALUE[tk] > VALUE[mk])) found |= MOTIF_PIN;
+        } else if ((tk == KING || VALUE[tk] > VALUE[k] || !(p->attacked[p->them] & BIT(t))) &&
+                   can_leave(p, m, board_line(s, t))) {
+          found |= tk == KING ? MOTIF_DISCOVERED_CHECK : MOTIF_DISCOVERED_ATTACK;
+        }
+      }
+    }
+  }
+  return found;
+}
+
+static void position_load(Position* p, const Board* b) {
+  board_piece_sets(b, p->sets);
+  p->us = b->sideToMove;
+  p->them = p->us ^ 1;
+  p->occ = 0;
+  for (int c = 0; c < 2; c++) {
+    p->side[c] = 0;
+    for (int k = PAWN; k <= KING; k++) p->side[c] |= p->sets[c * 6 + k];
+    p->occ |= p->side[c];
+  }
+  p->attacks[WHITE][PAWN] = ((p->sets[PAWN] & NOT_A) << 7) | ((p->sets[PAWN] & NOT_H) << 9);
+  p->attacks[BLACK][PAWN] = ((p->sets[6 + PAWN] & NOT_A) >> 9) | ((p->sets[6 + PAWN] & NOT_H) >> 7);
+  for (int c = 0; c < 2; c++) {
+    p->attacked[c] = p->attacks[c][PAWN];
+    for (int k = KNIGHT; k <= KING; k++) {
+      u64 bb = p->sets[c * 6 + k], att = 0;
+      while (bb) {
+        int sq = bb_pop_lsb(&bb);
+        p->piece_att[sq] = piece_attacks(k, c, sq, p->occ);
+        att |= p->piece_att[sq];
+      }
+      p->attacks[c][k] = att;
+      p->attacked[c] |= att;
+    }
+  }
+}
+
+uint32_t motif_tag(const Board* b) {
+  Position p;
+  init_rays();
+  position_load(&p, b);
+  uint32_t tags = find_lines(&p) | find_moves(&p);
+  if (find_hanging(&p)) tags |= MOTIF_HANGING;
+  return tags;
+}
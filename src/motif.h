@@ -0,0 +1,31 @@
+#ifndef MOTIF_H
+#define MOTIF_H
+
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Tactical motifs available to the side to move, read off attack bitboards,
+ * between/line masks and static exchange (SEE) values rather than by playing
+ * moves out. Moves are pseudo-legal: a piece pinned to its own king still
+ * counts. A target is the enemy king, an enemy piece worth more than the
+ * attacker, or one no enemy piece defends. */
+
+#define MOTIF_HANGING 1            /* a capture wins material by static exchange */
+#define MOTIF_FORK 2               /* a move to a square that loses nothing by exchange attacks two targets */
+#define MOTIF_PIN 4                /* a slider pins an enemy piece to the king or to a more valuable piece */
+#define MOTIF_SKEWER 8             /* a slider move to a safe square attacks a target with a lesser target behind it */
+#define MOTIF_DISCOVERED_ATTACK 16 /* our piece alone between our slider and a target can step off the line */
+#define MOTIF_DISCOVERED_CHECK 32  /* the same with the enemy king as the target */
+#define MOTIF_KINDS 6
+
+/* Static exchange on sq for side: it captures first with its least valuable
+ * attacker a piece worth target_value, and both sides then recapture with
+ * least valuable attackers while that pays (P 100, N and B 300, R 500,
+ * Q 900). sets are board_piece_sets order and only pieces within occ take
+ * part. Returns side's net gain, or 0 when side has no attacker. */
+int motif_see(const u64* sets, u64 occ, int sq, int side, int target_value);
+
+/* MOTIF_* bits of b for its side to move. */
+uint32_t motif_tag(const Board* b);
+
+#endif
@@ -0,0 +1,407 @@
+/* NDJSON game ingestion with a SIMD structural scan (SSE2 where available). */
+
+#include "ndjson.h"
+#include "alloc.h"
+#include "bitops.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NDJSON_SSE2 1
+#endif
+
+#define FEN_MAX 128
+#define FILE_CHUNK (1 << 20)
+
+/* Structural character sets for scan_to(). */
+#define SET_STRING 0 /* '"' '\\' */
+#define SET_NESTED 1 /* '"' '{' '}' '[' ']' */
+
+static bool in_set(unsigned char c, int set) {
+  if (set == SET_STRING) return c == '"' || c == '\\';
+  return c == '"' || c == '{' || c == '}' || c == '[' || c == ']';
+}
+
+/* First byte in [p, end) belonging to set, or end. Sixteen bytes are
+ * classified per step: one compare per structural character, OR-ed into a
+ * bitmask whose lowest set bit is the hit. */
+static const char* scan_to(const char* p, const char* end, int set) {
+#ifdef NDJSON_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i bslash = _mm_set1_epi8('\\');
+  const __m128i lbrace = _mm_set1_epi8('{');
+  const __m128i rbrace = _mm_set1_epi8('}');
+  const __m128i lbrack = _mm_set1_epi8('[');
+  const __m128i rbrack = _mm_set1_epi8(']');
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)p);
+    __m128i hit = _mm_cmpeq_epi8(v, quote);
+    if (set == SET_STRING) {
+      hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, bslash));
+    } else {
+      hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, lbrace), _mm_cmpeq_epi8(v, rbrace)));
+      hit = _mm_or_si128(hit, _mm_or_si128(_mm_cmpeq_epi8(v, lbrack), _mm_cmpeq_epi8(v, rbrack)));
+    }
+    unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+    if (mask) return p + bb_lsb(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && !in_set((unsigned char)*p, set)) p++;
+  return p;
+}
+
+static const char* skip_ws(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+  return p;
+}
+
+/* p is just past an opening quote; returns the closing quote or NULL. */
+static const char* string_end(const char* p, const char* end, bool* escaped) {
+  for (;;) {
+    p = scan_to(p, end, SET_STRING);
+    if (p >= end) return NULL;
+    if (*p == '"') return p;
+    *escaped = true;
+    p += 2;
+  }
+}
+
+/* p is at '{' or '['; returns just past the matching close or NULL. */
+static const char* skip_nested(const char* p, const char* end) {
+  int depth = 0;
+  while (p < end) {
+    p = scan_to(p, end, SET_NESTED);
+    if (p >= end) return NULL;
+    if (*p == '"') {
+      bool esc = false;
+      p = string_end(p + 1, end, &esc);
+      if (!p) return NULL;
+    } else if (*p == '{' || *p == '[') {
+      depth++;
+    } else if (--depth == 0) {
+      return p + 1;
+    }
+    p++;
+  }
+  return NULL;
+}
+
+bool json_scan_object(const char* line, size_t len, const char* const* names, int n, JsonSlice* out) {
+  const char* end = line + len;
+  const char* p = skip_ws(line, end);
+  for (int i = 0; i < n; i++) {
+    out[i].ptr = NULL;
+    out[i].len = 0;
+    out[i].type = JSON_MISSING;
+    out[i].escaped = false;
+  }
+  if (p >= end || *p != '{') return false;
+  p = skip_ws(p + 1, end);
+  if (p < end && *p == '}') return true;
+  while (p < end) {
+    bool esc = false;
+    if (*p != '"') return false;
+    const char* key = p + 1;
+    const char* key_end = string_end(key, end, &esc);
+    if (!key_end) return false;
+    p = skip_ws(key_end + 1, end);
+    if (p >= end || *p != ':') return false;
+    p = skip_ws(p + 1, end);
+    if (p >= end) return false;
+
+    JsonSlice v;
+    v.escaped = false;
+    if (*p == '"') {
+      v.ptr = p + 1;
+      const char* q = string_end(v.ptr, end, &v.escaped);
+      if (!q) return false;
+      v.len = (size_t)(q - v.ptr);
+      v.type = JSON_STRING;
+      p = q + 1;
+    } else if (*p == '{' || *p == '[') {
+      v.ptr = p;
+      p = skip_nested(p, end);
+      if (!p) return false;
+      v.len = (size_t)(p - v.ptr);
+      v.type = JSON_RAW;
+    } else {
+      v.ptr = p;
+      while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r') p++;
+      v.len = (size_t)(p - v.ptr);
+      if (v.len == 4 && memcmp(v.ptr, "true", 4) == 0) v.type = JSON_TRUE;
+      else if (v.len == 5 && memcmp(v.ptr, "false", 5) == 0) v.type = JSON_FALSE;
+      else if (v.len == 4 && memcmp(v.ptr, "null", 4) == 0) v.type = JSON_NULL;
+      else if (v.len > 0 && (*v.ptr == '-' || (*v.ptr >= '0' && *v.ptr <= '9'))) v.type = JSON_NUMBER;
+      else return false;
+    }
+
+    size_t key_len = (size_t)(key_end - key);
+    for (int i = 0; i < n; i++) {
+      if (out[i].type == JSON_MISSING && strlen(names[i]) == key_len && memcmp(names[i], key, key_len) == 0) {
+        out[i] = v;
+      }
+    }
+
+    p = skip_ws(p, end);
+    if (p >= end) return false;
+    if (*p == '}') return true;
+    if (*p != ',') return false;
+    p = skip_ws(p + 1, end);
+  }
+  return false;
+}
+
+static int hex4(const char* s) {
+  int v = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = s[i];
+    v <<= 4;
+    if (c >= '0' && c <= '9') v |= c - '0';
+    else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+    else return -1;
+  }
+  return v;
+}
+
+static size_t put_utf8(char* out, unsigned cp) {
+  if (cp < 0x80) {
+    out[0] = (char)cp;
+    return 1;
+  }
+  if (cp < 0x800) {
+    out[0] = (char)(0xc0 | (cp >> 6));
+    out[1] = (char)(0x80 | (cp & 0x3f));
+    return 2;
+  }
+  if (cp < 0x10000) {
+    out[0] = (char)(0xe0 | (cp >> 12));
+    out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+    out[2] = (char)(0x80 | (cp & 0x3f));
+    return 3;
+  }
+  out[0] = (char)(0xf0 | (cp >> 18));
+  out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+  out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+  out[3] = (char)(0x80 | (cp & 0x3f));
+  return 4;
+}
+
+size_t json_unescape(const char* s, size_t len, char* out) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] != '\\' || i + 1 >= len) {
+      out[n++] = s[i];
+      continue;
+    }
+    char c = s[++i];
+    switch (c) {
+      case 'b': out[n++] = '\b'; break;
+      case 'f': out[n++] = '\f'; break;
+      case 'n': out[n++] = '\n'; break;
+      case 'r': out[n++] = '\r'; break;
+      case 't': out[n++] = '\t'; break;
+      case 'u': {
+        int cp = i + 4 < len ? hex4(s + i + 1) : -1;
+        if (cp < 0) {
+          out[n++] = c;
+          break;
+        }
+        i += 4;
+        /* A high/low surrogate pair of escapes is one code point */
+        if (cp >= 0xd800 && cp < 0xdc00 && i + 6 < len && s[i + 1] == '\\' && s[i + 2] == 'u') {
+          int lo = hex4(s + i + 3);
+          if (lo >= 0xdc00 && lo < 0xe000) {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+            i += 6;
+          }
+        }
+        n += put_utf8(out + n, (unsigned)cp);
+        break;
+      }
+      default: out[n++] = c; break; /* \" \\ \/ */
+    }
+  }
+  return n;
+}
+
+void ndjson_reader_init(NdjsonReader* r, const NdjsonOptions* opts) {
+  memset(r, 0, sizeof(*r));
+  r->opts = *opts;
+  if (!r->opts.moves_field) r->opts.moves_field = "moves";
+  if (r->opts.field_count > NDJSON_MAX_FIELDS) r->opts.field_count = NDJSON_MAX_FIELDS;
+  replay_batch_init(&r->batch);
+  board_init_tables();
+}
+
+void ndjson_reader_free(NdjsonReader* r) {
+  replay_batch_free(&r->batch);
+  bc_free(r->values);
+  bc_free(r->strings);
+  bc_free(r->carry);
+  bc_free(r->scratch);
+  memset(r, 0, sizeof(*r));
+}
+
+void ndjson_reader_take(NdjsonReader* r) {
+  r->batch.key_count = 0;
+  r->batch.game_count = 0;
+  memset(&r->batch.norm, 0, sizeof(r->batch.norm));
+  r->strings_len = 0;
+}
+
+static bool reserve(char** buf, size_t* cap, size_t need) {
+  if (need <= *cap) return true;
+  size_t c = *cap ? *cap : 4096;
+  while (c < need) c *= 2;
+  char* p = (char*)bc_realloc(*buf, c);
+  if (!p) return false;
+  *buf = p;
+  *cap = c;
+  return true;
+}
+
+/* Copy a field value into the arena (strings unescaped, NUL-terminated). */
+static bool store_value(NdjsonReader* r, const JsonSlice* s, NdjsonValue* v) {
+  v->type = s->type;
+  v->offset = (uint32_t)r->strings_len;
+  v->len = 0;
+  if (s->type == JSON_MISSING) return true;
+  if (!reserve(&r->strings, &r->strings_cap, r->strings_len + s->len + 1)) return false;
+  char* dst = r->strings + r->strings_len;
+  size_t n = s->escaped ? json_unescape(s->ptr, s->len, dst) : (memcpy(dst, s->ptr, s->len), s->len);
+  dst[n] = '\0';
+  v->len = (uint32_t)n;
+  r->strings_len += n + 1;
+  return true;
+}
+
+static bool process_line(NdjsonReader* r, const char* line, size_t len) {
+  const NdjsonOptions* o = &r->opts;
+  const char* names[NDJSON_MAX_FIELDS + 2];
+  JsonSlice found[NDJSON_MAX_FIELDS + 2];
+  int nf = o->field_count;
+  int n = 0;
+  while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ' || line[len - 1] == '\t')) len--;
+  if (len == 0) return true;
+  for (int i = 0; i < nf; i++) names[n++] = o->fields[i];
+  names[n++] = o->moves_field;
+  if (o->fen_field) names[n++] = o->fen_field;
+
+  size_t game = r->batch.game_count;
+  if ((game + 1) * (size_t)nf > r->value_cap) {
+    size_t cap = r->value_cap ? r->value_cap * 2 : 256 * (size_t)(nf ? nf : 1);
+    while (cap < (game + 1) * (size_t)nf) cap *= 2;
+    NdjsonValue* values = (NdjsonValue*)bc_realloc(r->values, cap * sizeof(NdjsonValue));
+    if (!values) return false;
+    r->values = values;
+    r->value_cap = cap;
+  }
+
+  bool ok = json_scan_object(line, len, names, n, found);
+  const JsonSlice* moves = &found[nf];
+  const JsonSlice* fen = o->fen_field ? &found[nf + 1] : NULL;
+  /* A FEN too long to be one is malformed, not a reason to start from the initial position. */
+  bool bad_fen = ok && fen && fen->type == JSON_STRING && fen->len >= FEN_MAX;
+  if (!ok || moves->type != JSON_STRING || bad_fen) {
+    ReplayGameInfo* info = replay_batch_new_game(&r->batch);
+    if (!info) return false;
+    info->status = MOVE_ERR_SYNTAX;
+  } else {
+    Board b;
+    const char* text = moves->ptr;
+    size_t text_len = moves->len;
+    board_reset(&b);
+    if (fen && fen->type == JSON_STRING && fen->len > 0 && fen->len < FEN_MAX) {
+      char buf[FEN_MAX];
+      size_t fl = fen->escaped ? json_unescape(fen->ptr, fen->len, buf) : (memcpy(buf, fen->ptr, fen->len), fen->len);
+      buf[fl] = '\0';
+      board_load_fen(&b, buf);
+    }
+    if (moves->escaped) {
+      if (!reserve(&r->scratch, &r->scratch_cap, moves->len)) return false;
+      text_len = json_unescape(moves->ptr, moves->len, r->scratch);
+      text = r->scratch;
+    }
+    if (!replay_batch_game(&r->batch, &b, text, text_len, o->flags)) return false;
+  }
+  for (int i = 0; i < nf; i++) {
+    JsonSlice missing = { NULL, 0, JSON_MISSING, false };
+    if (!store_value(r, ok ? &found[i] : &missing, &r->values[game * (size_t)nf + (size_t)i])) return false;
+  }
+  return true;
+}
+
+bool ndjson_reader_push(NdjsonReader* r, const char* chunk, size_t len, bool final) {
+  const char* p = chunk;
+  const char* end = chunk + len;
+  if (r->oom) return false;
+  if (job_cancelled(r->batch.job)) {
+    r->carry_len = 0;
+    return true;
+  }
+  if (r->carry_len > 0) {
+    /* Complete the line left over from the previous chunk. */
+    const char* nl = (const char*)memchr(p, '\n', len);
+    size_t take = nl ? (size_t)(nl - p) : len;
+    if (!reserve(&r->carry, &r->carry_cap, r->carry_len + take)) goto oom;
+    memcpy(r->carry + r->carry_len, p, take);
+    r->carry_len += take;
+    if (!nl && !final) return true;
+    if (!process_line(r, r->carry, r->carry_len)) goto oom;
+    r->carry_len = 0;
+    p = nl ? nl + 1 : end;
+  }
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    if (!nl) break;
+    if (job_cancelled(r->batch.job)) {
+      r->carry_len = 0;
+      return true;
+    }
+    if (!process_line(r, p, (size_t)(nl - p))) goto oom;
+    p = nl + 1;
+  }
+  job_advance(r->batch.job, len);
+  if (p < end) {
+    size_t rest = (size_t)(end - p);
+    if (final) {
+      if (!process_line(r, p, rest)) goto oom;
+    } else {
+      if (!reserve(&r->carry, &r->carry_cap, rest)) goto oom;
+      memcpy(r->carry, p, rest);
+      r->carry_len = rest;
+    }
+  }
+  return true;
+oom:
+  r->oom = true;
+  return false;
+}
+
+bool ndjson_replay_file(NdjsonReader* r, const char* path) {
+  FILE* f = fopen(path, "rb");
+  if (!f) return false;
+  char* chunk = (char*)bc_malloc(FILE_CHUNK);
+  bool ok = chunk != NULL;
+  if (r->batch.job && fseek(f, 0, SEEK_END) == 0) {
+    long size = ftell(f);
+    if (size > 0) job_set_total(r->batch.job, (uint64_t)size);
+    rewind(f);
+  }
+  while (ok && !job_cancelled(r->batch.job)) {
+    size_t n = fread(chunk, 1, FILE_CHUNK, f);
+    bool last = n < FILE_CHUNK;
+    ok = ndjson_reader_push(r, chunk, n, last);
+    if (last) {
+      ok = ok && !ferror(f);
+      break;
+    }
+  }
+  bc_free(chunk);
+  fclose(f);
+  return ok;
+}
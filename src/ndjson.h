@@ -0,0 +1,91 @@
+#ifndef NDJSON_H
+#define NDJSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "replay.h"
+
+/* NDJSON game ingestion: one JSON object per line with a movetext field
+ * (space-separated SAN or UCI). Lines are not parsed into a DOM; a SIMD
+ * structural scan walks the top-level object, picks out the movetext, an
+ * optional start FEN and the requested fields, and replays the moves from
+ * the raw bytes (unescaping only when the string contains escapes). */
+
+#define NDJSON_MAX_FIELDS 32
+
+/* Type of a requested field's value */
+#define JSON_MISSING 0
+#define JSON_STRING 1  /* unescaped text */
+#define JSON_NUMBER 2  /* number text */
+#define JSON_TRUE 3
+#define JSON_FALSE 4
+#define JSON_NULL 5
+#define JSON_RAW 6     /* object or array, raw JSON text */
+
+typedef struct {
+  const char* ptr;
+  size_t len;
+  int type;
+  bool escaped; /* JSON_STRING containing backslash escapes */
+} JsonSlice;
+
+/* Find the top-level members names[0..n) of the JSON object in line and
+ * store their values (pointers into line, strings without quotes) in out.
+ * Returns false if the line is not a well-formed object. */
+bool json_scan_object(const char* line, size_t len, const char* const* names, int n, JsonSlice* out);
+
+/* Decode JSON string escapes (\uXXXX to UTF-8). out needs len bytes;
+ * returns the decoded length. */
+size_t json_unescape(const char* s, size_t len, char* out);
+
+typedef struct {
+  uint32_t offset; /* into NdjsonReader.strings; NUL-terminated */
+  uint32_t len;
+  int type;        /* JSON_* */
+} NdjsonValue;
+
+typedef struct {
+  int flags;                 /* REPLAY_* */
+  const char* moves_field;   /* default "moves" */
+  const char* fen_field;     /* start position, may be NULL; default none */
+  const char* const* fields; /* extra fields to return per game */
+  int field_count;
+} NdjsonOptions;
+
+/* Incremental reader: push chunks of any size; every complete line becomes a
+ * game in batch (keys, status) with its field values in values/strings. A
+ * blank line is skipped; a malformed one, or one whose FEN field is
+ * longer than any FEN, is a game with MOVE_ERR_SYNTAX. */
+typedef struct {
+  NdjsonOptions opts;
+  ReplayBatch batch;
+  NdjsonValue* values; /* game_count * field_count */
+  size_t value_cap;
+  char* strings;       /* field text arena */
+  size_t strings_len;
+  size_t strings_cap;
+  char* carry;         /* incomplete last line of the previous chunk */
+  size_t carry_len;
+  size_t carry_cap;
+  char* scratch;       /* unescaped movetext */
+  size_t scratch_cap;
+  bool oom;
+} NdjsonReader;
+
+void ndjson_reader_init(NdjsonReader* r, const NdjsonOptions* opts);
+void ndjson_reader_free(NdjsonReader* r);
+
+/* Process the complete lines of chunk; with final, also the unterminated
+ * tail. Once batch.job is cancelled the remaining lines are dropped.
+ * Returns false on allocation failure. */
+bool ndjson_reader_push(NdjsonReader* r, const char* chunk, size_t len, bool final);
+
+/* Drop the games collected so far (after the caller has consumed them). */
+void ndjson_reader_take(NdjsonReader* r);
+
+/* Replay a whole NDJSON file in chunks. Returns false if it cannot be read
+ * or on allocation failure. */
+bool ndjson_replay_file(NdjsonReader* r, const char* path);
+
+#endif
@@ -0,0 +1,176 @@
+/* Parallel hashed perft: root moves and deeper subtrees are split into tasks
+ * on a work-stealing pool; every task works on its own Board copy (copy-make)
+ * and all threads share one lockless hash table of (key, depth) -> nodes. */
+
+#include "perft.h"
+#include "alloc.h"
+#include "pool.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Subtrees with more plies left than this are split into child tasks. */
+#define PERFT_SPLIT_DEPTH 4
+
+/* Lockless entry (XOR trick): a torn write fails the check and reads as a miss. */
+typedef struct {
+  uint64_t check; /* key ^ data */
+  uint64_t data;  /* nodes << 8 | depth */
+} PerftEntry;
+
+typedef struct {
+  PerftEntry* entries;
+  uint64_t mask;
+} PerftHash;
+
+typedef struct {
+  Pool* pool;
+  PerftHash* hash;
+} PerftJob;
+
+typedef struct {
+  PerftJob* job;
+  Board board;
+  int depth;
+  uint64_t* counter;
+} PerftTask;
+
+static uint64_t hash_slot(const PerftHash* h, uint64_t key, int depth) {
+  return (key ^ ((uint64_t)depth * UINT64_C(0x9e3779b97f4a7c15))) & h->mask;
+}
+
+static bool hash_probe(const PerftHash* h, uint64_t key, int depth, uint64_t* nodes) {
+  PerftEntry* e = &h->entries[hash_slot(h, key, depth)];
+  uint64_t data = bc_atomic_load_u64(&e->data);
+  uint64_t check = bc_atomic_load_u64(&e->check);
+  if ((check ^ data) != key || (int)(data & 0xff) != depth) return false;
+  *nodes = data >> 8;
+  return true;
+}
+
+static void hash_store(PerftHash* h, uint64_t key, int depth, uint64_t nodes) {
+  PerftEntry* e = &h->entries[hash_slot(h, key, depth)];
+  uint64_t data = (nodes << 8) | (uint64_t)depth;
+  bc_atomic_store_u64(&e->data, data);
+  bc_atomic_store_u64(&e->check, key ^ data);
+}
+
+static uint64_t perft_serial(const Board* b, int depth, PerftHash* h) {
+  Move moves[BOARD_MAX_MOVES];
+  if (depth == 0) return 1;
+  int n = board_generate_moves(b, moves);
+  if (depth == 1) return (uint64_t)n;
+  uint64_t key = 0;
+  uint64_t total = 0;
+  if (h) {
+    key = board_get_zobrist_key(b);
+    if (hash_probe(h, key, depth, &total)) return total;
+  }
+  for (int i = 0; i < n; i++) {
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    total += perft_serial(&child, depth - 1, h);
+  }
+  if (h) hash_store(h, key, depth, total);
+  return total;
+}
+
+static void perft_task(void* arg, int worker) {
+  PerftTask* t = (PerftTask*)arg;
+  PerftJob* job = t->job;
+  if (t->depth > PERFT_SPLIT_DEPTH) {
+    Move moves[BOARD_MAX_MOVES];
+    int n = board_generate_moves(&t->board, moves);
+    uint64_t inline_nodes = 0;
+    for (int i = 0; i < n; i++) {
+      PerftTask* child = (PerftTask*)bc_malloc(sizeof(PerftTask));
+      Board next = t->board;
+      board_make_move(&next, &moves[i]);
+      if (child) {
+        child->job = job;
+        child->board = next;
+        child->depth = t->depth - 1;
+        child->counter = t->counter;
+        if (pool_submit(job->pool, worker, perft_task, child)) continue;
+        bc_free(child);
+      }
+      inline_nodes += perft_serial(&next, t->depth - 1, job->hash);
+    }
+    if (inline_nodes) bc_atomic_add_u64(t->counter, inline_nodes);
+  } else {
+    bc_atomic_add_u64(t->counter, perft_serial(&t->board, t->depth, job->hash));
+  }
+  bc_free(t);
+}
+
+static bool hash_init(PerftHash* h, size_t hash_mb) {
+  size_t count = 1;
+  size_t want = hash_mb * 1024 * 1024 / sizeof(PerftEntry);
+  while (count * 2 <= want) count *= 2;
+  h->entries = (PerftEntry*)bc_aligned_calloc(BC_CACHE_LINE, count, sizeof(PerftEntry));
+  h->mask = (uint64_t)count - 1;
+  return h->entries != NULL;
+}
+
+uint64_t board_perft(const Board* b, int depth, const PerftOptions* opts,
+                     PerftDivide* divide, int* divide_count) {
+  Move moves[BOARD_MAX_MOVES];
+  uint64_t counters[BOARD_MAX_MOVES];
+  PerftHash hash;
+  PerftHash* h = NULL;
+  int threads = opts && opts->threads > 0 ? opts->threads : 0;
+  size_t hash_mb = opts ? opts->hash_mb : 0;
+
+  board_init_tables();
+  if (divide_count) *divide_count = 0;
+  if (depth <= 0) return 1;
+  if (hash_mb > 0) {
+    if (!hash_init(&hash, hash_mb)) return UINT64_MAX;
+    h = &hash;
+  }
+
+  int n = board_generate_moves(b, moves);
+  memset(counters, 0, sizeof(counters));
+  Pool* pool = NULL;
+  if (threads != 1 && depth > 1) pool = pool_create(threads);
+
+  if (!pool) {
+    for (int i = 0; i < n; i++) {
+      Board child = *b;
+      board_make_move(&child, &moves[i]);
+      counters[i] = perft_serial(&child, depth - 1, h);
+    }
+  } else {
+    PerftJob job;
+    job.pool = pool;
+    job.hash = h;
+    for (int i = 0; i < n; i++) {
+      PerftTask* t = (PerftTask*)bc_malloc(sizeof(PerftTask));
+      Board child = *b;
+      board_make_move(&child, &moves[i]);
+      if (t) {
+        t->job = &job;
+        t->board = child;
+        t->depth = depth - 1;
+        t->counter = &counters[i];
+        if (pool_submit(pool, -1, perft_task, t)) continue;
+        bc_free(t);
+      }
+      counters[i] = perft_serial(&child, depth - 1, h);
+    }
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+
+  uint64_t total = 0;
+  for (int i = 0; i < n; i++) {
+    total += counters[i];
+    if (divide) {
+      divide[i].move = moves[i];
+      divide[i].nodes = counters[i];
+    }
+  }
+  if (divide_count) *divide_count = n;
+  if (h) bc_aligned_free(hash.entries);
+  return total;
+}
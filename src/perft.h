@@ -0,0 +1,24 @@
+#ifndef PERFT_H
+#define PERFT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+typedef struct {
+  Move move;
+  uint64_t nodes;
+} PerftDivide;
+
+typedef struct {
+  int threads;      /* <= 0: one per CPU */
+  size_t hash_mb;   /* shared perft hash size; 0 disables hashing */
+} PerftOptions;
+
+/* Count leaf nodes of the legal move tree to depth. When divide is non-NULL it
+ * receives one entry per legal root move (up to BOARD_MAX_MOVES) and
+ * *divide_count their number. Returns UINT64_MAX on allocation failure. */
+uint64_t board_perft(const Board* b, int depth, const PerftOptions* opts,
+                     PerftDivide* divide, int* divide_count);
+
+#endif
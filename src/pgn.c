@@ -0,0 +1,190 @@
+/* PGN game, tag and movetext scanning (see pgn.h). */
+
+#include "pgn.h"
+#include <string.h>
+
+static bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/* Start of the line after p (or end). */
+static size_t next_line(const char* buf, size_t len, size_t p) {
+  while (p < len && buf[p] != '\n') p++;
+  return p < len ? p + 1 : len;
+}
+
+static bool line_is_blank(const char* buf, size_t len, size_t p) {
+  while (p < len && buf[p] != '\n') {
+    if (!is_space(buf[p])) return false;
+    p++;
+  }
+  return true;
+}
+
+bool pgn_next_game(const char* buf, size_t len, size_t* pos, PgnGame* game) {
+  size_t p = *pos;
+  /* Skip blank lines and a UTF-8 BOM. */
+  if (p == 0 && len >= 3 && (unsigned char)buf[0] == 0xef && (unsigned char)buf[1] == 0xbb && (unsigned char)buf[2] == 0xbf) p = 3;
+  while (p < len && line_is_blank(buf, len, p)) p = next_line(buf, len, p);
+  if (p >= len) {
+    *pos = len;
+    return false;
+  }
+  game->offset = p;
+  game->tags = buf + p;
+  while (p < len) {
+    size_t q = p;
+    while (q < len && (buf[q] == ' ' || buf[q] == '\t')) q++;
+    if (q >= len || buf[q] != '[') break;
+    p = next_line(buf, len, p);
+  }
+  game->tags_len = (size_t)(buf + p - game->tags);
+  while (p < len && line_is_blank(buf, len, p)) p = next_line(buf, len, p);
+
+  game->moves = buf + p;
+  int depth = 0; /* inside {comment} */
+  bool seen = false;
+  size_t end = p;
+  while (p < len) {
+    if (depth == 0) {
+      size_t q = p;
+      while (q < len && (buf[q] == ' ' || buf[q] == '\t')) q++;
+      if (q < len && buf[q] == '[') break;
+      if (seen && line_is_blank(buf, len, p)) break;
+    }
+    size_t eol = next_line(buf, len, p);
+    for (size_t i = p; i < eol; i++) {
+      char c = buf[i];
+      if (c == '{') depth = 1;
+      else if (c == '}') depth = 0;
+      else if (depth == 0 && c == ';') break;
+      if (!is_space(c)) seen = true;
+    }
+    p = eol;
+    end = p;
+  }
+  game->moves_len = end - (size_t)(game->moves - buf);
+  *pos = p;
+  return true;
+}
+
+const char* pgn_find_game_start(const char* from, const char* end) {
+  const char* p = from;
+  while (p < end) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(end - p));
+    if (!nl) return end;
+    const char* q = nl + 1;
+    while (q < end && (*q == '\r' || *q == ' ' || *q == '\t')) q++;
+    if (q < end && *q == '\n') {
+      const char* r = q + 1;
+      while (r < end && (*r == '\r' || *r == '\n' || *r == ' ' || *r == '\t')) r++;
+      if (r < end && *r == '[') return r;
+    }
+    p = q;
+  }
+  return end;
+}
+
+bool pgn_get_tag(const PgnGame* game, const char* name, const char** value, size_t* value_len) {
+  size_t name_len = strlen(name);
+  const char* p = game->tags;
+  const char* end = game->tags + game->tags_len;
+  while (p < end) {
+    while (p < end && *p != '[') p++;
+    if (p >= end) break;
+    p++;
+    while (p < end && *p == ' ') p++;
+    const char* n = p;
+    while (p < end && !is_space(*p) && *p != '"' && *p != ']') p++;
+    bool match = (size_t)(p - n) == name_len && memcmp(n, name, name_len) == 0;
+    while (p < end && *p != '"' && *p != ']' && *p != '\n') p++;
+    if (p < end && *p == '"') {
+      const char* v = ++p;
+      while (p < end && *p != '"' && *p != '\n') {
+        if (*p == '\\' && p + 1 < end) p++;
+        p++;
+      }
+      if (match) {
+        *value = v;
+        *value_len = (size_t)(p - v);
+        return true;
+      }
+    }
+    while (p < end && *p != '\n') p++;
+  }
+  return false;
+}
+
+void pgn_tokens_init(PgnTokenizer* t, const char* text, size_t len) {
+  t->p = text;
+  t->end = text + len;
+}
+
+static bool is_result(const char* s, int n) {
+  return (n == 1 && s[0] == '*') ||
+         (n == 3 && (memcmp(s, "1-0", 3) == 0 || memcmp(s, "0-1", 3) == 0)) ||
+         (n == 7 && memcmp(s, "1/2-1/2", 7) == 0);
+}
+
+bool pgn_next_move(PgnTokenizer* t, const char** tok, int* tok_len) {
+  const char* p = t->p;
+  const char* end = t->end;
+  while (p < end) {
+    char c = *p;
+    if (is_space(c)) { p++; continue; }
+    if (c == '{') {
+      while (p < end && *p != '}') p++;
+      if (p < end) p++;
+      continue;
+    }
+    if (c == ';' || (c == '%' && (p == t->p || p[-1] == '\n'))) {
+      while (p < end && *p != '\n') p++;
+      continue;
+    }
+    if (c == '(') {
+      int depth = 0;
+      while (p < end) {
+        if (*p == '{') {
+          while (p < end && *p != '}') p++;
+        } else if (*p == '(') {
+          depth++;
+        } else if (*p == ')') {
+          if (--depth == 0) { p++; break; }
+        }
+        if (p < end) p++;
+      }
+      continue;
+    }
+    if (c == ')') { p++; continue; }
+    if (c == '$') {
+      p++;
+      while (p < end && *p >= '0' && *p <= '9') p++;
+      continue;
+    }
+    const char* s = p;
+    while (p < end && !is_space(*p) && *p != '{' && *p != '(' && *p != ')' && *p != ';') p++;
+    int n = (int)(p - s);
+    if (is_result(s, n)) {
+      t->p = end;
+      return false;
+    }
+    /* Move number prefix: "12." / "12..." possibly glued to the move ("1.e4"). */
+    int i = 0;
+    while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+    if (i > 0 && i < n && s[i] == '.') {
+      while (i < n && s[i] == '.') i++;
+      s += i;
+      n -= i;
+    } else if (i == n && !(n == 4 && memcmp(s, "0000", 4) == 0)) {
+      continue; /* bare move number; "0000" is a UCI null move */
+    }
+    while (n > 0 && s[0] == '.') { s++; n--; }
+    if (n == 0) continue;
+    t->p = p;
+    *tok = s;
+    *tok_len = n;
+    return true;
+  }
+  t->p = end;
+  return false;
+}
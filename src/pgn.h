@@ -0,0 +1,39 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Zero-copy PGN scanning: games, tag pairs and movetext tokens are returned as
+ * pointers into the caller's buffer, which need not be NUL-terminated. */
+
+typedef struct {
+  const char* tags;   /* tag-pair section ("[Event ...]" lines) */
+  size_t tags_len;
+  const char* moves;  /* movetext */
+  size_t moves_len;
+  size_t offset;      /* byte offset of the game in the buffer */
+} PgnGame;
+
+/* Find the next game at or after *pos; advances *pos past it. */
+bool pgn_next_game(const char* buf, size_t len, size_t* pos, PgnGame* game);
+
+/* Start of the first tag section ('[' opening a line after a blank line)
+ * after from, or end: where a chunk of a PGN buffer can be cut between games. */
+const char* pgn_find_game_start(const char* from, const char* end);
+
+/* Look up a tag value (without quotes or escapes resolved). */
+bool pgn_get_tag(const PgnGame* game, const char* name, const char** value, size_t* value_len);
+
+typedef struct {
+  const char* p;
+  const char* end;
+} PgnTokenizer;
+
+void pgn_tokens_init(PgnTokenizer* t, const char* text, size_t len);
+
+/* Next SAN/UCI move token. Move numbers, comments, variations, NAGs and
+ * escapes are skipped; a game result ends the movetext. */
+bool pgn_next_move(PgnTokenizer* t, const char** tok, int* tok_len);
+
+#endif
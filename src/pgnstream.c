@@ -0,0 +1,125 @@
+/* Incremental PGN replay and record batches (see pgnstream.h). A chunk is
+ * appended to the carry, which is searched for game starts from where the
+ * last search stopped (backed up over a blank line still forming at the
+ * cut); everything before the last start found is whole games, replayed
+ * with replay_pgn, and the carry keeps the rest. */
+
+#include "pgnstream.h"
+#include "alloc.h"
+#include <string.h>
+
+void pgn_stream_init(PgnStream* s, int flags) {
+  memset(s, 0, sizeof(*s));
+  s->flags = flags;
+  replay_batch_init(&s->batch);
+}
+
+void pgn_stream_free(PgnStream* s) {
+  replay_batch_free(&s->batch);
+  bc_free(s->carry);
+  memset(s, 0, sizeof(*s));
+}
+
+static bool is_blank(char c) {
+  return c == '\n' || c == '\r' || c == ' ' || c == '\t';
+}
+
+bool pgn_stream_push(PgnStream* s, const char* chunk, size_t len, bool final) {
+  if (s->carry_len + len > s->carry_cap) {
+    size_t cap = s->carry_cap ? s->carry_cap : 65536;
+    while (cap < s->carry_len + len) cap *= 2;
+    char* grown = (char*)bc_realloc(s->carry, cap);
+    if (!grown) return false;
+    s->carry = grown;
+    s->carry_cap = cap;
+  }
+  if (len) memcpy(s->carry + s->carry_len, chunk, len);
+  s->carry_len += len;
+
+  const char* end = s->carry + s->carry_len;
+  size_t cut = final ? s->carry_len : 0;
+  if (!final) {
+    size_t from = s->scanned;
+    while (from > 0 && is_blank(s->carry[from - 1])) from--;
+    if (from > 0) from--;
+    for (const char* p = pgn_find_game_start(s->carry + from, end); p < end; p = pgn_find_game_start(p, end)) {
+      cut = (size_t)(p - s->carry);
+    }
+    s->scanned = s->carry_len;
+  }
+  if (cut == 0) return true;
+  if (!replay_pgn(s->carry, cut, s->flags, &s->batch)) return false;
+  s->carry_len -= cut;
+  memmove(s->carry, s->carry + cut, s->carry_len);
+  s->scanned = s->carry_len;
+  return true;
+}
+
+static size_t game_first_key(const PgnStream* s, size_t g) {
+  return g < s->batch.game_count ? s->batch.games[g].first_key : s->batch.key_count;
+}
+
+size_t pgn_stream_batch_end(const PgnStream* s, size_t from, size_t max_records) {
+  size_t to = from + 1;
+  size_t first = game_first_key(s, from);
+  while (to < s->batch.game_count && game_first_key(s, to + 1) - first <= max_records) to++;
+  return to;
+}
+
+static size_t align8(size_t n) {
+  return (n + 7) & ~(size_t)7;
+}
+
+size_t pgn_stream_batch_size(const PgnStream* s, size_t from, size_t to) {
+  size_t records = game_first_key(s, to) - game_first_key(s, from);
+  size_t games = to - from;
+  size_t size = RECORD_BATCH_HEADER + records * 8 + align8(records * 4) + align8(records * 2) + align8(games) * 2;
+  if (s->flags & REPLAY_PACKED) size += records * BOARD_PACKED_SIZE;
+  return size;
+}
+
+void pgn_stream_write_batch(const PgnStream* s, size_t from, size_t to, uint8_t* out) {
+  const ReplayBatch* b = &s->batch;
+  size_t first = game_first_key(s, from);
+  uint32_t records = (uint32_t)(game_first_key(s, to) - first);
+  uint32_t games = (uint32_t)(to - from);
+  uint16_t version = RECORD_BATCH_VERSION;
+  uint16_t flags = (s->flags & REPLAY_PACKED) ? RECORD_BATCH_POSITIONS : 0;
+  uint64_t first_game = s->first_game + from;
+  uint32_t packed_size = flags ? BOARD_PACKED_SIZE : 0;
+  memset(out, 0, pgn_stream_batch_size(s, from, to));
+  memcpy(out, RECORD_BATCH_MAGIC, 4);
+  memcpy(out + 4, &version, 2);
+  memcpy(out + 6, &flags, 2);
+  memcpy(out + 8, &games, 4);
+  memcpy(out + 12, &records, 4);
+  memcpy(out + 16, &first_game, 8);
+  memcpy(out + 24, &packed_size, 4);
+
+  uint8_t* keys = out + RECORD_BATCH_HEADER;
+  uint8_t* game = keys + (size_t)records * 8;
+  uint8_t* ply = game + align8((size_t)records * 4);
+  uint8_t* status = ply + align8((size_t)records * 2);
+  uint8_t* ends = status + align8(games);
+  uint8_t* positions = ends + align8(games);
+  if (records) memcpy(keys, b->keys + first, (size_t)records * 8);
+  for (size_t g = from; g < to; g++) {
+    uint32_t id = (uint32_t)(g - from);
+    size_t k0 = game_first_key(s, g), k1 = game_first_key(s, g + 1);
+    for (size_t k = k0; k < k1; k++) {
+      size_t n = k - k0 + 1;
+      uint16_t p = (uint16_t)(n > UINT16_MAX ? UINT16_MAX : n);
+      memcpy(game + (k - first) * 4, &id, 4);
+      memcpy(ply + (k - first) * 2, &p, 2);
+    }
+    status[id] = (uint8_t)b->games[g].status;
+    ends[id] = (uint8_t)b->games[g].end;
+  }
+  if (flags && records) memcpy(positions, b->packed + first * BOARD_PACKED_SIZE, (size_t)records * BOARD_PACKED_SIZE);
+}
+
+void pgn_stream_take(PgnStream* s) {
+  s->first_game += s->batch.game_count;
+  s->batch.key_count = 0;
+  s->batch.game_count = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef PGNSTREAM_H
+#define PGNSTREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "replay.h"
+
+/* Incremental PGN replay for input arriving in chunks cut anywhere. Each
+ * push replays the games whose end is known (the next game's tag section
+ * has arrived) and carries the rest to the next push. The games collected
+ * since the last take are written out as record batches: fixed-layout
+ * buffers of one record per replayed ply.
+ *
+ * Record batch layout (little-endian), every column starting on an 8-byte
+ * boundary:
+ *   header (RECORD_BATCH_HEADER bytes)
+ *     0  "BCRB"
+ *     4  u16 version (RECORD_BATCH_VERSION)
+ *     6  u16 flags (RECORD_BATCH_POSITIONS)
+ *     8  u32 games
+ *     12 u32 records
+ *     16 u64 id of the batch's first game (games count from 0 over the stream)
+ *     24 u32 bytes per packed position (BOARD_PACKED_SIZE, or 0)
+ *     28 u32 zero
+ *   keys       u64[records]  Zobrist key after the ply
+ *   game       u32[records]  game of the record, from 0 within the batch
+ *   ply        u16[records]  1 = after the first move
+ *   status     u8[games]     MOVE_OK or the MOVE_ERR_* that stopped the game
+ *   end        u8[games]     GAME_END_*
+ *   positions  u8[records * BOARD_PACKED_SIZE]  with RECORD_BATCH_POSITIONS */
+
+#define RECORD_BATCH_MAGIC "BCRB"
+#define RECORD_BATCH_VERSION 1
+#define RECORD_BATCH_HEADER 32
+#define RECORD_BATCH_POSITIONS 1
+
+typedef struct {
+  int flags;          /* REPLAY_* for every game; REPLAY_PACKED adds the positions column */
+  ReplayBatch batch;  /* games replayed since the last take */
+  uint64_t first_game; /* stream id of batch's first game */
+  char* carry;        /* input from the start of the first game not yet replayed */
+  size_t carry_len;
+  size_t carry_cap;
+  size_t scanned;     /* carry bytes already searched for a game start */
+} PgnStream;
+
+void pgn_stream_init(PgnStream* s, int flags);
+void pgn_stream_free(PgnStream* s);
+
+/* Add a chunk and replay the games it completes; with final, replay the
+ * rest too. Returns false on allocation failure. */
+bool pgn_stream_push(PgnStream* s, const char* chunk, size_t len, bool final);
+
+/* End of the record batch starting at game from: the game after as many
+ * whole games as fit in max_records records (at least one game). */
+size_t pgn_stream_batch_end(const PgnStream* s, size_t from, size_t max_records);
+
+/* Bytes of the record batch of games [from, to) of s->batch. */
+size_t pgn_stream_batch_size(const PgnStream* s, size_t from, size_t to);
+
+/* Write the record batch of games [from, to) into out (pgn_stream_batch_size bytes). */
+void pgn_stream_write_batch(const PgnStream* s, size_t from, size_t to, uint8_t* out);
+
+/* Drop the batch's games after the caller has written them out. */
+void pgn_stream_take(PgnStream* s);
+
+#endif
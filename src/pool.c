@@ -0,0 +1,204 @@
+/* Work-stealing thread pool (see pool.h). Deques are small mutex-guarded rings:
+ * tasks here are coarse (subtrees, games, chunks), so lock cost is negligible. */
+
+#include "pool.h"
+#include "alloc.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  PoolTaskFn fn;
+  void* arg;
+} PoolTask;
+
+typedef struct {
+  bc_mutex lock;
+  PoolTask* items;
+  size_t head; /* thieves take from here */
+  size_t tail; /* owner pushes/pops here */
+  size_t cap;
+} PoolDeque;
+
+typedef struct {
+  Pool* pool;
+  int index;
+} PoolWorker;
+
+struct Pool {
+  int n;
+  bc_thread* threads;
+  PoolWorker* workers;
+  PoolDeque* deques;
+  bc_mutex lock;
+  bc_cond work_cv;
+  bc_cond idle_cv;
+  int queued;  /* tasks sitting in deques */
+  int pending; /* tasks submitted and not yet finished */
+  int stop;
+  int next;    /* round-robin target for external submits */
+};
+
+static bool deque_push(PoolDeque* d, PoolTask t) {
+  bc_mutex_lock(&d->lock);
+  if (d->tail == d->cap) {
+    if (d->head > 0) {
+      memmove(d->items, d->items + d->head, (d->tail - d->head) * sizeof(PoolTask));
+      d->tail -= d->head;
+      d->head = 0;
+    } else {
+      size_t cap = d->cap ? d->cap * 2 : 64;
+      PoolTask* items = (PoolTask*)bc_realloc(d->items, cap * sizeof(PoolTask));
+      if (!items) { bc_mutex_unlock(&d->lock); return false; }
+      d->items = items;
+      d->cap = cap;
+    }
+  }
+  d->items[d->tail++] = t;
+  bc_mutex_unlock(&d->lock);
+  return true;
+}
+
+static bool deque_pop(PoolDeque* d, PoolTask* out) {
+  bool ok = false;
+  bc_mutex_lock(&d->lock);
+  if (d->tail > d->head) {
+    *out = d->items[--d->tail];
+    ok = true;
+  }
+  bc_mutex_unlock(&d->lock);
+  return ok;
+}
+
+static bool deque_steal(PoolDeque* d, PoolTask* out) {
+  bool ok = false;
+  bc_mutex_lock(&d->lock);
+  if (d->tail > d->head) {
+    *out = d->items[d->head++];
+    ok = true;
+  }
+  bc_mutex_unlock(&d->lock);
+  return ok;
+}
+
+static bool find_task(Pool* p, int w, PoolTask* out) {
+  if (deque_pop(&p->deques[w], out)) return true;
+  for (int i = 1; i < p->n; i++) {
+    if (deque_steal(&p->deques[(w + i) % p->n], out)) return true;
+  }
+  return false;
+}
+
+static void worker_main(void* arg) {
+  PoolWorker* self = (PoolWorker*)arg;
+  Pool* p = self->pool;
+  int w = self->index;
+  for (;;) {
+    PoolTask t;
+    if (find_task(p, w, &t)) {
+      bc_atomic_add_int(&p->queued, -1);
+      t.fn(t.arg, w);
+      if (bc_atomic_add_int(&p->pending, -1) == 1) {
+        bc_mutex_lock(&p->lock);
+        bc_cond_broadcast(&p->idle_cv);
+        bc_mutex_unlock(&p->lock);
+      }
+      continue;
+    }
+    bc_mutex_lock(&p->lock);
+    while (bc_atomic_load_int(&p->queued) == 0 && !p->stop) bc_cond_wait(&p->work_cv, &p->lock);
+    if (p->stop && bc_atomic_load_int(&p->queued) == 0) {
+      bc_mutex_unlock(&p->lock);
+      break;
+    }
+    bc_mutex_unlock(&p->lock);
+  }
+}
+
+Pool* pool_create(int threads) {
+  if (threads <= 0) threads = bc_cpu_count();
+  Pool* p = (Pool*)bc_calloc(1, sizeof(Pool));
+  if (!p) return NULL;
+  p->n = threads;
+  p->threads = (bc_thread*)bc_calloc((size_t)threads, sizeof(bc_thread));
+  p->workers = (PoolWorker*)bc_calloc((size_t)threads, sizeof(PoolWorker));
+  p->deques = (PoolDeque*)bc_calloc((size_t)threads, sizeof(PoolDeque));
+  if (!p->threads || !p->workers || !p->deques) {
+    bc_free(p->threads);
+    bc_free(p->workers);
+    bc_free(p->deques);
+    bc_free(p);
+    return NULL;
+  }
+  bc_mutex_init(&p->lock);
+  bc_cond_init(&p->work_cv);
+  bc_cond_init(&p->idle_cv);
+  for (int i = 0; i < threads; i++) bc_mutex_init(&p->deques[i].lock);
+  int started = 0;
+  for (int i = 0; i < threads; i++) {
+    p->workers[i].pool = p;
+    p->workers[i].index = i;
+    if (bc_thread_create(&p->threads[i], worker_main, &p->workers[i]) != 0) break;
+    started++;
+  }
+  if (started == 0) {
+    p->n = 0;
+    pool_destroy(p);
+    return NULL;
+  }
+  p->n = started;
+  return p;
+}
+
+void pool_destroy(Pool* p) {
+  if (!p) return;
+  bc_mutex_lock(&p->lock);
+  p->stop = 1;
+  bc_cond_broadcast(&p->work_cv);
+  bc_mutex_unlock(&p->lock);
+  for (int i = 0; i < p->n; i++) bc_thread_join(p->threads[i]);
+  for (int i = 0; i < p->n; i++) {
+    bc_mutex_destroy(&p->deques[i].lock);
+    bc_free(p->deques[i].items);
+  }
+  bc_cond_destroy(&p->idle_cv);
+  bc_cond_destroy(&p->work_cv);
+  bc_mutex_destroy(&p->lock);
+  bc_free(p->threads);
+  bc_free(p->workers);
+  bc_free(p->deques);
+  bc_free(p);
+}
+
+int pool_size(const Pool* p) {
+  return p->n;
+}
+
+bool pool_submit(Pool* p, int worker, PoolTaskFn fn, void* arg) {
+  PoolTask t;
+  t.fn = fn;
+  t.arg = arg;
+  int target = worker;
+  if (target < 0 || target >= p->n) {
+    bc_mutex_lock(&p->lock);
+    target = p->next;
+    p->next = (p->next + 1) % p->n;
+    bc_mutex_unlock(&p->lock);
+  }
+  bc_atomic_add_int(&p->pending, 1);
+  if (!deque_push(&p->deques[target], t)) {
+    bc_atomic_add_int(&p->pending, -1);
+    return false;
+  }
+  bc_atomic_add_int(&p->queued, 1);
+  bc_mutex_lock(&p->lock);
+  bc_cond_signal(&p->work_cv);
+  bc_mutex_unlock(&p->lock);
+  return true;
+}
+
+void pool_wait(Pool* p) {
+  bc_mutex_lock(&p->lock);
+  while (bc_atomic_load_int(&p->pending) > 0) bc_cond_wait(&p->idle_cv, &p->lock);
+  bc_mutex_unlock(&p->lock);
+}
@@ -0,0 +1,24 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+
+/* Work-stealing thread pool. Each worker owns a deque: it pushes and pops its
+ * own tasks LIFO and steals FIFO from the other workers when it runs dry. */
+
+typedef void (*PoolTaskFn)(void* arg, int worker);
+typedef struct Pool Pool;
+
+/* threads <= 0 uses the number of online CPUs. */
+Pool* pool_create(int threads);
+void pool_destroy(Pool* p);
+int pool_size(const Pool* p);
+
+/* Queue a task. worker is the calling worker's index (from the task callback),
+ * or -1 when submitting from outside the pool. Returns false on OOM. */
+bool pool_submit(Pool* p, int worker, PoolTaskFn fn, void* arg);
+
+/* Block until every submitted task (including tasks they submitted) is done. */
+void pool_wait(Pool* p);
+
+#endif
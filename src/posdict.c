@@ -0,0 +1,312 @@
+/* Deduplicated position dictionary (see posdict.h). The writer keeps the
+ * three entry columns in growing arrays and an open-addressed index of
+ * entry numbers beside them, rebuilt at twice the size whenever it passes
+ * half full; the file is those same arrays, so the reader probes the mapped
+ * index exactly as the writer probed its own. */
+
+#include "posdict.h"
+#include "alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define POSDICT_ALIGN 64
+#define POSDICT_PATH_MAX 1024
+#define POSDICT_MIN_SLOTS 1024
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint64_t count;
+  uint64_t slots;
+  uint64_t collisions;
+  uint8_t reserved[32];
+} PosDictFileHeader; /* 64 bytes; the columns follow */
+
+typedef struct {
+  uint64_t keys;
+  uint64_t flags;
+  uint64_t positions;
+  uint64_t index;
+} PosDictLayout;
+
+static uint64_t align(uint64_t n) {
+  return (n + POSDICT_ALIGN - 1) / POSDICT_ALIGN * POSDICT_ALIGN;
+}
+
+/* Offset of every column for count entries and slots index slots; returns the file size. */
+static uint64_t layout(uint64_t count, uint64_t slots, PosDictLayout* l) {
+  l->keys = sizeof(PosDictFileHeader);
+  l->flags = l->keys + align(count * 8);
+  l->positions = l->flags + align(count);
+  l->index = l->positions + align(count * BOARD_PACKED_SIZE);
+  return l->index + align(slots * 4);
+}
+
+/* Index slot holding key among keys[0..count), or the empty slot where it
+ * would go. A mapped index may be corrupt: the probe stops at an entry past
+ * count, or after visiting every slot, and callers check what it returns. */
+static size_t probe(const uint32_t* index, size_t mask, const uint64_t* keys, size_t count, uint64_t key) {
+  size_t slot = (size_t)key & mask;
+  for (size_t step = 0; step <= mask && index[slot]; step++) {
+    if (index[slot] > count || keys[index[slot] - 1] == key) break;
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/* ---- writer ---- */
+
+struct PosDictWriter {
+  uint64_t* keys;
+  uint8_t* flags;
+  uint8_t* positions;
+  size_t count;
+  size_t cap;
+  uint32_t* index;
+  size_t slots;
+  size_t collisions;
+};
+
+PosDictWriter* posdict_writer_create(void) {
+  return (PosDictWriter*)bc_calloc(1, sizeof(PosDictWriter));
+}
+
+void posdict_writer_destroy(PosDictWriter* w) {
+  if (!w) return;
+  bc_free(w->keys);
+  bc_free(w->flags);
+  bc_free(w->positions);
+  bc_free(w->index);
+  bc_free(w);
+}
+
+size_t posdict_writer_size(const PosDictWriter* w) {
+  return w->count;
+}
+
+size_t posdict_writer_collisions(const PosDictWriter* w) {
+  return w->collisions;
+}
+
+static bool grow_index(PosDictWriter* w) {
+  size_t slots = w->slots ? w->slots * 2 : POSDICT_MIN_SLOTS;
+  uint32_t* index = (uint32_t*)bc_calloc(slots, sizeof(uint32_t));
+  if (!index) return false;
+  for (size_t i = 0; i < w->count; i++) index[probe(index, slots - 1, w->keys, i, w->keys[i])] = (uint32_t)(i + 1);
+  bc_free(w->index);
+  w->index = index;
+  w->slots = slots;
+  return true;
+}
+
+static bool grow_entries(PosDictWriter* w) {
+  if (w->cap >= UINT32_MAX - 1) return false;
+  size_t cap = w->cap ? w->cap * 2 : 4096;
+  if (cap > UINT32_MAX - 1) cap = UINT32_MAX - 1;
+  uint64_t* keys = (uint64_t*)bc_realloc(w->keys, cap * sizeof(uint64_t));
+  if (!keys) return false;
+  w->keys = keys;
+  uint8_t* flags = (uint8_t*)bc_realloc(w->flags, cap);
+  if (!flags) return false;
+  w->flags = flags;
+  uint8_t* positions = (uint8_t*)bc_realloc(w->positions, cap * BOARD_PACKED_SIZE);
+  if (!positions) return false;
+  w->positions = positions;
+  w->cap = cap;
+  return true;
+}
+
+bool posdict_writer_add_packed(PosDictWriter* w, uint64_t key, const uint8_t packed[BOARD_PACKED_SIZE], uint8_t flags) {
+  if ((w->count + 1) * 2 > w->slots && !grow_index(w)) return false;
+  size_t slot = probe(w->index, w->slots - 1, w->keys, w->count, key);
+  if (w->index[slot]) {
+    size_t i = w->index[slot] - 1;
+    bool differs = memcmp(w->positions + i * BOARD_PACKED_SIZE, packed, BOARD_PACKED_SIZE) != 0;
+    uint8_t was = w->flags[i];
+    w->flags[i] |= (uint8_t)((flags & ~POSDICT_UNPACKED) | (differs ? POSDICT_COLLIDED : 0));
+    if (!(was & POSDICT_COLLIDED) && (w->flags[i] & POSDICT_COLLIDED)) w->collisions++;
+    return true;
+  }
+  if (w->count == w->cap && !grow_entries(w)) return false;
+  size_t i = w->count++;
+  w->keys[i] = key;
+  w->flags[i] = flags;
+  memcpy(w->positions + i * BOARD_PACKED_SIZE, packed, BOARD_PACKED_SIZE);
+  w->index[slot] = (uint32_t)(i + 1);
+  if (flags & POSDICT_COLLIDED) w->collisions++;
+  return true;
+}
+
+bool posdict_writer_add(PosDictWriter* w, uint64_t key, const Board* b) {
+  uint8_t packed[BOARD_PACKED_SIZE];
+  bool fits = board_pack(b, packed);
+  return posdict_writer_add_packed(w, key, packed, fits ? 0 : POSDICT_UNPACKED);
+}
+
+bool posdict_writer_load(PosDictWriter* w, const PositionDict* d) {
+  size_t n = posdict_size(d);
+  for (size_t i = 0; i < n; i++) {
+    uint64_t key;
+    const uint8_t* packed;
+    uint8_t flags;
+    posdict_get(d, i, &key, &packed, &flags);
+    if (!posdict_writer_add_packed(w, key, packed, flags)) return false;
+  }
+  return true;
+}
+
+static bool write_column(FILE* f, const void* data, size_t bytes) {
+  static const char zeros[POSDICT_ALIGN] = { 0 };
+  size_t pad = (size_t)(align(bytes) - bytes);
+  return (!bytes || fwrite(data, 1, bytes, f) == bytes) && (!pad || fwrite(zeros, 1, pad, f) == pad);
+}
+
+bool posdict_writer_finish(PosDictWriter* w, const char* path) {
+  char tmp[POSDICT_PATH_MAX + 8];
+  PosDictFileHeader h;
+  if (strlen(path) >= POSDICT_PATH_MAX) return false;
+  if (!w->slots && !grow_index(w)) return false;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, "BCPD", 4);
+  h.version = 1;
+  h.count = w->count;
+  h.slots = w->slots;
+  h.collisions = w->collisions;
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE* f = fopen(tmp, "wb");
+  if (!f) return false;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && write_column(f, w->keys, w->count * 8) &&
+            write_column(f, w->flags, w->count) && write_column(f, w->positions, w->count * BOARD_PACKED_SIZE) &&
+            write_column(f, w->index, w->slots * 4);
+  ok = (fclose(f) == 0) && ok;
+  if (ok) {
+    remove(path);
+    ok = rename(tmp, path) == 0;
+  }
+  if (!ok) remove(tmp);
+  return ok;
+}
+
+/* ---- reader ---- */
+
+struct PositionDict {
+  void* map;
+  size_t map_len;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+  size_t count;
+  size_t mask;
+  size_t collisions;
+  const uint64_t* keys;
+  const uint8_t* flags;
+  const uint8_t* positions;
+  const uint32_t* index;
+};
+
+static void unmap(PositionDict* d) {
+#ifdef _WIN32
+  UnmapViewOfFile(d->map);
+  CloseHandle(d->mapping);
+  CloseHandle(d->file);
+#else
+  munmap(d->map, d->map_len);
+#endif
+}
+
+PositionDict* posdict_open(const char* path) {
+  PosDictFileHeader h;
+  PosDictLayout l;
+  PositionDict* d = (PositionDict*)bc_calloc(1, sizeof(PositionDict));
+  if (!d) return NULL;
+#ifdef _WIN32
+  d->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (d->file == INVALID_HANDLE_VALUE) goto fail;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(d->file, &size) || (uint64_t)size.QuadPart < sizeof(PosDictFileHeader)) goto fail_file;
+  d->map_len = (size_t)size.QuadPart;
+  d->mapping = CreateFileMappingA(d->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!d->mapping) goto fail_file;
+  d->map = MapViewOfFile(d->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!d->map) {
+    CloseHandle(d->mapping);
+    goto fail_file;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0) goto fail;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(PosDictFileHeader)) {
+    close(fd);
+    goto fail;
+  }
+  d->map_len = (size_t)st.st_size;
+  d->map = mmap(NULL, d->map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (d->map == MAP_FAILED) {
+    d->map = NULL;
+    goto fail;
+  }
+#endif
+  memcpy(&h, d->map, sizeof(h));
+  if (memcmp(h.magic, "BCPD", 4) != 0 || h.version != 1 || h.count >= UINT32_MAX || h.slots < 2 * h.count ||
+      (h.slots & (h.slots - 1)) != 0 || layout(h.count, h.slots, &l) != (uint64_t)d->map_len) {
+    posdict_close(d);
+    return NULL;
+  }
+  d->count = (size_t)h.count;
+  d->mask = (size_t)h.slots - 1;
+  d->collisions = (size_t)h.collisions;
+  const char* base = (const char*)d->map;
+  d->keys = (const uint64_t*)(base + l.keys);
+  d->flags = (const uint8_t*)(base + l.flags);
+  d->positions = (const uint8_t*)(base + l.positions);
+  d->index = (const uint32_t*)(base + l.index);
+  return d;
+#ifdef _WIN32
+fail_file:
+  CloseHandle(d->file);
+#endif
+fail:
+  bc_free(d);
+  return NULL;
+}
+
+void posdict_close(PositionDict* d) {
+  if (!d) return;
+  if (d->map) unmap(d);
+  bc_free(d);
+}
+
+size_t posdict_size(const PositionDict* d) {
+  return d->count;
+}
+
+size_t posdict_collisions(const PositionDict* d) {
+  return d->collisions;
+}
+
+const uint8_t* posdict_find(const PositionDict* d, uint64_t key, uint8_t* flags) {
+  size_t slot = probe(d->index, d->mask, d->keys, d->count, key);
+  uint32_t entry = d->index[slot];
+  if (!entry || entry > d->count || d->keys[entry - 1] != key) return NULL;
+  if (flags) *flags = d->flags[entry - 1];
+  return d->positions + (size_t)(entry - 1) * BOARD_PACKED_SIZE;
+}
+
+void posdict_get(const PositionDict* d, size_t i, uint64_t* key, const uint8_t** packed, uint8_t* flags) {
+  if (key) *key = d->keys[i];
+  if (packed) *packed = d->positions + i * BOARD_PACKED_SIZE;
+  if (flags) *flags = d->flags[i];
+}
@@ -0,0 +1,63 @@
+#ifndef POSDICT_H
+#define POSDICT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Deduplicated position dictionary: one packed position (board_pack) per
+ * distinct Zobrist key, in the order the keys were first seen. Entries are
+ * only ever appended; a key arriving again with a different position keeps
+ * the first one and is flagged POSDICT_COLLIDED.
+ *
+ * A finished dictionary is a single file, memory-mapped to be read: a
+ * 64-byte header, then keys u64[count], flags u8[count], positions
+ * u8[count * BOARD_PACKED_SIZE] and the hash index u32[slots] (entry + 1,
+ * 0 for an empty slot; linear probing from the key's low bits, slots a
+ * power of two at least twice count), each starting on a 64-byte boundary. */
+
+#define POSDICT_COLLIDED 1 /* another position was added under the key */
+#define POSDICT_UNPACKED 2 /* more than 32 pieces: the position is all zero */
+
+/* ---- writing ---- */
+
+typedef struct PosDictWriter PosDictWriter;
+typedef struct PositionDict PositionDict;
+
+PosDictWriter* posdict_writer_create(void);
+void posdict_writer_destroy(PosDictWriter* w);
+size_t posdict_writer_size(const PosDictWriter* w);
+size_t posdict_writer_collisions(const PosDictWriter* w);
+
+/* Add b under key unless the key is already there, in which case the
+ * positions are compared. Returns false on allocation failure or past
+ * UINT32_MAX entries. */
+bool posdict_writer_add(PosDictWriter* w, uint64_t key, const Board* b);
+/* Same with the position already packed; flags (POSDICT_*) are or-ed into the entry's. */
+bool posdict_writer_add_packed(PosDictWriter* w, uint64_t key, const uint8_t packed[BOARD_PACKED_SIZE], uint8_t flags);
+
+/* Add every entry of d, to extend a dictionary written earlier. */
+bool posdict_writer_load(PosDictWriter* w, const PositionDict* d);
+
+/* Write the entries added so far to path (through a temporary file, so
+ * readers never see a partial dictionary). The writer keeps them, so later
+ * additions extend the same dictionary. Returns false on a write failure. */
+bool posdict_writer_finish(PosDictWriter* w, const char* path);
+
+/* ---- reading ---- */
+
+/* Map a dictionary file; NULL if it is missing or not a dictionary. */
+PositionDict* posdict_open(const char* path);
+void posdict_close(PositionDict* d);
+size_t posdict_size(const PositionDict* d);
+size_t posdict_collisions(const PositionDict* d);
+
+/* The packed position of key (in the map) and its flags (optional); NULL if
+ * absent, or if a corrupt index does not lead to it. */
+const uint8_t* posdict_find(const PositionDict* d, uint64_t key, uint8_t* flags);
+
+/* Entry i: key, packed position and flags (any may be NULL). */
+void posdict_get(const PositionDict* d, size_t i, uint64_t* key, const uint8_t** packed, uint8_t* flags);
+
+#endif
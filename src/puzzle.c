@@ -0,0 +1,261 @@
+/* Parallel puzzle CSV replay: the data rows are cut into line-aligned chunks,
+ * each chunk is replayed by a pool task into its own PuzzleBatch, and the
+ * chunk batches are concatenated in input order. */
+
+#include "puzzle.h"
+#include "alloc.h"
+#include "pool.h"
+#include "replay.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FEN_MAX 128
+#define CSV_MAX_COLUMNS 64
+#define CHUNKS_PER_THREAD 4
+#define MIN_CHUNK_BYTES (64 * 1024)
+
+typedef struct {
+  int id;
+  int fen;
+  int moves;
+  int rating;
+} PuzzleColumns;
+
+typedef struct {
+  const char* base; /* whole input, for id offsets */
+  const char* start;
+  const char* end;
+  const PuzzleColumns* cols;
+  int flags;
+  PuzzleBatch out;
+  size_t key_cap;
+  size_t row_cap;
+  size_t fens_cap;
+  bool oom;
+} PuzzleChunk;
+
+/* Split one CSV line into at most max fields (outer quotes stripped, "" left
+ * as is: ids, FENs and UCI lines never contain quotes). Returns the count. */
+static int csv_split(const char* p, const char* end, const char** field, size_t* field_len, int max) {
+  int n = 0;
+  while (n < max) {
+    const char* s = p;
+    const char* e;
+    if (p < end && *p == '"') {
+      s = ++p;
+      while (p < end && !(*p == '"' && (p + 1 >= end || p[1] != '"'))) p += (*p == '"') ? 2 : 1;
+      e = p < end ? p : end;
+      while (p < end && *p != ',') p++;
+    } else {
+      while (p < end && *p != ',') p++;
+      e = p;
+    }
+    field[n] = s;
+    field_len[n] = (size_t)(e - s);
+    n++;
+    if (p >= end) break;
+    p++;
+  }
+  return n;
+}
+
+static bool header_matches(const char* s, size_t n, const char* name) {
+  return strlen(name) == n && memcmp(s, name, n) == 0;
+}
+
+/* Column indices from a header line; false if the line is data. */
+static bool parse_header(const char* p, const char* end, PuzzleColumns* cols) {
+  const char* field[CSV_MAX_COLUMNS];
+  size_t field_len[CSV_MAX_COLUMNS];
+  int n = csv_split(p, end, field, field_len, CSV_MAX_COLUMNS);
+  PuzzleColumns c = { -1, -1, -1, -1 };
+  for (int i = 0; i < n; i++) {
+    if (header_matches(field[i], field_len[i], "PuzzleId")) c.id = i;
+    else if (header_matches(field[i], field_len[i], "FEN")) c.fen = i;
+    else if (header_matches(field[i], field_len[i], "Moves")) c.moves = i;
+    else if (header_matches(field[i], field_len[i], "Rating")) c.rating = i;
+  }
+  if (c.fen < 0 || c.moves < 0) return false;
+  *cols = c;
+  return true;
+}
+
+static bool grow(void** buf, size_t* cap, size_t need, size_t elem) {
+  if (need <= *cap) return true;
+  size_t c = *cap ? *cap * 2 : 256;
+  while (c < need) c *= 2;
+  void* p = bc_realloc(*buf, c * elem);
+  if (!p) return false;
+  *buf = p;
+  *cap = c;
+  return true;
+}
+
+static void collect_key(void* ctx, const Board* b, const Move* move, uint64_t key) {
+  PuzzleChunk* c = (PuzzleChunk*)ctx;
+  (void)b;
+  (void)move;
+  if (!grow((void**)&c->out.keys, &c->key_cap, c->out.key_count + 1, sizeof(uint64_t))) {
+    c->oom = true;
+    return;
+  }
+  c->out.keys[c->out.key_count++] = key;
+}
+
+static int parse_rating(const char* s, size_t n) {
+  int v = 0;
+  for (size_t i = 0; i < n && s[i] >= '0' && s[i] <= '9'; i++) v = v * 10 + (s[i] - '0');
+  return v;
+}
+
+static void replay_row(PuzzleChunk* c, const char* line, const char* end) {
+  const char* field[CSV_MAX_COLUMNS];
+  size_t field_len[CSV_MAX_COLUMNS];
+  const PuzzleColumns* cols = c->cols;
+  int n = csv_split(line, end, field, field_len, CSV_MAX_COLUMNS);
+  if (!grow((void**)&c->out.rows, &c->row_cap, c->out.row_count + 1, sizeof(PuzzleRow))) {
+    c->oom = true;
+    return;
+  }
+  PuzzleRow* row = &c->out.rows[c->out.row_count++];
+  memset(row, 0, sizeof(*row));
+  row->first_key = c->out.key_count;
+  if (cols->id >= 0 && cols->id < n) {
+    row->id_offset = (size_t)(field[cols->id] - c->base);
+    row->id_len = field_len[cols->id];
+  }
+  if (cols->rating >= 0 && cols->rating < n) row->rating = parse_rating(field[cols->rating], field_len[cols->rating]);
+
+  Board b;
+  char fen[FEN_MAX];
+  if (cols->fen >= n || cols->moves >= n || field_len[cols->fen] == 0 || field_len[cols->fen] >= FEN_MAX) {
+    row->status = MOVE_ERR_SYNTAX;
+    return;
+  }
+  memcpy(fen, field[cols->fen], field_len[cols->fen]);
+  fen[field_len[cols->fen]] = '\0';
+  board_reset(&b);
+  board_load_fen(&b, fen);
+
+  ReplayOptions opts;
+  opts.flags = c->flags;
+  opts.on_ply = collect_key;
+  opts.ctx = c;
+  opts.norm = NULL;
+  ReplayResult r = replay_movetext(&b, field[cols->moves], field_len[cols->moves], &opts);
+  row->plies = r.plies;
+  row->status = r.status;
+
+  if (!grow((void**)&c->out.fens, &c->fens_cap, c->out.fens_len + FEN_MAX, 1)) {
+    c->oom = true;
+    return;
+  }
+  row->fen_offset = c->out.fens_len;
+  row->fen_len = (size_t)board_to_fen(&b, c->out.fens + c->out.fens_len, FEN_MAX);
+  c->out.fens_len += row->fen_len;
+}
+
+static void replay_chunk(void* arg, int worker) {
+  PuzzleChunk* c = (PuzzleChunk*)arg;
+  const char* p = c->start;
+  (void)worker;
+  while (p < c->end && !c->oom) {
+    const char* nl = (const char*)memchr(p, '\n', (size_t)(c->end - p));
+    const char* line_end = nl ? nl : c->end;
+    const char* e = line_end;
+    if (e > p && e[-1] == '\r') e--;
+    if (e > p) replay_row(c, p, e);
+    p = line_end + 1;
+  }
+}
+
+void puzzle_batch_free(PuzzleBatch* out) {
+  bc_free(out->rows);
+  bc_free(out->keys);
+  bc_free(out->fens);
+  memset(out, 0, sizeof(*out));
+}
+
+/* Append chunk c to out, rebasing its key and FEN offsets. */
+static bool append_chunk(PuzzleBatch* out, const PuzzleChunk* c) {
+  const PuzzleBatch* in = &c->out;
+  size_t rows = out->row_count + in->row_count;
+  size_t keys = out->key_count + in->key_count;
+  size_t fens = out->fens_len + in->fens_len;
+  PuzzleRow* r = (PuzzleRow*)bc_realloc(out->rows, (rows ? rows : 1) * sizeof(PuzzleRow));
+  if (!r) return false;
+  out->rows = r;
+  uint64_t* k = (uint64_t*)bc_realloc(out->keys, (keys ? keys : 1) * sizeof(uint64_t));
+  if (!k) return false;
+  out->keys = k;
+  char* f = (char*)bc_realloc(out->fens, fens ? fens : 1);
+  if (!f) return false;
+  out->fens = f;
+  for (size_t i = 0; i < in->row_count; i++) {
+    PuzzleRow row = in->rows[i];
+    row.first_key += out->key_count;
+    row.fen_offset += out->fens_len;
+    out->rows[out->row_count + i] = row;
+  }
+  if (in->key_count) memcpy(out->keys + out->key_count, in->keys, in->key_count * sizeof(uint64_t));
+  if (in->fens_len) memcpy(out->fens + out->fens_len, in->fens, in->fens_len);
+  out->row_count = rows;
+  out->key_count = keys;
+  out->fens_len = fens;
+  return true;
+}
+
+bool puzzle_replay_csv(const char* buf, size_t len, int flags, int threads, PuzzleBatch* out) {
+  PuzzleColumns cols = { 0, 1, 2, 3 };
+  const char* p = buf;
+  const char* end = buf + len;
+  memset(out, 0, sizeof(*out));
+  board_init_tables();
+
+  const char* nl = (const char*)memchr(p, '\n', len);
+  if (parse_header(p, nl ? nl : end, &cols)) p = nl ? nl + 1 : end;
+
+  if (threads <= 0) threads = bc_cpu_count();
+  size_t body = (size_t)(end - p);
+  size_t nchunks = (size_t)threads * CHUNKS_PER_THREAD;
+  if (nchunks > body / MIN_CHUNK_BYTES + 1) nchunks = body / MIN_CHUNK_BYTES + 1;
+  if (threads == 1) nchunks = 1;
+
+  PuzzleChunk* chunks = (PuzzleChunk*)bc_calloc(nchunks, sizeof(PuzzleChunk));
+  if (!chunks) return false;
+  size_t count = 0;
+  while (p < end && count < nchunks) {
+    const char* stop = count + 1 == nchunks ? end : p + body / nchunks;
+    if (stop < end) {
+      const char* brk = (const char*)memchr(stop, '\n', (size_t)(end - stop));
+      stop = brk ? brk + 1 : end;
+    }
+    PuzzleChunk* c = &chunks[count++];
+    c->base = buf;
+    c->start = p;
+    c->end = stop;
+    c->cols = &cols;
+    c->flags = flags;
+    p = stop;
+  }
+
+  Pool* pool = (threads != 1 && count > 1) ? pool_create(threads) : NULL;
+  for (size_t i = 0; i < count; i++) {
+    if (pool && pool_submit(pool, -1, replay_chunk, &chunks[i])) continue;
+    replay_chunk(&chunks[i], -1);
+  }
+  if (pool) {
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < count; i++) {
+    if (ok && (chunks[i].oom || !append_chunk(out, &chunks[i]))) ok = false;
+    puzzle_batch_free(&chunks[i].out);
+  }
+  bc_free(chunks);
+  if (!ok) puzzle_batch_free(out);
+  return ok;
+}
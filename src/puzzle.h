@@ -0,0 +1,40 @@
+#ifndef PUZZLE_H
+#define PUZZLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Batch replay of Lichess-style puzzle CSVs: every row's FEN is loaded, its
+ * space-separated UCI line applied, and the per-ply keys and final FEN kept.
+ * Columns come from a header row (PuzzleId, FEN, Moves, Rating) when there is
+ * one, otherwise the Lichess order (id, FEN, moves, rating, ...) is assumed. */
+
+typedef struct {
+  size_t first_key;    /* index of the row's first key in PuzzleBatch.keys */
+  int plies;
+  int status;          /* MOVE_OK or the MOVE_ERR_* of the first rejected move */
+  int rating;          /* 0 when missing */
+  size_t id_offset;    /* PuzzleId, as a byte range of the input */
+  size_t id_len;
+  size_t fen_offset;   /* final FEN in PuzzleBatch.fens */
+  size_t fen_len;
+} PuzzleRow;
+
+typedef struct {
+  PuzzleRow* rows;
+  size_t row_count;
+  uint64_t* keys;
+  size_t key_count;
+  char* fens;
+  size_t fens_len;
+} PuzzleBatch;
+
+void puzzle_batch_free(PuzzleBatch* out);
+
+/* Replay every data row of a CSV buffer, splitting the rows across threads
+ * (<= 0: one per CPU). flags are REPLAY_* flags. Rows keep input order.
+ * Returns false on allocation failure. */
+bool puzzle_replay_csv(const char* buf, size_t len, int flags, int threads, PuzzleBatch* out);
+
+#endif
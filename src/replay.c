@@ -0,0 +1,383 @@
+/* Batch replay of SAN/UCI movetext and PGN buffers, optionally validating. */
+
+#include "replay.h"
+#include "alloc.h"
+#include "minhash.h"
+#include "motif.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FEN_MAX 128
+
+static bool looks_like_uci(const char* t, int n) {
+  if (n == 4 && memcmp(t, "0000", 4) == 0) return true;
+  return (n == 4 || n == 5) &&
+         t[0] >= 'a' && t[0] <= 'h' && t[1] >= '1' && t[1] <= '8' &&
+         t[2] >= 'a' && t[2] <= 'h' && t[3] >= '1' && t[3] <= '8';
+}
+
+void san_norm_stats_add(SanNormStats* stats, int normalized) {
+  for (int i = 0; i < SAN_NORM_KINDS; i++) {
+    if (normalized & (1 << i)) stats->counts[i]++;
+  }
+}
+
+int replay_resolve_token(const Board* b, const char* tok, int len, int flags, Move* out, int* normalized) {
+  if (normalized) *normalized = 0;
+  if (looks_like_uci(tok, len)) {
+    if (!board_parse_uci(b, tok, len, out)) return MOVE_ERR_SYNTAX;
+    return (flags & REPLAY_VALIDATE) ? board_check_move(b, out) : MOVE_OK;
+  }
+  ParseSANResult p;
+  if (!board_parse_san(tok, len, &p)) return MOVE_ERR_SYNTAX;
+  if (normalized) *normalized = p.normalized;
+  return board_resolve_parsed_san(b, &p, (flags & REPLAY_VALIDATE) != 0, out);
+}
+
+ReplayResult replay_movetext(Board* b, const char* text, size_t len, const ReplayOptions* opts) {
+  ReplayResult r;
+  PgnTokenizer t;
+  const char* tok;
+  int tok_len;
+  int flags = opts ? opts->flags : 0;
+  SanNormStats* norm = opts ? opts->norm : NULL;
+  r.status = MOVE_OK;
+  r.plies = 0;
+  pgn_tokens_init(&t, text, len);
+  while (pgn_next_move(&t, &tok, &tok_len)) {
+    Move move;
+    int normalized;
+    /* "exd6 e.p." splits the suffix into a token of its own */
+    if (tok_len == 4 && memcmp(tok, "e.p.", 4) == 0) {
+      if (norm) san_norm_stats_add(norm, SAN_NORM_EP_SUFFIX);
+      continue;
+    }
+    int status = replay_resolve_token(b, tok, tok_len, flags, &move, &normalized);
+    if (status != MOVE_OK) {
+      r.status = status;
+      return r;
+    }
+    if (norm && normalized) san_norm_stats_add(norm, normalized);
+    board_make_move(b, &move);
+    r.plies++;
+    if (opts && opts->on_ply) opts->on_ply(opts->ctx, b, &move, board_get_zobrist_key(b));
+  }
+  return r;
+}
+
+/* TCN alphabet: a-z, A-Z, 0-9 then these. Index 0-63 is a square (a1 = 0);
+ * in the second character, 64 and up encodes a promotion as 3 * piece + direction. */
+static const char TCN_SYMBOLS[] = "!?{~}(^)[_]@#$,./&-*++=";
+
+static int tcn_index(unsigned char c) {
+  if (c >= 'a' && c <= 'z') return c - 'a';
+  if (c >= 'A' && c <= 'Z') return c - 'A' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  const char* p = c ? strchr(TCN_SYMBOLS, c) : NULL;
+  return p ? 62 + (int)(p - TCN_SYMBOLS) : -1;
+}
+
+static uint64_t side_occupancy(const Board* b, int side) {
+  return b->pawns[side] | b->knights[side] | b->bishops[side] |
+         b->rooks[side] | b->queens[side] | b->kings[side];
+}
+
+static int tcn_decode(const Board* b, unsigned char c0, unsigned char c1, Move* out) {
+  int from = tcn_index(c0);
+  int to = tcn_index(c1);
+  int promotion = 0;
+  if (from < 0 || to < 0 || from > 63) return MOVE_ERR_SYNTAX; /* drops are > 75 */
+  if (to > 63) {
+    int piece = (to - 64) / 3;
+    if (piece > 3) return MOVE_ERR_SYNTAX;
+    promotion = "qnrb"[piece];
+    to = from + (from < 16 ? -8 : 8) + (to - 1) % 3 - 1;
+    if (to < 0 || to > 63) return MOVE_ERR_SYNTAX;
+  }
+  board_move_from_squares(b, from, to, promotion, out);
+  return MOVE_OK;
+}
+
+ReplayResult replay_tcn(Board* b, const char* tcn, size_t len, const ReplayOptions* opts) {
+  ReplayResult r;
+  const unsigned char* p = (const unsigned char*)tcn;
+  int flags = opts ? opts->flags : 0;
+  r.status = MOVE_OK;
+  r.plies = 0;
+  if (len % 2) {
+    r.status = MOVE_ERR_SYNTAX;
+    return r;
+  }
+  for (size_t i = 0; i < len; i += 2) {
+    Move move;
+    int status = tcn_decode(b, p[i], p[i + 1], &move);
+    if (status == MOVE_OK) {
+      if (flags & REPLAY_VALIDATE) {
+        status = board_check_move(b, &move);
+      } else if (!(side_occupancy(b, b->sideToMove) & (1ULL << move.from))) {
+        status = MOVE_ERR_NO_PIECE;
+      }
+    }
+    if (status != MOVE_OK) {
+      r.status = status;
+      return r;
+    }
+    board_make_move(b, &move);
+    r.plies++;
+    if (opts && opts->on_ply) opts->on_ply(opts->ctx, b, &move, board_get_zobrist_key(b));
+  }
+  return r;
+}
+
+void replay_batch_init(ReplayBatch* out) {
+  memset(out, 0, sizeof(*out));
+}
+
+void replay_batch_free(ReplayBatch* out) {
+  bc_free(out->keys);
+  bc_free(out->evals);
+  bc_free(out->motifs);
+  bc_free(out->sets);
+  bc_free(out->packed);
+  bc_free(out->minhash);
+  bc_free(out->games);
+  memset(out, 0, sizeof(*out));
+}
+
+typedef struct {
+  ReplayBatch* out;
+  bool evals;
+  bool motifs;
+  bool sets;
+  bool packed;
+  bool oom;
+} BatchCtx;
+
+static void collect_key(void* ctx, const Board* b, const Move* move, uint64_t key) {
+  BatchCtx* c = (BatchCtx*)ctx;
+  ReplayBatch* out = c->out;
+  (void)move;
+  if (out->key_count == out->key_cap) {
+    size_t cap = out->key_cap ? out->key_cap * 2 : 4096;
+    uint64_t* keys = (uint64_t*)bc_realloc(out->keys, cap * sizeof(uint64_t));
+    if (!keys) {
+      c->oom = true;
+      return;
+    }
+    out->keys = keys;
+    if (c->evals) {
+      int16_t* evals = (int16_t*)bc_realloc(out->evals, cap * sizeof(int16_t));
+      if (!evals) {
+        c->oom = true;
+        return;
+      }
+      out->evals = evals;
+    }
+    if (c->motifs) {
+      uint8_t* motifs = (uint8_t*)bc_realloc(out->motifs, cap);
+      if (!motifs) {
+        c->oom = true;
+        return;
+      }
+      out->motifs = motifs;
+    }
+    if (c->sets) {
+      u64* sets = (u64*)bc_realloc(out->sets, cap * 12 * sizeof(u64));
+      if (!sets) {
+        c->oom = true;
+        return;
+      }
+      out->sets = sets;
+    }
+    if (c->packed) {
+      uint8_t* packed = (uint8_t*)bc_realloc(out->packed, cap * BOARD_PACKED_SIZE);
+      if (!packed) {
+        c->oom = true;
+        return;
+      }
+      out->packed = packed;
+    }
+    out->key_cap = cap;
+  }
+  if (out->store) {
+    size_t ply = out->key_count - out->games[out->game_count - 1].first_key + 1;
+    if (!store_writer_add(out->store, b, (uint32_t)ply)) {
+      c->oom = true;
+      return;
+    }
+  }
+  if (out->dict && !posdict_writer_add(out->dict, key, b)) {
+    c->oom = true;
+    return;
+  }
+  if (out->audit && !audit_add(out->audit, key, b)) {
+    c->oom = true;
+    return;
+  }
+  if (c->evals) {
+    int eval = board_eval(b);
+    out->evals[out->key_count] = (int16_t)(eval > INT16_MAX ? INT16_MAX : eval < INT16_MIN ? INT16_MIN : eval);
+  }
+  if (c->motifs) out->motifs[out->key_count] = (uint8_t)motif_tag(b);
+  if (c->sets) board_piece_sets(b, out->sets + out->key_count * 12);
+  if (c->packed) board_pack(b, out->packed + out->key_count * BOARD_PACKED_SIZE);
+  out->keys[out->key_count++] = key;
+}
+
+bool replay_game_start(Board* b, const PgnGame* game) {
+  const char* fen;
+  size_t fen_len;
+  board_reset(b);
+  if (!pgn_get_tag(game, "FEN", &fen, &fen_len) || fen_len == 0) return true;
+  /* A FEN too long to be one is malformed, not a reason to start from the initial position. */
+  if (fen_len >= FEN_MAX) return false;
+  char buf[FEN_MAX];
+  memcpy(buf, fen, fen_len);
+  buf[fen_len] = '\0';
+  board_load_fen(b, buf);
+  return true;
+}
+
+int replay_classify_end(const Board* b, const uint64_t* keys, size_t count, uint64_t start_key) {
+  int end = board_game_end(b);
+  if (end != GAME_END_UNFINISHED || count == 0) return end;
+  /* Positions since the last pawn move or capture, same side to move. */
+  size_t window = (size_t)(b->halfmove > 0 ? b->halfmove : 0);
+  if (window > count) window = count;
+  uint64_t final_key = keys[count - 1];
+  int seen = 1;
+  for (size_t back = 2; back <= window; back += 2) {
+    uint64_t k = back == count ? start_key : keys[count - 1 - back];
+    if (k == final_key && ++seen >= 3) return GAME_END_THREEFOLD;
+  }
+  if (b->halfmove >= 100) return GAME_END_FIFTY_MOVE;
+  return GAME_END_UNFINISHED;
+}
+
+static bool contains_ci(const char* s, size_t len, const char* needle) {
+  size_t n = strlen(needle);
+  for (size_t i = 0; i + n <= len; i++) {
+    size_t j = 0;
+    while (j < n && tolower((unsigned char)s[i + j]) == needle[j]) j++;
+    if (j == n) return true;
+  }
+  return false;
+}
+
+/* Reason named by a [Termination] tag (lichess/chess.com wording), or -1 for none. */
+static int termination_reason(const char* t, size_t len) {
+  if (contains_ci(t, len, "stalemate")) return GAME_END_STALEMATE;
+  if (contains_ci(t, len, "checkmate")) return GAME_END_CHECKMATE;
+  if (contains_ci(t, len, "insufficient")) return GAME_END_INSUFFICIENT_MATERIAL;
+  if (contains_ci(t, len, "repetition")) return GAME_END_THREEFOLD;
+  if (contains_ci(t, len, "50-move") || contains_ci(t, len, "50 move") || contains_ci(t, len, "fifty")) return GAME_END_FIFTY_MOVE;
+  return -1;
+}
+
+int replay_check_result(const PgnGame* game, const Board* b, int end) {
+  const char* v;
+  size_t n;
+  int flags = 0;
+  const char* expected = NULL;
+  if (end == GAME_END_CHECKMATE) expected = b->sideToMove == BLACK ? "1-0" : "0-1";
+  else if (end == GAME_END_STALEMATE || end == GAME_END_INSUFFICIENT_MATERIAL) expected = "1/2-1/2";
+  if (expected) {
+    if (!pgn_get_tag(game, "Result", &v, &n) || n != strlen(expected) || memcmp(v, expected, n) != 0)
+      flags |= RESULT_MISMATCH;
+  }
+  if (pgn_get_tag(game, "Termination", &v, &n)) {
+    int reason = termination_reason(v, n);
+    if (reason >= 0 && reason != end) flags |= TERMINATION_MISMATCH;
+  }
+  return flags;
+}
+
+/* Room for games signatures, new slots MINHASH_EMPTY. */
+static bool reserve_minhash(ReplayBatch* out, size_t games) {
+  if (games <= out->minhash_cap) return true;
+  uint32_t* sigs = (uint32_t*)bc_realloc(out->minhash, games * MINHASH_SIZE * sizeof(uint32_t));
+  if (!sigs) return false;
+  memset(sigs + out->minhash_cap * MINHASH_SIZE, 0xff, (games - out->minhash_cap) * MINHASH_SIZE * sizeof(uint32_t));
+  out->minhash = sigs;
+  out->minhash_cap = games;
+  return true;
+}
+
+ReplayGameInfo* replay_batch_new_game(ReplayBatch* out) {
+  if (out->game_count == out->game_cap) {
+    size_t cap = out->game_cap ? out->game_cap * 2 : 256;
+    ReplayGameInfo* games = (ReplayGameInfo*)bc_realloc(out->games, cap * sizeof(ReplayGameInfo));
+    if (!games) return NULL;
+    out->games = games;
+    out->game_cap = cap;
+  }
+  if (out->minhash) {
+    if (!reserve_minhash(out, out->game_cap)) return NULL;
+    memset(out->minhash + out->game_count * MINHASH_SIZE, 0xff, MINHASH_SIZE * sizeof(uint32_t));
+  }
+  if (out->store) store_writer_begin_game(out->store);
+  ReplayGameInfo* info = &out->games[out->game_count++];
+  info->first_key = out->key_count;
+  info->plies = 0;
+  info->status = MOVE_OK;
+  info->end = GAME_END_UNFINISHED;
+  info->mismatch = 0;
+  info->wdl = TB_UNKNOWN;
+  return info;
+}
+
+ReplayGameInfo* replay_batch_game(ReplayBatch* out, Board* b, const char* moves, size_t len, int flags) {
+  BatchCtx ctx;
+  ReplayOptions opts;
+  ctx.out = out;
+  ctx.evals = (flags & REPLAY_EVALS) != 0;
+  ctx.motifs = (flags & REPLAY_MOTIFS) != 0;
+  ctx.sets = (flags & REPLAY_SETS) != 0;
+  ctx.packed = (flags & REPLAY_PACKED) != 0;
+  ctx.oom = false;
+  opts.flags = flags;
+  opts.on_ply = collect_key;
+  opts.ctx = &ctx;
+  opts.norm = &out->norm;
+  if ((flags & REPLAY_MINHASH) && !reserve_minhash(out, out->game_cap ? out->game_cap : 256)) return NULL;
+  ReplayGameInfo* info = replay_batch_new_game(out);
+  if (!info) return NULL;
+  uint64_t start_key = board_get_zobrist_key(b);
+  ReplayResult r = replay_movetext(b, moves, len, &opts);
+  if (ctx.oom) return NULL;
+  info->plies = r.plies;
+  info->status = r.status;
+  if (flags & REPLAY_MINHASH) {
+    minhash_sign(out->keys + info->first_key, (size_t)r.plies, out->minhash + (out->game_count - 1) * MINHASH_SIZE);
+  }
+  if (r.status == MOVE_OK) {
+    info->end = replay_classify_end(b, out->keys + info->first_key, (size_t)r.plies, start_key);
+    if (out->tablebase) info->wdl = tb_probe_wdl(out->tablebase, b);
+  }
+  return info;
+}
+
+bool replay_pgn(const char* buf, size_t len, int flags, ReplayBatch* out) {
+  Board b;
+  PgnGame game;
+  size_t pos = 0, counted = 0;
+  board_init_tables();
+  job_set_total(out->job, len);
+  while (!job_cancelled(out->job) && pgn_next_game(buf, len, &pos, &game)) {
+    ReplayGameInfo* info;
+    if (replay_game_start(&b, &game)) {
+      info = replay_batch_game(out, &b, game.moves, game.moves_len, flags);
+      if (!info) return false;
+      if (info->status == MOVE_OK) info->mismatch = replay_check_result(&game, &b, info->end);
+    } else {
+      info = replay_batch_new_game(out);
+      if (!info) return false;
+      info->status = MOVE_ERR_SYNTAX;
+    }
+    job_advance(out->job, pos - counted);
+    counted = pos;
+  }
+  if (!job_cancelled(out->job)) job_advance(out->job, len - counted);
+  return true;
+}
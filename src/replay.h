@@ -0,0 +1,121 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "audit.h"
+#include "bitboard_chess.h"
+#include "job.h"
+#include "pgn.h"
+#include "posdict.h"
+#include "store.h"
+#include "tablebase.h"
+
+/* Replay flags */
+#define REPLAY_VALIDATE 1 /* check every move against the legal move rules */
+#define REPLAY_EVALS 2    /* batch replay: record board_eval after every ply */
+#define REPLAY_MOTIFS 4   /* batch replay: record motif_tag after every ply */
+#define REPLAY_SETS 8     /* batch replay: record the twelve piece bitboards after every ply */
+#define REPLAY_MINHASH 16 /* batch replay: record a MinHash signature of every game's keys */
+#define REPLAY_PACKED 32  /* batch replay: record board_pack after every ply */
+
+/* Called after each applied move with the new position and its Zobrist key. */
+typedef void (*ReplayPlyFn)(void* ctx, const Board* b, const Move* move, uint64_t key);
+
+/* Moves accepted only through lenient SAN, counted per SAN_NORM_* bit. */
+typedef struct {
+  uint64_t counts[SAN_NORM_KINDS]; /* index = bit position of SAN_NORM_* */
+} SanNormStats;
+
+void san_norm_stats_add(SanNormStats* stats, int normalized);
+
+typedef struct {
+  int flags;
+  ReplayPlyFn on_ply;
+  void* ctx;
+  SanNormStats* norm; /* optional */
+} ReplayOptions;
+
+typedef struct {
+  int status; /* MOVE_OK or the MOVE_ERR_* of the first rejected move */
+  int plies;  /* moves applied; on error, the index of the rejected move */
+} ReplayResult;
+
+/* Apply a movetext of SAN and/or UCI tokens (PGN move numbers, comments,
+ * variations and results are skipped) to b, stopping at the first error. */
+ReplayResult replay_movetext(Board* b, const char* text, size_t len, const ReplayOptions* opts);
+
+/* Apply a chess.com TCN move string (two characters per ply) to b, stopping
+ * at the first error. Castling (king two files or onto its rook) and en
+ * passant are inferred from the position; piece drops are MOVE_ERR_SYNTAX. */
+ReplayResult replay_tcn(Board* b, const char* tcn, size_t len, const ReplayOptions* opts);
+
+/* Resolve one SAN/UCI token ("0000" and "--" are null moves) against b.
+ * Returns MOVE_OK or MOVE_ERR_*; *normalized (optional) gets SAN_NORM_* bits. */
+int replay_resolve_token(const Board* b, const char* tok, int len, int flags, Move* out, int* normalized);
+
+/* Reset b to the game's start: the standard position or its [FEN] tag.
+ * Returns false, leaving the standard position, when the tag is longer than
+ * any FEN; callers treat the game as MOVE_ERR_SYNTAX. */
+bool replay_game_start(Board* b, const PgnGame* game);
+
+/* Classify the final position b of a game: board_game_end, then threefold
+ * repetition (keys[0..count) are the keys after each ply, start_key the key
+ * before the first) and the fifty-move rule. Returns GAME_END_*. */
+int replay_classify_end(const Board* b, const uint64_t* keys, size_t count, uint64_t start_key);
+
+/* Result-check flags */
+#define RESULT_MISMATCH 1      /* [Result] contradicts a decided final position */
+#define TERMINATION_MISMATCH 2 /* [Termination] names a reason the position does not show */
+
+/* Compare the classification of the final position with the game's tags. */
+int replay_check_result(const PgnGame* game, const Board* b, int end);
+
+typedef struct {
+  size_t first_key; /* index of the game's first key in ReplayBatch.keys */
+  int plies;
+  int status;
+  int end;      /* GAME_END_*, UNFINISHED when replay stopped early */
+  int mismatch; /* RESULT_MISMATCH | TERMINATION_MISMATCH */
+  int wdl;      /* TB_* of the final position; TB_UNKNOWN without a tablebase */
+} ReplayGameInfo;
+
+typedef struct {
+  uint64_t* keys; /* key after every applied ply, all games concatenated */
+  size_t key_count;
+  size_t key_cap;
+  int16_t* evals; /* with REPLAY_EVALS (on every game of the batch): board_eval after every ply, parallel to keys */
+  uint8_t* motifs; /* with REPLAY_MOTIFS (likewise): MOTIF_* bits after every ply, parallel to keys */
+  u64* sets;       /* with REPLAY_SETS (likewise): board_piece_sets after every ply, 12 per key */
+  uint8_t* packed; /* with REPLAY_PACKED (likewise): BOARD_PACKED_SIZE bytes per key, zero where board_pack failed */
+  uint32_t* minhash; /* with REPLAY_MINHASH (likewise): MINHASH_SIZE per game, parallel to games */
+  size_t minhash_cap; /* games minhash has room for */
+  ReplayGameInfo* games;
+  size_t game_count;
+  size_t game_cap;
+  SanNormStats norm;
+  Tablebase* tablebase; /* optional, set by the caller: probed for each game's final position */
+  StoreWriter* store;   /* optional, set by the caller: gets a game per game and every position after a ply */
+  PosDictWriter* dict;  /* optional, set by the caller: gets every position after a ply under its key */
+  CollisionAudit* audit; /* optional, set by the caller: gets every position after a ply under its key */
+  Job* job;             /* optional, set by the caller: replay_pgn and the NDJSON reader count input bytes
+                         * into it and stop between games once it is cancelled */
+} ReplayBatch;
+
+void replay_batch_init(ReplayBatch* out);
+void replay_batch_free(ReplayBatch* out);
+
+/* Append an empty game (MOVE_OK, no plies) to out; NULL on allocation failure. */
+ReplayGameInfo* replay_batch_new_game(ReplayBatch* out);
+
+/* Replay one movetext from b's position as a new game of out, collecting its
+ * keys and classifying its end. Returns the game, or NULL on allocation failure. */
+ReplayGameInfo* replay_batch_game(ReplayBatch* out, Board* b, const char* moves, size_t len, int flags);
+
+/* Replay every game of a PGN buffer (honouring [FEN] tags) into out. A
+ * cancelled out->job leaves out with the games replayed so far.
+ * Returns false on allocation failure. */
+bool replay_pgn(const char* buf, size_t len, int flags, ReplayBatch* out);
+
+#endif
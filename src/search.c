@@ -0,0 +1,422 @@
+/* Lazy SMP alpha-beta search. Each thread runs its own iterative deepening
+ * from the root (odd helpers one iteration ahead) with copy-make Boards, whose
+ * tapered material + piece-square score make_move keeps up to date; the
+ * threads share only the lockless transposition table and the stop flag. The
+ * deepest completed iteration (thread 0 on ties) gives the result. */
+
+#include "search.h"
+#include "alloc.h"
+#include "bitops.h"
+#include "pool.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_DEFAULT_HASH_MB 16
+#define SEARCH_CHECK_NODES 1024 /* nodes between limit checks (power of two) */
+#define SEARCH_INF (SEARCH_MATE + 1)
+#define HISTORY_MAX (1 << 20)
+
+#define BOUND_UPPER 1
+#define BOUND_LOWER 2
+#define BOUND_EXACT 3
+
+/* Piece kinds of move ordering */
+#define PAWN 0
+#define KNIGHT 1
+#define BISHOP 2
+#define ROOK 3
+#define QUEEN 4
+#define KING 5
+
+/* MVV-LVA victim values; the evaluation itself is kept in Board. */
+static const int PIECE_VALUE[6] = { 100, 320, 330, 500, 900, 0 };
+
+/* Lockless entry (XOR trick), as in the perft hash. */
+typedef struct {
+  uint64_t check; /* key ^ data */
+  uint64_t data;  /* move (16) | score (16) << 16 | depth (8) << 32 | bound (2) << 40 */
+} TTEntry;
+
+typedef struct {
+  TTEntry* tt;
+  uint64_t tt_mask;
+  Board root;
+  int max_depth;
+  uint64_t node_limit;
+  double deadline; /* bc_now_ms() value; 0 = none */
+  uint64_t nodes;  /* advanced by SEARCH_CHECK_NODES at a time, for the limits */
+  int stop;
+} SearchShared;
+
+typedef struct {
+  SearchShared* sh;
+  int id;
+  uint64_t nodes;
+  int depth; /* completed iterations */
+  int score;
+  Move best_pv[SEARCH_MAX_DEPTH];
+  int best_pv_len;
+  uint64_t keys[SEARCH_MAX_PLY];
+  Move killers[SEARCH_MAX_PLY][2];
+  int history[2][64][64];
+  Move pv[SEARCH_MAX_PLY][SEARCH_MAX_PLY];
+  int pv_len[SEARCH_MAX_PLY];
+} SearchThread;
+
+/* ---- evaluation ---- */
+
+static int piece_at(const Board* b, int sq, int color) {
+  u64 bit = (u64)1 << sq;
+  if (b->pawns[color] & bit) return PAWN;
+  if (b->knights[color] & bit) return KNIGHT;
+  if (b->bishops[color] & bit) return BISHOP;
+  if (b->rooks[color] & bit) return ROOK;
+  if (b->queens[color] & bit) return QUEEN;
+  if (b->kings[color] & bit) return KING;
+  return -1;
+}
+
+static int promo_kind(int promotion) {
+  switch (promotion) {
+    case 'n': return KNIGHT;
+    case 'b': return BISHOP;
+    case 'r': return ROOK;
+    default: return QUEEN;
+  }
+}
+
+/* Score for the side to move. */
+static int side_eval(const Board* b) {
+  int eval = board_eval(b);
+  return b->sideToMove == WHITE ? eval : -eval;
+}
+
+int board_evaluate(const Board* b) {
+  Board copy = *b;
+  board_refresh_eval(&copy);
+  return side_eval(&copy);
+}
+
+/* ---- transposition table ---- */
+
+static uint32_t move_pack(const Move* m) {
+  int promo = 0;
+  if (m->promotion) promo = promo_kind(m->promotion);
+  return (uint32_t)(m->from | (m->to << 6) | (promo << 12));
+}
+
+static bool move_matches(const Move* m, uint32_t packed) {
+  return packed && move_pack(m) == packed;
+}
+
+/* Mate scores are stored relative to the node, not the root. */
+static int score_to_tt(int score, int ply) {
+  if (score >= SEARCH_MATE_BOUND) return score + ply;
+  if (score <= -SEARCH_MATE_BOUND) return score - ply;
+  return score;
+}
+
+static int score_from_tt(int score, int ply) {
+  if (score >= SEARCH_MATE_BOUND) return score - ply;
+  if (score <= -SEARCH_MATE_BOUND) return score + ply;
+  return score;
+}
+
+static bool tt_probe(const SearchShared* sh, uint64_t key, uint32_t* move, int* score, int* depth, int* bound) {
+  TTEntry* e = &sh->tt[key & sh->tt_mask];
+  uint64_t data = bc_atomic_load_u64(&e->data);
+  uint64_t check = bc_atomic_load_u64(&e->check);
+  if ((check ^ data) != key) return false;
+  *move = (uint32_t)(data & 0xffff);
+  *score = (int16_t)(uint16_t)((data >> 16) & 0xffff);
+  *depth = (int)((data >> 32) & 0xff);
+  *bound = (int)((data >> 40) & 3);
+  return true;
+}
+
+static void tt_store(SearchShared* sh, uint64_t key, uint32_t move, int score, int depth, int bound) {
+  TTEntry* e = &sh->tt[key & sh->tt_mask];
+  uint64_t old = bc_atomic_load_u64(&e->data);
+  /* Keep a deeper result for the same position, and its move when none is given. */
+  if ((bc_atomic_load_u64(&e->check) ^ old) == key) {
+    if ((int)((old >> 32) & 0xff) > depth && bound != BOUND_EXACT) return;
+    if (!move) move = (uint32_t)(old & 0xffff);
+  }
+  uint64_t data = (uint64_t)move | ((uint64_t)(uint16_t)(int16_t)score << 16) |
+                  ((uint64_t)depth << 32) | ((uint64_t)bound << 40);
+  bc_atomic_store_u64(&e->data, data);
+  bc_atomic_store_u64(&e->check, key ^ data);
+}
+
+/* ---- search ---- */
+
+/* Once a thread has an iteration (helpers: always), it obeys the stop flag. */
+static bool stopped(const SearchThread* t) {
+  return (t->depth > 0 || t->id > 0) && bc_atomic_load_int(&t->sh->stop);
+}
+
+static bool count_node(SearchThread* t) {
+  if ((++t->nodes & (SEARCH_CHECK_NODES - 1)) == 0) {
+    SearchShared* sh = t->sh;
+    uint64_t total = bc_atomic_add_u64(&sh->nodes, SEARCH_CHECK_NODES) + SEARCH_CHECK_NODES;
+    if ((sh->node_limit && total >= sh->node_limit) || (sh->deadline > 0 && bc_now_ms() >= sh->deadline)) {
+      bc_atomic_store_int(&sh->stop, 1);
+    }
+  }
+  return stopped(t);
+}
+
+static bool is_repetition(const SearchThread* t, const Board* b, int ply) {
+  for (int i = ply - 2; i >= 0 && ply - i <= b->halfmove; i -= 2) {
+    if (t->keys[i] == t->keys[ply]) return true;
+  }
+  return false;
+}
+
+static bool is_capture(const Board* b, const Move* m) {
+  return m->enpassant || piece_at(b, m->to, b->sideToMove ^ 1) >= 0;
+}
+
+/* TT move, then captures by MVV-LVA, queen promotions, killers and history. */
+static void score_moves(const SearchThread* t, const Board* b, const Move* moves, int n, uint32_t tt_move, int ply,
+                        int* scores) {
+  int side = b->sideToMove;
+  for (int i = 0; i < n; i++) {
+    const Move* m = &moves[i];
+    int victim = m->enpassant ? PAWN : piece_at(b, m->to, side ^ 1);
+    if (move_matches(m, tt_move)) {
+      scores[i] = 1 << 30;
+    } else if (victim >= 0) {
+      scores[i] = (1 << 28) + PIECE_VALUE[victim] * 8 - piece_at(b, m->from, side);
+    } else if (m->promotion == 'q') {
+      scores[i] = 1 << 27;
+    } else if (m->from == t->killers[ply][0].from && m->to == t->killers[ply][0].to) {
+      scores[i] = 1 << 26;
+    } else if (m->from == t->killers[ply][1].from && m->to == t->killers[ply][1].to) {
+      scores[i] = (1 << 26) - 1;
+    } else {
+      scores[i] = t->history[side][m->from][m->to];
+    }
+  }
+}
+
+/* Selection sort step: bring the best remaining move to index i. */
+static void pick_move(Move* moves, int* scores, int i, int n) {
+  int best = i;
+  for (int j = i + 1; j < n; j++) {
+    if (scores[j] > scores[best]) best = j;
+  }
+  if (best != i) {
+    Move m = moves[i];
+    int s = scores[i];
+    moves[i] = moves[best];
+    scores[i] = scores[best];
+    moves[best] = m;
+    scores[best] = s;
+  }
+}
+
+static int quiesce(SearchThread* t, const Board* b, int ply, int alpha, int beta) {
+  t->pv_len[ply] = 0;
+  if (count_node(t)) return 0;
+  bool in_check = board_in_check(b);
+  int stand = side_eval(b);
+  if (!in_check) {
+    if (stand >= beta) return stand;
+    if (stand > alpha) alpha = stand;
+  }
+  if (ply >= SEARCH_MAX_PLY - 1) return stand;
+
+  Move moves[BOARD_MAX_MOVES];
+  int scores[BOARD_MAX_MOVES];
+  int n = board_generate_moves(b, moves);
+  if (n == 0) return in_check ? -SEARCH_MATE + ply : 0;
+  int best = in_check ? -SEARCH_INF : stand;
+  score_moves(t, b, moves, n, 0, ply, scores);
+  for (int i = 0; i < n; i++) {
+    pick_move(moves, scores, i, n);
+    const Move* m = &moves[i];
+    /* Out of check every evasion is searched; otherwise captures and promotions. */
+    if (!in_check && !m->promotion && !is_capture(b, m)) continue;
+    Board child = *b;
+    board_make_move(&child, m);
+    int score = -quiesce(t, &child, ply + 1, -beta, -alpha);
+    if (stopped(t)) return 0;
+    if (score > best) {
+      best = score;
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta) break;
+      }
+    }
+  }
+  return best;
+}
+
+static int negamax(SearchThread* t, const Board* b, int depth, int ply, int alpha, int beta) {
+  SearchShared* sh = t->sh;
+  bool pv_node = beta - alpha > 1;
+  t->pv_len[ply] = 0;
+  t->keys[ply] = board_get_zobrist_key(b);
+  if (ply > 0) {
+    if (b->halfmove >= 100 || is_repetition(t, b, ply)) return 0;
+    if (alpha < -SEARCH_MATE + ply) alpha = -SEARCH_MATE + ply;
+    if (beta > SEARCH_MATE - ply - 1) beta = SEARCH_MATE - ply - 1;
+    if (alpha >= beta) return alpha;
+  }
+  bool in_check = board_in_check(b);
+  if (in_check) depth++;
+  if (depth <= 0 || ply >= SEARCH_MAX_PLY - 1) return quiesce(t, b, ply, alpha, beta);
+  if (count_node(t)) return 0;
+
+  uint32_t tt_move = 0;
+  int tt_score, tt_depth, tt_bound;
+  if (tt_probe(sh, t->keys[ply], &tt_move, &tt_score, &tt_depth, &tt_bound) && !pv_node && tt_depth >= depth) {
+    tt_score = score_from_tt(tt_score, ply);
+    if (tt_bound == BOUND_EXACT || (tt_bound == BOUND_LOWER && tt_score >= beta) ||
+        (tt_bound == BOUND_UPPER && tt_score <= alpha)) {
+      return tt_score;
+    }
+  }
+
+  Move moves[BOARD_MAX_MOVES];
+  int scores[BOARD_MAX_MOVES];
+  int n = board_generate_moves(b, moves);
+  if (n == 0) return in_check ? -SEARCH_MATE + ply : 0;
+  score_moves(t, b, moves, n, tt_move, ply, scores);
+
+  int orig_alpha = alpha;
+  int best = -SEARCH_INF;
+  uint32_t best_move = 0;
+  for (int i = 0; i < n; i++) {
+    pick_move(moves, scores, i, n);
+    const Move* m = &moves[i];
+    Board child = *b;
+    board_make_move(&child, m);
+    int score;
+    if (i == 0) {
+      score = -negamax(t, &child, depth - 1, ply + 1, -beta, -alpha);
+    } else {
+      score = -negamax(t, &child, depth - 1, ply + 1, -alpha - 1, -alpha);
+      if (score > alpha && score < beta && !stopped(t)) {
+        score = -negamax(t, &child, depth - 1, ply + 1, -beta, -alpha);
+      }
+    }
+    if (stopped(t)) return 0;
+    if (score <= best) continue;
+    best = score;
+    best_move = move_pack(m);
+    if (score <= alpha) continue;
+    alpha = score;
+    t->pv[ply][0] = *m;
+    memcpy(&t->pv[ply][1], t->pv[ply + 1], (size_t)t->pv_len[ply + 1] * sizeof(Move));
+    t->pv_len[ply] = t->pv_len[ply + 1] + 1;
+    if (alpha >= beta) {
+      if (!is_capture(b, m) && !m->promotion) {
+        int* h = &t->history[b->sideToMove][m->from][m->to];
+        if (t->killers[ply][0].from != m->from || t->killers[ply][0].to != m->to) {
+          t->killers[ply][1] = t->killers[ply][0];
+          t->killers[ply][0] = *m;
+        }
+        *h += depth * depth;
+        if (*h > HISTORY_MAX) {
+          for (int c = 0; c < 2; c++)
+            for (int f = 0; f < 64; f++)
+              for (int s = 0; s < 64; s++) t->history[c][f][s] /= 2;
+        }
+      }
+      break;
+    }
+  }
+  int bound = best >= beta ? BOUND_LOWER : best > orig_alpha ? BOUND_EXACT : BOUND_UPPER;
+  tt_store(sh, t->keys[ply], best_move, score_to_tt(best, ply), depth, bound);
+  return best;
+}
+
+static void search_thread(void* arg, int worker) {
+  SearchThread* t = (SearchThread*)arg;
+  SearchShared* sh = t->sh;
+  (void)worker;
+  for (int d = 1 + (t->id & 1); d <= sh->max_depth; d++) {
+    int score = negamax(t, &sh->root, d, 0, -SEARCH_INF, SEARCH_INF);
+    if (stopped(t)) break;
+    t->depth = d;
+    t->score = score;
+    t->best_pv_len = t->pv_len[0] < SEARCH_MAX_DEPTH ? t->pv_len[0] : SEARCH_MAX_DEPTH;
+    memcpy(t->best_pv, t->pv[0], (size_t)t->best_pv_len * sizeof(Move));
+    /* A mate inside the horizon will not change with more depth. */
+    if ((score >= SEARCH_MATE_BOUND || score <= -SEARCH_MATE_BOUND) && SEARCH_MATE - abs(score) <= d) break;
+    if (t->pv_len[0] == 0) break; /* no legal move */
+  }
+  if (t->id == 0) bc_atomic_store_int(&sh->stop, 1);
+}
+
+bool board_search(const Board* b, const SearchOptions* opts, SearchResult* out) {
+  SearchShared sh;
+  double start = bc_now_ms();
+  int threads = opts ? (opts->threads > 0 ? opts->threads : bc_cpu_count()) : 1;
+  size_t hash_mb = opts && opts->hash_mb > 0 ? opts->hash_mb : SEARCH_DEFAULT_HASH_MB;
+
+  board_init_tables();
+  memset(out, 0, sizeof(*out));
+  memset(&sh, 0, sizeof(sh));
+  sh.root = *b;
+  board_refresh_eval(&sh.root);
+  sh.max_depth = opts && opts->depth > 0 ? opts->depth : SEARCH_MAX_DEPTH;
+  if (sh.max_depth > SEARCH_MAX_DEPTH) sh.max_depth = SEARCH_MAX_DEPTH;
+  if (opts) {
+    sh.node_limit = opts->nodes;
+    sh.deadline = opts->ms > 0 ? start + opts->ms : 0;
+  }
+  if (!opts || (opts->depth <= 0 && !opts->nodes && opts->ms <= 0)) sh.max_depth = SEARCH_DEFAULT_DEPTH;
+
+  size_t count = 1;
+  size_t want = hash_mb * 1024 * 1024 / sizeof(TTEntry);
+  while (count * 2 <= want) count *= 2;
+  sh.tt = (TTEntry*)bc_aligned_calloc(BC_CACHE_LINE, count, sizeof(TTEntry));
+  sh.tt_mask = (uint64_t)count - 1;
+  SearchThread** workers = (SearchThread**)bc_calloc((size_t)threads, sizeof(SearchThread*));
+  bool ok = sh.tt && workers;
+  for (int i = 0; ok && i < threads; i++) {
+    workers[i] = (SearchThread*)bc_calloc(1, sizeof(SearchThread));
+    if (!workers[i]) ok = false;
+    else {
+      workers[i]->sh = &sh;
+      workers[i]->id = i;
+    }
+  }
+
+  if (ok) {
+    /* Thread 0 runs on the caller; helpers need a worker each to run alongside it. */
+    Pool* pool = threads > 1 ? pool_create(threads - 1) : NULL;
+    for (int i = 1; pool && i < threads; i++) pool_submit(pool, -1, search_thread, workers[i]);
+    search_thread(workers[0], -1);
+    if (pool) {
+      pool_wait(pool);
+      pool_destroy(pool);
+    }
+
+    const SearchThread* best = workers[0];
+    for (int i = 1; i < threads; i++) {
+      if (workers[i]->depth > best->depth && workers[i]->best_pv_len > 0) best = workers[i];
+    }
+    out->score = best->score;
+    out->depth = best->depth;
+    out->pv_len = best->best_pv_len;
+    memcpy(out->pv, best->best_pv, (size_t)best->best_pv_len * sizeof(Move));
+    if (out->pv_len > 0) {
+      out->best = out->pv[0];
+    } else {
+      out->best.from = -1;
+      out->best.to = -1;
+    }
+    for (int i = 0; i < threads; i++) out->nodes += workers[i]->nodes;
+  }
+  out->ms = bc_now_ms() - start;
+
+  for (int i = 0; workers && i < threads; i++) bc_free(workers[i]);
+  bc_free(workers);
+  bc_aligned_free(sh.tt);
+  return ok;
+}
@@ -0,0 +1,46 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Iterative-deepening alpha-beta (PVS) with quiescence, a shared lockless
+ * transposition table and lazy SMP: every thread searches the whole tree from
+ * the root on its own Board copies and they cooperate only through the table. */
+
+#define SEARCH_MAX_DEPTH 64 /* iterations */
+#define SEARCH_MAX_PLY 128  /* including quiescence and check extensions */
+#define SEARCH_MATE 32000   /* score of mate at the root; mate in n plies is SEARCH_MATE - n */
+#define SEARCH_MATE_BOUND (SEARCH_MATE - SEARCH_MAX_PLY)
+#define SEARCH_DEFAULT_DEPTH 6 /* when no limit is given */
+
+typedef struct {
+  int depth;        /* maximum iteration depth; 0 = SEARCH_MAX_DEPTH (or SEARCH_DEFAULT_DEPTH with no other limit) */
+  uint64_t nodes;   /* node budget over all threads, checked every 1024 nodes; 0 = none */
+  double ms;        /* time budget; 0 = none */
+  int threads;      /* <= 0: one per CPU */
+  size_t hash_mb;   /* transposition table size (rounded down to a power of two entries) */
+} SearchOptions;
+
+typedef struct {
+  Move best;        /* from = to = -1 when the side to move has no legal move */
+  int score;        /* centipawns for the side to move, or +-(SEARCH_MATE - plies) */
+  int depth;        /* deepest completed iteration */
+  uint64_t nodes;   /* all threads, quiescence included */
+  double ms;
+  Move pv[SEARCH_MAX_DEPTH];
+  int pv_len;
+} SearchResult;
+
+/* Search b within the limits of opts (NULL: SEARCH_DEFAULT_DEPTH, one thread,
+ * 16 MB). At least one iteration always completes. Returns false on
+ * allocation failure. */
+bool board_search(const Board* b, const SearchOptions* opts, SearchResult* out);
+
+/* Tapered material + piece-square evaluation (board_eval, recomputed from
+ * the current tables) for the side to move, in centipawns. */
+int board_evaluate(const Board* b);
+
+#endif
@@ -0,0 +1,61 @@
+/* AVX2 kernels with runtime dispatch. The build targets baseline x86-64, so
+ * AVX2 functions are compiled per function (BC_TARGET_AVX2) and only called
+ * when bc_cpu_avx2() says the CPU and OS support them. Header-only. */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BC_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BC_TARGET_AVX2
+#else
+#define BC_TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+#endif
+
+static inline bool bc_cpu_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  int r[4];
+  __cpuid(r, 1);
+  bool osxsave = (r[2] & (1 << 27)) != 0;
+  if (!osxsave || (_xgetbv(0) & 6) != 6) return false;
+  __cpuidex(r, 7, 0);
+  return (r[1] & (1 << 5)) != 0;
+#else
+  static int cached = -1;
+  if (cached < 0) {
+    __builtin_cpu_init();
+    cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return cached == 1;
+#endif
+}
+
+/* Popcount of each byte of v (nibble lookup). */
+BC_TARGET_AVX2 static inline __m256i bc_byte_popcount256(__m256i v) {
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+  __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+  return _mm256_add_epi8(lo, hi);
+}
+
+/* Sum of the 32 unsigned bytes of v. */
+BC_TARGET_AVX2 static inline uint64_t bc_sum_bytes256(__m256i v) {
+  __m256i sad = _mm256_sad_epu8(v, _mm256_setzero_si256());
+  __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+  return (uint64_t)_mm_cvtsi128_si64(s) + (uint64_t)_mm_extract_epi64(s, 1);
+}
+#else
+static inline bool bc_cpu_avx2(void) {
+  return false;
+}
+#endif
+
+#endif
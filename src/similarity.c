@@ -0,0 +1,398 @@
+/* Position similarity index (see similarity.h). Each rank has a table of
+ * position ids grouped by a hash of that rank's twelve bytes, built by a
+ * counting sort over a power-of-two bucket count; a 32-bit fingerprint per
+ * entry drops most hash collisions before the full distance is taken.
+ * Positions added after a build are chained per rank into an overflow table
+ * on the same buckets, as in minhash.c; once they outnumber the positions in
+ * the sorted tables, everything is rebuilt. */
+
+#include "similarity.h"
+#include "alloc.h"
+#include "bitops.h"
+#include "pool.h"
+#include "simd.h"
+#include "threads.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SIM_RANKS 8
+#define SCAN_CHUNK 16384 /* positions per scan task */
+
+typedef struct {
+  uint32_t id;
+  uint32_t fp;
+  uint32_t next; /* 1 + the previous entry of the bucket, or 0 */
+} SimEntry;
+
+struct SimIndex {
+  u64* sets; /* 12 per position, cache-line aligned */
+  size_t count;
+  size_t cap;
+  size_t built; /* positions covered by the sorted rank tables */
+  uint64_t mask;
+  uint32_t* starts[SIM_RANKS]; /* mask + 2 offsets into ids/fps */
+  uint32_t* ids[SIM_RANKS];
+  uint32_t* fps[SIM_RANKS];
+  /* Per rank, positions from built on: ov_head[r][bucket] is 1 + the newest
+   * entry of the bucket's chain (0 when empty), ov[r][0..ov_len[r]) the entries. */
+  uint32_t* ov_head[SIM_RANKS];
+  SimEntry* ov[SIM_RANKS];
+  size_t ov_len[SIM_RANKS];
+  size_t ov_cap[SIM_RANKS];
+};
+
+static uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= UINT64_C(0xBF58476D1CE4E5B9);
+  x ^= x >> 27;
+  x *= UINT64_C(0x94D049BB133111EB);
+  return x ^ (x >> 31);
+}
+
+/* Hash of rank r's byte in each of the twelve bitboards. */
+static uint64_t rank_hash(const u64* sets, int r) {
+  uint64_t lo = 0, hi = 0;
+  for (int i = 0; i < 8; i++) lo |= ((sets[i] >> (8 * r)) & 0xFF) << (8 * i);
+  for (int i = 8; i < 12; i++) hi |= ((sets[i] >> (8 * r)) & 0xFF) << (8 * (i - 8));
+  return mix64(lo ^ mix64(hi + (uint64_t)(r + 1) * UINT64_C(0x9E3779B97F4A7C15)));
+}
+
+static void free_tables(SimIndex* idx) {
+  for (int r = 0; r < SIM_RANKS; r++) {
+    bc_aligned_free(idx->starts[r]);
+    bc_aligned_free(idx->ids[r]);
+    bc_aligned_free(idx->fps[r]);
+    bc_free(idx->ov_head[r]);
+    bc_free(idx->ov[r]);
+    idx->starts[r] = idx->ids[r] = idx->fps[r] = idx->ov_head[r] = NULL;
+    idx->ov[r] = NULL;
+    idx->ov_len[r] = idx->ov_cap[r] = 0;
+  }
+  idx->built = 0;
+}
+
+SimIndex* sim_create(void) {
+  SimIndex* idx = (SimIndex*)bc_calloc(1, sizeof(SimIndex));
+  board_init_tables();
+  return idx;
+}
+
+void sim_destroy(SimIndex* idx) {
+  if (!idx) return;
+  free_tables(idx);
+  bc_aligned_free(idx->sets);
+  bc_free(idx);
+}
+
+size_t sim_size(const SimIndex* idx) {
+  return idx->count;
+}
+
+const u64* sim_position(const SimIndex* idx, uint32_t id) {
+  return idx->sets + 12 * (size_t)id;
+}
+
+bool sim_add(SimIndex* idx, const u64* sets, size_t count) {
+  if (count > UINT32_MAX - idx->count) return false;
+  if (idx->count + count > idx->cap) {
+    size_t cap = idx->cap ? idx->cap : 1024;
+    while (cap < idx->count + count) cap *= 2;
+    u64* grown = (u64*)bc_aligned_calloc(BC_CACHE_LINE, cap, 12 * sizeof(u64));
+    if (!grown) return false;
+    if (idx->count) memcpy(grown, idx->sets, idx->count * 12 * sizeof(u64));
+    bc_aligned_free(idx->sets);
+    idx->sets = grown;
+    idx->cap = cap;
+  }
+  memcpy(idx->sets + 12 * idx->count, sets, count * 12 * sizeof(u64));
+  idx->count += count;
+  return true;
+}
+
+/* Chain positions built + ov_len[r] .. count into each rank's overflow table.
+ * Ranks are independent, so a cancelled append resumes where it stopped. */
+static bool append_overflow(SimIndex* idx, Job* job) {
+  size_t buckets = (size_t)idx->mask + 1;
+  uint64_t pending = 0;
+  for (int r = 0; r < SIM_RANKS; r++) pending += idx->count - idx->built - idx->ov_len[r];
+  job_set_total(job, pending);
+  for (int r = 0; r < SIM_RANKS; r++) {
+    size_t from = idx->built + idx->ov_len[r];
+    if (from == idx->count) continue;
+    if (job_cancelled(job)) return false;
+    if (!idx->ov_head[r]) {
+      idx->ov_head[r] = (uint32_t*)bc_calloc(buckets, sizeof(uint32_t));
+      if (!idx->ov_head[r]) return false;
+    }
+    size_t need = idx->count - idx->built;
+    if (need > idx->ov_cap[r]) {
+      size_t cap = idx->ov_cap[r] ? idx->ov_cap[r] : 64;
+      while (cap < need) cap *= 2;
+      SimEntry* grown = (SimEntry*)bc_realloc(idx->ov[r], cap * sizeof(SimEntry));
+      if (!grown) return false;
+      idx->ov[r] = grown;
+      idx->ov_cap[r] = cap;
+    }
+    uint32_t* head = idx->ov_head[r];
+    for (size_t i = from; i < idx->count; i++) {
+      uint64_t h = rank_hash(idx->sets + 12 * i, r);
+      SimEntry* e = &idx->ov[r][idx->ov_len[r]++];
+      e->id = (uint32_t)i;
+      e->fp = (uint32_t)(h >> 32);
+      e->next = head[h & idx->mask];
+      head[h & idx->mask] = (uint32_t)idx->ov_len[r];
+    }
+    job_advance(job, idx->count - from);
+  }
+  return true;
+}
+
+bool sim_build(SimIndex* idx, Job* job) {
+  if (idx->starts[0]) {
+    bool current = true;
+    for (int r = 0; r < SIM_RANKS; r++) current = current && idx->built + idx->ov_len[r] == idx->count;
+    if (current) return true;
+    if (idx->count - idx->built <= idx->built) return append_overflow(idx, job);
+  }
+  free_tables(idx);
+  size_t n = idx->count, buckets = 1;
+  while (buckets < n) buckets *= 2;
+  uint64_t* hashes = (uint64_t*)bc_malloc(n * sizeof(uint64_t));
+  if (!hashes) return false;
+  job_set_total(job, (uint64_t)n * (uint64_t)SIM_RANKS);
+  for (int r = 0; r < SIM_RANKS; r++) {
+    if (job_cancelled(job)) {
+      bc_free(hashes);
+      free_tables(idx);
+      return false;
+    }
+    uint32_t* starts = (uint32_t*)bc_aligned_calloc(BC_CACHE_LINE, buckets + 1, sizeof(uint32_t));
+    uint32_t* ids = (uint32_t*)bc_aligned_calloc(BC_CACHE_LINE, n, sizeof(uint32_t));
+    uint32_t* fps = (uint32_t*)bc_aligned_calloc(BC_CACHE_LINE, n, sizeof(uint32_t));
+    idx->starts[r] = starts;
+    idx->ids[r] = ids;
+    idx->fps[r] = fps;
+    if (!starts || !ids || !fps) {
+      bc_free(hashes);
+      free_tables(idx);
+      return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+      hashes[i] = rank_hash(idx->sets + 12 * i, r);
+      starts[(hashes[i] & (buckets - 1)) + 1]++;
+    }
+    for (size_t b = 0; b < buckets; b++) starts[b + 1] += starts[b];
+    /* Place by bucket, advancing each start to its end, then shift back. */
+    for (size_t i = 0; i < n; i++) {
+      uint32_t at = starts[hashes[i] & (buckets - 1)]++;
+      ids[at] = (uint32_t)i;
+      fps[at] = (uint32_t)(hashes[i] >> 32);
+    }
+    memmove(starts + 1, starts, buckets * sizeof(uint32_t));
+    starts[0] = 0;
+    job_advance(job, n);
+  }
+  bc_free(hashes);
+  idx->mask = buckets - 1;
+  idx->built = n;
+  return true;
+}
+
+/* Distances from query to positions ids[i] (or i with ids NULL) for i in [begin, end). */
+static void distances_scalar(const SimIndex* idx, const u64* query, const uint32_t* ids, size_t begin, size_t end,
+                             uint16_t* out) {
+  for (size_t i = begin; i < end; i++) {
+    const u64* p = idx->sets + 12 * (size_t)(ids ? ids[i] : i);
+    int d = 0;
+    for (int j = 0; j < 12; j++) d += bb_popcount(p[j] ^ query[j]);
+    out[i] = (uint16_t)d;
+  }
+}
+
+#ifdef BC_AVX2
+/* A position is three 256-bit words; per-byte counts of all three stay below 25. */
+BC_TARGET_AVX2 static void distances_avx2(const SimIndex* idx, const u64* query, const uint32_t* ids, size_t begin,
+                                          size_t end, uint16_t* out) {
+  const __m256i q0 = _mm256_loadu_si256((const __m256i*)query);
+  const __m256i q1 = _mm256_loadu_si256((const __m256i*)(query + 4));
+  const __m256i q2 = _mm256_loadu_si256((const __m256i*)(query + 8));
+  for (size_t i = begin; i < end; i++) {
+    const u64* p = idx->sets + 12 * (size_t)(ids ? ids[i] : i);
+    __m256i c = bc_byte_popcount256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), q0));
+    c = _mm256_add_epi8(c, bc_byte_popcount256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p + 4)), q1)));
+    c = _mm256_add_epi8(c, bc_byte_popcount256(_mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(p + 8)), q2)));
+    out[i] = (uint16_t)bc_sum_bytes256(c);
+  }
+}
+#endif
+
+static void distances(const SimIndex* idx, const u64* query, const uint32_t* ids, size_t begin, size_t end,
+                      uint16_t* out) {
+#ifdef BC_AVX2
+  if (bc_cpu_avx2()) {
+    distances_avx2(idx, query, ids, begin, end, out);
+    return;
+  }
+#endif
+  distances_scalar(idx, query, ids, begin, end, out);
+}
+
+typedef struct {
+  const SimIndex* idx;
+  const u64* query;
+  uint16_t* out;
+  uint64_t next; /* next chunk to take */
+} ScanCtx;
+
+static void scan_task(void* arg, int worker) {
+  ScanCtx* ctx = (ScanCtx*)arg;
+  size_t n = ctx->idx->count;
+  (void)worker;
+  for (;;) {
+    size_t begin = (size_t)bc_atomic_add_u64(&ctx->next, 1) * SCAN_CHUNK;
+    if (begin >= n) break;
+    size_t end = begin + SCAN_CHUNK < n ? begin + SCAN_CHUNK : n;
+    distances(ctx->idx, ctx->query, NULL, begin, end, ctx->out);
+  }
+}
+
+static void scan(const SimIndex* idx, const u64* query, int threads, uint16_t* out) {
+  ScanCtx ctx = { idx, query, out, 0 };
+  size_t chunks = (idx->count + SCAN_CHUNK - 1) / SCAN_CHUNK;
+  if (threads <= 0) threads = bc_cpu_count();
+  if ((size_t)threads > chunks) threads = chunks ? (int)chunks : 1;
+  Pool* pool = threads > 1 ? pool_create(threads) : NULL;
+  int submitted = 0;
+  for (int i = 0; pool && i < threads; i++) {
+    if (pool_submit(pool, -1, scan_task, &ctx)) submitted++;
+  }
+  if (!submitted) scan_task(&ctx, -1);
+  if (pool) {
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+}
+
+static int compare_u32(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int compare_u64(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+/* Top k of n distances (position ids[i], or i with ids NULL; ascending
+ * either way) by distance then id. A histogram finds the k-th distance, so
+ * only the winners are sorted. Returns how many were written. */
+static int select_top(const uint16_t* dist, const uint32_t* ids, size_t n, int k, uint32_t* out_ids,
+                      uint16_t* out_dist) {
+  uint32_t hist[SIM_MAX_DISTANCE + 1] = { 0 };
+  size_t want = (size_t)k < n ? (size_t)k : n;
+  if (!want) return 0;
+  uint64_t* keys = (uint64_t*)bc_malloc(want * sizeof(uint64_t));
+  if (!keys) return -1;
+  for (size_t i = 0; i < n; i++) hist[dist[i]]++;
+  size_t below = 0;
+  int cut = 0;
+  while (below + hist[cut] < want) below += hist[cut++];
+  size_t at_cut = want - below, taken = 0;
+  for (size_t i = 0; i < n && taken < want; i++) {
+    if (dist[i] > cut || (dist[i] == cut && !at_cut)) continue;
+    if (dist[i] == cut) at_cut--;
+    keys[taken++] = (uint64_t)dist[i] << 32 | (ids ? ids[i] : (uint32_t)i);
+  }
+  qsort(keys, taken, sizeof(uint64_t), compare_u64);
+  for (size_t i = 0; i < taken; i++) {
+    out_ids[i] = (uint32_t)keys[i];
+    out_dist[i] = (uint16_t)(keys[i] >> 32);
+  }
+  bc_free(keys);
+  return (int)taken;
+}
+
+/* Ids sharing a rank with query, ascending and distinct, into *out. */
+static bool collect(const SimIndex* idx, const u64* query, size_t max_bucket, uint32_t** out, size_t* count,
+                    int* skipped) {
+  uint32_t slot_begin[SIM_RANKS], slot_end[SIM_RANKS], chain[SIM_RANKS], fp[SIM_RANKS];
+  size_t total = 0;
+  for (int r = 0; r < SIM_RANKS; r++) {
+    uint64_t h = rank_hash(query, r);
+    slot_begin[r] = idx->starts[r][h & idx->mask];
+    slot_end[r] = idx->starts[r][(h & idx->mask) + 1];
+    chain[r] = idx->ov_head[r] ? idx->ov_head[r][h & idx->mask] : 0;
+    fp[r] = (uint32_t)(h >> 32);
+    size_t span = slot_end[r] - slot_begin[r];
+    for (uint32_t e = chain[r]; e; e = idx->ov[r][e - 1].next) span++;
+    if (span > max_bucket) {
+      (*skipped)++;
+      slot_end[r] = slot_begin[r];
+      chain[r] = 0;
+      span = 0;
+    }
+    total += span;
+  }
+  uint32_t* ids = (uint32_t*)bc_malloc((total ? total : 1) * sizeof(uint32_t));
+  if (!ids) return false;
+  size_t n = 0;
+  for (int r = 0; r < SIM_RANKS; r++) {
+    for (uint32_t j = slot_begin[r]; j < slot_end[r]; j++) {
+      if (idx->fps[r][j] == fp[r]) ids[n++] = idx->ids[r][j];
+    }
+    for (uint32_t e = chain[r]; e; e = idx->ov[r][e - 1].next) {
+      if (idx->ov[r][e - 1].fp == fp[r]) ids[n++] = idx->ov[r][e - 1].id;
+    }
+  }
+  qsort(ids, n, sizeof(uint32_t), compare_u32);
+  size_t unique = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!unique || ids[i] != ids[unique - 1]) ids[unique++] = ids[i];
+  }
+  *out = ids;
+  *count = unique;
+  return true;
+}
+
+int sim_query(SimIndex* idx, const u64* query, const SimOptions* opts, uint32_t* ids, uint16_t* distances_out,
+              SimStats* stats) {
+  SimStats local;
+  if (!stats) stats = &local;
+  memset(stats, 0, sizeof(*stats));
+  if (opts->k <= 0 || !idx->count) {
+    stats->exact = true;
+    return 0;
+  }
+  if (!sim_build(idx, NULL)) return -1;
+  size_t max_bucket = opts->max_bucket ? opts->max_bucket : SIM_DEFAULT_MAX_BUCKET;
+  size_t want = (size_t)opts->k < idx->count ? (size_t)opts->k : idx->count;
+
+  uint32_t* cand;
+  size_t count;
+  if (!collect(idx, query, max_bucket, &cand, &count, &stats->skipped)) return -1;
+  stats->candidates = count;
+  uint16_t* dist = (uint16_t*)bc_malloc((count ? count : 1) * sizeof(uint16_t));
+  if (!dist) {
+    bc_free(cand);
+    return -1;
+  }
+  distances(idx, query, cand, 0, count, dist);
+  int written = select_top(dist, cand, count, (int)want, ids, distances_out);
+  bc_free(dist);
+  bc_free(cand);
+  if (written < 0) return -1;
+  /* A position outside the candidates differs on every rank looked up. */
+  if ((size_t)written == want) {
+    stats->exact = count == idx->count || distances_out[written - 1] + stats->skipped < SIM_RANKS;
+  }
+  if (stats->exact || opts->approximate) return written;
+
+  dist = (uint16_t*)bc_malloc(idx->count * sizeof(uint16_t));
+  if (!dist) return -1;
+  scan(idx, query, opts->threads, dist);
+  written = select_top(dist, NULL, idx->count, (int)want, ids, distances_out);
+  bc_free(dist);
+  stats->scanned = true;
+  stats->exact = written >= 0;
+  return written;
+}
@@ -0,0 +1,64 @@
+#ifndef SIMILARITY_H
+#define SIMILARITY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+#include "job.h"
+
+/* Nearest positions by piece placement. A position is its twelve piece
+ * bitboards (board_piece_sets order); the distance between two is the
+ * number of differing bits over all twelve, so a quiet move is 2 and a
+ * capture 3. Candidates come from multi-index hashing: the eight ranks are
+ * hashed as separate substrings, and two positions within distance 7 share
+ * at least one rank exactly. Candidates are then ranked by their full
+ * distance (AVX2 when the CPU has it). When the candidates cannot prove the
+ * top k, the query scans every position instead. */
+
+#define SIM_MAX_DISTANCE (12 * 64)
+#define SIM_DEFAULT_MAX_BUCKET 4096
+
+typedef struct SimIndex SimIndex;
+
+typedef struct {
+  int k;             /* results wanted */
+  bool approximate;  /* keep the candidates' top k even when unproven (no scan) */
+  int threads;       /* for a scan; <= 0: one per CPU */
+  size_t max_bucket; /* ranks shared by more positions are not looked up; 0 = SIM_DEFAULT_MAX_BUCKET */
+} SimOptions;
+
+typedef struct {
+  uint64_t candidates; /* distinct positions re-ranked from the rank tables */
+  int skipped;         /* ranks whose bucket exceeded max_bucket */
+  bool scanned;        /* every position was compared */
+  bool exact;          /* the results are the true top k (ties by lower id) */
+} SimStats;
+
+SimIndex* sim_create(void);
+void sim_destroy(SimIndex* idx);
+size_t sim_size(const SimIndex* idx);
+
+/* Append count positions of twelve bitboards each; their ids follow on from
+ * sim_size(). Rank tables take them in at the next query or sim_build: new
+ * positions are chained into per-rank overflow tables at O(ranks) each, and
+ * once they outnumber the positions already in the sorted tables all n are
+ * rebuilt at O(n * ranks). Returns false on allocation failure or past
+ * UINT32_MAX positions. */
+bool sim_add(SimIndex* idx, const u64* sets, size_t count);
+
+/* Build the rank tables now rather than at the next query, counting the
+ * positions times ranks it takes in into job (optional). Returns false on allocation
+ * failure or when job is cancelled, which leaves the build to the next query. */
+bool sim_build(SimIndex* idx, Job* job);
+
+/* The twelve bitboards of position id. */
+const u64* sim_position(const SimIndex* idx, uint32_t id);
+
+/* Nearest positions to query[12], closest first and ties by id, into
+ * ids[k] and distances[k]. Returns how many were written (at most k), or
+ * -1 on allocation failure. Queries on one index must not overlap. */
+int sim_query(SimIndex* idx, const u64* query, const SimOptions* opts, uint32_t* ids, uint16_t* distances,
+              SimStats* stats);
+
+#endif
@@ -0,0 +1,593 @@
+/* Columnar position store (see store.h). A query is a list of terms over
+ * unions of piece columns; positions are tested 64 at a time, term by term,
+ * so a block stops reading columns once no position in it can match. With
+ * AVX2 a term covers four positions per step: the union is OR-ed from the
+ * piece columns, masked, and compared (or popcounted per 64-bit lane with a
+ * nibble lookup and a byte sum) into a hit bit per position. */
+
+#include "store.h"
+#include "alloc.h"
+#include "bitops.h"
+#include "pool.h"
+#include "simd.h"
+#include "threads.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define STORE_COLUMNS 15 /* 12 bitboards, game, ply, flags */
+#define STORE_ALIGN 64
+#define STORE_PATH_MAX 1024
+#define BLOCK 64
+#define CHUNK (1024 * BLOCK) /* positions per query task */
+
+static const size_t COLUMN_WIDTH[STORE_COLUMNS] = { 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 4, 2, 1 };
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  uint64_t positions;
+  uint32_t games;
+  uint8_t reserved[44];
+} StoreFileHeader; /* 64 bytes; the columns follow */
+
+/* Offset of every column for n positions; returns the file size. */
+static uint64_t layout(uint64_t n, uint64_t offsets[STORE_COLUMNS]) {
+  uint64_t at = sizeof(StoreFileHeader);
+  for (int c = 0; c < STORE_COLUMNS; c++) {
+    offsets[c] = at;
+    at += (n * COLUMN_WIDTH[c] + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+  }
+  return at;
+}
+
+/* ---- writer ---- */
+
+struct StoreWriter {
+  void* columns[STORE_COLUMNS];
+  size_t count;
+  size_t cap;
+  uint32_t games;
+};
+
+StoreWriter* store_writer_create(void) {
+  return (StoreWriter*)bc_calloc(1, sizeof(StoreWriter));
+}
+
+static void writer_clear(StoreWriter* w) {
+  for (int c = 0; c < STORE_COLUMNS; c++) {
+    bc_free(w->columns[c]);
+    w->columns[c] = NULL;
+  }
+  w->count = 0;
+  w->cap = 0;
+  w->games = 0;
+}
+
+void store_writer_destroy(StoreWriter* w) {
+  if (!w) return;
+  writer_clear(w);
+  bc_free(w);
+}
+
+size_t store_writer_positions(const StoreWriter* w) {
+  return w->count;
+}
+
+uint32_t store_writer_games(const StoreWriter* w) {
+  return w->games;
+}
+
+uint32_t store_writer_begin_game(StoreWriter* w) {
+  return w->games++;
+}
+
+bool store_writer_add(StoreWriter* w, const Board* b, uint32_t ply) {
+  if (w->count == w->cap) {
+    if (w->cap >= UINT32_MAX) return false;
+    size_t cap = w->cap ? w->cap * 2 : 4096;
+    if (cap > UINT32_MAX) cap = UINT32_MAX;
+    for (int c = 0; c < STORE_COLUMNS; c++) {
+      void* grown = bc_realloc(w->columns[c], cap * COLUMN_WIDTH[c]);
+      if (!grown) return false;
+      w->columns[c] = grown;
+    }
+    w->cap = cap;
+  }
+  size_t i = w->count++;
+  u64 sets[12];
+  board_piece_sets(b, sets);
+  for (int p = 0; p < 12; p++) ((u64*)w->columns[p])[i] = sets[p];
+  ((uint32_t*)w->columns[12])[i] = w->games ? w->games - 1 : 0;
+  ((uint16_t*)w->columns[13])[i] = (uint16_t)(ply > UINT16_MAX ? UINT16_MAX : ply);
+  uint8_t flags = b->sideToMove == BLACK ? STORE_FLAG_BLACK : 0;
+  for (const char* c = b->castling; *c; c++) {
+    if (*c == 'K') flags |= STORE_FLAG_CASTLE_K;
+    else if (*c == 'Q') flags |= STORE_FLAG_CASTLE_Q;
+    else if (*c == 'k') flags |= STORE_FLAG_CASTLE_k;
+    else if (*c == 'q') flags |= STORE_FLAG_CASTLE_q;
+  }
+  ((uint8_t*)w->columns[14])[i] = flags;
+  return true;
+}
+
+bool store_writer_finish(StoreWriter* w, const char* path) {
+  static const char zeros[STORE_ALIGN] = { 0 };
+  char tmp[STORE_PATH_MAX + 8];
+  StoreFileHeader h;
+  uint64_t offsets[STORE_COLUMNS];
+  if (strlen(path) >= STORE_PATH_MAX) return false;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, "BBPS", 4);
+  h.version = 1;
+  h.positions = w->count;
+  h.games = w->games;
+  uint64_t total = layout(w->count, offsets);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE* f = fopen(tmp, "wb");
+  if (!f) return false;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+  for (int c = 0; ok && c < STORE_COLUMNS; c++) {
+    size_t bytes = w->count * COLUMN_WIDTH[c];
+    uint64_t end = c + 1 < STORE_COLUMNS ? offsets[c + 1] : total;
+    size_t pad = (size_t)(end - offsets[c]) - bytes;
+    ok = (!bytes || fwrite(w->columns[c], 1, bytes, f) == bytes) && (!pad || fwrite(zeros, 1, pad, f) == pad);
+  }
+  ok = (fclose(f) == 0) && ok;
+  if (ok) {
+    remove(path);
+    ok = rename(tmp, path) == 0;
+  }
+  if (!ok) {
+    remove(tmp);
+    return false;
+  }
+  writer_clear(w);
+  return true;
+}
+
+/* ---- reader ---- */
+
+struct PositionStore {
+  void* map;
+  size_t map_len;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+  size_t count;
+  uint32_t games;
+  const u64* sets[12];
+  const uint32_t* game;
+  const uint16_t* ply;
+  const uint8_t* flags;
+};
+
+static void unmap(PositionStore* s) {
+#ifdef _WIN32
+  UnmapViewOfFile(s->map);
+  CloseHandle(s->mapping);
+  CloseHandle(s->file);
+#else
+  munmap(s->map, s->map_len);
+#endif
+}
+
+PositionStore* store_open(const char* path) {
+  StoreFileHeader h;
+  uint64_t offsets[STORE_COLUMNS];
+  PositionStore* s = (PositionStore*)bc_calloc(1, sizeof(PositionStore));
+  if (!s) return NULL;
+#ifdef _WIN32
+  s->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (s->file == INVALID_HANDLE_VALUE) goto fail;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(s->file, &size) || (uint64_t)size.QuadPart < sizeof(StoreFileHeader)) goto fail_file;
+  s->map_len = (size_t)size.QuadPart;
+  s->mapping = CreateFileMappingA(s->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!s->mapping) goto fail_file;
+  s->map = MapViewOfFile(s->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!s->map) {
+    CloseHandle(s->mapping);
+    goto fail_file;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0) goto fail;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(StoreFileHeader)) {
+    close(fd);
+    goto fail;
+  }
+  s->map_len = (size_t)st.st_size;
+  s->map = mmap(NULL, s->map_len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (s->map == MAP_FAILED) {
+    s->map = NULL;
+    goto fail;
+  }
+#endif
+  memcpy(&h, s->map, sizeof(h));
+  if (memcmp(h.magic, "BBPS", 4) != 0 || h.version != 1 || h.positions > UINT32_MAX ||
+      layout(h.positions, offsets) != (uint64_t)s->map_len) {
+    store_close(s);
+    return NULL;
+  }
+  s->count = (size_t)h.positions;
+  s->games = h.games;
+  const char* base = (const char*)s->map;
+  for (int p = 0; p < 12; p++) s->sets[p] = (const u64*)(base + offsets[p]);
+  s->game = (const uint32_t*)(base + offsets[12]);
+  s->ply = (const uint16_t*)(base + offsets[13]);
+  s->flags = (const uint8_t*)(base + offsets[14]);
+  return s;
+#ifdef _WIN32
+fail_file:
+  CloseHandle(s->file);
+#endif
+fail:
+  bc_free(s);
+  return NULL;
+}
+
+void store_close(PositionStore* s) {
+  if (!s) return;
+  if (s->map) unmap(s);
+  bc_free(s);
+}
+
+size_t store_size(const PositionStore* s) {
+  return s->count;
+}
+
+uint32_t store_games(const PositionStore* s) {
+  return s->games;
+}
+
+void store_get(const PositionStore* s, size_t i, u64* sets, uint32_t* game, uint32_t* ply, uint8_t* flags) {
+  if (sets) {
+    for (int p = 0; p < 12; p++) sets[p] = s->sets[p][i];
+  }
+  if (game) *game = s->game[i];
+  if (ply) *ply = s->ply[i];
+  if (flags) *flags = s->flags[i];
+}
+
+/* ---- query compiler ---- */
+
+static const char PIECE_CHARS[] = "PNBRQKpnbrqk";
+
+/* Piece letters (or '*') up to '@', a comparison or the end; 0 on error. */
+static uint16_t parse_pieces(const char** p, const char* end) {
+  uint16_t pieces = 0;
+  for (; *p < end && **p != '@' && !strchr("=<>", **p); (*p)++) {
+    const char* at = **p ? strchr(PIECE_CHARS, **p) : NULL;
+    if (**p == '*') pieces = 0xFFF;
+    else if (at) pieces |= (uint16_t)(1u << (at - PIECE_CHARS));
+    else return 0;
+  }
+  return pieces;
+}
+
+/* Comma-separated squares, files, ranks or '*' up to a comparison or the end; 0 on error. */
+static u64 parse_squares(const char** p, const char* end) {
+  u64 squares = 0;
+  for (;;) {
+    char c = *p < end ? **p : 0;
+    if (c == '*') {
+      squares = ~UINT64_C(0);
+      (*p)++;
+    } else if (c >= 'a' && c <= 'h') {
+      int file = c - 'a';
+      (*p)++;
+      if (*p < end && **p >= '1' && **p <= '8') {
+        squares |= UINT64_C(1) << (8 * (**p - '1') + file);
+        (*p)++;
+      } else {
+        squares |= UINT64_C(0x0101010101010101) << file;
+      }
+    } else if (c >= '1' && c <= '8') {
+      squares |= UINT64_C(0xFF) << (8 * (c - '1'));
+      (*p)++;
+    } else {
+      return 0;
+    }
+    if (*p == end || **p != ',') return squares;
+    (*p)++;
+  }
+}
+
+static bool parse_number(const char** p, const char* end, int* out) {
+  int n = 0, digits = 0;
+  for (; *p < end && **p >= '0' && **p <= '9' && digits < 3; (*p)++, digits++) n = n * 10 + (**p - '0');
+  *out = n;
+  return digits > 0 && (*p == end || **p < '0' || **p > '9');
+}
+
+/* "=n", "=a..b", "<n", "<=n", ">n" or ">=n" ending the token, into [lo, hi]. */
+static bool parse_range(const char* p, const char* end, int* lo, int* hi) {
+  int n, m;
+  if (p == end) return false;
+  char op = *p++;
+  bool or_equal = op != '=' && p < end && *p == '=';
+  if (or_equal) p++;
+  if (!parse_number(&p, end, &n)) return false;
+  if (op == '=') {
+    *lo = *hi = n;
+    if (p + 2 <= end && p[0] == '.' && p[1] == '.') {
+      p += 2;
+      if (!parse_number(&p, end, &m) || m < n) return false;
+      *hi = m;
+    }
+  } else if (op == '<') {
+    *lo = 0;
+    *hi = or_equal ? n : n - 1;
+  } else if (op == '>') {
+    *lo = or_equal ? n : n + 1;
+    *hi = 64;
+  } else {
+    return false;
+  }
+  return p == end && *lo <= *hi;
+}
+
+static bool parse_castle(const char* p, const char* end, uint8_t* rights) {
+  *rights = 0;
+  if (end - p == 1 && *p == '-') return true;
+  for (; p < end; p++) {
+    if (*p == 'K') *rights |= STORE_FLAG_CASTLE_K;
+    else if (*p == 'Q') *rights |= STORE_FLAG_CASTLE_Q;
+    else if (*p == 'k') *rights |= STORE_FLAG_CASTLE_k;
+    else if (*p == 'q') *rights |= STORE_FLAG_CASTLE_q;
+    else return false;
+  }
+  return *rights != 0;
+}
+
+static bool starts_with(const char* p, const char* end, const char* prefix) {
+  size_t n = strlen(prefix);
+  return (size_t)(end - p) >= n && memcmp(p, prefix, n) == 0;
+}
+
+static bool compile_term(const char* p, const char* end, StoreQuery* q) {
+  bool negate = *p == '!';
+  if (negate) p++;
+  if (starts_with(p, end, "turn=")) {
+    p += 5;
+    if (negate || end - p != 1 || (*p != 'w' && *p != 'b')) return false;
+    if (*p == 'b') q->flags_set |= STORE_FLAG_BLACK;
+    else q->flags_clear |= STORE_FLAG_BLACK;
+    return true;
+  }
+  if (starts_with(p, end, "castle=")) {
+    uint8_t rights;
+    if (!parse_castle(p + 7, end, &rights)) return false;
+    if (!rights) {
+      if (negate) return false;
+      q->flags_clear |= STORE_FLAG_CASTLE_K | STORE_FLAG_CASTLE_Q | STORE_FLAG_CASTLE_k | STORE_FLAG_CASTLE_q;
+    } else if (negate) {
+      q->flags_clear |= rights;
+    } else {
+      q->flags_set |= rights;
+    }
+    return true;
+  }
+  if (q->count == STORE_MAX_TERMS) return false;
+  StoreTerm* t = &q->terms[q->count];
+  bool count = *p == '#';
+  if (count && negate) return false;
+  if (count) p++;
+  t->pieces = parse_pieces(&p, end);
+  if (!t->pieces) return false;
+  t->squares = ~UINT64_C(0);
+  if (p < end && *p == '@') {
+    p++;
+    t->squares = parse_squares(&p, end);
+    if (!t->squares) return false;
+  } else if (!count) {
+    return false;
+  }
+  if (count) {
+    t->kind = STORE_TERM_COUNT;
+    if (!parse_range(p, end, &t->lo, &t->hi)) return false;
+  } else {
+    if (p != end) return false;
+    t->kind = negate ? STORE_TERM_NONE : STORE_TERM_ALL;
+  }
+  q->count++;
+  return true;
+}
+
+bool store_compile(const char* text, size_t len, StoreQuery* out, size_t* err_at) {
+  const char* p = text;
+  const char* end = text + len;
+  memset(out, 0, sizeof(*out));
+  while (p < end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    if (p == end) break;
+    const char* start = p;
+    while (p < end && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') p++;
+    if (!compile_term(start, p, out)) {
+      if (err_at) *err_at = (size_t)(start - text);
+      return false;
+    }
+  }
+  /* Square tests first: they are cheaper than counts and usually rarer. */
+  StoreTerm sorted[STORE_MAX_TERMS];
+  int n = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < out->count; i++) {
+      if ((out->terms[i].kind == STORE_TERM_COUNT) == (pass == 1)) sorted[n++] = out->terms[i];
+    }
+  }
+  memcpy(out->terms, sorted, (size_t)n * sizeof(StoreTerm));
+  return true;
+}
+
+/* ---- query evaluation ---- */
+
+/* Hit bits of t for positions [base, base + n). */
+static uint64_t term_block_scalar(const PositionStore* s, const StoreTerm* t, size_t base, int n) {
+  uint64_t bits = 0;
+  for (int j = 0; j < n; j++) {
+    u64 v = 0;
+    for (uint32_t pieces = t->pieces; pieces; pieces &= pieces - 1) v |= s->sets[bb_lsb(pieces)][base + j];
+    v &= t->squares;
+    bool hit;
+    if (t->kind == STORE_TERM_ALL) hit = v == t->squares;
+    else if (t->kind == STORE_TERM_NONE) hit = v == 0;
+    else {
+      int c = bb_popcount(v);
+      hit = c >= t->lo && c <= t->hi;
+    }
+    bits |= (uint64_t)hit << j;
+  }
+  return bits;
+}
+
+#ifdef BC_AVX2
+/* Hit bits of t for the full block at base. */
+BC_TARGET_AVX2 static uint64_t term_block_avx2(const PositionStore* s, const StoreTerm* t, size_t base) {
+  const __m256i squares = _mm256_set1_epi64x((long long)t->squares);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i lo = _mm256_set1_epi64x(t->lo - 1);
+  const __m256i hi = _mm256_set1_epi64x(t->hi + 1);
+  uint64_t bits = 0;
+  for (int j = 0; j < BLOCK; j += 4) {
+    __m256i v = zero;
+    for (uint32_t pieces = t->pieces; pieces; pieces &= pieces - 1) {
+      v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i*)(s->sets[bb_lsb(pieces)] + base + j)));
+    }
+    v = _mm256_and_si256(v, squares);
+    __m256i hit;
+    if (t->kind == STORE_TERM_ALL) hit = _mm256_cmpeq_epi64(v, squares);
+    else if (t->kind == STORE_TERM_NONE) hit = _mm256_cmpeq_epi64(v, zero);
+    else {
+      __m256i c = _mm256_sad_epu8(bc_byte_popcount256(v), zero);
+      hit = _mm256_and_si256(_mm256_cmpgt_epi64(c, lo), _mm256_cmpgt_epi64(hi, c));
+    }
+    bits |= (uint64_t)(unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(hit)) << j;
+  }
+  return bits;
+}
+#endif
+
+static uint64_t block_hits(const PositionStore* s, const StoreQuery* q, size_t base, int n, bool avx2) {
+  uint64_t alive = n == BLOCK ? ~UINT64_C(0) : (UINT64_C(1) << n) - 1;
+  (void)avx2;
+  if (q->flags_set | q->flags_clear) {
+    for (int j = 0; j < n; j++) {
+      uint8_t f = s->flags[base + j];
+      if ((f & q->flags_set) != q->flags_set || (f & q->flags_clear)) alive &= ~(UINT64_C(1) << j);
+    }
+  }
+  for (int i = 0; i < q->count && alive; i++) {
+#ifdef BC_AVX2
+    if (avx2 && n == BLOCK) {
+      alive &= term_block_avx2(s, &q->terms[i], base);
+      continue;
+    }
+#endif
+    alive &= term_block_scalar(s, &q->terms[i], base, n);
+  }
+  return alive;
+}
+
+typedef struct {
+  uint32_t* hits;
+  size_t count;
+  size_t cap;
+} ChunkHits;
+
+typedef struct {
+  const PositionStore* s;
+  const StoreQuery* q;
+  bool avx2;
+  size_t chunks;
+  ChunkHits* out;
+  uint64_t next; /* next chunk to take */
+  int oom;
+} QueryCtx;
+
+static bool push_hit(ChunkHits* h, uint32_t i) {
+  if (h->count == h->cap) {
+    size_t cap = h->cap ? h->cap * 2 : 256;
+    uint32_t* hits = (uint32_t*)bc_realloc(h->hits, cap * sizeof(uint32_t));
+    if (!hits) return false;
+    h->hits = hits;
+    h->cap = cap;
+  }
+  h->hits[h->count++] = i;
+  return true;
+}
+
+static void query_task(void* arg, int worker) {
+  QueryCtx* ctx = (QueryCtx*)arg;
+  (void)worker;
+  for (;;) {
+    uint64_t c = bc_atomic_add_u64(&ctx->next, 1);
+    if (c >= ctx->chunks) break;
+    size_t begin = (size_t)c * CHUNK;
+    size_t end = begin + CHUNK < ctx->s->count ? begin + CHUNK : ctx->s->count;
+    for (size_t base = begin; base < end; base += BLOCK) {
+      int n = end - base < BLOCK ? (int)(end - base) : BLOCK;
+      for (uint64_t bits = block_hits(ctx->s, ctx->q, base, n, ctx->avx2); bits; bits &= bits - 1) {
+        if (!push_hit(&ctx->out[c], (uint32_t)(base + (size_t)bb_lsb(bits)))) {
+          bc_atomic_store_int(&ctx->oom, 1);
+          return;
+        }
+      }
+    }
+  }
+}
+
+bool store_query(const PositionStore* s, const StoreQuery* q, int threads, uint32_t** hits, size_t* count) {
+  QueryCtx ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.s = s;
+  ctx.q = q;
+  ctx.avx2 = bc_cpu_avx2();
+  ctx.chunks = (s->count + CHUNK - 1) / CHUNK;
+  ctx.out = (ChunkHits*)bc_calloc(ctx.chunks ? ctx.chunks : 1, sizeof(ChunkHits));
+  if (!ctx.out) return false;
+  if (threads <= 0) threads = bc_cpu_count();
+  if ((size_t)threads > ctx.chunks) threads = ctx.chunks ? (int)ctx.chunks : 1;
+  Pool* pool = threads > 1 ? pool_create(threads) : NULL;
+  int submitted = 0;
+  for (int i = 0; pool && i < threads; i++) {
+    if (pool_submit(pool, -1, query_task, &ctx)) submitted++;
+  }
+  if (!submitted) query_task(&ctx, -1);
+  if (pool) {
+    pool_wait(pool);
+    pool_destroy(pool);
+  }
+
+  size_t total = 0;
+  for (size_t c = 0; c < ctx.chunks; c++) total += ctx.out[c].count;
+  uint32_t* all = ctx.oom ? NULL : (uint32_t*)bc_malloc((total ? total : 1) * sizeof(uint32_t));
+  size_t at = 0;
+  for (size_t c = 0; c < ctx.chunks; c++) {
+    if (all && ctx.out[c].count) memcpy(all + at, ctx.out[c].hits, ctx.out[c].count * sizeof(uint32_t));
+    at += ctx.out[c].count;
+    bc_free(ctx.out[c].hits);
+  }
+  bc_free(ctx.out);
+  if (!all) return false;
+  *hits = all;
+  *count = total;
+  return true;
+}
+
+void store_hits_free(uint32_t* hits) {
+  bc_free(hits);
+}
@@ -0,0 +1,94 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Columnar position store. Every position replayed into a StoreWriter is
+ * kept as its twelve piece bitboards (board_piece_sets order) plus its game
+ * id, ply and a flags byte, one column each. A finished store is a single
+ * file: a 64-byte header, then the columns in that order, each starting on
+ * a 64-byte boundary. It is memory-mapped to be queried.
+ *
+ * Queries are whitespace-separated terms, all of which must hold:
+ *   Nn@e5,d4   each listed square holds one of the pieces (N: white knight, n: black)
+ *   !p@d,e     none of the squares holds one (files a-h and ranks 1-8 stand for all 8 squares)
+ *   #P=8  #Qq=0  #p@d,e>=2  #R=1..2
+ *              number of those pieces (on those squares) =, <, <=, >, >= or within a..b
+ *   turn=w  castle=Kq  !castle=KQ  castle=-
+ *              side to move, castling rights all held / none held / no rights at all
+ * '*' stands for all twelve pieces or all 64 squares. */
+
+#define STORE_FLAG_CASTLE_K 1
+#define STORE_FLAG_CASTLE_Q 2
+#define STORE_FLAG_CASTLE_k 4
+#define STORE_FLAG_CASTLE_q 8
+#define STORE_FLAG_BLACK 16 /* black to move */
+
+#define STORE_MAX_TERMS 64
+
+#define STORE_TERM_ALL 0   /* every square of squares is covered */
+#define STORE_TERM_NONE 1  /* no square of squares is covered */
+#define STORE_TERM_COUNT 2 /* lo <= covered squares <= hi */
+
+typedef struct {
+  int kind;
+  uint16_t pieces; /* bit i: piece set i */
+  u64 squares;
+  int lo;
+  int hi;
+} StoreTerm;
+
+typedef struct {
+  StoreTerm terms[STORE_MAX_TERMS];
+  int count;
+  uint8_t flags_set;   /* flag bits that must be set */
+  uint8_t flags_clear; /* flag bits that must be clear */
+} StoreQuery;
+
+/* ---- writing ---- */
+
+typedef struct StoreWriter StoreWriter;
+
+StoreWriter* store_writer_create(void);
+void store_writer_destroy(StoreWriter* w);
+size_t store_writer_positions(const StoreWriter* w);
+uint32_t store_writer_games(const StoreWriter* w);
+
+/* Start a game; returns its id (games are numbered from 0 in the order started). */
+uint32_t store_writer_begin_game(StoreWriter* w);
+/* Append b as ply (1 = after the first move) of the current game. Returns
+ * false on allocation failure or past UINT32_MAX positions. */
+bool store_writer_add(StoreWriter* w, const Board* b, uint32_t ply);
+
+/* Write everything added so far to path (through a temporary file, so
+ * readers never see a partial store) and empty the writer. Returns false on
+ * a write failure, leaving the writer as it was. */
+bool store_writer_finish(StoreWriter* w, const char* path);
+
+/* ---- reading ---- */
+
+typedef struct PositionStore PositionStore;
+
+/* Map a store file; NULL if it is missing or not a store. */
+PositionStore* store_open(const char* path);
+void store_close(PositionStore* s);
+size_t store_size(const PositionStore* s);
+uint32_t store_games(const PositionStore* s);
+
+/* Position i: bitboards into sets[12], game id, ply and flags (any may be NULL). */
+void store_get(const PositionStore* s, size_t i, u64* sets, uint32_t* game, uint32_t* ply, uint8_t* flags);
+
+/* Compile a query (len bytes, no NUL needed). Returns false on a syntax
+ * error, with *err_at (optional) the offset of the offending term. */
+bool store_compile(const char* text, size_t len, StoreQuery* out, size_t* err_at);
+
+/* Indices of the positions matching q, ascending, into *hits (release with
+ * store_hits_free); the columns are scanned in 64-position blocks split
+ * across threads (<= 0: one per CPU). Returns false on allocation failure. */
+bool store_query(const PositionStore* s, const StoreQuery* q, int threads, uint32_t** hits, size_t* count);
+void store_hits_free(uint32_t* hits);
+
+#endif
@@ -0,0 +1,816 @@
+/* Retrograde WDL tablebase generation and probing.
+ *
+ * Generation, per table:
+ *  1. init: every index is decoded; impossible positions are marked invalid,
+ *     mates are losses, and positions with a capture or promotion into a lost
+ *     position of a smaller table are wins. Resolved positions form the frontier.
+ *  2. repeat until nothing changes: the unmoves of every frontier position
+ *     (non-capturing moves played backwards by the side not to move) mark its
+ *     predecessors as candidates; each unresolved candidate is re-evaluated
+ *     from its legal moves: a move to a lost position wins, and if every move
+ *     goes to a won one it is lost. Whatever stays unresolved is a draw.
+ *     A double pawn push is valued with its en passant replies (ep_eval): the
+ *     child's entry for the other moves, the smaller table for the captures.
+ * Each phase splits the index range over the thread pool in 64-entry aligned
+ * slices, so every 2-bit table word and frontier word has a single writer;
+ * candidate bits are set with an atomic OR. */
+
+#include "tablebase.h"
+#include "alloc.h"
+#include "bitops.h"
+#include "pool.h"
+#include "threads.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define TB_MAX_TABLES 1024
+#define TB_SIG_MAX 16
+#define TB_PATH_MAX 1024
+#define TB_FILE_MAX (TB_PATH_MAX + TB_SIG_MAX + 16) /* dir/sig.bbtb.tmp */
+#define TB_TASKS_PER_THREAD 8
+
+/* 2-bit entries */
+#define E_DRAW 0 /* or not (yet) resolved */
+#define E_WIN 1
+#define E_LOSS 2
+#define E_INVALID 3
+
+#define KIND_K 0
+#define KIND_P 5
+static const char KIND_CHARS[] = "KQRBNP";
+
+typedef struct {
+  char magic[4];
+  uint32_t version;
+  char signature[TB_SIG_MAX];
+  uint64_t entries;
+  uint32_t pieces;
+  uint8_t reserved[28];
+} TbFileHeader; /* 64 bytes; the 2-bit entries follow */
+
+typedef struct {
+  char signature[TB_SIG_MAX];
+  int pieces;
+  int color[TB_MAX_PIECES]; /* slot order: first side's pieces, then the second's, K..P */
+  int kind[TB_MAX_PIECES];
+  int king2;                /* slot of the second side's king */
+  int pawns;                /* 1 if any slot is a pawn: only the left-right mirror applies */
+  int groups;               /* runs of identical non-king pieces */
+  int group_start[TB_MAX_PIECES];
+  int group_len[TB_MAX_PIECES];
+  uint64_t group_size[TB_MAX_PIECES]; /* square sets a group can take */
+  uint64_t entries;
+  uint64_t* words;          /* 32 entries per word */
+  void* map;                /* file mapping, or NULL when words is allocated */
+  size_t map_len;
+#ifdef _WIN32
+  HANDLE file;
+  HANDLE mapping;
+#endif
+} TbTable;
+
+struct Tablebase {
+  char dir[TB_PATH_MAX];
+  TbTable* tables[TB_MAX_TABLES];
+  int count; /* published with release stores; readers scan without the lock */
+  bc_mutex lock;
+};
+
+/* ---- material signatures ---- */
+
+static u64* piece_bb(Board* b, int color, int kind) {
+  switch (kind) {
+    case 0: return &b->kings[color];
+    case 1: return &b->queens[color];
+    case 2: return &b->rooks[color];
+    case 3: return &b->bishops[color];
+    case 4: return &b->knights[color];
+    default: return &b->pawns[color];
+  }
+}
+
+static u64 piece_bb_of(const Board* b, int color, int kind) {
+  return *piece_bb((Board*)b, color, kind);
+}
+
+static u64 occupancy(const Board* b) {
+  u64 occ = 0;
+  for (int c = 0; c < 2; c++) {
+    for (int k = 0; k < 6; k++) occ |= piece_bb_of(b, c, k);
+  }
+  return occ;
+}
+
+/* > 0 when side a is stronger: more pieces, then more of the first kind that differs. */
+static int side_cmp(const int* a, const int* b) {
+  int na = 0, nb = 0;
+  for (int k = 0; k < 6; k++) {
+    na += a[k];
+    nb += b[k];
+  }
+  if (na != nb) return na - nb;
+  for (int k = 0; k < 6; k++) {
+    if (a[k] != b[k]) return a[k] - b[k];
+  }
+  return 0;
+}
+
+/* Writes the canonical signature of counts; returns 1 if the sides were swapped. */
+static int format_signature(int counts[2][6], char* out) {
+  int swap = side_cmp(counts[0], counts[1]) < 0;
+  int n = 0;
+  for (int s = 0; s < 2; s++) {
+    const int* side = counts[s ^ swap];
+    if (s) out[n++] = 'v';
+    for (int k = 0; k < 6; k++) {
+      for (int i = 0; i < side[k]; i++) out[n++] = KIND_CHARS[k];
+    }
+  }
+  out[n] = '\0';
+  return swap;
+}
+
+static bool parse_signature(const char* sig, int counts[2][6]) {
+  int side = 0;
+  int total = 0;
+  memset(counts, 0, sizeof(int) * 12);
+  for (const char* p = sig; *p; p++) {
+    if (*p == 'v' && side == 0) {
+      side = 1;
+      continue;
+    }
+    const char* k = strchr(KIND_CHARS, *p);
+    if (!k || !*p) return false;
+    counts[side][k - KIND_CHARS]++;
+    total++;
+  }
+  return side == 1 && counts[0][KIND_K] == 1 && counts[1][KIND_K] == 1 && total <= TB_MAX_PIECES;
+}
+
+static void board_counts(const Board* b, int counts[2][6]) {
+  for (int c = 0; c < 2; c++) {
+    for (int k = 0; k < 6; k++) counts[c][k] = bb_popcount(piece_bb_of(b, c, k));
+  }
+}
+
+int tb_signature(const Board* b, char* out) {
+  int counts[2][6];
+  if (bb_popcount(occupancy(b)) > TB_MAX_PIECES) return 0;
+  board_counts(b, counts);
+  format_signature(counts, out);
+  return (int)strlen(out);
+}
+
+/* ---- indexing ----
+ * Without castling rights a position has the value of its left-right mirror,
+ * and with no pawns of all eight of its rotations and reflections. The kings
+ * are indexed together as one of kp_count[pawns] pairs: the first side's king
+ * is folded into files a-d (with no pawns, into the a1-d1-d4 triangle, the
+ * other king on or below a1-h8 when it is on it), and touching kings are left
+ * out. Every other run of identical pieces is indexed by the rank of its
+ * square set (pawns over the 48 squares of ranks 2-7):
+ * ((pair * size1 + rank1) * size2 + rank2 ...) * 2 + stm. */
+
+#define TB_KP_MAX 1806 /* king pairs with pawns; 462 without */
+#define TB_NO_INDEX UINT64_MAX
+
+static int16_t kp_index[2][64][64]; /* [pawns][king1][king2]: pair, or -1 outside the fold */
+static uint8_t kp_squares[2][TB_KP_MAX][2];
+static int kp_count[2];
+
+static void init_king_pairs(void) {
+  static int done = 0;
+  if (done) return;
+  for (int pawns = 0; pawns < 2; pawns++) {
+    int n = 0;
+    for (int k1 = 0; k1 < 64; k1++) {
+      for (int k2 = 0; k2 < 64; k2++) {
+        int f1 = k1 & 7, r1 = k1 >> 3;
+        bool ok = f1 < 4 && k1 != k2 && !(board_king_attacks(k1) & ((u64)1 << k2));
+        if (!pawns) ok = ok && (r1 < f1 || (r1 == f1 && (k2 >> 3) <= (k2 & 7)));
+        kp_index[pawns][k1][k2] = (int16_t)(ok ? n : -1);
+        if (!ok) continue;
+        kp_squares[pawns][n][0] = (uint8_t)k1;
+        kp_squares[pawns][n][1] = (uint8_t)k2;
+        n++;
+      }
+    }
+    kp_count[pawns] = n;
+  }
+  done = 1;
+}
+
+static uint64_t binom(int n, int k) {
+  uint64_t r = 1;
+  for (int i = 0; i < k; i++) r = r * (uint64_t)(n - i) / (uint64_t)(i + 1);
+  return r;
+}
+
+static int sq_transform(int s, int flip, bool transpose) {
+  s ^= flip;
+  return transpose ? ((s & 7) << 3) | (s >> 3) : s;
+}
+
+static int entry_get(const TbTable* t, uint64_t i) {
+  uint64_t w = bc_atomic_load_u64(&t->words[i >> 5]);
+  return (int)(w >> ((i & 31) << 1)) & 3;
+}
+
+/* Callers own the word (single writer), so load/modify/store is enough. */
+static void entry_set(TbTable* t, uint64_t i, int v) {
+  uint64_t* p = &t->words[i >> 5];
+  int shift = (int)(i & 31) << 1;
+  uint64_t w = bc_atomic_load_u64(p);
+  w = (w & ~((uint64_t)3 << shift)) | ((uint64_t)v << shift);
+  bc_atomic_store_u64(p, w);
+}
+
+/* Index of sq (slot order) after flipping by flip and transposing if asked;
+ * TB_NO_INDEX unless that brings the kings into the fold. */
+static uint64_t fold_index(const TbTable* t, const int* sq, int flip, bool transpose) {
+  int kp = kp_index[t->pawns][sq_transform(sq[0], flip, transpose)][sq_transform(sq[t->king2], flip, transpose)];
+  if (kp < 0) return TB_NO_INDEX;
+  uint64_t idx = (uint64_t)kp;
+  for (int g = 0; g < t->groups; g++) {
+    int c[TB_MAX_PIECES];
+    int first = t->group_start[g];
+    int base = t->kind[first] == KIND_P ? 8 : 0;
+    for (int i = 0; i < t->group_len[g]; i++) {
+      int v = sq_transform(sq[first + i], flip, transpose) - base;
+      int j = i;
+      for (; j > 0 && c[j - 1] > v; j--) c[j] = c[j - 1];
+      c[j] = v;
+    }
+    uint64_t rank = 0;
+    for (int i = 0; i < t->group_len[g]; i++) rank += binom(c[i], i + 1);
+    idx = idx * t->group_size[g] + rank;
+  }
+  return idx;
+}
+
+/* Index of the position with piece squares sq (slot order); TB_NO_INDEX if the
+ * kings touch. With both kings on a1-h8 the transpose keeps them in the fold,
+ * so the smaller of the two indices stands for both and every position has
+ * exactly one index (the unmoves of a resolved position must reach it). */
+static uint64_t index_of(const TbTable* t, const int* sq, int stm) {
+  int k1 = sq[0];
+  int flip = (k1 & 7) > 3 ? 7 : 0;
+  uint64_t idx;
+  if (t->pawns) {
+    idx = fold_index(t, sq, flip, false);
+  } else {
+    if ((k1 >> 3) > 3) flip ^= 56;
+    k1 ^= flip;
+    int k2 = sq[t->king2] ^ flip;
+    bool transpose = (k1 >> 3) > (k1 & 7) || ((k1 >> 3) == (k1 & 7) && (k2 >> 3) > (k2 & 7));
+    idx = fold_index(t, sq, flip, transpose);
+    if ((k1 >> 3) == (k1 & 7) && (k2 >> 3) == (k2 & 7)) {
+      uint64_t other = fold_index(t, sq, flip, true);
+      if (other < idx) idx = other;
+    }
+  }
+  return idx == TB_NO_INDEX ? idx : idx * 2 + (uint64_t)stm;
+}
+
+/* Index of b in t; mirror swaps colours and flips ranks (b has the weaker side as white). */
+static uint64_t encode(const TbTable* t, const Board* b, int mirror) {
+  u64 bbs[2][6];
+  int sq[TB_MAX_PIECES];
+  for (int c = 0; c < 2; c++) {
+    for (int k = 0; k < 6; k++) bbs[c][k] = piece_bb_of(b, c, k);
+  }
+  for (int s = 0; s < t->pieces; s++) {
+    u64* bb = &bbs[t->color[s] ^ mirror][t->kind[s]];
+    sq[s] = bb_pop_lsb(bb) ^ (mirror ? 56 : 0);
+  }
+  return index_of(t, sq, b->sideToMove ^ mirror);
+}
+
+/* Position of index i; false if impossible (overlap, the side not to move in
+ * check, or the transpose of a position with the kings on a1-h8 that has the
+ * smaller index). */
+static bool decode(const TbTable* t, uint64_t i, Board* b, int* sq) {
+  uint64_t index = i;
+  int stm = (int)(i & 1);
+  u64 occ = 0;
+  i >>= 1;
+  for (int g = t->groups - 1; g >= 0; g--) {
+    int first = t->group_start[g];
+    int base = t->kind[first] == KIND_P ? 8 : 0;
+    int c = base ? 48 : 64;
+    uint64_t rank = i % t->group_size[g];
+    i /= t->group_size[g];
+    for (int k = t->group_len[g]; k > 0; k--) {
+      c--;
+      while (binom(c, k) > rank) c--;
+      rank -= binom(c, k);
+      sq[first + k - 1] = c + base;
+    }
+  }
+  sq[0] = kp_squares[t->pawns][i][0];
+  sq[t->king2] = kp_squares[t->pawns][i][1];
+  if (!t->pawns && sq[0] % 9 == 0 && sq[t->king2] % 9 == 0 && index_of(t, sq, stm) != index) return false;
+  memset(b, 0, sizeof(*b));
+  for (int s = 0; s < t->pieces; s++) {
+    u64 bit = (u64)1 << sq[s];
+    if (occ & bit) return false;
+    occ |= bit;
+    *piece_bb(b, t->color[s], t->kind[s]) |= bit;
+  }
+  b->sideToMove = stm;
+  b->castling[0] = '\0';
+  b->enPassant = -1;
+  b->fullmove = 1;
+  return !board_square_attacked(b, bb_lsb(b->kings[stm ^ 1]), stm);
+}
+
+/* ---- table registry ---- */
+
+static TbTable* find_table(Tablebase* tb, const char* sig) {
+  int n = bc_atomic_load_int(&tb->count);
+  for (int i = 0; i < n; i++) {
+    if (strcmp(tb->tables[i]->signature, sig) == 0) return tb->tables[i];
+  }
+  return NULL;
+}
+
+static void table_free(TbTable* t) {
+  if (!t) return;
+#ifdef _WIN32
+  if (t->map) {
+    UnmapViewOfFile(t->map);
+    CloseHandle(t->mapping);
+    CloseHandle(t->file);
+  } else {
+    bc_aligned_free(t->words);
+  }
+#else
+  if (t->map) munmap(t->map, t->map_len);
+  else bc_aligned_free(t->words);
+#endif
+  bc_free(t);
+}
+
+static TbTable* table_new(const char* sig) {
+  TbTable* t = (TbTable*)bc_calloc(1, sizeof(TbTable));
+  if (!t) return NULL;
+  strcpy(t->signature, sig);
+  int side = 0;
+  for (const char* p = sig; *p; p++) {
+    if (*p == 'v') {
+      side = 1;
+      continue;
+    }
+    t->color[t->pieces] = side;
+    t->kind[t->pieces] = (int)(strchr(KIND_CHARS, *p) - KIND_CHARS);
+    t->pieces++;
+  }
+  for (int s = 0; s < t->pieces; s++) {
+    if (t->kind[s] == KIND_P) t->pawns = 1;
+    if (t->kind[s] == KIND_K) {
+      if (s > 0) t->king2 = s;
+    } else if (s > 0 && t->kind[s] == t->kind[s - 1] && t->color[s] == t->color[s - 1]) {
+      t->group_len[t->groups - 1]++;
+    } else {
+      t->group_start[t->groups] = s;
+      t->group_len[t->groups++] = 1;
+    }
+  }
+  t->entries = 2 * (uint64_t)kp_count[t->pawns];
+  for (int g = 0; g < t->groups; g++) {
+    t->group_size[g] = binom(t->kind[t->group_start[g]] == KIND_P ? 48 : 64, t->group_len[g]);
+    t->entries *= t->group_size[g];
+  }
+  return t;
+}
+
+static void table_path(const Tablebase* tb, const char* sig, char* out) {
+  snprintf(out, TB_FILE_MAX, "%s/%s.bbtb", tb->dir, sig);
+}
+
+static size_t table_bytes(const TbTable* t) {
+  return (size_t)((t->entries + 31) / 32) * sizeof(uint64_t);
+}
+
+/* Map a table file; NULL if missing or not a table for sig. */
+static TbTable* table_load(const Tablebase* tb, const char* sig) {
+  char path[TB_FILE_MAX];
+  TbFileHeader h;
+  char want[TB_SIG_MAX] = {0};
+  if (!tb->dir[0]) return NULL;
+  table_path(tb, sig, path);
+  TbTable* t = table_new(sig);
+  if (!t) return NULL;
+  size_t len = sizeof(TbFileHeader) + table_bytes(t);
+#ifdef _WIN32
+  t->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (t->file == INVALID_HANDLE_VALUE) goto fail;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(t->file, &size) || (uint64_t)size.QuadPart != (uint64_t)len) goto fail_file;
+  t->mapping = CreateFileMappingA(t->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!t->mapping) goto fail_file;
+  t->map = MapViewOfFile(t->mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!t->map) {
+    CloseHandle(t->mapping);
+    goto fail_file;
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0) goto fail;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size != (uint64_t)len) {
+    close(fd);
+    goto fail;
+  }
+  t->map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (t->map == MAP_FAILED) {
+    t->map = NULL;
+    goto fail;
+  }
+#endif
+  t->map_len = len;
+  memcpy(&h, t->map, sizeof(h));
+  /* The file's signature field need not be terminated: compare all of it. */
+  memcpy(want, sig, strlen(sig));
+  if (memcmp(h.magic, "BBTB", 4) != 0 || h.version != 2 || memcmp(h.signature, want, TB_SIG_MAX) != 0 ||
+      h.entries != t->entries) {
+    table_free(t);
+    return NULL;
+  }
+  t->words = (uint64_t*)((char*)t->map + sizeof(TbFileHeader));
+  return t;
+#ifdef _WIN32
+fail_file:
+  CloseHandle(t->file);
+#endif
+fail:
+  t->map = NULL;
+  bc_free(t);
+  return NULL;
+}
+
+static bool table_write(const Tablebase* tb, const TbTable* t) {
+  char path[TB_FILE_MAX];
+  char tmp[TB_FILE_MAX + 8];
+  TbFileHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, "BBTB", 4);
+  h.version = 2;
+  strcpy(h.signature, t->signature);
+  h.entries = t->entries;
+  h.pieces = (uint32_t)t->pieces;
+  table_path(tb, t->signature, path);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE* f = fopen(tmp, "wb");
+  if (!f) return false;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(t->words, 1, table_bytes(t), f) == table_bytes(t);
+  ok = (fclose(f) == 0) && ok;
+  /* Readers only ever see complete files. */
+  if (ok) {
+    remove(path);
+    ok = rename(tmp, path) == 0;
+  }
+  if (!ok) remove(tmp);
+  return ok;
+}
+
+static void publish(Tablebase* tb, TbTable* t) {
+  int n = tb->count;
+  tb->tables[n] = t;
+  bc_atomic_store_int(&tb->count, n + 1);
+}
+
+/* Table for a canonical signature: in memory, else mapped from dir. */
+static TbTable* get_table(Tablebase* tb, const char* sig) {
+  TbTable* t = find_table(tb, sig);
+  if (t) return t;
+  bc_mutex_lock(&tb->lock);
+  t = find_table(tb, sig);
+  if (!t && tb->count < TB_MAX_TABLES) {
+    t = table_load(tb, sig);
+    if (t) publish(tb, t);
+  }
+  bc_mutex_unlock(&tb->lock);
+  return t;
+}
+
+Tablebase* tb_create(const char* dir) {
+  Tablebase* tb = (Tablebase*)bc_calloc(1, sizeof(Tablebase));
+  if (!tb) return NULL;
+  if (dir) snprintf(tb->dir, sizeof(tb->dir), "%s", dir);
+  bc_mutex_init(&tb->lock);
+  board_init_tables();
+  init_king_pairs();
+  return tb;
+}
+
+void tb_destroy(Tablebase* tb) {
+  if (!tb) return;
+  for (int i = 0; i < tb->count; i++) table_free(tb->tables[i]);
+  bc_mutex_destroy(&tb->lock);
+  bc_free(tb);
+}
+
+/* ---- probing ---- */
+
+/* WDL of b ignoring en passant and castling. */
+static int probe_raw(Tablebase* tb, const Board* b) {
+  int counts[2][6];
+  char sig[TB_SIG_MAX];
+  int pieces = bb_popcount(occupancy(b));
+  if (pieces == 2) return TB_DRAW;
+  if (pieces > TB_MAX_PIECES) return TB_UNKNOWN;
+  board_counts(b, counts);
+  int mirror = format_signature(counts, sig);
+  TbTable* t = get_table(tb, sig);
+  if (!t) return TB_UNKNOWN;
+  uint64_t i = encode(t, b, mirror);
+  if (i == TB_NO_INDEX) return TB_UNKNOWN; /* touching kings */
+  switch (entry_get(t, i)) {
+    case E_WIN: return TB_WIN;
+    case E_LOSS: return TB_LOSS;
+    case E_DRAW: return TB_DRAW;
+    default: return TB_UNKNOWN;
+  }
+}
+
+int tb_probe_wdl(Tablebase* tb, const Board* b) {
+  if (b->castling[0]) return TB_UNKNOWN;
+  if (b->enPassant < 0) return probe_raw(tb, b);
+  /* The tables hold no en passant rights: search one ply instead. */
+  Move moves[BOARD_MAX_MOVES];
+  int n = board_generate_moves(b, moves);
+  if (n == 0) return board_in_check(b) ? TB_LOSS : TB_DRAW;
+  int best = TB_LOSS;
+  for (int i = 0; i < n; i++) {
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    int v = tb_probe_wdl(tb, &child);
+    if (v == TB_UNKNOWN) return TB_UNKNOWN;
+    if (-v > best) best = -v;
+  }
+  return best;
+}
+
+/* ---- generation ---- */
+
+#define PHASE_INIT 0
+#define PHASE_UNMOVE 1
+#define PHASE_EVAL 2
+
+typedef struct {
+  Tablebase* tb;
+  TbTable* t;
+  uint64_t* cand;     /* bit per index: predecessor of a newly resolved position */
+  uint64_t* frontier; /* bit per index: resolved in the last pass */
+  int phase;
+  uint64_t resolved;
+} GenJob;
+
+typedef struct {
+  GenJob* job;
+  uint64_t lo;
+  uint64_t hi;
+} GenTask;
+
+/* Value of b, a position of the table being generated that has an en passant
+ * square: the entry of b without it covers the other moves, the en passant
+ * captures lead to a smaller table. */
+static int ep_eval(GenJob* job, const Board* b) {
+  Move moves[BOARD_MAX_MOVES];
+  int n = board_generate_moves(b, moves);
+  int others = 0;
+  bool all_win = true;
+  for (int i = 0; i < n; i++) {
+    if (!moves[i].enpassant) {
+      others++;
+      continue;
+    }
+    Board child = *b;
+    board_make_move(&child, &moves[i]);
+    int w = probe_raw(job->tb, &child);
+    if (w == TB_LOSS) return E_WIN;
+    if (w != TB_WIN) all_win = false;
+  }
+  if (others == 0) return all_win ? E_LOSS : E_DRAW; /* the entry would be a mate or stalemate */
+  int v = entry_get(job->t, encode(job->t, b, 0));
+  if (others == n || v != E_LOSS) return v;
+  return all_win ? E_LOSS : E_DRAW;
+}
+
+/* E_WIN / E_LOSS if the legal moves decide b, else E_DRAW. */
+static int forward_eval(GenJob* job, const Board* b) {
+  Move moves[BOARD_MAX_MOVES];
+  int n = board_generate_moves(b, moves);
+  if (n == 0) return board_in_check(b) ? E_LOSS : E_DRAW;
+  int pieces = job->t->pieces;
+  bool all_win = true;
+  for (int i = 0; i < n; i++) {
+    Board child = *b;
+    int v;
+    board_make_move(&child, &moves[i]);
+    if (!moves[i].promotion && bb_popcount(occupancy(&child)) == pieces) {
+      v = child.enPassant >= 0 ? ep_eval(job, &child) : entry_get(job->t, encode(job->t, &child, 0));
+    } else {
+      int w = probe_raw(job->tb, &child);
+      v = w == TB_WIN ? E_WIN : w == TB_LOSS ? E_LOSS : E_DRAW;
+    }
+    if (v == E_LOSS) return E_WIN;
+    if (v != E_WIN) all_win = false;
+  }
+  return all_win ? E_LOSS : E_DRAW;
+}
+
+/* Mark the predecessors of position (b, sq) in cand. */
+static void mark_unmoves(GenJob* job, const Board* b, const int* sq) {
+  const TbTable* t = job->t;
+  int mover = b->sideToMove ^ 1;
+  u64 occ = occupancy(b);
+  int from_sq[TB_MAX_PIECES];
+  memcpy(from_sq, sq, sizeof(int) * (size_t)t->pieces);
+  for (int s = 0; s < t->pieces; s++) {
+    if (t->color[s] != mover) continue;
+    int to = sq[s];
+    u64 from;
+    switch (t->kind[s]) {
+      case 0: from = board_king_attacks(to); break;
+      case 1: from = board_rook_attacks(to, occ) | board_bishop_attacks(to, occ); break;
+      case 2: from = board_rook_attacks(to, occ); break;
+      case 3: from = board_bishop_attacks(to, occ); break;
+      case 4: from = board_knight_attacks(to); break;
+      default: {
+        int dir = mover == WHITE ? -8 : 8;
+        int one = to + dir;
+        int home_rank = mover == WHITE ? 1 : 6;
+        from = 0;
+        if (one >= 8 && one < 56 && !(occ & ((u64)1 << one))) {
+          from |= (u64)1 << one;
+          int two = one + dir;
+          if (two / 8 == home_rank && !(occ & ((u64)1 << two))) from |= (u64)1 << two;
+        }
+        break;
+      }
+    }
+    from &= ~occ;
+    while (from) {
+      from_sq[s] = bb_pop_lsb(&from);
+      uint64_t j = index_of(t, from_sq, mover);
+      if (j == TB_NO_INDEX) continue;
+      bc_atomic_or_u64(&job->cand[j >> 6], (uint64_t)1 << (j & 63));
+    }
+    from_sq[s] = to;
+  }
+}
+
+static void gen_task(void* arg, int worker) {
+  GenTask* task = (GenTask*)arg;
+  GenJob* job = task->job;
+  TbTable* t = job->t;
+  uint64_t resolved = 0;
+  Board b;
+  int sq[TB_MAX_PIECES];
+  (void)worker;
+  if (job->phase == PHASE_INIT) {
+    for (uint64_t i = task->lo; i < task->hi; i++) {
+      if (!decode(t, i, &b, sq)) {
+        entry_set(t, i, E_INVALID);
+        continue;
+      }
+      int v = forward_eval(job, &b);
+      if (v != E_DRAW) {
+        entry_set(t, i, v);
+        job->frontier[i >> 6] |= (uint64_t)1 << (i & 63);
+        resolved++;
+      }
+    }
+  } else if (job->phase == PHASE_UNMOVE) {
+    for (uint64_t w = task->lo >> 6; w < task->hi >> 6; w++) {
+      uint64_t bits = job->frontier[w];
+      job->frontier[w] = 0;
+      while (bits) {
+        uint64_t i = (w << 6) | (uint64_t)bb_pop_lsb(&bits);
+        if (decode(t, i, &b, sq)) mark_unmoves(job, &b, sq);
+      }
+    }
+  } else {
+    for (uint64_t w = task->lo >> 6; w < task->hi >> 6; w++) {
+      uint64_t bits = job->cand[w];
+      job->cand[w] = 0;
+      while (bits) {
+        uint64_t i = (w << 6) | (uint64_t)bb_pop_lsb(&bits);
+        if (entry_get(t, i) != E_DRAW || !decode(t, i, &b, sq)) continue;
+        int v = forward_eval(job, &b);
+        if (v != E_DRAW) {
+          entry_set(t, i, v);
+          job->frontier[w] |= (uint64_t)1 << (i & 63);
+          resolved++;
+        }
+      }
+    }
+  }
+  if (resolved) bc_atomic_add_u64(&job->resolved, resolved);
+}
+
+static void run_phase(GenJob* job, Pool* pool, GenTask* tasks, int ntasks, int phase) {
+  job->phase = phase;
+  for (int i = 0; i < ntasks; i++) {
+    if (pool && pool_submit(pool, -1, gen_task, &tasks[i])) continue;
+    gen_task(&tasks[i], -1);
+  }
+  if (pool) pool_wait(pool);
+}
+
+static bool generate_table(Tablebase* tb, TbTable* t, int threads) {
+  size_t bitmap_words = (size_t)(t->entries / 64) + 1;
+  GenJob job;
+  memset(&job, 0, sizeof(job));
+  job.tb = tb;
+  job.t = t;
+  t->words = (uint64_t*)bc_aligned_calloc(BC_CACHE_LINE, table_bytes(t) / sizeof(uint64_t), sizeof(uint64_t));
+  job.cand = (uint64_t*)bc_aligned_calloc(BC_CACHE_LINE, bitmap_words, sizeof(uint64_t));
+  job.frontier = (uint64_t*)bc_aligned_calloc(BC_CACHE_LINE, bitmap_words, sizeof(uint64_t));
+  if (threads <= 0) threads = bc_cpu_count();
+  int ntasks = threads == 1 ? 1 : threads * TB_TASKS_PER_THREAD;
+  uint64_t slice = ((t->entries / (uint64_t)ntasks) + 63) & ~(uint64_t)63;
+  if (slice < 64) slice = 64;
+  ntasks = (int)((t->entries + slice - 1) / slice);
+  GenTask* tasks = (GenTask*)bc_calloc((size_t)ntasks, sizeof(GenTask));
+  if (!t->words || !job.cand || !job.frontier || !tasks) {
+    bc_aligned_free(job.cand);
+    bc_aligned_free(job.frontier);
+    bc_free(tasks);
+    return false;
+  }
+  for (int i = 0; i < ntasks; i++) {
+    tasks[i].job = &job;
+    tasks[i].lo = (uint64_t)i * slice;
+    tasks[i].hi = tasks[i].lo + slice < t->entries ? tasks[i].lo + slice : t->entries;
+  }
+  Pool* pool = threads != 1 ? pool_create(threads) : NULL;
+  run_phase(&job, pool, tasks, ntasks, PHASE_INIT);
+  while (bc_atomic_load_u64(&job.resolved) > 0) {
+    job.resolved = 0;
+    run_phase(&job, pool, tasks, ntasks, PHASE_UNMOVE);
+    run_phase(&job, pool, tasks, ntasks, PHASE_EVAL);
+  }
+  if (pool) pool_destroy(pool);
+  bc_aligned_free(job.cand);
+  bc_aligned_free(job.frontier);
+  bc_free(tasks);
+  return true;
+}
+
+bool tb_generate(Tablebase* tb, const char* signature, int threads) {
+  int counts[2][6];
+  char sig[TB_SIG_MAX];
+  if (!parse_signature(signature, counts)) return false;
+  format_signature(counts, sig);
+  if (get_table(tb, sig)) return true;
+
+  /* Tables reached by a capture or a promotion come first. */
+  for (int c = 0; c < 2; c++) {
+    for (int k = 1; k < 6; k++) {
+      if (!counts[c][k]) continue;
+      int sub[2][6];
+      char sub_sig[TB_SIG_MAX];
+      memcpy(sub, counts, sizeof(sub));
+      sub[c][k]--;
+      if (sub[0][1] + sub[0][2] + sub[0][3] + sub[0][4] + sub[0][5] +
+          sub[1][1] + sub[1][2] + sub[1][3] + sub[1][4] + sub[1][5] > 0) {
+        format_signature(sub, sub_sig);
+        if (!tb_generate(tb, sub_sig, threads)) return false;
+      }
+      if (k != KIND_P) continue;
+      for (int promo = 1; promo < KIND_P; promo++) {
+        sub[c][promo]++;
+        format_signature(sub, sub_sig);
+        if (!tb_generate(tb, sub_sig, threads)) return false;
+        sub[c][promo]--;
+      }
+    }
+  }
+
+  TbTable* t = table_new(sig);
+  if (!t) return false;
+  if (!generate_table(tb, t, threads) || (tb->dir[0] && !table_write(tb, t))) {
+    table_free(t);
+    return false;
+  }
+  bc_mutex_lock(&tb->lock);
+  bool ok = tb->count < TB_MAX_TABLES;
+  if (ok) publish(tb, t);
+  bc_mutex_unlock(&tb->lock);
+  if (!ok) table_free(t);
+  return ok;
+}
@@ -0,0 +1,52 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bitboard_chess.h"
+
+/* Win/draw/loss endgame tables for up to TB_MAX_PIECES pieces, generated by
+ * retrograde analysis on Board and stored as 2 bits per position.
+ *
+ * A table covers one material signature ("KQvKR": the stronger side first,
+ * pieces in K Q R B N P order). Positions are indexed up to symmetry: the two
+ * kings as one of 462 pairs with the first king in the a1-d1-d4 triangle (1806
+ * with it on files a-d when there are pawns, which only allow the left-right
+ * mirror), then each set of identical pieces by its rank among the square sets
+ * it can take, then the side to move: a pawnless n-piece table has at most
+ * 2 * 462 * 64^(n-2) entries (60 MB at five pieces). Positions with the sides
+ * swapped are probed through the colour-flipped table. Castling
+ * rights are not covered; en passant replies to a double push are searched
+ * during generation, and an en passant square is resolved by one ply of
+ * search on probing. Tables are written as "<dir>/<signature>.bbtb" and
+ * memory-mapped when loaded. */
+
+#define TB_MAX_PIECES 5
+
+/* tb_probe_wdl results, for the side to move */
+#define TB_LOSS -1
+#define TB_DRAW 0
+#define TB_WIN 1
+#define TB_UNKNOWN -2 /* too many pieces, castling rights, or table not available */
+
+typedef struct Tablebase Tablebase;
+
+/* dir holds the table files (read and written); NULL keeps tables in memory only. */
+Tablebase* tb_create(const char* dir);
+void tb_destroy(Tablebase* tb);
+
+/* Generate the table for signature (and, first, every table its captures and
+ * promotions lead to), loading instead of generating where a file exists.
+ * threads <= 0 uses one per CPU. Returns false on a bad signature, allocation
+ * or write failure. */
+bool tb_generate(Tablebase* tb, const char* signature, int threads);
+
+/* WDL of b for the side to move, loading tables from dir on first use.
+ * Safe to call from several threads. */
+int tb_probe_wdl(Tablebase* tb, const Board* b);
+
+/* Canonical material signature of b into out (>= 16 bytes); returns its
+ * length, or 0 when b has more than TB_MAX_PIECES pieces. */
+int tb_signature(const Board* b, char* out);
+
+#endif
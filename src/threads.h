@@ -0,0 +1,129 @@
+/* Minimal thread, lock and atomic wrappers (pthreads or Win32). Header-only. */
+
+#ifndef THREADS_H
+#define THREADS_H
+
+#include "alloc.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+
+typedef HANDLE bc_thread;
+typedef CRITICAL_SECTION bc_mutex;
+typedef CONDITION_VARIABLE bc_cond;
+
+typedef struct {
+  void (*fn)(void*);
+  void* arg;
+} bc_thread_start;
+
+static unsigned __stdcall bc_thread_trampoline(void* p) {
+  bc_thread_start s = *(bc_thread_start*)p;
+  bc_free(p);
+  s.fn(s.arg);
+  return 0;
+}
+
+static __inline int bc_thread_create(bc_thread* t, void (*fn)(void*), void* arg) {
+  bc_thread_start* s = (bc_thread_start*)bc_malloc(sizeof(bc_thread_start));
+  if (!s) return -1;
+  s->fn = fn;
+  s->arg = arg;
+  *t = (HANDLE)_beginthreadex(NULL, 0, bc_thread_trampoline, s, 0, NULL);
+  if (!*t) { bc_free(s); return -1; }
+  return 0;
+}
+static __inline void bc_thread_join(bc_thread t) { WaitForSingleObject(t, INFINITE); CloseHandle(t); }
+static __inline void bc_mutex_init(bc_mutex* m) { InitializeCriticalSection(m); }
+static __inline void bc_mutex_destroy(bc_mutex* m) { DeleteCriticalSection(m); }
+static __inline void bc_mutex_lock(bc_mutex* m) { EnterCriticalSection(m); }
+static __inline void bc_mutex_unlock(bc_mutex* m) { LeaveCriticalSection(m); }
+static __inline void bc_cond_init(bc_cond* c) { InitializeConditionVariable(c); }
+static __inline void bc_cond_destroy(bc_cond* c) { (void)c; }
+static __inline void bc_cond_wait(bc_cond* c, bc_mutex* m) { SleepConditionVariableCS(c, m, INFINITE); }
+static __inline void bc_cond_signal(bc_cond* c) { WakeConditionVariable(c); }
+static __inline void bc_cond_broadcast(bc_cond* c) { WakeAllConditionVariable(c); }
+/* Monotonic milliseconds. */
+static __inline double bc_now_ms(void) {
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+}
+
+static __inline int bc_cpu_count(void) {
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  return (int)si.dwNumberOfProcessors;
+}
+
+#define bc_atomic_load_u64(p) ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)(p), 0, 0))
+#define bc_atomic_store_u64(p, v) ((void)InterlockedExchange64((volatile LONG64*)(p), (LONG64)(v)))
+#define bc_atomic_add_u64(p, v) ((uint64_t)InterlockedExchangeAdd64((volatile LONG64*)(p), (LONG64)(v)))
+#define bc_atomic_or_u64(p, v) ((uint64_t)InterlockedOr64((volatile LONG64*)(p), (LONG64)(v)))
+#define bc_atomic_load_int(p) ((int)InterlockedCompareExchange((volatile LONG*)(p), 0, 0))
+#define bc_atomic_store_int(p, v) ((void)InterlockedExchange((volatile LONG*)(p), (LONG)(v)))
+#define bc_atomic_add_int(p, v) ((int)InterlockedExchangeAdd((volatile LONG*)(p), (LONG)(v)))
+
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef pthread_t bc_thread;
+typedef pthread_mutex_t bc_mutex;
+typedef pthread_cond_t bc_cond;
+
+typedef struct {
+  void (*fn)(void*);
+  void* arg;
+} bc_thread_start;
+
+static void* bc_thread_trampoline(void* p) {
+  bc_thread_start s = *(bc_thread_start*)p;
+  bc_free(p);
+  s.fn(s.arg);
+  return NULL;
+}
+
+static inline int bc_thread_create(bc_thread* t, void (*fn)(void*), void* arg) {
+  bc_thread_start* s = (bc_thread_start*)bc_malloc(sizeof(bc_thread_start));
+  if (!s) return -1;
+  s->fn = fn;
+  s->arg = arg;
+  if (pthread_create(t, NULL, bc_thread_trampoline, s) != 0) { bc_free(s); return -1; }
+  return 0;
+}
+static inline void bc_thread_join(bc_thread t) { pthread_join(t, NULL); }
+static inline void bc_mutex_init(bc_mutex* m) { pthread_mutex_init(m, NULL); }
+static inline void bc_mutex_destroy(bc_mutex* m) { pthread_mutex_destroy(m); }
+static inline void bc_mutex_lock(bc_mutex* m) { pthread_mutex_lock(m); }
+static inline void bc_mutex_unlock(bc_mutex* m) { pthread_mutex_unlock(m); }
+static inline void bc_cond_init(bc_cond* c) { pthread_cond_init(c, NULL); }
+static inline void bc_cond_destroy(bc_cond* c) { pthread_cond_destroy(c); }
+static inline void bc_cond_wait(bc_cond* c, bc_mutex* m) { pthread_cond_wait(c, m); }
+static inline void bc_cond_signal(bc_cond* c) { pthread_cond_signal(c); }
+static inline void bc_cond_broadcast(bc_cond* c) { pthread_cond_broadcast(c); }
+static inline double bc_now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+static inline int bc_cpu_count(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+}
+
+#define bc_atomic_load_u64(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define bc_atomic_store_u64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define bc_atomic_add_u64(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#define bc_atomic_or_u64(p, v) __atomic_fetch_or((p), (v), __ATOMIC_RELAXED)
+#define bc_atomic_load_int(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define bc_atomic_store_int(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define bc_atomic_add_int(p, v) __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#endif
+
+#endif
@@ -89,6 +89,21 @@ describe('BitboardChess vs chess.js', function () {
     );
   });
 
+  it('castling right after a double pawn push clears the en passant square', function () {
+    assertSamePosition(
+      ['e4', 'e5', 'Nf3', 'Nc6', 'Bc4', 'd5', 'O-O'],
+      'O-O after ...d5'
+    );
+  });
+
+  it('a king move clears both castling rights', function () {
+    assertSamePosition(['e4', 'e5', 'Ke2', 'Ke7'], 'Ke2 Ke7 leave no castling rights');
+  });
+
+  it('capturing a rook on its home square clears that castling right', function () {
+    assertSamePosition(['g3', 'b6', 'Bg2', 'e6', 'Bxa8'], 'Bxa8 removes q');
+  });
+
   it('en passant', function () {
     // d4 f5 e4 fxe4 d5 e5 then dxe6 (en passant: d5 pawn captures e5 and lands on e6)
     assertSamePosition(
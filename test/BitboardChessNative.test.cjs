@@ -7,10 +7,42 @@ const { describe, it, before, afterEach } = require('node:test');
 const { expect } = require('chai');
 const Chess = require('chess.js').Chess;
 
-let BitboardChessNative, SQUARES, squareNameToIndex, squareToBitboard, squareNameToBitboard, getFileMask, getRankMask;
+let BitboardChessNative, MOTIF, SimilarityIndex, MinHashIndex, minhashSign, MINHASH_SIZE, PositionStore, PositionStoreWriter, PositionDictionary, PositionDictionaryWriter, CollisionAudit, checkFEN, checkFENs, FEN_STATUS, getEvalTables, setEvalTables, Tablebase, WDL, solveMates, MATE_STATUS, replayPGN, replayNDJSON, replayNDJSONFile, NDJSONReader, replayPuzzles, groupPGN, replayPGNAsync, groupPGNAsync, createReplayStream, decodeRecordBatch, REPLAY_STATUS, GAME_END, RESULT_MISMATCH, SQUARES, squareNameToIndex, squareToBitboard, squareNameToBitboard, getFileMask, getRankMask;
 try {
   const nativeModule = require('../index-native.cjs');
   BitboardChessNative = nativeModule.BitboardChessNative;
+  MOTIF = nativeModule.MOTIF;
+  replayPGN = nativeModule.replayPGN;
+  replayNDJSON = nativeModule.replayNDJSON;
+  replayNDJSONFile = nativeModule.replayNDJSONFile;
+  NDJSONReader = nativeModule.NDJSONReader;
+  replayPuzzles = nativeModule.replayPuzzles;
+  groupPGN = nativeModule.groupPGN;
+  replayPGNAsync = nativeModule.replayPGNAsync;
+  groupPGNAsync = nativeModule.groupPGNAsync;
+  createReplayStream = nativeModule.createReplayStream;
+  decodeRecordBatch = nativeModule.decodeRecordBatch;
+  Tablebase = nativeModule.Tablebase;
+  SimilarityIndex = nativeModule.SimilarityIndex;
+  MinHashIndex = nativeModule.MinHashIndex;
+  minhashSign = nativeModule.minhashSign;
+  MINHASH_SIZE = nativeModule.MINHASH_SIZE;
+  PositionStore = nativeModule.PositionStore;
+  PositionStoreWriter = nativeModule.PositionStoreWriter;
+  PositionDictionary = nativeModule.PositionDictionary;
+  PositionDictionaryWriter = nativeModule.PositionDictionaryWriter;
+  CollisionAudit = nativeModule.CollisionAudit;
+  getEvalTables = nativeModule.getEvalTables;
+  checkFEN = nativeModule.checkFEN;
+  checkFENs = nativeModule.checkFENs;
+  FEN_STATUS = nativeModule.FEN_STATUS;
+  setEvalTables = nativeModule.setEvalTables;
+  solveMates = nativeModule.solveMates;
+  MATE_STATUS = nativeModule.MATE_STATUS;
+  WDL = nativeModule.WDL;
+  REPLAY_STATUS = nativeModule.REPLAY_STATUS;
+  GAME_END = nativeModule.GAME_END;
+  RESULT_MISMATCH = nativeModule.RESULT_MISMATCH;
   SQUARES = nativeModule.SQUARES;
   squareNameToIndex = nativeModule.squareNameToIndex;
   squareToBitboard = nativeModule.squareToBitboard;
@@ -74,6 +106,13 @@ function runNativeTests() {
       );
     });
 
+    it('castling right after a double pawn push clears the en passant square', function () {
+      assertSamePosition(
+        ['e4', 'e5', 'Nf3', 'Nc6', 'Bc4', 'd5', 'O-O'],
+        'O-O after ...d5'
+      );
+    });
+
     it('en passant', function () {
       assertSamePosition(
         ['d4', 'f5', 'e4', 'fxe4', 'd5', 'e5', 'dxe6'],
@@ -285,6 +324,32 @@ function runNativeTests() {
           b.destroy();
         }
       });
+
+      it('renders the same FENs through the rank cache, re-rendering only changed ranks', function () {
+        const full = new BitboardChessNative();
+        const cached = new BitboardChessNative();
+        try {
+          cached.setFENCache();
+          expect(cached.toFEN()).to.equal(full.toFEN());
+          expect(cached.fenCacheRendered()).to.equal(8);
+          const sans = ['e4', 'd5', 'exd5', 'Qxd5', 'Nc3', 'Qa5', 'd4', 'Nf6', 'Bd2', 'Bf5', 'Qe2', 'e6', 'O-O-O'];
+          for (const san of sans) {
+            full.makeMoveSAN(san);
+            cached.makeMoveSAN(san);
+            expect(cached.toFEN()).to.equal(full.toFEN());
+          }
+          expect(cached.fenCacheRendered()).to.be.lessThan(8 + 3 * sans.length);
+          const fen = '8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1';
+          full.loadFromFEN(fen);
+          cached.loadFromFEN(fen);
+          expect(cached.toFEN()).to.equal(fen);
+          cached.setFENCache(false);
+          expect(cached.fenCacheRendered()).to.equal(0);
+        } finally {
+          full.destroy();
+          cached.destroy();
+        }
+      });
     });
 
     describe('reset', function () {
@@ -345,6 +410,1199 @@ function runNativeTests() {
       });
     });
 
+    describe('perft', function () {
+      // Standard perft positions (chessprogramming.org) with known node counts.
+      const POSITIONS = [
+        ['rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1', [20, 400, 8902, 197281]],
+        ['r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1', [48, 2039, 97862]],
+        ['8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1', [14, 191, 2812, 43238]],
+        ['r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1', [6, 264, 9467]],
+        ['rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8', [44, 1486, 62379]],
+        ['r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10', [46, 2079, 89890]],
+      ];
+
+      it('matches known node counts for the standard positions', function () {
+        const b = new BitboardChessNative();
+        try {
+          for (const [fen, counts] of POSITIONS) {
+            b.loadFromFEN(fen);
+            counts.forEach((expected, i) => {
+              expect(b.perft(i + 1, 1, 0), `${fen} depth ${i + 1}`).to.equal(expected);
+            });
+          }
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('gives the same counts with several threads and a shared hash', function () {
+        const b = new BitboardChessNative();
+        try {
+          for (const [fen, counts] of POSITIONS) {
+            b.loadFromFEN(fen);
+            const depth = counts.length;
+            expect(b.perft(depth, 4, 4), fen).to.equal(counts[depth - 1]);
+          }
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('tracks castling rights through king moves and rook captures at depth', function () {
+        // Both counts were inflated while a king move kept its rights or a captured rook kept its side's.
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN('r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1');
+          expect(b.perft(4, 1, 16)).to.equal(4085603);
+          b.loadFromFEN('r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1');
+          expect(b.perft(5, 1, 16)).to.equal(7594526);
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('perftDivide returns per-root-move counts summing to perft', function () {
+        const b = new BitboardChessNative();
+        try {
+          const divide = b.perftDivide(3, 2);
+          expect(Object.keys(divide)).to.have.length(20);
+          expect(divide.e2e4).to.equal(600);
+          expect(divide.g1f3).to.equal(440);
+          expect(Object.values(divide).reduce((a, n) => a + n, 0)).to.equal(8902);
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('perft(0) is 1 and does not change the board', function () {
+        const b = new BitboardChessNative();
+        try {
+          const fen = b.toFEN();
+          expect(b.perft(0)).to.equal(1);
+          b.perft(3, 2);
+          expect(b.toFEN()).to.equal(fen);
+        } finally {
+          b.destroy();
+        }
+      });
+    });
+
+    describe('search', function () {
+      function searchFEN(fen, options) {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN(fen);
+          return b.search(options);
+        } finally {
+          b.destroy();
+        }
+      }
+
+      it('finds mates and reports them as moves to mate', function () {
+        const mate1 = searchFEN('r1bqkbnr/pppp1ppp/2n5/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 2 3', { depth: 3 });
+        expect(mate1.best).to.equal('h5f7');
+        expect(mate1.mate).to.equal(1);
+        const mate4 = searchFEN('2k5/8/8/8/8/8/8/1R1R2K1 w - - 0 1', { depth: 8 });
+        expect(mate4.mate).to.equal(4);
+        expect(mate4.pv).to.have.length(7);
+        const mated = searchFEN('k7/8/1K6/8/8/8/8/7R b - - 0 1', { depth: 4 });
+        expect(mated.mate).to.equal(-1);
+        expect(searchFEN('7k/5Q2/6K1/8/8/8/8/8 b - - 0 1').best).to.equal(null); // stalemate
+      });
+
+      it('wins hanging material and stops at node and time limits, on one or several threads', function () {
+        const fen = 'rnb1kbnr/pppp1ppp/8/4p1q1/3P4/2N5/PPP1PPPP/R1BQKBNR w KQkq - 0 1';
+        expect(searchFEN(fen, { depth: 4 }).best).to.equal('c1g5');
+        for (const threads of [1, 3]) {
+          const byNodes = searchFEN(fen, { nodes: 20000, threads });
+          expect(byNodes.best).to.equal('c1g5');
+          expect(byNodes.nodes).to.be.lessThan(20000 + 1024 * threads * 2);
+          const byTime = searchFEN('r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1', { ms: 100, threads });
+          expect(byTime.depth).to.be.greaterThan(0);
+          expect(byTime.ms).to.be.lessThan(1000);
+        }
+      });
+
+      it('evaluate() is symmetric and counts material', function () {
+        const b = new BitboardChessNative();
+        try {
+          expect(b.evaluate()).to.equal(0);
+          b.loadFromFEN('rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNB1KBNR w KQkq - 0 1');
+          const down = b.evaluate();
+          expect(down).to.be.lessThan(-800);
+          b.loadFromFEN('rnb1kbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1');
+          expect(b.evaluate()).to.equal(down);
+        } finally {
+          b.destroy();
+        }
+      });
+    });
+
+    describe('incremental evaluation', function () {
+      function evalOfFEN(fen) {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN(fen);
+          return b.getEval();
+        } finally {
+          b.destroy();
+        }
+      }
+
+      it('matches a fresh load after castling, en passant, captures and promotions', function () {
+        const b = new BitboardChessNative();
+        try {
+          const start = b.getEval();
+          expect(start).to.deep.equal({ mg: 0, eg: 0, phase: 24, score: 0 });
+          const sans = ['e4', 'd5', 'e5', 'f5', 'exf6', 'Nc6', 'fxg7', 'Be6', 'gxh8=Q', 'Qd7', 'Nf3', 'O-O-O', 'Bc4', 'dxc4', 'O-O'];
+          for (const san of sans) {
+            expect(b.makeMoveSAN(san)).to.equal(true);
+            expect(b.getEval()).to.deep.equal(evalOfFEN(b.toFEN()));
+          }
+          expect(b.getEval().phase).to.equal(25); // an extra queen, a bishop lost
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('tapers towards the endgame tables and accepts tables at runtime', function () {
+        const endgame = evalOfFEN('8/8/8/4k3/8/8/8/K7 w - - 0 1');
+        expect(endgame.phase).to.equal(0);
+        expect(endgame.score).to.equal(endgame.eg);
+        expect(endgame.score).to.be.lessThan(0); // centralised black king
+        try {
+          const tables = getEvalTables();
+          expect(tables.mgPst).to.have.length(6);
+          tables.egPst[5] = new Array(64).fill(0);
+          setEvalTables({ egPst: tables.egPst, egValue: [100, 300, 300, 500, 900, 0] });
+          expect(evalOfFEN('8/8/8/4k3/8/8/8/K7 w - - 0 1').score).to.equal(0);
+          expect(evalOfFEN('8/8/8/4k3/8/8/8/KN6 w - - 0 1').eg).to.equal(300 + getEvalTables().egPst[1][1]);
+          expect(() => setEvalTables({ mgValue: [1, 2] })).to.throw(TypeError);
+        } finally {
+          setEvalTables(null);
+        }
+        expect(evalOfFEN('8/8/8/4k3/8/8/8/K7 w - - 0 1')).to.deep.equal(endgame);
+      });
+
+      it('replayPGN({ evals }) returns the score after every ply', function () {
+        const res = replayPGN('1. e4 e5 2. Qh5 Nc6 3. Bc4 Nf6 4. Qxf7# 1-0\n', { evals: true });
+        expect(res.evals).to.be.instanceOf(Int16Array);
+        expect(res.evals).to.have.length(res.keys.length);
+        expect(res.evals[6]).to.equal(evalOfFEN('r1bqkb1r/pppp1Qpp/2n2n2/4p3/2B1P3/8/PPPP1PPP/RNB1K1NR b KQkq - 0 4').score);
+        expect(replayPGN('1. e4 e5 *\n').evals).to.equal(undefined);
+      });
+    });
+
+    describe('getMotifs', function () {
+      function motifsOfFEN(fen) {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN(fen);
+          return b.getMotifs();
+        } finally {
+          b.destroy();
+        }
+      }
+
+      it('tags forks, pins, skewers, discoveries and winning captures for the side to move', function () {
+        const cases = [
+          ['rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1', 0],
+          ['r3k3/8/8/1N6/8/8/8/4K3 w - - 0 1', MOTIF.FORK],                    // Nc7+
+          ['4k3/8/8/8/3p4/8/2N1K3/r7 b - - 0 1', 0],                           // d3 would fork, but Kxd3
+          ['7k/8/5n2/8/8/8/8/B3K3 w - - 0 1', MOTIF.PIN | MOTIF.HANGING],      // loose knight pinned on the long diagonal
+          ['8/8/8/1q2k3/8/8/8/K6R w - - 0 1', MOTIF.SKEWER],                   // Rh5+ then Rxb5
+          ['4k3/8/8/8/4N3/8/8/K3R3 w - - 0 1', MOTIF.DISCOVERED_CHECK],
+          ['4k3/8/8/8/4N3/8/8/K3R3 b - - 0 1', 0],
+          ['6k1/5ppp/8/8/8/8/5PPP/3rR1K1 w - - 0 1', MOTIF.HANGING],           // Rxd1#
+          ['4k3/8/3p4/4p3/3P4/8/8/4K3 w - - 0 1', 0],                          // dxe5 dxe5 is even
+        ];
+        for (const [fen, want] of cases) expect(motifsOfFEN(fen), fen).to.equal(want);
+      });
+
+      it('replayPGN({ motifs }) tags every ply like getMotifs', function () {
+        const moves = 'e4 e5 Nf3 Nc6 Bc4 Nd4 Nxe5 Qg5 Nxf7 Qxg2 Rf1 Qxe4+ Be2 Nf3#'.split(' ');
+        const res = replayPGN(moves.map((m, i) => (i % 2 ? m : `${i / 2 + 1}. ${m}`)).join(' ') + ' 0-1\n', { motifs: true });
+        expect(res.motifs).to.be.instanceOf(Uint8Array);
+        expect(res.motifs).to.have.length(moves.length);
+        const b = new BitboardChessNative();
+        try {
+          const expected = moves.map((m) => {
+            b.makeMoveSAN(m);
+            return b.getMotifs();
+          });
+          expect(Array.from(res.motifs)).to.deep.equal(expected);
+        } finally {
+          b.destroy();
+        }
+        expect(res.motifs[7] & MOTIF.FORK).to.equal(MOTIF.FORK); // after 4...Qg5, Nxf7 hits queen and rook
+        expect(replayPGN('1. e4 e5 *\n').motifs).to.equal(undefined);
+      });
+    });
+
+    describe('solveMate', function () {
+      const PUZZLES = [
+        'r1bqkbnr/pppp1ppp/2n5/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 2 3', // Qxf7#
+        'r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1',   // Bc5+, mate in 3
+        '2k5/8/8/8/8/8/8/1R1R2K1 w - - 0 1',                                // rook roller, five ways
+      ];
+
+      it('returns every mating first move with its shortest mate', function () {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN(PUZZLES[0]);
+          const mate1 = b.solveMate(3);
+          expect(mate1.status).to.equal(MATE_STATUS.FOUND);
+          expect(mate1.moves).to.deep.equal([{ move: 'h5f7', mateIn: 1 }]);
+          b.loadFromFEN(PUZZLES[1]);
+          expect(b.solveMate(2).status).to.equal(MATE_STATUS.NONE);
+          expect(b.solveMate(3).moves).to.deep.equal([{ move: 'f8c5', mateIn: 3 }]);
+          b.loadFromFEN(PUZZLES[2]);
+          const many = b.solveMate(4);
+          expect(many.count).to.equal(5);
+          expect(many.moves.map(m => m.mateIn)).to.deep.equal([4, 4, 4, 4, 4]);
+          expect(many.moves.map(m => m.move)).to.include('b1b3');
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('solves FEN lists across threads with a node budget per position', function () {
+        const fens = [...PUZZLES, '8/8/8/8/8/8/8/8 w - - 0 1'];
+        const one = solveMates(fens, { n: 4, threads: 1 });
+        const many = solveMates(fens.concat(fens), { n: 4, threads: 3 });
+        expect(one.map(r => r.status)).to.deep.equal(
+          [MATE_STATUS.FOUND, MATE_STATUS.FOUND, MATE_STATUS.FOUND, MATE_STATUS.INVALID]);
+        // node counts depend on what the thread's table already holds
+        const strip = rs => rs.map(({ nodes, ...r }) => r);
+        expect(strip(many)).to.deep.equal(strip(one.concat(one)));
+        const budget = solveMates([PUZZLES[2]], { n: 4, nodes: 2000 })[0];
+        expect(budget.status).to.equal(MATE_STATUS.UNKNOWN);
+        expect(budget.nodes).to.be.at.most(2001);
+      });
+    });
+
+    describe('replay', function () {
+      const SAN = ['e4', 'e5', 'Nf3', 'Nc6', 'Bb5', 'a6', 'Ba4', 'Nf6', 'O-O', 'Be7'];
+      const UCI = ['e2e4', 'e7e5', 'g1f3', 'b8c6', 'f1b5', 'a7a6', 'b5a4', 'g8f6', 'e1g1', 'f8e7'];
+
+      function keysBySAN(moves) {
+        const b = new BitboardChessNative();
+        try {
+          return moves.map(san => {
+            b.makeMoveSAN(san);
+            return b.getZobristKey();
+          });
+        } finally {
+          b.destroy();
+        }
+      }
+
+      it('skips move numbers, comments, variations, NAGs and the result', function () {
+        const b = new BitboardChessNative();
+        try {
+          const r = b.replay('1. e4 e5 2. Nf3 {main line} Nc6 (2... d6 3. d4) 3. Bb5 $1 a6 4.Ba4 Nf6 5. O-O Be7 1-0');
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(r.plies).to.equal(10);
+          expect(Array.from(r.keys)).to.deep.equal(keysBySAN(SAN));
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('accepts UCI moves, inferring castling', function () {
+        const b = new BitboardChessNative();
+        try {
+          const r = b.replay(UCI.join(' '), { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(Array.from(r.keys)).to.deep.equal(keysBySAN(SAN));
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('validate stops at the first illegal move with a reason code', function () {
+        const b = new BitboardChessNative();
+        try {
+          let r = b.replay('e4 e5 Ke2 Ke7 Ke3 Qe8 Kd3 Qh5', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.NO_PIECE); // Qe8-h5 is blocked by f7
+          expect(r.plies).to.equal(7);
+          b.reset();
+          r = b.replay('e4 e5 Ke2 Qg5 Kf3 Nc6 Kg4', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.ILLEGAL); // king walks into check
+          expect(r.plies).to.equal(6);
+          b.reset();
+          r = b.replay('e4 e5 Nf3 Nc6 e5', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.ILLEGAL); // push onto a piece
+          b.reset();
+          r = b.replay('e4 e5 Nz9', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.SYNTAX);
+          b.reset();
+          r = b.replay('e2e4 e7e5 e1g1', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.ILLEGAL);
+          expect(r.plies).to.equal(2);
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('validate reports ambiguity and resolves it using pins', function () {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN('4k3/8/8/6N1/8/8/3N4/4K3 w - - 0 1');
+          expect(b.replay('Nf3', { validate: true }).status).to.equal(REPLAY_STATUS.AMBIGUOUS);
+          b.loadFromFEN('4k3/8/8/b5N1/8/8/3N4/4K3 w - - 0 1');
+          expect(b.replay('Nf3', { validate: true }).status).to.equal(REPLAY_STATUS.OK);
+          expect(b.toFEN().split(' ')[0]).to.equal('4k3/8/8/b7/8/5N2/3N4/4K3');
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('accepts lenient SAN and counts each normalization', function () {
+        const b = new BitboardChessNative();
+        try {
+          const r = b.replay('1. e4!! e5?! 2. \u2658f3 \u265ec6 3. Bb5 a6 4. B\u00d7c6 d:c6 5. 0-0 Be7', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(Array.from(r.keys)).to.deep.equal(
+            keysBySAN(['e4', 'e5', 'Nf3', 'Nc6', 'Bb5', 'a6', 'Bxc6', 'dxc6', 'O-O', 'Be7']));
+          expect(r.normalized).to.deep.equal({
+            glyph: 2, epSuffix: 0, promotionWithoutEquals: 0, timesSign: 1, figurine: 2, nullMove: 0,
+          });
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('accepts e.p. suffixes, promotions without "=" and null moves', function () {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN('4k3/1P6/8/3pP3/8/8/8/4K3 w - d6 0 1');
+          let r = b.replay('exd6e.p. Kf7 b8Q', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(b.toFEN().split(' ')[0]).to.equal('1Q6/5k2/3P4/8/8/8/8/4K3');
+          expect(r.normalized.epSuffix).to.equal(1);
+          expect(r.normalized.promotionWithoutEquals).to.equal(1);
+
+          b.loadFromFEN('4k3/1P6/8/3pP3/8/8/8/4K3 w - d6 0 1');
+          r = b.replay('exd6 e.p. Kf7 b8=q', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(r.plies).to.equal(3);
+          expect(b.toFEN().split(' ')[0]).to.equal('1Q6/5k2/3P4/8/8/8/8/4K3');
+
+          b.reset();
+          r = b.replay('e4 -- d4 0000', { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(r.normalized.nullMove).to.equal(1);
+          expect(b.toFEN()).to.equal('rnbqkbnr/pppppppp/8/8/3PP3/8/PPP2PPP/RNBQKBNR w KQkq - 1 3');
+
+          b.loadFromFEN('4k3/8/8/8/8/8/4r3/4K3 w - - 0 1');
+          expect(b.replay('--', { validate: true }).status).to.equal(REPLAY_STATUS.ILLEGAL);
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('replayTCN decodes chess.com TCN, inferring castling, en passant and promotion', function () {
+        const T = 'abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!?{~}(^)[_]@#$,./&-*++=';
+        const sq = s => (s.charCodeAt(0) - 97) + 8 * (s.charCodeAt(1) - 49);
+        const tcn = ucis => ucis.map(u => {
+          const from = sq(u.slice(0, 2));
+          const to = sq(u.slice(2, 4));
+          if (!u[4]) return T[from] + T[to];
+          return T[from] + T[64 + 3 * 'qnrb'.indexOf(u[4]) + (to % 8) - (from % 8) + 1];
+        }).join('');
+        const b = new BitboardChessNative();
+        try {
+          let r = b.replayTCN(tcn(UCI), { validate: true });
+          expect(r.status).to.equal(REPLAY_STATUS.OK);
+          expect(Array.from(r.keys)).to.deep.equal(keysBySAN(SAN));
+
+          b.loadFromFEN('4k3/1P6/8/3pP3/8/8/8/4K3 w - d6 0 1');
+          r = b.replayTCN(tcn(['e5d6', 'e8f7', 'b7b8q']));
+          expect(r.plies).to.equal(3);
+          expect(b.toFEN().split(' ')[0]).to.equal('1Q6/5k2/3P4/8/8/8/8/4K3');
+
+          b.loadFromFEN('4k3/8/8/8/8/8/8/4K2R w K - 0 1');
+          b.replayTCN(tcn(['e1h1'])); // king onto its rook also castles
+          expect(b.toFEN().split(' ')[0]).to.equal('4k3/8/8/8/8/8/8/5RK1');
+
+          b.reset();
+          expect(b.replayTCN(tcn(['e2e4', 'e2e4'])).status).to.equal(REPLAY_STATUS.NO_PIECE);
+          b.reset();
+          expect(b.replayTCN(tcn(['e2e5']), { validate: true }).status).to.equal(REPLAY_STATUS.ILLEGAL);
+          b.reset();
+          expect(b.replayTCN('mC=u').status).to.equal(REPLAY_STATUS.SYNTAX); // piece drop
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('replayPGN returns per-game offsets and status', function () {
+        const pgn = [
+          '[Event "one"]', '', '1. e4 e5 2. Nf3 Nc6 1-0', '',
+          '[Event "two"]', '[FEN "4k3/8/8/8/8/8/4P3/4K3 w - - 0 1"]', '', '1. e4 Kd7 2. Ke2 Kd6 *', '',
+          '[Event "three"]', '', '1. e4 e5 2. Ke3 *', '',
+        ].join('\n');
+        for (const input of [pgn, Buffer.from(pgn)]) {
+          const r = replayPGN(input, { validate: true });
+          expect(r.games).to.equal(3);
+          expect(Array.from(r.offsets)).to.deep.equal([0, 4, 8, 10]);
+          expect(Array.from(r.status)).to.deep.equal([REPLAY_STATUS.OK, REPLAY_STATUS.OK, REPLAY_STATUS.NO_PIECE]);
+          expect(Array.from(r.keys.subarray(0, 4))).to.deep.equal(keysBySAN(['e4', 'e5', 'Nf3', 'Nc6']));
+        }
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN('4k3/8/8/8/8/8/4P3/4K3 w - - 0 1');
+          b.replay('e4 Kd7 Ke2 Kd6');
+          expect(replayPGN(pgn).keys[7]).to.equal(b.getZobristKey());
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('rejects a FEN tag too long to be a FEN instead of starting from the initial position', function () {
+        const fen = `4k3/8/8/8/8/8/4P3/4K3 w - - 0 1${' '.repeat(200)}`;
+        const pgn = `[FEN "${fen}"]\n\n1. e4 e5 *\n\n[Event "next"]\n\n1. e4 *\n`;
+        const r = replayPGN(pgn, { validate: true });
+        expect(Array.from(r.status)).to.deep.equal([REPLAY_STATUS.SYNTAX, REPLAY_STATUS.OK]);
+        expect(Array.from(r.offsets)).to.deep.equal([0, 0, 1]);
+        expect(groupPGN(pgn, { by: ['Event'], aggregate: { games: 'count', plies: { sum: 'plies' } } }))
+          .to.deep.equal([{ key: ['?'], games: 1, plies: 0 }, { key: ['next'], games: 1, plies: 1 }]);
+      });
+    });
+
+    describe('replayPGN result verification', function () {
+      function game(tags, moves) {
+        return Object.entries(tags).map(([k, v]) => `[${k} "${v}"]`).join('\n') + `\n\n${moves}\n\n`;
+      }
+
+      it('classifies the final position and flags contradicting Result tags', function () {
+        const pgn = [
+          game({ Result: '1-0' }, '1. e4 e5 2. Bc4 Nc6 3. Qh5 Nf6 4. Qxf7# 1-0'),
+          game({ Result: '0-1' }, '1. e4 e5 2. Bc4 Nc6 3. Qh5 Nf6 4. Qxf7# 0-1'),
+          game({ Result: '1-0', FEN: '7k/8/5Q2/6K1/8/8/8/8 w - - 0 1' }, '1. Qf7 1-0'),
+          game({ Result: '1/2-1/2', FEN: '8/8/4k3/8/8/3K4/3r4/8 w - - 0 1' }, '1. Kxd2 1/2-1/2'),
+          game({ Result: '1/2-1/2' }, '1. Nf3 Nf6 2. Ng1 Ng8 3. Nf3 Nf6 4. Ng1 Ng8 1/2-1/2'),
+          game({ Result: '1/2-1/2', FEN: '8/8/4k3/8/8/3K4/3R4/8 w - - 99 80' }, '80. Rd1 1/2-1/2'),
+          game({ Result: '0-1' }, '1. e4 e5 2. Nf3 0-1'),
+        ].join('');
+        const r = replayPGN(pgn);
+        expect(r.games).to.equal(7);
+        expect(Array.from(r.end)).to.deep.equal([
+          GAME_END.CHECKMATE, GAME_END.CHECKMATE, GAME_END.STALEMATE, GAME_END.INSUFFICIENT_MATERIAL,
+          GAME_END.THREEFOLD, GAME_END.FIFTY_MOVE, GAME_END.UNFINISHED,
+        ]);
+        expect(Array.from(r.mismatch)).to.deep.equal([0, RESULT_MISMATCH.RESULT, RESULT_MISMATCH.RESULT, 0, 0, 0, 0]);
+      });
+
+      it('flags Termination tags that the final position does not show', function () {
+        const pgn = [
+          game({ Result: '1/2-1/2', Termination: 'Game drawn by repetition' }, '1. Nf3 Nf6 2. Ng1 Ng8 3. Nf3 Nf6 4. Ng1 Ng8 1/2-1/2'),
+          game({ Result: '1-0', Termination: 'White won by checkmate' }, '1. e4 e5 2. Nf3 1-0'),
+          game({ Result: '1-0', Termination: 'White won on time' }, '1. e4 e5 2. Nf3 1-0'),
+          game({ Result: '1/2-1/2', Termination: 'Game drawn by stalemate', FEN: '7k/8/5Q2/6K1/8/8/8/8 w - - 0 1' }, '1. Qf7 1/2-1/2'),
+        ].join('');
+        const r = replayPGN(pgn);
+        expect(Array.from(r.mismatch)).to.deep.equal([0, RESULT_MISMATCH.TERMINATION, 0, 0]);
+      });
+
+      it('tracks the halfmove clock through replay', function () {
+        const b = new BitboardChessNative();
+        try {
+          b.replay('Nf3 Nf6 Ng1 Ng8 e4');
+          expect(b.toFEN().split(' ')[4]).to.equal('0');
+          b.replay('Nc6 Nf3');
+          expect(b.toFEN().split(' ')[4]).to.equal('2');
+        } finally {
+          b.destroy();
+        }
+      });
+    });
+
+    describe('replayNDJSON', function () {
+      const NDJSON = [
+        '{"id":"a","moves":"e4 e5 Nf3 Nc6","rated":true,"clock":{"initial":60,"increment":[0]},"white":{"name":"x"}}',
+        '',
+        '{"id":"b\\u00e9\\"","initialFen":"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1","moves":"e2e4 Kd7","elo":1234.5}',
+        'not json',
+        '{"moves":"e4 e5 Ke3","id":null}',
+      ].join('\n');
+      const OPTIONS = { fields: ['id', 'rated', 'elo', 'clock'], fenField: 'initialFen', validate: true };
+
+      it('replays the moves field and returns the requested fields', function () {
+        const r = replayNDJSON(NDJSON, OPTIONS);
+        expect(r.games).to.equal(4);
+        expect(Array.from(r.offsets)).to.deep.equal([0, 4, 6, 6, 8]);
+        expect(Array.from(r.status)).to.deep.equal(
+          [REPLAY_STATUS.OK, REPLAY_STATUS.OK, REPLAY_STATUS.SYNTAX, REPLAY_STATUS.NO_PIECE]);
+        expect(r.fields.id).to.deep.equal(['a', 'b\u00e9"', undefined, null]);
+        expect(r.fields.rated).to.deep.equal([true, undefined, undefined, undefined]);
+        expect(r.fields.elo[1]).to.equal(1234.5);
+        expect(JSON.parse(r.fields.clock[0])).to.deep.equal({ initial: 60, increment: [0] });
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN('4k3/8/8/8/8/8/4P3/4K3 w - - 0 1');
+          b.replay('e4 Kd7');
+          expect(r.keys[5]).to.equal(b.getZobristKey());
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('rejects a FEN field too long to be a FEN instead of starting from the initial position', function () {
+        const fen = `4k3/8/8/8/8/8/4P3/4K3 w - - 0 1${' '.repeat(200)}`;
+        const r = replayNDJSON(`{"id":"long","initialFen":"${fen}","moves":"e4 e5"}\n{"id":"next","moves":"e4"}\n`, OPTIONS);
+        expect(Array.from(r.status)).to.deep.equal([REPLAY_STATUS.SYNTAX, REPLAY_STATUS.OK]);
+        expect(Array.from(r.offsets)).to.deep.equal([0, 0, 1]);
+        expect(r.fields.id).to.deep.equal(['long', 'next']);
+      });
+
+      it('gives the same result from any chunking and from a file', function () {
+        const whole = replayNDJSON(NDJSON, OPTIONS);
+        const buf = Buffer.from(NDJSON);
+        for (const size of [1, 7, 64]) {
+          const reader = new NDJSONReader(OPTIONS);
+          const keys = [];
+          const ids = [];
+          for (let i = 0; i < buf.length; i += size) {
+            const r = reader.push(buf.subarray(i, i + size));
+            keys.push(...r.keys);
+            ids.push(...r.fields.id);
+          }
+          const r = reader.end();
+          keys.push(...r.keys);
+          ids.push(...r.fields.id);
+          expect(keys).to.deep.equal(Array.from(whole.keys));
+          expect(ids).to.deep.equal(whole.fields.id);
+        }
+        const path = require('path').join(require('os').tmpdir(), `bitboard-ndjson-${process.pid}.ndjson`);
+        require('fs').writeFileSync(path, NDJSON);
+        try {
+          const r = replayNDJSONFile(path, OPTIONS);
+          expect(Array.from(r.keys)).to.deep.equal(Array.from(whole.keys));
+          expect(Array.from(r.status)).to.deep.equal(Array.from(whole.status));
+        } finally {
+          require('fs').unlinkSync(path);
+        }
+        expect(() => replayNDJSONFile(path, OPTIONS)).to.throw(/cannot read/);
+      });
+    });
+
+    describe('replayPuzzles', function () {
+      const HEADER = 'PuzzleId,FEN,Moves,Rating,RatingDeviation,Popularity,NbPlays,Themes,GameUrl,OpeningTags';
+      const ROWS = [
+        '00008,r6k/pp2r2p/4Rp1Q/3p4/8/1N1P2R1/PqP2bPP/7K b - - 0 24,f2g3 e6e7 b2b1 b3c1 b1c1 h6c1,1913,75,94,6230,crushing hangingPiece long middlegame,https://lichess.org/787zsVup/black#47,',
+        '0000D,5rk1/1p3ppp/pq3b2/8/8/1P1Q1N2/P4PPP/3R2K1 w - - 2 27,d3d6 f8d8 d6d8 f6d8,1580,74,96,11765,advantage endgame short,https://lichess.org/F8M8OS71#53,',
+        '0009B,r2qr1k1/b1p2ppp/pp4n1/P1P1p3/4P1n1/B2P2Pb/3NBP1P/RN1QR1K1 b - - 1 16,b6c5 e2g4 h3g4 d1g4,1106,75,96,1302,advantage middlegame short,https://lichess.org/4MWQCxQ6/black#31,Kings_Pawn_Game',
+        '000XX,8/8/8/8/8/8/8/K6k w - - 0 1,a1a2 h1h3,900,0,0,0,,,',
+      ];
+
+      it('loads each FEN, applies the UCI line and returns keys and final FENs', function () {
+        const r = replayPuzzles([HEADER, ...ROWS].join('\r\n'), { validate: true });
+        expect(r.rows).to.equal(4);
+        expect(r.ids).to.deep.equal(['00008', '0000D', '0009B', '000XX']);
+        expect(Array.from(r.ratings)).to.deep.equal([1913, 1580, 1106, 900]);
+        expect(Array.from(r.status)).to.deep.equal(
+          [REPLAY_STATUS.OK, REPLAY_STATUS.OK, REPLAY_STATUS.OK, REPLAY_STATUS.ILLEGAL]);
+        const b = new BitboardChessNative();
+        try {
+          ROWS.slice(0, 3).forEach((row, i) => {
+            const [, fen, moves] = row.split(',');
+            b.loadFromFEN(fen);
+            const expected = b.replay(moves);
+            expect(Array.from(r.keys.subarray(r.offsets[i], r.offsets[i + 1]))).to.deep.equal(Array.from(expected.keys));
+            expect(r.fens[i]).to.equal(b.toFEN());
+          });
+        } finally {
+          b.destroy();
+        }
+      });
+
+      it('gives the same rows in the same order on several threads, with or without a header', function () {
+        const body = (ROWS.join('\n') + '\n').repeat(2000);
+        const one = replayPuzzles(body, { threads: 1 });
+        const many = replayPuzzles(HEADER + '\n' + body, { threads: 4 });
+        expect(many.rows).to.equal(ROWS.length * 2000);
+        expect(many.ids).to.deep.equal(one.ids);
+        expect(many.fens).to.deep.equal(one.fens);
+        expect(Array.from(many.offsets)).to.deep.equal(Array.from(one.offsets));
+        expect(Array.from(many.keys)).to.deep.equal(Array.from(one.keys));
+      });
+    });
+
+    describe('groupPGN', function () {
+      const game = (white, elo, date, moves) =>
+        `[White "${white}"]\n${elo ? `[WhiteElo "${elo}"]\n` : ''}[Date "${date}"]\n\n${moves} *\n\n`;
+      const PGN =
+        game('x', 2437, '2024.03.15', '1. e4 e5 2. Nf3 Nc6') +
+        game('x', 2401, '2024.03.20', '1. e4 c5') +
+        game('x', 1800, '2024.04.01', '1. d4') +
+        game('y', 0, '2024.??.??', '1. d4 d5 2. c4');
+
+      it('groups by bucketed tags and folds every aggregator', function () {
+        const rows = groupPGN(PGN, {
+          by: ['White', { tag: 'Date', bucket: 'month' }, { tag: 'WhiteElo', bucket: 100 }],
+          aggregate: {
+            games: 'count', plies: { sum: 'plies' }, minElo: { min: 'WhiteElo' },
+            positions: 'distinctPositions', first: { topFirstMoves: 1 },
+          },
+        });
+        expect(rows.map((r) => r.key)).to.deep.equal(
+          [['x', '2024.03', '2400'], ['x', '2024.04', '1800'], ['y', '?', '?']]);
+        expect(rows[0]).to.deep.include({ games: 2, plies: 6, minElo: 2401, positions: 5 });
+        expect(rows[0].first).to.deep.equal([{ move: 'e2e4', count: 2 }]);
+        expect(rows[2].minElo).to.equal(null);
+      });
+
+      it('merges the per-thread tables into the single-thread result', function () {
+        const big = PGN.repeat(3000);
+        const spec = { by: ['White'], aggregate: { games: 'count', hi: { max: 'WhiteElo' }, first: { topFirstMoves: 2 } } };
+        const many = groupPGN(big, { ...spec, threads: 4 });
+        expect(many).to.deep.equal(groupPGN(big, { ...spec, threads: 1 }));
+        expect(many[0]).to.deep.include({ games: 9000, hi: 2437 });
+        expect(many[0].first).to.deep.equal([{ move: 'e2e4', count: 6000 }, { move: 'd2d4', count: 3000 }]);
+      });
+
+      it('estimates distinct positions the same way in small and large groups, on any thread count', function () {
+        let seed = 11;
+        const next = () => (seed = (Math.imul(seed, 1103515245) + 12345) >>> 0) >>> 8;
+        const b = new BitboardChessNative();
+        const games = [];
+        for (let i = 0; i < 60; i++) {
+          const moves = [];
+          b.reset();
+          while (moves.length < 60) {
+            const legal = Object.keys(b.perftDivide(1));
+            if (!legal.length) break;
+            moves.push(legal[next() % legal.length]);
+            b.replay(moves[moves.length - 1]);
+          }
+          games.push(`[White "${i < 55 ? 'many' : 'few'}"]\n\n${moves.join(' ')} *\n\n`);
+        }
+        b.destroy();
+        const pgn = games.join('');
+        const keys = replayPGN(pgn).keys;
+        const exact = (from, to) => {
+          const r = replayPGN(games.slice(from, to).join(''));
+          return new Set(r.keys).size;
+        };
+        // Thousands of positions take the group past the sparse registers.
+        const spec = { by: ['White'], aggregate: { positions: 'distinctPositions' } };
+        const rows = groupPGN(pgn.repeat(100), { ...spec, threads: 4 });
+        expect(rows).to.deep.equal(groupPGN(pgn, { ...spec, threads: 1 }));
+        expect(keys.length).to.be.above(3000);
+        expect(rows[1].key).to.deep.equal(['many']);
+        expect(rows[1].positions / exact(0, 55)).to.be.within(0.95, 1.05);
+        expect(rows[0].positions / exact(55, 60)).to.be.within(0.97, 1.03);
+      });
+    });
+
+    describe('async batch jobs', function () {
+      const PGN = '[White "x"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 *\n\n[White "y"]\n\n1. d4 d5 2. c4 *\n\n';
+
+      it('resolves with the synchronous result and reports progress up to the input size', async function () {
+        const input = PGN.repeat(2000);
+        const reports = [];
+        const r = await replayPGNAsync(input, { evals: true, onProgress: (done, total) => reports.push([done, total]) });
+        const sync = replayPGN(input, { evals: true });
+        expect(r.cancelled).to.equal(false);
+        expect(r.keys).to.deep.equal(sync.keys);
+        expect(r.evals).to.deep.equal(sync.evals);
+        expect(reports[reports.length - 1]).to.deep.equal([input.length, input.length]);
+        const grouped = await groupPGNAsync(input, { by: ['White'], aggregate: { games: 'count' } });
+        expect(grouped).to.deep.equal({ rows: groupPGN(input, { by: ['White'] }), cancelled: false });
+        const index = new MinHashIndex();
+        index.add(replayPGN(PGN, { minhash: true }).minhash);
+        const built = index.build();
+        expect(() => index.query(0)).to.throw(/in progress/);
+        expect(await built).to.deep.equal({ cancelled: false });
+        expect(Array.from(index.query(0, { k: 1 }).ids)).to.deep.equal([0]);
+      });
+
+      it('stops when the signal aborts and resolves with the games finished', async function () {
+        const input = Buffer.from(PGN.repeat(50000));
+        const aborted = new AbortController();
+        aborted.abort();
+        const none = await replayPGNAsync(input, { signal: aborted.signal });
+        expect([none.games, none.keys.length, none.cancelled]).to.deep.equal([0, 0, true]);
+        expect(await groupPGNAsync(input, { signal: aborted.signal })).to.deep.equal({ rows: [], cancelled: true });
+
+        const controller = new AbortController();
+        const r = await replayPGNAsync(input, { signal: controller.signal, onProgress: () => controller.abort() });
+        expect(r.cancelled).to.equal(true);
+        expect(r.games).to.be.below(100000);
+        expect(r.offsets[r.games]).to.equal(r.keys.length);
+      });
+
+      it('rejects a cancelled index build with an AbortError', async function () {
+        const index = new MinHashIndex();
+        index.add(replayPGN(PGN, { minhash: true }).minhash);
+        const aborted = new AbortController();
+        aborted.abort();
+        let error = null;
+        await index.build({ signal: aborted.signal }).catch((err) => { error = err; });
+        expect(error && [error.name, error.code]).to.deep.equal(['AbortError', 'ABORT_ERR']);
+        expect(Array.from(index.query(0, { k: 1 }).ids)).to.deep.equal([0]);
+      });
+
+      it('keeps the store, dict and audit writers of a running replay busy until it settles', async function () {
+        const store = new PositionStoreWriter();
+        const dict = new PositionDictionaryWriter();
+        const audit = new CollisionAudit();
+        const reader = new NDJSONReader({ store });
+        const running = replayPGNAsync(PGN.repeat(100), { store, dict, audit });
+        for (const writer of [store, dict, audit]) {
+          expect(() => writer.counts).to.throw(/async replay in progress/);
+          expect(() => writer.finish()).to.throw(/async replay in progress/);
+        }
+        expect(() => replayPGN(PGN, { dict })).to.throw(/async replay in progress/);
+        expect(() => replayPGNAsync(PGN, { audit })).to.throw(/async replay in progress/);
+        expect(() => reader.push('{"moves":"e4"}\n')).to.throw(/async replay in progress/);
+        expect((await running).games).to.equal(200);
+        expect(store.counts).to.deep.equal({ positions: 900, games: 200 });
+        expect(dict.counts.positions).to.equal(9);
+        expect(audit.finish().positions).to.equal(900);
+        expect(reader.end('{"moves":"e4"}\n').games).to.equal(1);
+      });
+    });
+
+    describe('createReplayStream', function () {
+      it('replays chunks cut anywhere into record batches matching replayPGN', async function () {
+        const { Readable } = require('stream');
+        let pgn = '';
+        for (let i = 0; i < 600; i++) {
+          pgn += `[Event "${i}"]\n\n${i % 3 ? '1. e4 e5 2. Nf3 Nc6 3. Bb5 a6' : '1. d4 d5 2. c4 Zz9'} *\n\n`;
+        }
+        const input = Buffer.from(pgn);
+        const chunks = [];
+        for (let at = 0, n = 1; at < input.length; at += n, n = 1 + ((n * 7919) % 613)) chunks.push(input.subarray(at, at + n));
+        const batches = [];
+        for await (const buf of Readable.from(chunks).pipe(createReplayStream({ positions: true, maxRecords: 100 }))) {
+          batches.push(decodeRecordBatch(buf));
+        }
+        const ref = replayPGN(pgn);
+        expect(batches.reduce((n, b) => n + b.games, 0)).to.equal(600);
+        expect(batches.flatMap((b) => Array.from(b.keys))).to.deep.equal(Array.from(ref.keys));
+        expect(batches.flatMap((b) => Array.from(b.status))).to.deep.equal(Array.from(ref.status));
+        batches.forEach((b, i) => {
+          expect(b.firstGame).to.equal(i ? batches[i - 1].firstGame + batches[i - 1].games : 0);
+          expect(b.records).to.be.at.most(100);
+          expect(b.positions.length).to.equal(b.records * 32);
+        });
+        const first = batches[0];
+        expect(Array.from(first.game.subarray(0, 5))).to.deep.equal([0, 0, 0, 1, 1]);
+        expect(Array.from(first.ply.subarray(0, 5))).to.deep.equal([1, 2, 3, 1, 2]);
+      });
+
+      it('cancels the chunk in flight when its signal aborts', async function () {
+        const { once } = require('events');
+        const controller = new AbortController();
+        const stream = createReplayStream({ signal: controller.signal });
+        const closed = new Promise((resolve) => stream.on('close', resolve));
+        const errored = once(stream, 'error');
+        stream.write(Buffer.from('[Event "a"]\n\n1. e4 e5 2. Nf3 Nc6 *\n\n'.repeat(200000)));
+        controller.abort();
+        const [err] = await errored;
+        expect(err.name).to.equal('AbortError');
+        await closed;
+      });
+    });
+
+    describe('checkFENs', function () {
+      const CASES = [
+        ['rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1', 'OK'],
+        ['8/8/8/4k3/8/8/8/K7 w - -', 'OK'],
+        ['rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNX w KQkq - 0 1', 'SYNTAX'],
+        ['8/8/8/4k3/8/8/8/K7 w - - 0', 'SYNTAX'],
+        ['8/8/8/44k3/8/8/8/K7 w - - 0 1', 'SYNTAX'],
+        ['8/8/8/4k4/8/8/8/K7 w - - 0 1', 'RANKS'],
+        ['8/8/4k3/8/8/8/K7 w - - 0 1', 'RANKS'],
+        ['8/8/8/4k3/8/8/8/KK6 w - - 0 1', 'KINGS'],
+        ['8/8/8/8/8/8/8/K7 w - - 0 1', 'KINGS'],
+        ['P7/8/8/4k3/8/8/8/K7 w - - 0 1', 'PAWNS'],
+        ['r3k2r/8/8/8/8/8/8/R3K1R1 w KQkq - 0 1', 'CASTLING'],
+        ['4k3/8/8/8/4P3/8/8/4K3 b - d3 0 1', 'EN_PASSANT'],
+        ['4k3/8/8/8/4P3/8/8/4K3 w - e3 0 1', 'EN_PASSANT'],
+        ['4k3/8/8/8/8/8/8/4K2R b - - 0 1', 'OK'],
+        ['4k3/8/8/8/8/8/8/4R1K1 w - - 0 1', 'CHECK'],
+        ['', 'EMPTY'],
+      ];
+
+      it('gives each line the first check it fails', function () {
+        for (const [fen, status] of CASES) {
+          expect(checkFEN(fen), fen).to.equal(FEN_STATUS[status]);
+        }
+        const lines = CASES.map(([fen]) => fen).join('\r\n') + '\n';
+        const expected = CASES.map(([, status]) => FEN_STATUS[status]);
+        expect(Array.from(checkFENs(lines, { threads: 1 }))).to.deep.equal(expected);
+        expect(Array.from(checkFENs(Buffer.from(lines.trimEnd())))).to.deep.equal(expected.slice(0, -1));
+      });
+
+      it('splits large inputs across threads without changing the result', function () {
+        const fens = CASES.map(([fen]) => fen).filter(Boolean);
+        const big = Array.from({ length: 20000 }, (_, i) => fens[i % fens.length]).join('\n');
+        const one = checkFENs(big, { threads: 1 });
+        expect(one).to.have.length(20000);
+        expect(Array.from(checkFENs(big, { threads: 4 }))).to.deep.equal(Array.from(one));
+        expect(one[fens.length + 7]).to.equal(FEN_STATUS.KINGS);
+      });
+    });
+
+    describe('SimilarityIndex', function () {
+      function distance(a, b) {
+        let d = 0;
+        for (let j = 0; j < 12; j++) {
+          for (let x = a[j] ^ b[j]; x; x &= x - 1n) d++;
+        }
+        return d;
+      }
+
+      it('ranks the positions of a game by differing piece bits', function () {
+        const index = new SimilarityIndex();
+        const b = new BitboardChessNative();
+        const fens = [b.toFEN()];
+        for (const san of ['e4', 'e5', 'Nf3', 'Nc6', 'Bb5', 'a6', 'Bxc6', 'dxc6']) {
+          b.makeMoveSAN(san);
+          fens.push(b.toFEN());
+        }
+        expect(index.addFENs(fens.join('\n') + '\n\n')).to.equal(fens.length);
+        expect(index.add(b)).to.equal(fens.length);
+        const r = index.query(fens[4], { k: 4 });
+        expect(Array.from(r.ids)).to.deep.equal([4, 3, 5, 2]);
+        expect(Array.from(r.distances)).to.deep.equal([0, 2, 2, 4]);
+        expect(r.exact).to.equal(true);
+        expect(r.scanned).to.equal(false);
+        // Bxc6 dxc6 (ids 8 and the board itself) are a capture and a recapture away.
+        expect(Array.from(index.query(b, { k: 2 }).ids)).to.deep.equal([8, 9]);
+        expect(index.query(fens[6], { k: 3 }).distances[2]).to.equal(3);
+        b.destroy();
+      });
+
+      it('matches a full comparison whether or not the rank tables can prove the result', function () {
+        let seed = 7;
+        const next = () => (seed = (Math.imul(seed, 1103515245) + 12345) >>> 0) >>> 8;
+        const word = () => (BigInt(next() & next() & next()) << 40n) | BigInt(next() & next() & next());
+        const bases = Array.from({ length: 40 }, () => Array.from({ length: 12 }, word));
+        const n = 3000;
+        const sets = new BigUint64Array(n * 12);
+        for (let i = 0; i < n; i++) {
+          const base = bases[next() % bases.length];
+          for (let j = 0; j < 12; j++) sets[i * 12 + j] = base[j];
+          for (let f = next() % 6; f > 0; f--) sets[i * 12 + (next() % 12)] ^= 1n << BigInt(next() % 64);
+        }
+        const index = new SimilarityIndex();
+        expect(index.addPositions(sets)).to.equal(n);
+        for (let t = 0; t < 8; t++) {
+          const query = BigUint64Array.from(bases[t]);
+          query[t] ^= 1n << BigInt(t * 5);
+          const expected = Array.from({ length: n }, (_, i) => [distance(sets.subarray(i * 12, i * 12 + 12), query), i])
+            .sort((x, y) => x[0] - y[0] || x[1] - y[1])
+            .slice(0, 20);
+          for (const maxBucket of [0, 1]) {
+            const r = index.query(query, { k: 20, maxBucket, threads: 2 });
+            expect(r.exact).to.equal(true);
+            expect(r.scanned).to.equal(maxBucket === 1);
+            expect(Array.from(r.ids)).to.deep.equal(expected.map(([, i]) => i));
+            expect(Array.from(r.distances)).to.deep.equal(expected.map(([d]) => d));
+          }
+        }
+
+        // Positions added between queries go to the overflow tables until a rebuild.
+        const grown = new SimilarityIndex();
+        grown.addPositions(sets.subarray(0, 500 * 12));
+        for (let i = 500; i < n; i += 250) {
+          grown.query(BigUint64Array.from(bases[0]), { k: 1 });
+          grown.addPositions(sets.subarray(i * 12, Math.min(i + 250, n) * 12));
+        }
+        for (let t = 0; t < 8; t++) {
+          const query = BigUint64Array.from(bases[t]);
+          const a = grown.query(query, { k: 20 });
+          const b = index.query(query, { k: 20 });
+          expect(Array.from(a.ids)).to.deep.equal(Array.from(b.ids));
+          expect(Array.from(a.distances)).to.deep.equal(Array.from(b.distances));
+          expect(a.scanned).to.equal(false);
+        }
+      });
+    });
+
+    describe('MinHashIndex', function () {
+      it('signs games during replay and finds games sharing most of their positions', function () {
+        let seed = 11;
+        const next = () => (seed = (Math.imul(seed, 1103515245) + 12345) >>> 0) >>> 8;
+        const b = new BitboardChessNative();
+        const walk = (prefix, plies) => {
+          b.reset();
+          b.replay(prefix.join(' '));
+          const moves = prefix.slice();
+          while (moves.length < plies) {
+            const legal = Object.keys(b.perftDivide(1));
+            if (!legal.length) break;
+            moves.push(legal[next() % legal.length]);
+            b.replay(moves[moves.length - 1]);
+          }
+          return moves;
+        };
+        // 20 games of 80 plies, then each again with its last 8 plies changed.
+        const games = Array.from({ length: 20 }, () => walk([], 80));
+        games.push(...games.map((g) => walk(g.slice(0, 72), 80)));
+        b.destroy();
+        const r = replayPGN(games.map((g) => g.join(' ') + ' *\n\n').join(''), { minhash: true });
+        expect(r.minhash.length).to.equal(40 * MINHASH_SIZE);
+        const sig = (i) => r.minhash.subarray(i * MINHASH_SIZE, (i + 1) * MINHASH_SIZE);
+        expect(Array.from(minhashSign(r.keys.subarray(r.offsets[3], r.offsets[4])))).to.deep.equal(Array.from(sig(3)));
+
+        const index = new MinHashIndex();
+        expect(index.add(r.minhash)).to.equal(40);
+        for (let i = 0; i < 20; i++) {
+          const q = index.query(i, { k: 2, minJaccard: 0.5 });
+          expect(Array.from(q.ids)).to.deep.equal([i, i + 20]);
+          expect(q.jaccard[0]).to.equal(1);
+          expect(q.jaccard[1]).to.be.within(0.6, 0.95); // 72 / 88 shared
+        }
+        expect(Array.from(index.query(sig(25), { k: 1 }).ids)).to.deep.equal([25]);
+
+        // Games added between queries go to the overflow tables until a rebuild.
+        const grown = new MinHashIndex();
+        grown.add(r.minhash.subarray(0, 10 * MINHASH_SIZE));
+        for (let i = 10; i < 40; i += 3) {
+          grown.query(0, { k: 1 });
+          grown.add(r.minhash.subarray(i * MINHASH_SIZE, Math.min(i + 3, 40) * MINHASH_SIZE));
+        }
+        for (let i = 0; i < 40; i++) expect(grown.query(i, { k: 3 })).to.deep.equal(index.query(i, { k: 3 }));
+      });
+    });
+
+    describe('PositionStore', function () {
+      const fs = require('fs');
+      const os = require('os');
+      const path = require('path');
+      const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bbps-'));
+      const PGN = `[Event "a"]
+
+1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 4. Ba4 Nf6 5. O-O Be7 6. Re1 b5 7. Bb3 O-O *
+
+[Event "b"]
+
+1. d4 d5 2. c4 e6 3. Nc3 Nf6 4. Bg5 Be7 5. e3 O-O 6. Nf3 Nbd7 *
+`;
+      const sq = (name) => 1n << BigInt((name.charCodeAt(1) - 49) * 8 + name.charCodeAt(0) - 97);
+      const count = (x) => {
+        let n = 0;
+        for (; x; x &= x - 1n) n++;
+        return n;
+      };
+
+      it('stores every replayed ply with its game, ply, side to move and castling rights', function () {
+        const writer = new PositionStoreWriter();
+        replayPGN(PGN, { store: writer });
+        replayNDJSON('{"moves":"e4 c5 Nf3 d6"}\n{"moves":"e4 e5 Zz9"}\n', { store: writer, validate: true });
+        expect(writer.counts).to.deep.equal({ positions: 32, games: 4 });
+        const file = path.join(dir, 'small.bbps');
+        writer.finish(file);
+        expect(writer.counts).to.deep.equal({ positions: 0, games: 0 });
+
+        const store = new PositionStore(file);
+        expect(store.counts).to.deep.equal({ positions: 32, games: 4 });
+        const last = store.get(13);
+        expect([last.game, last.ply, last.turn, last.castling]).to.deep.equal([0, 14, 'w', '-']);
+        expect(store.get(0).sets[0]).to.equal(0xef00n | sq('e4'));
+        expect(store.get(31)).to.include({ game: 3, ply: 2, turn: 'w', castling: 'KQkq' });
+
+        const hits = store.query('K@g1 R@e1 k@g8 r@f8');
+        expect(Array.from(hits.games)).to.deep.equal([0]);
+        expect(Array.from(hits.plies)).to.deep.equal([14]);
+        expect(Array.from(store.query('N@f3 !n@c6 turn=b').positions)).to.deep.equal([2, 24, 28]);
+        expect(Array.from(store.query('castle=Q !castle=k #Bb@b5,e7,g5=2').plies)).to.deep.equal([10, 11, 12]);
+        expect(Array.from(store.query('#p@d,e=2 #Nn@c,f>=3').positions)).to.deep.equal([7, 8, 9, 10, 11, 12, 13, 24, 25]);
+        expect(() => store.query('N@e9')).to.throw(/offset 0: N@e9/);
+        expect(() => store.query('N@e4 #q=1..')).to.throw(/offset 5/);
+        expect(() => new PositionStore(path.join(dir, 'missing.bbps'))).to.throw(/missing or not a position store/);
+      });
+
+      it('matches a per-position check over several blocks and threads', function () {
+        const writer = new PositionStoreWriter();
+        for (let i = 0; i < 3000; i++) replayPGN(PGN, { store: writer });
+        const file = path.join(dir, 'big.bbps');
+        writer.finish(file);
+        const store = new PositionStore(file);
+        const n = store.counts.positions;
+        expect(n).to.equal(78000);
+        const queries = {
+          'N@f3 p@e6': (s) => (s[1] & sq('f3')) && (s[6] & sq('e6')),
+          '!P@e2,d2 turn=w': (s, p) => !(s[0] & (sq('e2') | sq('d2'))) && p.turn === 'w',
+          '#*@4,5=4 castle=q': (s, p) => count(s.reduce((a, b) => a | b) & 0xffff000000n) === 4 && p.castling.includes('q'),
+          '#Pp@4,5>=3': (s) => count((s[0] | s[6]) & 0xffff000000n) >= 3,
+        };
+        const first = Array.from({ length: 26 }, (_, i) => store.get(i));
+        for (const [text, check] of Object.entries(queries)) {
+          const expected = [];
+          for (let i = 0; i < n; i++) if (check(first[i % 26].sets, first[i % 26])) expected.push(i);
+          expect(Array.from(store.query(text, { threads: 1 }).positions), text).to.deep.equal(expected);
+          expect(Array.from(store.query(text, { threads: 3 }).positions), text).to.deep.equal(expected);
+        }
+      });
+    });
+
+    describe('PositionDictionary', function () {
+      it('keeps one position per key, looks keys up in bulk and extends a written dictionary', function () {
+        const fs = require('fs');
+        const os = require('os');
+        const path = require('path');
+        const file = path.join(fs.mkdtempSync(path.join(os.tmpdir(), 'bcpd-')), 'positions.bcpd');
+        const writer = new PositionDictionaryWriter(file);
+        // The knights return to the start position, and 3. e4 transposes into the second game's first ply.
+        const replayed = replayPGN('[Event "a"]\n\n1. Nf3 Nf6 2. Ng1 Ng8 3. e4 *\n\n[Event "b"]\n\n1. e4 e5 *\n', { dict: writer });
+        expect(replayed.keys.length).to.equal(7);
+        expect(writer.counts).to.deep.equal({ positions: 6, collisions: 0 });
+        writer.finish(file);
+
+        const dict = new PositionDictionary(file);
+        expect(dict.counts).to.deep.equal({ positions: 6, collisions: 0 });
+        const fens = dict.lookup(replayed.keys, { fen: true });
+        expect(fens[3]).to.equal('rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1');
+        expect(fens[6]).to.equal('rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 1');
+        const packed = dict.lookup(new BigUint64Array([replayed.keys[4], 12345n, replayed.keys[5]]));
+        expect(packed.length).to.equal(96);
+        expect(packed.subarray(32, 64).every((b) => b === 0)).to.equal(true);
+        expect(Array.from(packed.subarray(0, 32))).to.deep.equal(Array.from(packed.subarray(64, 96)));
+        expect(dict.lookup(new BigUint64Array([12345n]), { fen: true })).to.deep.equal([null]);
+        expect(dict.collisions().length).to.equal(0);
+
+        const more = new PositionDictionaryWriter(file);
+        replayNDJSON('{"moves":"e4 c5"}\n', { dict: more });
+        more.finish(file);
+        expect(new PositionDictionary(file).counts).to.deep.equal({ positions: 7, collisions: 0 });
+
+        // A corrupt index of the right size: entries past the count, then a full table.
+        const bytes = fs.readFileSync(file);
+        const slots = Number(bytes.readBigUInt64LE(16));
+        for (const entry of [0xffffffff, 1]) {
+          for (let i = bytes.length - slots * 4; i < bytes.length; i += 4) bytes.writeUInt32LE(entry, i);
+          fs.writeFileSync(file, bytes);
+          const corrupt = new PositionDictionary(file);
+          expect(corrupt.lookup(new BigUint64Array([replayed.keys[6], 12345n]), { fen: true })).to.deep.equal([null, null]);
+        }
+      });
+    });
+
+    describe('CollisionAudit', function () {
+      it('counts distinct keys and positions through run files and cleans them up', function () {
+        const fs = require('fs');
+        const os = require('os');
+        const path = require('path');
+        const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bcaudit-'));
+        const audit = new CollisionAudit({ dir, memoryMb: 1 });
+        let pgn = '';
+        for (let i = 0; i < 2000; i++) pgn += `[Event "${i}"]\n\n${i % 2 ? '1. e4 e5 2. Nf3 Nc6 3. Bb5 a6' : '1. d4 d5 2. c4 e6 3. Nc3 Nf6 4. Bg5'} *\n\n`;
+        // 13000 positions a pass: six passes overflow the 43690-record buffer into runs.
+        for (let pass = 0; pass < 6; pass++) replayPGN(pgn, { audit });
+        replayNDJSON('{"moves":"e4 c5"}\n', { audit });
+        expect(audit.counts).to.deep.equal({ positions: 78002, runs: 1 });
+        expect(fs.readdirSync(dir)).to.have.length(1);
+
+        const report = audit.finish();
+        expect(report).to.include({ positions: 78002, keys: 14, fingerprints: 14 });
+        expect(report.collisions.length).to.equal(0);
+        expect(report.counts.length).to.equal(0);
+        expect(fs.readdirSync(dir)).to.have.length(0);
+        expect(audit.counts).to.deep.equal({ positions: 0, runs: 0 });
+      });
+    });
+
+    describe('Tablebase', function () {
+      const fs = require('fs');
+      const os = require('os');
+      const path = require('path');
+      const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bbtb-'));
+      const tb = new Tablebase(dir);
+      tb.generate('KQvK', { threads: 2 });
+      tb.generate('KRvK');
+      tb.generate('KvKP');
+
+      function probe(t, fen) {
+        const b = new BitboardChessNative();
+        try {
+          b.loadFromFEN(fen);
+          return t.probeWDL(b);
+        } finally {
+          b.destroy();
+        }
+      }
+
+      it('classifies three-piece endings for the side to move', function () {
+        expect(probe(tb, '8/8/8/4k3/8/8/8/KQ6 w - - 0 1')).to.equal(WDL.WIN);
+        expect(probe(tb, '8/8/8/4k3/8/8/8/KQ6 b - - 0 1')).to.equal(WDL.LOSS);
+        expect(probe(tb, 'k7/2Q5/1K6/8/8/8/8/8 b - - 0 1')).to.equal(WDL.DRAW); // stalemate
+        expect(probe(tb, '8/8/8/8/8/8/8/K1k1R3 b - - 0 1')).to.equal(WDL.LOSS);
+        expect(probe(tb, '4k3/8/4K3/4P3/8/8/8/8 b - - 0 1')).to.equal(WDL.LOSS);
+        expect(probe(tb, '8/8/8/8/8/k7/P7/K7 w - - 0 1')).to.equal(WDL.DRAW);
+        expect(probe(tb, '8/8/8/4k3/8/8/8/K7 w - - 0 1')).to.equal(WDL.DRAW);
+      });
+
+      it('probes colour-swapped positions and reports what it cannot cover', function () {
+        expect(probe(tb, 'kq6/8/8/8/8/8/8/4K3 w - - 0 1')).to.equal(WDL.LOSS);
+        expect(probe(tb, '8/8/8/8/4p3/8/8/k3K3 b - - 0 1')).to.equal(probe(tb, 'K3k3/8/8/4P3/8/8/8/8 w - - 0 1'));
+        expect(probe(tb, '4k3/8/8/8/8/8/8/4KB2 w - - 0 1')).to.equal(WDL.DRAW); // via KPvK's promotions
+        expect(probe(tb, 'r3k3/8/8/8/8/8/8/4KQ2 w - - 0 1')).to.equal(WDL.UNKNOWN); // not generated
+        expect(probe(tb, 'r3k3/8/8/8/8/8/8/4K3 w q - 0 1')).to.equal(WDL.UNKNOWN); // castling rights
+      });
+
+      it('indexes positions up to the board symmetries', function () {
+        // 462 king pairs without pawns, 1806 with; 2 bits per entry after the 64-byte header.
+        expect(fs.statSync(path.join(dir, 'KQvK.bbtb')).size).to.equal(64 + (2 * 462 * 64) / 4);
+        expect(fs.statSync(path.join(dir, 'KPvK.bbtb')).size).to.equal(64 + (2 * 1806 * 48) / 4);
+        const fen = '8/8/8/8/8/1k6/5Q2/6K1 b - - 0 1';
+        for (const image of [
+          '8/8/8/8/8/6k1/2Q5/1K6 b - - 0 1', // mirrored left-right
+          '6K1/5Q2/1k6/8/8/8/8/8 b - - 0 1', // mirrored top-bottom
+          '8/K7/1Q6/8/8/8/2k5/8 b - - 0 1', // transposed
+        ]) {
+          expect(probe(tb, image), image).to.equal(probe(tb, fen));
+        }
+        expect(probe(tb, fen)).to.equal(WDL.LOSS);
+        expect(probe(tb, '8/8/8/8/2k5/2K5/8/Q7 w - - 0 1')).to.equal(WDL.UNKNOWN); // touching kings
+      });
+
+      it('maps generated files in a new instance and annotates replayPGN', function () {
+        expect(fs.readdirSync(dir).sort()).to.deep.equal(['KBvK.bbtb', 'KNvK.bbtb', 'KPvK.bbtb', 'KQvK.bbtb', 'KRvK.bbtb']);
+        const loaded = new Tablebase(dir);
+        expect(probe(loaded, '8/8/8/4k3/8/8/8/KQ6 w - - 0 1')).to.equal(WDL.WIN);
+        const pgn = '[FEN "8/8/8/4k3/8/8/8/KQ6 w - - 0 1"]\n\n1. Qb2+ Kd5 *\n\n1. e4 *\n';
+        const r = replayPGN(pgn, { validate: true, tablebase: loaded });
+        expect(Array.from(r.wdl)).to.deep.equal([WDL.WIN, WDL.UNKNOWN]);
+        expect(replayPGN(pgn).wdl).to.equal(undefined);
+        fs.rmSync(dir, { recursive: true, force: true });
+      });
+
+      it('values double pawn pushes with their en passant replies', function () {
+        // Promotion tables are stubbed as all-draw files so only KPvKP (and the
+        // three-piece tables) is generated; captures still reach real tables.
+        const pawnDir = fs.mkdtempSync(path.join(os.tmpdir(), 'bbtb-'));
+        for (const sig of ['KQvKP', 'KRvKP', 'KBvKP', 'KNvKP']) {
+          const entries = 2n * 1806n * 64n * 48n; // king pairs with pawns, the piece, the pawn
+          const header = Buffer.alloc(64);
+          header.write('BBTB', 0, 'latin1');
+          header.writeUInt32LE(2, 4);
+          header.write(sig, 8, 'latin1');
+          header.writeBigUInt64LE(entries, 24);
+          header.writeUInt32LE(4, 32);
+          fs.writeFileSync(path.join(pawnDir, `${sig}.bbtb`), Buffer.concat([header, Buffer.alloc(Number(entries / 4n))]));
+        }
+        try {
+          const pawns = new Tablebase(pawnDir);
+          pawns.generate('KPvKP');
+          // d2-d4 only escapes if cxd3 e.p. is ignored.
+          expect(probe(pawns, '8/8/8/8/2pP4/8/8/K1k5 b - - 0 1')).to.equal(WDL.DRAW);
+          expect(probe(pawns, '8/8/8/8/2pP4/8/8/K1k5 b - d3 0 1')).to.equal(WDL.WIN);
+          expect(probe(pawns, '8/8/8/8/2p5/8/3P4/K1k5 w - - 0 1')).to.equal(WDL.LOSS);
+          // d2-d4 would win, but cxd3 e.p. holds the draw.
+          expect(probe(pawns, '8/8/8/8/2p5/8/3P4/K5k1 w - - 0 1')).to.equal(WDL.DRAW);
+        } finally {
+          fs.rmSync(pawnDir, { recursive: true, force: true });
+        }
+      });
+    });
+
     describe('square helpers', function () {
       it('squareNameToIndex returns 0-63', function () {
         expect(squareNameToIndex('a1')).to.equal(0);
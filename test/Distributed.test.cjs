@@ -0,0 +1,100 @@
+/**
+ * Distributed ingest: game-aligned splitting, worker processes over a Unix socket,
+ * retries of failed ranges, and a merge that does not depend on the worker layout.
+ * Skipped if the native addon is not built (npm run build).
+ */
+const { describe, it } = require('node:test');
+const { expect } = require('chai');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+let native = null;
+try {
+  native = require('../index-native.cjs');
+} catch (_) {
+  native = null;
+}
+const { ingestPGN, splitPGN, sortedRun } = require('../distributed.cjs');
+
+const GAMES = [
+  '[Event "a"]\n[Result "*"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 *\n\n',
+  '[Event "b"]\n\n1. d4 d5 2. c4 e6 {[%clk 0:03:00]} 3. Nc3 *\n\n',
+  '[Event "c"]\r\n\r\n1. e4 c5 2. Nf3 d6 *\r\n\r\n',
+  '[Event "d"]\n\n1. e4 e5 2. Ke3 *\n\n',
+];
+const PGN = Buffer.from(Array.from({ length: 1200 }, (_, i) => GAMES[i % GAMES.length]).join(''));
+
+function sameRun(a, b) {
+  expect(Array.from(a.keys)).to.deep.equal(Array.from(b.keys));
+  expect(Array.from(a.counts)).to.deep.equal(Array.from(b.counts));
+}
+
+describe('distributed ingest', function () {
+  it('splitPGN cuts only at game starts', function () {
+    const ranges = splitPGN(PGN, 4096);
+    expect(ranges.length).to.be.greaterThan(4);
+    expect(ranges[0].start).to.equal(0);
+    expect(ranges[ranges.length - 1].end).to.equal(PGN.length);
+    for (let i = 1; i < ranges.length; i++) {
+      expect(ranges[i].start).to.equal(ranges[i - 1].end);
+      expect(PGN.toString('latin1', ranges[i].start, ranges[i].start + 7)).to.equal('[Event ');
+    }
+  });
+
+  if (!native) {
+    it('skipped (native addon not built; run npm run build)', function () {
+      this.skip();
+    });
+    return;
+  }
+
+  it('matches a single-process replay for any worker count, from buffers and files', async function () {
+    const expected = sortedRun(native.replayPGN(Buffer.concat([PGN, PGN]), { validate: true }).keys);
+    const file = path.join(os.tmpdir(), `bitboard-distributed-${process.pid}.pgn`);
+    fs.writeFileSync(file, PGN);
+    try {
+      for (const workers of [1, 3]) {
+        const r = await ingestPGN([PGN, file], { workers, rangeBytes: 8192, validate: true });
+        expect(r.games).to.equal(2400);
+        expect(r.rejected).to.equal(600); // every game "d" (Ke3)
+        expect(r.plies).to.equal(expected.counts.reduce((n, c) => n + c, 0));
+        expect(r.ranges.map(x => x.source)).to.include(1);
+        sameRun(r, expected);
+      }
+    } finally {
+      fs.unlinkSync(file);
+    }
+  });
+
+  it('retries ranges whose worker dies and still produces the same result', async function () {
+    const expected = sortedRun(native.replayPGN(PGN).keys);
+    const r = await ingestPGN(PGN, {
+      workers: 2,
+      rangeBytes: 8192,
+      workerArgs: i => (i === 0 ? ['--crash-after', '2'] : []),
+    });
+    expect(r.retries).to.be.greaterThan(0);
+    sameRun(r, expected);
+  });
+
+  it('fails once a range has used up its attempts', async function () {
+    let error = null;
+    try {
+      await ingestPGN(PGN, { workers: 1, rangeBytes: 8192, maxAttempts: 2, workerArgs: () => ['--crash-after', '1'] });
+    } catch (err) {
+      error = err;
+    }
+    expect(error && error.message).to.match(/failed 2 times/);
+  });
+
+  it('fails when every worker exits before taking a range', async function () {
+    let error = null;
+    try {
+      await ingestPGN(PGN, { workers: 2, rangeBytes: 8192, maxAttempts: 1, workerArgs: () => ['--crash-after', '0'] });
+    } catch (err) {
+      error = err;
+    }
+    expect(error && error.message).to.match(/all workers exited \(last exit code 1\)/);
+  });
+});